@@ -0,0 +1,193 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_BLAKE3_H_
+#define _SYNCDIR_BLAKE3_H_
+/*++
+Header of the source file providing the BLAKE3 engine (hash mode, 256-bit output). BLAKE3 is a collision-resistant tree hash: 
+the input is split in 1 KiB chunks, which are combined by a binary tree of parent nodes. Independent subtrees can therefore be 
+hashed in parallel, which SyncDir uses to hash large files on several cores.
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+
+
+
+#define SD_BLAKE3_BLOCK_SIZE    64                                      // Compression function input.
+#define SD_BLAKE3_CHUNK_SIZE    1024                                    // Leaf size of the hash tree.
+#define SD_BLAKE3_DIGEST_SIZE   32                                      // 256-bit digest.
+#define SD_BLAKE3_MAX_DEPTH     54                                      // Enough for 2^64 bytes of input.
+#define SD_BLAKE3_SIMD_DEGREE   8                                       // Number of chunks hashed at once (one per vector lane).
+
+#define SD_BLAKE3_SEGMENT_SIZE  (1024 * 1024)                           // Unit of parallel work. Must be a power of 2 multiple of the 
+                                                                        // chunk size, so that each segment is a whole subtree.
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// BLAKE3_CHUNK_STATE - State of the chunk (tree leaf) currently being hashed.
+//
+typedef struct _BLAKE3_CHUNK_STATE
+{
+    DWORD   ChainingValue[8];                                           // Chaining value of the blocks compressed so far.
+    QWORD   ChunkCounter;                                               // Index of the chunk in the whole input.
+    BYTE    Block[SD_BLAKE3_BLOCK_SIZE];                                // Pending block.
+    BYTE    BlockLength;                                                // Number of bytes in Block.
+    BYTE    BlocksCompressed;                                           // Number of blocks of the chunk already compressed.
+} BLAKE3_CHUNK_STATE, *PBLAKE3_CHUNK_STATE;
+
+
+
+//
+// BLAKE3_CONTEXT - Streaming state of one BLAKE3 computation.
+//
+typedef struct _BLAKE3_CONTEXT
+{
+    BLAKE3_CHUNK_STATE  Chunk;                                          // Current (last) chunk.
+    QWORD               ChunkCounterBase;                               // First chunk of the (sub)tree hashed by this context.
+    DWORD               StackLength;                                    // Number of pending subtree chaining values.
+    DWORD               Stack[SD_BLAKE3_MAX_DEPTH][8];                  // Chaining values of complete, not yet merged subtrees.
+} BLAKE3_CONTEXT, *PBLAKE3_CONTEXT;
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// Blake3Init
+//
+void
+Blake3Init(
+    __out BLAKE3_CONTEXT    *Context
+    );
+/*++
+Description:
+    The routine initializes a BLAKE3 context, before any data is hashed with Blake3Update().
+Arguments:
+    - Context: Pointer to the context to be initialized. The caller provides the storage space.
+Return value:
+    None.
+--*/
+
+
+
+//
+// Blake3Update
+//
+void
+Blake3Update(
+    __inout BLAKE3_CONTEXT  *Context,
+    __in const void         *Data,
+    __in size_t             DataLength
+    );
+/*++
+Description:
+    The routine adds DataLength bytes from Data to the hash computation represented by Context. The result does not depend on how
+    the input is split between calls.
+Arguments:
+    - Context: Pointer to an initialized context.
+    - Data: Pointer to the bytes to be hashed.
+    - DataLength: Number of bytes at Data.
+Return value:
+    None.
+--*/
+
+
+
+//
+// Blake3Final
+//
+void
+Blake3Final(
+    __inout BLAKE3_CONTEXT  *Context,
+    __out BYTE              *Digest
+    );
+/*++
+Description:
+    The routine completes the hash computation (merges the pending subtrees up to the root) and outputs the 32 bytes digest.
+Arguments:
+    - Context: Pointer to the context.
+    - Digest: Pointer to where the routine outputs the digest. Storage of at least SD_BLAKE3_DIGEST_SIZE bytes is provided by the caller.
+Return value:
+    None.
+--*/
+
+
+
+//
+// Blake3HashOfFileDescriptorParallel
+//
+SDSTATUS
+Blake3HashOfFileDescriptorParallel(
+    __in __int32    FileDescriptor,
+    __in QWORD      FileSize,
+    __in DWORD      NumberOfThreads,
+    __out BYTE      *Digest
+    );
+/*++
+Description:
+    The routine outputs the BLAKE3 digest of the first FileSize bytes of the file identified by FileDescriptor. The file is split in 
+    segments of SD_BLAKE3_SEGMENT_SIZE bytes, read with pread() and hashed as independent subtrees by NumberOfThreads threads (the
+    calling thread included). The segment chaining values are merged into the root at the end. The file offset is not used.
+Arguments:
+    - FileDescriptor: Descriptor of the file, open for reading.
+    - FileSize: Number of bytes to be hashed. The file must not shrink while it is hashed.
+    - NumberOfThreads: Number of threads hashing segments (at least 1).
+    - Digest: Pointer to where the routine outputs the digest. Storage of at least SD_BLAKE3_DIGEST_SIZE bytes is provided by the caller.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// Blake3HashMany
+//
+void
+Blake3HashMany(
+    __in DWORD          NumberOfInputs,
+    __in const BYTE     **Inputs,
+    __in const size_t   *InputLengths,
+    __out BYTE          (*Digests)[SD_BLAKE3_DIGEST_SIZE]
+    );
+/*++
+Description:
+    The routine outputs the BLAKE3 digests of NumberOfInputs independent inputs, hashing SD_BLAKE3_SIMD_DEGREE inputs at once
+    (multi-buffer, one input per vector lane). Meant for many small inputs (e.g. small files).
+Arguments:
+    - NumberOfInputs: Number of inputs.
+    - Inputs: Pointer to the NumberOfInputs pointers to the inputs.
+    - InputLengths: Pointer to the NumberOfInputs input lengths, in bytes.
+    - Digests: Pointer to where the routine outputs the NumberOfInputs digests.
+Return value:
+    None.
+--*/
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_BLAKE3_H_
@@ -0,0 +1,120 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_CDC_H_
+#define _SYNCDIR_CDC_H_
+/*++
+Header of the source file providing the content-defined chunking of files (FastCDC). The chunk boundaries depend only on the content
+(a rolling "gear" hash over the bytes), not on the offsets: an insertion shifts the data, but the chunks after it stay the same. The
+client and the server chunk the files in the same way, so the server can find any chunk it already stores, in any file (see
+PACKET_CHUNK).
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+#include "syncdir_hash.h"
+
+#include <pthread.h>
+
+
+
+#define SD_CDC_MIN_FILE_SIZE (1024 * 1024)                              // Smaller files are not chunked (whole file transfers).
+#define SD_CDC_MAX_FILE_SIZE (4ULL * 1024 * 1024 * 1024)                // Larger files are streamed whole (bounded chunk lists).
+#define SD_CDC_MIN_CHUNK_SIZE (16 * 1024)                               // Chunk sizes: min, normal (average), max.
+#define SD_CDC_AVG_CHUNK_SIZE (64 * 1024)
+#define SD_CDC_MAX_CHUNK_SIZE (256 * 1024)
+#define SD_CDC_MAX_HOLE_SIZE SD_DATA_HOLE_MAX_SIZE                      // Hole chunks (zeros, no hash code): longer holes are split.
+#define SD_CDC_MAX_CHUNKS (SD_CDC_MAX_FILE_SIZE / SD_CDC_MIN_CHUNK_SIZE + 1)    // Max. chunks of a file (see CdcChunksOfFile()).
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// CDC_CHUNK - One chunk of a file.
+//
+typedef struct _CDC_CHUNK
+{
+    QWORD   Offset;                                                     // Offset of the chunk in the file.
+    DWORD   Size;                                                       // Size of the chunk, in bytes.
+    char    HashCode[SD_MAX_HASH_CODE_LENGTH + 1];                      // Hash code of the chunk content (negotiated algorithm). "": hole.
+} CDC_CHUNK, *PCDC_CHUNK;
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// CdcNextChunkSize
+//
+DWORD
+CdcNextChunkSize(
+    __in const BYTE *Data,
+    __in size_t     Length
+    );
+/*++
+Description:
+    The routine returns the size of the chunk starting at Data. Length is the number of bytes available: at least
+    SD_CDC_MAX_CHUNK_SIZE, unless Data holds the end of the file.
+Arguments:
+    - Data: Pointer to the start of the chunk.
+    - Length: Number of bytes available at Data.
+Return value:
+    The size of the chunk, in bytes (at most SD_CDC_MAX_CHUNK_SIZE, and at most Length).
+--*/
+
+
+
+//
+// CdcChunksOfFile
+//
+SDSTATUS
+CdcChunksOfFile(
+    __in HASH_ALGORITHM     Algorithm,
+    __in __int32            FileDescriptor,
+    __in_opt const BYTE     *FileContent,
+    __in QWORD              FileSize,
+    __out CDC_CHUNK         **Chunks,
+    __out DWORD             *NumberOfChunks
+    );
+/*++
+Description:
+    The routine splits the content of a file into chunks (see CdcNextChunkSize()) and outputs them, with their hash codes. The content
+    is taken from FileContent, if the caller already has it in memory, otherwise it is read from FileDescriptor (FileSize bytes, from
+    offset 0). The holes of a sparse file (found with FileDescriptor) and the chunks holding only zeros are output as hole chunks, with
+    an empty hash code.
+Arguments:
+    - Algorithm: The hash algorithm of the chunk hash codes.
+    - FileDescriptor: Descriptor of the file, open for reading (or -1, with FileContent: no holes are looked for).
+    - FileContent: Optional. Pointer to the content of the file (FileSize bytes).
+    - FileSize: Size of the file, in bytes.
+    - Chunks: Pointer to where the routine outputs the array of chunks (allocated by the routine, freed by the caller with free()).
+    - NumberOfChunks: Pointer to where the routine outputs the number of chunks.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. the file was truncated meanwhile).
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_CDC_H_
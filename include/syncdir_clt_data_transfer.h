@@ -15,12 +15,19 @@ Header for the source files related to all information transfer towards the Sync
 
 
 #include "syncdir_clt_def_types.h"
+#include "syncdir_dir_digest.h"
+#include "syncdir_delta.h"
+#include "syncdir_cdc.h"
+#include "syncdir_clt_governor.h"
 #include <set>
 
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <poll.h>
+#include <linux/errqueue.h>
 
 
 //extern __int32 gCltSock;     // Just declaration (extern).
@@ -54,21 +61,234 @@ Return value:
 --*/
 
 
+//
+// CltNegotiateSessionWithServer
+//
+extern "C"				// Need it in syncdir_clt_main.h, so make it callable by C compiler.
+SDSTATUS
+CltNegotiateSessionWithServer(
+    __in __int32    CltSock
+    );
+/*++
+Description:
+    The routine performs the handshake with the SyncDir server, right after connection (see PACKET_HELLO). The client announces 
+    its supported hash algorithms and its preferred one (SD_CLT_HASH_ALGORITHM); the server chooses. On success, gHashAlgorithm
+    holds the content hash algorithm of the session and gCompressionCodec the compression codec of the data frames.
+Arguments:
+    - CltSock: Descriptor representing the socket connection with the SyncDir server application.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. no common hash algorithm).
+--*/
+
+
+//
+// CltOpenDataConnections
+//
+extern "C"				// Need it in syncdir_clt_main.h, so make it callable by C compiler.
+SDSTATUS
+CltOpenDataConnections(
+    __in    DWORD   SrvPort, 
+    __in    char    *SrvIP
+    );
+/*++
+Description:
+    The routine opens the data connections granted by the server at handshake (see PACKET_DATA_CONNECTION), and starts their
+    sending threads. The whole files are then sent in ranges over them (see PACKET_STRIPE_HEADER).
+Arguments:
+    - SrvPort: Server port to connect to.
+    - SrvIP: Server IP address to connect to (in human readable format "x.x.x.x").
+Return value:
+    STATUS_SUCCESS on success (possibly with fewer data connections, or none), STATUS_WARNING if some data connections could not be
+    opened.
+--*/
+
+
+//
+// CltCloseDataConnections
+//
+extern "C"				// Need it in syncdir_clt_main.h, so make it callable by C compiler.
+void
+CltCloseDataConnections(
+    void
+    );
+/*++
+Description:
+    The routine waits until the ranges queued are sent (or the connections fail), stops the sending threads and closes the data
+    connections.
+Arguments:
+    None.
+Return value:
+    None.
+--*/
+
+
+//
+// BuildDirDigestsOfClientTree
+//
+SDSTATUS
+BuildDirDigestsOfClientTree(
+    __in const char                                         *DirFullPath,
+    __in const char                                         *DirRelativePath,
+    __inout std::unordered_map<std::string, std::string>    & DirDigestHMap,
+    __inout std::unordered_map<std::string, std::vector<std::string> > & SubdirsHMap,
+    __out std::string                                       & DirDigest
+    );
+/*++
+Description:
+    The routine computes the digests (see DirDigestOfEntries()) of the DirFullPath directory and of all its subdirectories. The
+    digests are stored in DirDigestHMap, and the subdirectories of each directory in SubdirsHMap, by relative paths.
+Arguments:
+    - DirFullPath: Pointer to the string containing the full path of the directory.
+    - DirRelativePath: Pointer to the string containing the relative path of the directory.
+    - DirDigestHMap: Reference to the hash map where the routine stores the digests (key: relative path of the directory).
+    - SubdirsHMap: Reference to the hash map where the routine stores the relative paths of the subdirectories of each directory.
+    - DirDigest: Reference to where the routine outputs the digest of the DirFullPath directory ("" if unknown).
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+//
+// ReconcileDirDigestsWithServer
+//
+SDSTATUS
+ReconcileDirDigestsWithServer(
+    __in DIR_WATCH                                          *Watches,
+    __inout std::unordered_map<std::string, FILE_INFO>      &FileInfoHMap,
+    __in __int32                                            CltSock
+    );
+/*++
+Description:
+    The routine compares the directory tree of the client with the server one (Merkle directory digests, see PACKET_DIR_DIGEST),
+    descending only into the directories that differ. The events (FileInfo's) of the directories found identical on the server
+    (including their subtrees) are removed from FileInfoHMap, so they are not sent. Called once, at startup.
+Arguments:
+    - Watches: Pointer to the array of directory watches (index 0: main directory).
+    - FileInfoHMap: Reference to the hash map of FILE_INFO structures built for all the files (see BuildEventsForAllSubdirFiles()).
+    - CltSock: Descriptor representing the socket connection with the SyncDir server application.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
 //
 // SendFileToServer
 //
 SDSTATUS
 SendFileToServer(
-    __in DWORD      FileSize,
-    __in char       *FileFullPath,
-    __in __int32    CltSock
+    __in QWORD          FileSize,
+    __in __int32        FileDescriptor,
+    __in_opt const BYTE *FileContent,
+    __in __int32        CltSock
+    );
+/*++
+Description: 
+    The routine sends the content of a file to a server address. The content is taken from FileContent, if the caller already has 
+    it in memory, otherwise it is read from FileDescriptor, starting at offset 0.
+Arguments:
+    - FileSize: Size of the file to be sent, in bytes.
+    - FileDescriptor: Descriptor of the file, open for reading. Used only if FileContent is NULL.
+    - FileContent: Optional. Pointer to the content of the file (FileSize bytes).
+    - CltSock: Descriptor representing the socket connection with the SyncDir server application.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+//
+// SendFileRangeToServer
+//
+SDSTATUS
+SendFileRangeToServer(
+    __in QWORD          Offset,
+    __in QWORD          Length,
+    __in __int32        FileDescriptor,
+    __in_opt const BYTE *FileContent,
+    __in __int32        CltSock
     );
 /*++
 Description: 
-    The routine sends the content of a file to a server address.
+    The routine sends Length bytes of the content of a file, from Offset, as data frames (see PACKET_DATA_HEADER). The content is
+    taken from FileContent, if the caller already has it in memory, otherwise it is read from FileDescriptor.
+Arguments:
+    - Offset: Offset of the first byte to send, in the file.
+    - Length: Number of bytes to send.
+    - FileDescriptor: Descriptor of the file, open for reading. Used only if FileContent is NULL.
+    - FileContent: Optional. Pointer to the content of the whole file.
+    - CltSock: Descriptor representing the socket connection with the SyncDir server application.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+//
+// SendDeltaToServer
+//
+SDSTATUS
+SendDeltaToServer(
+    __in QWORD          FileSize,
+    __in __int32        FileDescriptor,
+    __in_opt const BYTE *FileContent,
+    __in __int32        CltSock
+    );
+/*++
+Description: 
+    The routine sends the content of a file as a delta against the server copy (see PACKET_DELTA_HEADER): it receives the block
+    signatures of the server copy, then sends only the data that does not match any block. If the server cannot rebuild the file,
+    the whole file is sent (see SendFileToServer()).
 Arguments:
     - FileSize: Size of the file to be sent, in bytes.
-    - FileFullPath: Pointer to the string containing the full path of the file (absolute path). 
+    - FileDescriptor: Descriptor of the file, open for reading. Used only if FileContent is NULL.
+    - FileContent: Optional. Pointer to the content of the file (FileSize bytes).
+    - CltSock: Descriptor representing the socket connection with the SyncDir server application.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+//
+// SendChunksToServer
+//
+SDSTATUS
+SendChunksToServer(
+    __in QWORD          FileSize,
+    __in __int32        FileDescriptor,
+    __in_opt const BYTE *FileContent,
+    __in __int32        CltSock,
+    __out BOOL          *IsStripeAsked
+    );
+/*++
+Description: 
+    The routine sends the content of a file as a list of content-defined chunks (see PACKET_CHUNK): it sends the sizes and hash codes
+    of the chunks, then only the content of the chunks the server does not have. If the server cannot assemble the file, the whole
+    file is sent (see SendFileToServer()). If the server has few of the chunks, it may ask for the whole file in ranges instead ("File
+    Stripes"): nothing more is sent, the caller sends the file as for a "File Stripes" answer to the MODIFY.
+Arguments:
+    - FileSize: Size of the file to be sent, in bytes.
+    - FileDescriptor: Descriptor of the file, open for reading. Used only if FileContent is NULL.
+    - FileContent: Optional. Pointer to the content of the file (FileSize bytes).
+    - CltSock: Descriptor representing the socket connection with the SyncDir server application.
+    - IsStripeAsked: Pointer to where the routine outputs TRUE if the server asked for the file in ranges, FALSE otherwise.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+//
+// SendBufferToServer
+//
+SDSTATUS
+SendBufferToServer(
+    __in const void     *Buffer,
+    __in size_t         BufferSize,
+    __in __int32        CltSock
+    );
+/*++
+Description: 
+    The routine sends BufferSize bytes to the server, resuming partial sends.
+Arguments:
+    - Buffer: Pointer to the data.
+    - BufferSize: Number of bytes to send.
     - CltSock: Descriptor representing the socket connection with the SyncDir server application.
 Return value:
     STATUS_SUCCESS on success, STATUS_FAIL otherwise.
@@ -154,17 +374,26 @@ SendModifyToServer(
     __in PACKET_OP  *OpToSend,
     __in char       *FileRelativePath,
     __in char       *FileFullPath,
-    __in DWORD      FileSize,
-    __in __int32    CltSock
+    __in QWORD                  FileSize,
+    __in_opt const char         *HashCodeOnServer,
+    __inout MODIFY_PIPELINE     &Pipeline,
+    __in __int32                CltSock
     );
 /*++
 Description: 
-    The routine sends a file modify operation to a server address.
+    The routine sends a file modify operation to a server address, without waiting for the answer: the operation stays in flight in
+    Pipeline, and its content is sent later by CompleteModifiesOnServer(). The file is read once: its content is kept in memory (up 
+    to SD_CLT_SINGLE_PASS_BUFFER_LIMIT bytes) while it is hashed, and sent from there if the server does not have it already.
+    Small regular files the server does not have (up to SD_CLT_BATCH_MAX_FILE_SIZE bytes) are added to the batch of Pipeline instead
+    (see PACKET_BATCH_HEADER): no MODIFY is sent for them.
 Arguments:
     - OpToSend: Pointer to the packet containing the operation information.
     - FileRelativePath: Pointer to the relative path of the file (relative to SyncDir main directory).
     - FileFullPath: Pointer to the full path of the file.
-    - FileSize: Size of the file concerned by the operation.
+    - FileSize: Size of the file concerned by the operation (as known at event processing; the size sent is the one read).
+    - HashCodeOnServer: Hash code of the file content, if the server holds it (see QueryContentsOnServer()): the file is then not
+    opened, if unchanged since hashed. NULL otherwise.
+    - Pipeline: Reference to the MODIFY operations in flight. The operation is added to it.
     - CltSock: Descriptor representing the socket connection with the SyncDir server application.
 Return value: 
     STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
@@ -172,6 +401,47 @@ Return value:
 --*/
 
 
+//
+// CompleteModifiesOnServer
+//
+SDSTATUS
+CompleteModifiesOnServer(
+    __inout MODIFY_PIPELINE     &Pipeline,
+    __in size_t                 MaxInFlight,
+    __in __int32                CltSock
+    );
+/*++
+Description: 
+    The routine completes the oldest MODIFY operations in flight, until at most MaxInFlight remain: it receives the answers of the
+    server, and sends the contents the server does not have (opMODIFYDATA, see PACKET_MODIFY_REPLY).
+Arguments:
+    - Pipeline: Reference to the MODIFY operations in flight.
+    - MaxInFlight: Number of operations that may stay in flight (0: complete all of them, and send the batch of small files).
+    - CltSock: Descriptor representing the socket connection with the SyncDir server application.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING is returned if some contents could not be sent (e.g. 
+    volatile files).
+--*/
+
+
+//
+// ReleaseModifyPipeline
+//
+void
+ReleaseModifyPipeline(
+    __inout MODIFY_PIPELINE &Pipeline
+    );
+/*++
+Description: 
+    The routine drops all the MODIFY operations in flight (e.g. after a failure), closing their files and freeing their contents,
+    and the batch of small files.
+Arguments:
+    - Pipeline: Reference to the MODIFY operations in flight.
+Return value: 
+    None.
+--*/
+
+
 
 //
 // SendDeleteToServer
@@ -232,6 +502,29 @@ Return value:
 --*/
 
 
+//
+// QueryContentsOnServer
+//
+SDSTATUS
+QueryContentsOnServer(
+    __in char                                               *MainDirFullPath,
+    __inout std::unordered_map<std::string, FILE_INFO>      &FileInfoHMap,
+    __in __int32                                            CltSock
+    );
+/*++
+Description: 
+    The routine asks the server, in one message, which of the contents to be sent by MODIFY's it already holds (see
+    PACKET_HASH_QUERY_HEADER), and sets the HashCode and IsContentOnServer fields of the FileInfo's. Only the hash codes of the hash
+    cache are sent (the small files not found in it are hashed first, together).
+Arguments:
+    - MainDirFullPath: Pointer to the full path of the main directory monitored by SyncDir client application.
+    - FileInfoHMap: Reference to the hash map containing the file information related to system events.
+    - CltSock: Descriptor representing the socket connection with the SyncDir server application.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
 //
 // SendAllFileInfoEventsToServer
 //
@@ -25,11 +25,20 @@ extern "C"
     #include "syncdir_utile.h"
 #endif
 
+#include "syncdir_hash.h"
+#include "syncdir_hash_cache.h"
+#include "syncdir_compress.h"
+#include "syncdir_uring.h"
+
 //#include <linux/inotify.h>
 #include <sys/inotify.h>
 
 #ifdef __cplusplus
     #include <vector>
+    #include <deque>
+    #include <thread>
+    #include <mutex>
+    #include <condition_variable>
 #endif 
 
 
@@ -45,6 +54,34 @@ extern "C"
 #define SD_MIN_TIME_BEFORE_SYNC     0
 #define SD_TIME_TRESHOLD_AT_SYNC    5
 #define SD_INITIAL_NR_OF_WATCHES    50
+#define SD_CLT_HASH_ALGORITHM       haBLAKE3                            // Preferred content hash algorithm (see HASH_ALGORITHM).
+#define SD_CLT_SINGLE_PASS_BUFFER_LIMIT (64 * 1024 * 1024)          // Files up to this size are read once (hashed and sent from memory).
+#define SD_CLT_COMPRESSION_CODEC    ccLZ                                // Requested compression of the data frames. ccNONE: off.
+#define SD_CLT_ZERO_COPY            TRUE                                // Send files without copies (sendfile(), MSG_ZEROCOPY).
+#define SD_CLT_ZERO_COPY_MIN_SIZE   (256 * 1024)                        // Smaller contents in memory are copied (cheaper than pinning).
+#define SD_CLT_SPARSE_FILES         TRUE                                // Send the holes of sparse files as lengths (SEEK_DATA/SEEK_HOLE).
+#define SD_CLT_LARGE_FILE_MIN_SIZE  (64 * 1024 * 1024)                  // Larger contents are read sequentially, ahead of the sends.
+#define SD_CLT_IO_URING             TRUE                                // Read large contents ahead with io_uring (several reads in flight).
+#define SD_CLT_READ_QUEUE_DEPTH     4                                   // Frames read ahead of the sends (2 - SD_URING_MAX_QUEUE_DEPTH).
+#define SD_CLT_PIPELINE_WINDOW      64                                  // MODIFY's in flight (sent, content not sent yet). 1: stop-and-wait.
+#define SD_CLT_PIPELINE_MEMORY_LIMIT (256 * 1024 * 1024)                // Bytes of file contents kept in memory by the MODIFY's in flight.
+#define SD_CLT_HASH_CACHE_SUFFIX    ".syncdir_hash_cache"               // Hash cache file: <main directory><suffix>. "" disables the cache.
+#define SD_CLT_DATA_CONNECTIONS     4                                   // Data connections requested (whole files). 0: control connection only.
+#define SD_CLT_STRIPE_RANGE_SIZE    (8 * 1024 * 1024)                   // Larger whole files are split into ranges of this size.
+#define SD_CLT_STRIPE_QUEUE_LIMIT   (64 * 1024 * 1024)                  // Bytes of ranges queued for the data connections (not sent yet).
+#define SD_CLT_BATCH_MAX_FILE_SIZE  (64 * 1024)                         // Smaller files not on the server are sent in batches. 0: off.
+#define SD_CLT_BATCH_MAX_SIZE       (4 * 1024 * 1024)                   // Bytes of one batch (at most SD_BATCH_MAX_SIZE).
+#define SD_CLT_RECONNECT_ATTEMPTS   10                                  // Reconnections in a row, once the server is lost. 0: exit.
+#define SD_CLT_RECONNECT_DELAY      5                                   // Seconds between two reconnection attempts.
+#define SD_CLT_CONNECTION_LOST_WAIT 1000                                // Milliseconds waited for the server end of a failed session.
+#define SD_CLT_SEND_RATE_LIMIT      0                                   // Bytes per second of file data sent. 0: unlimited.
+#define SD_CLT_READ_RATE_LIMIT      0                                   // Bytes per second read from the files. 0: unlimited.
+#define SD_CLT_READ_IOPS_LIMIT      0                                   // File reads per second. 0: unlimited.
+#define SD_CLT_RATE_BURST_MS        250                                 // Unused limit saved for later (milliseconds of the rate).
+#define SD_CLT_IDLE_IO_PRIORITY     FALSE                               // Idle I/O scheduling class: disk time only when unused.
+#define SD_CLT_LIMITS_SUFFIX        ".syncdir_limits"                   // Limits file: <main directory><suffix>, read again on SIGHUP.
+#define SD_CLT_SCHEDULE_AGING_RATE  (1024 * 1024)                       // Bytes of transfer cost forgiven per second waited by an event.
+#define SD_CLT_PRIORITIES_SUFFIX    ".syncdir_priorities"               // Path priorities file: <main directory><suffix>. "": none.
 
 #define SD_EVENT_SIZE (sizeof(struct inotify_event))
 #define SD_EVENT_BUFFER_SIZE (1024 * (SD_EVENT_SIZE + NAME_MAX + 1))        // see "man inotify".
@@ -76,6 +113,145 @@ typedef struct _DIR_WATCH_NODE
     std::vector<_DIR_WATCH_NODE*>   Subdirs;                    // Array of children (PDIR_WATCH_NODE's).
 } DIR_WATCH_NODE, *PDIR_WATCH_NODE;
 
+
+
+//
+// PENDING_MODIFY - MODIFY operation in flight: sent to the server, whose content was not sent yet (see PACKET_MODIFY_REPLY).
+//
+typedef struct _PENDING_MODIFY
+{
+    DWORD           RequestId;
+    PACKET_OP       Operation;                                  // As sent (opMODIFY or opFILMOVEDTO).
+    std::string     RelativePath;
+    std::string     FullPath;
+    char            HashCode[SD_MAX_HASH_CODE_LENGTH + 1];      // Content hash code (negotiated algorithm) + '\0'.
+    __int32         FileDescriptor;                             // File open at hashing time (-1 if not opened, see QueryContentsOnServer()). Owned.
+    BYTE            *FileContent;                               // Content read while hashing, or NULL (then read from FileDescriptor). Owned.
+    QWORD           FileSize;                                   // Size of the content hashed (as sent to the server).
+    BOOL            IsReplyReceived;
+    char            Reply[SD_SHORT_MSG_SIZE];                   // Server answer, once received.
+    QWORD           ResumeOffset;                               // "File Resume": bytes already held by the server. 0 otherwise.
+} PENDING_MODIFY, *PPENDING_MODIFY;
+
+
+
+//
+// MODIFY_PIPELINE - The MODIFY operations in flight, oldest first. The server answers them in this order. Small files are batched.
+//
+typedef struct _MODIFY_PIPELINE
+{
+    std::deque<PENDING_MODIFY>      Pending;
+    DWORD                           NextRequestId;
+    QWORD                           ContentBytes;               // Bytes of FileContent held by the pending MODIFY's.
+    std::vector<BYTE>               Batch;                      // Small files not sent yet (see PACKET_BATCH_HEADER), header first.
+    DWORD                           BatchEntries;
+    std::unordered_set<std::string> BatchPaths;                 // Relative paths of the files in Batch.
+} MODIFY_PIPELINE, *PMODIFY_PIPELINE;
+
+
+
+//
+// STRIPE_FILE - Whole file sent in ranges over the data connections (see PACKET_STRIPE_HEADER). Released with its last range.
+//
+typedef struct _STRIPE_FILE
+{
+    std::string     RelativePath;
+    __int32         FileDescriptor;                             // As taken from the PENDING_MODIFY. Owned.
+    BYTE            *FileContent;                               // As taken from the PENDING_MODIFY. Owned.
+    QWORD           FileSize;
+    DWORD           RemainingRanges;                            // Ranges not sent yet.
+} STRIPE_FILE, *PSTRIPE_FILE;
+
+
+
+//
+// STRIPE_RANGE - One range of a STRIPE_FILE, queued for a data connection.
+//
+typedef struct _STRIPE_RANGE
+{
+    DWORD           RequestId;
+    QWORD           Offset;
+    DWORD           Length;
+    STRIPE_FILE     *File;
+} STRIPE_RANGE, *PSTRIPE_RANGE;
+
+
+
+//
+// STRIPE_CONNECTION - One data connection of the session, with its sending thread.
+//
+typedef struct _STRIPE_CONNECTION
+{
+    __int32                     Sock;
+    std::thread                 Sender;                         // See StripeSenderWorker().
+    std::deque<STRIPE_RANGE>    Queue;                          // Ranges to send, in order.
+} STRIPE_CONNECTION, *PSTRIPE_CONNECTION;
+
+
+
+//
+// STRIPE_SENDER - State shared by the control thread and the sending threads of the data connections (see PACKET_DATA_CONNECTION).
+//
+typedef struct _STRIPE_SENDER
+{
+    std::mutex                      Lock;                       // Protects the queues, the files and the fields below.
+    std::condition_variable         QueueNotEmpty;              // Signaled for the senders: new range, or closing.
+    std::condition_variable         QueueNotFull;               // Signaled for the control thread: range sent, or failure.
+    std::deque<STRIPE_CONNECTION>   Connections;                // Stable addresses (used by the senders).
+    DWORD                           GrantedConnections;         // By the server, at handshake.
+    BYTE                            SessionKey[SD_SESSION_KEY_SIZE];
+    DWORD                           NextConnection;             // Round-robin.
+    QWORD                           QueuedBytes;                // Bytes of the ranges queued (at most SD_CLT_STRIPE_QUEUE_LIMIT).
+    BOOL                            IsClosing;
+    BOOL                            IsFailed;                   // A data connection failed: the server cannot complete its files.
+} STRIPE_SENDER, *PSTRIPE_SENDER;
+
+
+
+//
+// READ_AHEAD - Reading of a large range of a file ahead of the sends: a reader thread fills the buffers, in turns, while the sender
+// sends the ones already filled. With io_uring, the reads of all the free buffers are in flight at once.
+//
+typedef struct _READ_AHEAD
+{
+    std::mutex                  Lock;                           // Protects the fields below.
+    std::condition_variable     Changed;                        // Signaled: buffer filled or released, or stopping.
+    std::thread                 Reader;                         // See ReadAheadWorker().
+    __int32                     FileDescriptor;
+    QWORD                       Offset;                         // Range to read (in frames of up to SD_DATA_FRAME_SIZE bytes).
+    QWORD                       Length;
+    URING                       Ring;                           // Set up by the reader. Not set up: synchronous reads (pread()).
+    BYTE                        *Buffers[SD_CLT_READ_QUEUE_DEPTH];  // Aligned (SD_FILE_READ_BUFFER_ALIGNMENT). Filled in turns.
+    DWORD                       Sizes[SD_CLT_READ_QUEUE_DEPTH];     // Bytes read in each buffer.
+    BOOL                        IsFull[SD_CLT_READ_QUEUE_DEPTH];    // Filled by the reader, not released by the sender yet.
+    BOOL                        IsLast[SD_CLT_READ_QUEUE_DEPTH];    // Last frame: end of the range, or end of the file (truncated).
+    BOOL                        IsStopping;                     // The sender no longer waits for frames.
+} READ_AHEAD, *PREAD_AHEAD;
+
+
+
+//
+// PATH_PRIORITY - Priority declared for the files under a path (see SD_CLT_PRIORITIES_SUFFIX). The longest matching path applies.
+//
+typedef struct _PATH_PRIORITY
+{
+    std::string                 RelativePath;                   // "./<path>", without a trailing '/'. The file itself, or a directory.
+    __int32                     Priority;                       // Higher first. 0: default.
+} PATH_PRIORITY, *PPATH_PRIORITY;
+
+
+
+//
+// SCHEDULED_TRANSFER - A FileInfo to be sent, with its rank keys in the transfer schedule (see ScheduleFileInfoTransfers()).
+//
+typedef struct _SCHEDULED_TRANSFER
+{
+    std::string                 RelativePath;                   // Key of the FileInfo.
+    DWORD                       Class;                          // 0: directory. 1: no content to send. 2: content to send.
+    __int32                     Priority;                       // Priority of the path (higher first).
+    __int64                     Cost;                           // Bytes to send, minus the aging credit (lower first).
+} SCHEDULED_TRANSFER, *PSCHEDULED_TRANSFER;
+
 #endif //--> #ifdef __cplusplus
 // *********************** C++ only (end) ***********************
 
@@ -116,9 +292,11 @@ typedef struct _FILE_INFO
     char    FileName[255+1];                                            // Short name of the file.
     char    RelativePath[SD_MAX_PATH_LENGTH];                           // File path relative to the main directory.
     char    RealRelativePath[SD_MAX_PATH_LENGTH];                       // Only for sym links: path with all sub-paths resolved.
-    char    MD5Hash[32+1];                                              // 128-bit hash + '\0'.
+    char    HashCode[SD_MAX_HASH_CODE_LENGTH + 1];                      // Content hash code (negotiated algorithm) + '\0'.
+    BOOL    IsContentOnServer;                                          // The server holds HashCode (see QueryContentsOnServer()).
     DWORD   Inode;
-    DWORD   FileSize;                                                   // Size of the file, in bytes.
+    QWORD   FileSize;                                                   // Size of the file, in bytes (MODIFY's, see QueryContentsOnServer()).
+    QWORD   FirstEventTime;                                             // Time of the first event recorded (seconds, CLOCK_MONOTONIC).
     //BOOL    IsHardLink;                                               // Set upon inode comparison with all file inodes.
 
     BOOL    WasCreated;                                                 // File was created.
@@ -54,6 +54,19 @@ SendAllFileInfoEventsToServer(
 
 
 
+//
+// ReconcileDirDigestsWithServer: From syncdir_clt_data_transfer.h.
+//
+extern                                                                              // "extern" used for clarity.
+SDSTATUS
+ReconcileDirDigestsWithServer(
+    __in DIR_WATCH                                          *Watches,
+    __inout std::unordered_map<std::string, FILE_INFO>      &FileInfoHMap,
+    __in __int32                                            CltSock
+    );
+
+
+
 //
 // InitEventData
 //
@@ -72,6 +85,25 @@ Return value:
 
 
 
+//
+// PrehashFilesIntoHashCache
+//
+SDSTATUS
+PrehashFilesIntoHashCache(
+    __inout std::vector<std::string>    &FileFullPaths
+    );
+/*++
+Description: 
+    The routine hashes the files of FileFullPaths in batches (multi-buffer) and stores their hash codes in the hash cache, then
+    empties FileFullPaths.
+Arguments:
+    - FileFullPaths: Reference to the full paths of the files (small, regular, not in the cache).
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING if some of the files could not be hashed.
+--*/
+
+
+
 //
 // BuildEventsForAllSubdirFiles
 //
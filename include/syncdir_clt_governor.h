@@ -0,0 +1,171 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_CLT_GOVERNOR_H_
+#define _SYNCDIR_CLT_GOVERNOR_H_
+/*++
+Header of the source file providing the resource governor of the SyncDir client, so that the synchronization does not starve the
+applications of the host: token buckets limit the bandwidth of the file data sent to the server, and the bytes and the number of the
+file reads; the client may also take the idle I/O scheduling class (disk time only when no one else needs it). The limits are
+adjustable at runtime: the limits file is read again when the client receives SIGHUP.
+--*/
+
+
+
+#include "syncdir_clt_def_types.h"
+#include <pthread.h>
+#include <signal.h>
+#include <sys/syscall.h>
+
+
+
+#define SD_GOVERNOR_MIN_BURST       4096                                // Min. bytes granted at once, when limited (see TOKEN_BUCKET).
+#define SD_IOPRIO_WHO_PROCESS       1                                   // From linux/ioprio.h (not in every libc).
+#define SD_IOPRIO_CLASS_IDLE        3
+#define SD_IOPRIO_CLASS_SHIFT       13
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// TOKEN_BUCKET - Limit of one resource: Rate tokens (bytes, or reads) per second.
+//
+/*++
+The tokens unused are saved, up to Burst (SD_CLT_RATE_BURST_MS of Rate): an idle client may then send (or read) a little faster,
+for a short time. A caller takes its tokens at once, even if they are not there: the bucket goes into debt, and the caller waits for
+the time the debt takes to be refilled. Concurrent callers (the data connections, the hashing threads) thus share the Rate.
+--*/
+typedef struct _TOKEN_BUCKET
+{
+    QWORD       Rate;                                                   // Tokens per second. 0: unlimited.
+    QWORD       Burst;                                                  // Max. tokens saved. Also the max. granted at once.
+    double      Tokens;                                                 // Tokens available. Negative: debt of the callers waiting.
+    QWORD       LastRefillNs;                                           // Time of the last refill (CLOCK_MONOTONIC).
+} TOKEN_BUCKET, *PTOKEN_BUCKET;
+
+
+
+//
+// GOVERNOR - The limits of the client (process memory).
+//
+typedef struct _GOVERNOR
+{
+    TOKEN_BUCKET        SendBytes;                                      // File data sent to the server.
+    TOKEN_BUCKET        ReadBytes;                                      // Bytes read from the files.
+    TOKEN_BUCKET        ReadOperations;                                 // Reads from the files.
+    char                LimitsFilePath[SD_MAX_PATH_LENGTH];             // "" if there is no limits file.
+    pthread_mutex_t     Lock;
+} GOVERNOR, *PGOVERNOR;
+
+
+
+extern GOVERNOR gGovernor;          // declaration only (extern).
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// GovernorInit
+//
+SDSTATUS
+GovernorInit(
+    __in_opt const char     *LimitsFilePath
+    );
+/*++
+Description:
+    The routine sets the built-in limits (SD_CLT_SEND_RATE_LIMIT, SD_CLT_READ_RATE_LIMIT, SD_CLT_READ_IOPS_LIMIT), then the ones of
+    the limits file at LimitsFilePath, if any (see GovernorLoadLimits()). It installs the SIGHUP handler, which makes the limits file
+    read again, and limits the file reads of the hashing and chunking routines (see gReadQuotaRoutine). With SD_CLT_IDLE_IO_PRIORITY,
+    the calling thread takes the idle I/O scheduling class: called before any other thread is created, the whole client has it.
+Arguments:
+    - LimitsFilePath: Optional. Pointer to the full path of the limits file. NULL or "": the built-in limits only.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING if the limits file or the I/O priority could not be used
+    (the client goes on with the built-in limits).
+--*/
+
+
+
+//
+// GovernorLoadLimits
+//
+SDSTATUS
+GovernorLoadLimits(
+    void
+    );
+/*++
+Description:
+    The routine reads the limits file (gGovernor.LimitsFilePath), if any. Each line holds a name and a value, in units per second
+    (0: unlimited): "send_rate <bytes>", "read_rate <bytes>", "read_iops <reads>". The limits not named in the file keep their
+    built-in values. Lines starting with '#' are comments.
+Arguments:
+    None.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. unreadable limits file: the limits are not changed).
+--*/
+
+
+
+//
+// GovernorSendQuota
+//
+size_t
+GovernorSendQuota(
+    __in size_t     Wanted
+    );
+/*++
+Description:
+    The routine returns how many of the Wanted bytes of file data the caller may send now, waiting for the send rate limit to allow
+    them: all of them if the rate is unlimited, otherwise at most the burst of the limit. The caller sends at most this many bytes,
+    then asks again for the rest. If the limits file must be read again (SIGHUP), it is read first.
+Arguments:
+    - Wanted: Number of bytes the caller is about to send.
+Return value:
+    The number of bytes allowed (at most Wanted; not 0, unless Wanted is 0).
+--*/
+
+
+
+//
+// GovernorReadQuota
+//
+size_t
+GovernorReadQuota(
+    __in size_t     Wanted
+    );
+/*++
+Description:
+    The routine returns how many of the Wanted bytes the caller may read now from a file (one read), waiting for the read limits
+    (bytes, and reads per second) to allow them. Same as GovernorSendQuota(), otherwise. Used as gReadQuotaRoutine.
+Arguments:
+    - Wanted: Number of bytes the caller is about to read.
+Return value:
+    The number of bytes allowed (at most Wanted; not 0, unless Wanted is 0).
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_CLT_GOVERNOR_H_
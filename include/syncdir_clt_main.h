@@ -15,6 +15,12 @@ Header for the source file of the SyncDir client launch routine.
 
 
 #include "syncdir_clt_def_types.h"
+#include "syncdir_clt_governor.h"
+
+#include <sys/socket.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 
 
 
@@ -56,8 +62,11 @@ MainCltRoutine(
 /*++
 Description: 
     The routine verifies and validates all command-line arguments of SyncDir launch (MainArgc and MainArgv arguments), then 
-    executes 2 routine calls: CltReturnConnectedSocket and CltMonitorPartition. The former creates a socket connection to the SyncDir server
-    and the latter launches the client partition monitoring, which also loops the server update procedures.
+    runs the sessions with the server. Each one executes 4 routine calls: CltReturnConnectedSocket, CltNegotiateSessionWithServer,
+    CltOpenDataConnections and CltMonitorPartition. The first creates a socket connection to the SyncDir server, the second agrees
+    with the server on the session parameters (e.g. content hash algorithm), the third opens the data connections granted (for whole
+    files) and the last launches the client partition monitoring, which also loops the server update procedures. If the connection
+    to the server is lost, the routine reconnects (at most SD_CLT_RECONNECT_ATTEMPTS times in a row) and starts a new session.
 Arguments:
     - MainArgc: Length of the MainArgv array, i.e. number of command-line arguments provided at SyncDir client startup. 
     - MainArgv: Pointer to the array of command-line arguments (strings) provided at SyncDir client launch.
@@ -81,6 +90,40 @@ CltReturnConnectedSocket(
 
 
 
+//
+// CltNegotiateSessionWithServer
+//
+extern                          // From syncdir_clt_data_transfer.h ("extern" used just for clarity).
+SDSTATUS
+CltNegotiateSessionWithServer(
+    __in __int32    CltSock
+    );
+
+
+
+//
+// CltOpenDataConnections
+//
+extern                          // From syncdir_clt_data_transfer.h ("extern" used just for clarity).
+SDSTATUS
+CltOpenDataConnections(
+    __in    DWORD   SrvPort, 
+    __in    char    *SrvIP
+    );
+
+
+
+//
+// CltCloseDataConnections
+//
+extern                          // From syncdir_clt_data_transfer.h ("extern" used just for clarity).
+void
+CltCloseDataConnections(
+    void
+    );
+
+
+
 //
 // CltMonitorPartition
 //
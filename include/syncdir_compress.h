@@ -0,0 +1,143 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_COMPRESS_H_
+#define _SYNCDIR_COMPRESS_H_
+/*++
+Header of the source file providing the compression of the file contents sent whole (data frames). The codec is built in: a fast
+LZ77 block codec (LZ4-like sequences of literals and back references, within 64 KB), so no external library is needed. The client
+and the server agree on the codec when the connection is established (see PACKET_HELLO); each data frame is compressed on its own
+(see SD_DATA_FLAG_COMPRESSED).
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+
+
+
+#define SD_COMPRESSION_MIN_FILE_SIZE 1024                               // Smaller files are sent as they are.
+#define SD_COMPRESSION_SAMPLE_SIZE (64 * 1024)                          // Bytes at the start of a file, compressed to test it.
+#define SD_COMPRESSION_MIN_SAVING 10                                    // Percent. Less on the sample: file sent uncompressed.
+
+#define SD_LZ_HASH_BITS 14                                              // Match finder: 2^14 entries (64 KB on the stack).
+#define SD_LZ_MIN_MATCH 4
+#define SD_LZ_MAX_OFFSET 65535
+#define SD_LZ_LAST_LITERALS 5                                           // A block always ends with (at least) 5 literals.
+#define SD_LZ_MATCH_START_LIMIT 12                                      // No match starts in the last 12 bytes of a block.
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// COMPRESSION_CODEC - Compression codecs of the data frames.
+//
+typedef enum _COMPRESSION_CODEC
+{
+    ccNONE = 0,                                                         // No compression.
+    ccLZ = 1,                                                           // Built-in LZ block codec.
+    ccUNKNOWN
+} COMPRESSION_CODEC;
+
+
+
+extern COMPRESSION_CODEC gCompressionCodec;                             // Codec of the session. Declaration only (extern).
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// GetCompressionCodecName
+//
+const char*
+GetCompressionCodecName(
+    __in COMPRESSION_CODEC Codec
+    );
+/*++
+Description:
+    The routine returns the name of a compression codec (for logging).
+Arguments:
+    - Codec: The compression codec.
+Return value:
+    The name of the codec ("unknown" for an invalid value).
+--*/
+
+
+
+//
+// CompressBlock
+//
+size_t
+CompressBlock(
+    __in COMPRESSION_CODEC  Codec,
+    __in const BYTE         *Source,
+    __in size_t             SourceSize,
+    __out BYTE              *Destination,
+    __in size_t             DestinationCapacity
+    );
+/*++
+Description:
+    The routine compresses SourceSize bytes into Destination. A DestinationCapacity smaller than the source makes the routine give up
+    as soon as the output would not fit: the caller only gets the outputs that save enough.
+Arguments:
+    - Codec: The compression codec (not ccNONE).
+    - Source: Pointer to the data to compress.
+    - SourceSize: Size of the data to compress, in bytes.
+    - Destination: Pointer to the output buffer.
+    - DestinationCapacity: Size of the output buffer, in bytes.
+Return value:
+    The size of the compressed data, or 0 if it does not fit in DestinationCapacity bytes (or on invalid parameters).
+--*/
+
+
+
+//
+// DecompressBlock
+//
+SDSTATUS
+DecompressBlock(
+    __in COMPRESSION_CODEC  Codec,
+    __in const BYTE         *Source,
+    __in size_t             SourceSize,
+    __out BYTE              *Destination,
+    __in size_t             DestinationSize
+    );
+/*++
+Description:
+    The routine decompresses the output of CompressBlock(). The input comes from the network: it is fully validated, nothing is read
+    or written out of the buffers.
+Arguments:
+    - Codec: The compression codec (not ccNONE).
+    - Source: Pointer to the compressed data.
+    - SourceSize: Size of the compressed data, in bytes.
+    - Destination: Pointer to the output buffer.
+    - DestinationSize: Exact size of the decompressed data, in bytes.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (corrupt data, or other size than DestinationSize).
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_COMPRESS_H_
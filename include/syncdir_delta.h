@@ -0,0 +1,241 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_DELTA_H_
+#define _SYNCDIR_DELTA_H_
+/*++
+Header of the source file providing the delta transfers of modified files (rsync algorithm). The server splits its copy of the file
+into blocks and sends their signatures: a weak rolling checksum and a strong digest. The client slides a window over the new content,
+one byte at a time, and looks the rolling checksum up in the index of the signatures; the strong digest confirms the matches. Only
+the data between the matched blocks is sent (see PACKET_DELTA_HEADER).
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+#include "syncdir_hash.h"
+
+#include <arpa/inet.h>
+
+
+
+#define SD_DELTA_MIN_FILE_SIZE (256 * 1024)                             // Smaller server copies: the whole file is sent.
+#define SD_DELTA_MIN_BLOCK_SIZE 2048                                    // Block size: sqrt(file size), within these bounds.
+#define SD_DELTA_MAX_BLOCK_SIZE (128 * 1024)
+#define SD_DELTA_MAX_LITERAL_SIZE (64 * 1024)                           // Max. data of one SD_DELTA_OP_LITERAL.
+#define SD_DELTA_NO_MATCH 0xFFFFFFFF                                    // Block index: no matching block.
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// DELTA_INDEX - Index of the block signatures of a server copy, searched by the client (host byte order).
+//
+typedef struct _DELTA_INDEX
+{
+    HASH_ALGORITHM      Algorithm;                                      // Algorithm of the strong digests.
+    DWORD               BlockSize;
+    DWORD               NumberOfBlocks;
+    PACKET_DELTA_BLOCK  *Blocks;                                        // Signatures, by block index. Owned by the caller.
+    DWORD               *SortedBlocks;                                  // Block indexes, sorted by tag, then by weak checksum.
+    DWORD               *TagTable;                                      // 65536 + 1 entries: range of each tag in SortedBlocks.
+} DELTA_INDEX, *PDELTA_INDEX;
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// DeltaBlockSize
+//
+DWORD
+DeltaBlockSize(
+    __in QWORD FileSize
+    );
+/*++
+Description:
+    The routine returns the block size used for the signatures of a file of FileSize bytes: about the square root of the size (so
+    that both the signatures and the unmatched data stay small), within [SD_DELTA_MIN_BLOCK_SIZE, SD_DELTA_MAX_BLOCK_SIZE].
+Arguments:
+    - FileSize: Size of the server copy of the file, in bytes.
+Return value:
+    The block size, in bytes.
+--*/
+
+
+
+//
+// DeltaWeakChecksum
+//
+DWORD
+DeltaWeakChecksum(
+    __in const BYTE *Data,
+    __in DWORD      Length
+    );
+/*++
+Description:
+    The routine returns the weak (rolling) checksum of Length bytes: two 16-bit sums, the plain one in the low half and the
+    position-weighted one in the high half. The checksum of the next window is derived in constant time (see DeltaFindMatch()).
+Arguments:
+    - Data: Pointer to the data.
+    - Length: Number of bytes.
+Return value:
+    The checksum.
+--*/
+
+
+
+//
+// DeltaStrongHashes
+//
+SDSTATUS
+DeltaStrongHashes(
+    __in HASH_ALGORITHM     Algorithm,
+    __in DWORD              NumberOfBlocks,
+    __in const BYTE         **Blocks,
+    __in const size_t       *BlockLengths,
+    __out BYTE              (*StrongHashes)[SD_DELTA_STRONG_HASH_SIZE]
+    );
+/*++
+Description:
+    The routine outputs the strong digests of NumberOfBlocks blocks: the first SD_DELTA_STRONG_HASH_SIZE bytes of their digests
+    (negotiated algorithm). The blocks are hashed together (see HashMany()).
+Arguments:
+    - Algorithm: The hash algorithm.
+    - NumberOfBlocks: Number of blocks.
+    - Blocks: Pointer to the NumberOfBlocks pointers to the blocks.
+    - BlockLengths: Pointer to the NumberOfBlocks block lengths, in bytes.
+    - StrongHashes: Pointer to where the NumberOfBlocks digests are output.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// DeltaSignaturesOfFile
+//
+SDSTATUS
+DeltaSignaturesOfFile(
+    __in HASH_ALGORITHM         Algorithm,
+    __in __int32                FileDescriptor,
+    __in DWORD                  BlockSize,
+    __in DWORD                  NumberOfBlocks,
+    __out PACKET_DELTA_BLOCK    *Blocks
+    );
+/*++
+Description:
+    The routine outputs the signatures of the first NumberOfBlocks blocks of BlockSize bytes of a file (server side). The weak
+    checksums are output in network byte order, ready to be sent.
+Arguments:
+    - Algorithm: The hash algorithm of the strong digests.
+    - FileDescriptor: Descriptor of the file, open for reading.
+    - BlockSize: Size of the blocks, in bytes.
+    - NumberOfBlocks: Number of blocks (the file has at least NumberOfBlocks * BlockSize bytes).
+    - Blocks: Pointer to where the NumberOfBlocks signatures are output.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. the file was truncated meanwhile).
+--*/
+
+
+
+//
+// DeltaBuildIndex
+//
+SDSTATUS
+DeltaBuildIndex(
+    __in HASH_ALGORITHM         Algorithm,
+    __in DWORD                  BlockSize,
+    __in DWORD                  NumberOfBlocks,
+    __in PACKET_DELTA_BLOCK     *Blocks,
+    __out DELTA_INDEX           *Index
+    );
+/*++
+Description:
+    The routine builds the index of the block signatures received from the server (client side). The weak checksums of Blocks must
+    be in host byte order. Blocks must stay valid while the index is used. The index is freed by DeltaFreeIndex().
+Arguments:
+    - Algorithm: The hash algorithm of the strong digests.
+    - BlockSize: Size of the blocks, in bytes.
+    - NumberOfBlocks: Number of blocks.
+    - Blocks: Pointer to the NumberOfBlocks signatures.
+    - Index: Pointer to the index to initialize.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// DeltaFreeIndex
+//
+void
+DeltaFreeIndex(
+    __inout DELTA_INDEX *Index
+    );
+/*++
+Description:
+    The routine frees the memory of an index built by DeltaBuildIndex().
+Arguments:
+    - Index: Pointer to the index.
+Return value:
+    None.
+--*/
+
+
+
+//
+// DeltaFindMatch
+//
+SDSTATUS
+DeltaFindMatch(
+    __in DELTA_INDEX    *Index,
+    __in const BYTE     *Data,
+    __in size_t         Length,
+    __inout size_t      *Offset,
+    __inout DWORD       *Checksum,
+    __inout BOOL        *IsChecksumValid,
+    __out DWORD         *BlockIndex
+    );
+/*++
+Description:
+    The routine slides a window of BlockSize bytes over Data, from Offset, rolling the weak checksum, until the window matches a
+    block of the index (weak checksum, then strong digest) or reaches the end of Data.
+Arguments:
+    - Index: Pointer to the index of the block signatures.
+    - Data: Pointer to the data.
+    - Length: Number of bytes of Data.
+    - Offset: Pointer to the offset of the first window to check. Output: offset of the matching window, or of the first window
+    not checked yet (reaching past Length).
+    - Checksum: Pointer to the rolling checksum of the window at Offset. Kept between calls.
+    - IsChecksumValid: Pointer to the validity flag of Checksum (FALSE: recomputed from Data). The caller sets it to FALSE whenever
+    Offset or Data is changed by the caller.
+    - BlockIndex: Pointer to where the index of the matching block is output, or SD_DELTA_NO_MATCH.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_DELTA_H_
@@ -0,0 +1,107 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_DIR_DIGEST_H_
+#define _SYNCDIR_DIR_DIGEST_H_
+/*++
+Header of the source file providing the directory digests (Merkle tree) used at startup reconciliation. The digest of a directory is
+the hash (negotiated algorithm) of its entries, sorted by name: content hash codes for files, digests for subdirectories. Hence, two
+directories with equal digests have identical subtrees. The client and the server compute the digests in the same (canonical) way,
+so that they can compare their trees by exchanging only the digests of the directories that differ (see PACKET_DIR_DIGEST).
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+#include "syncdir_hash.h"
+
+
+
+#define SD_DIR_DIGEST_ENTRY_FILE        'F'                             // Regular file. HashCode: content hash code.
+#define SD_DIR_DIGEST_ENTRY_DIRECTORY   'D'                             // Directory. HashCode: directory digest.
+#define SD_DIR_DIGEST_ENTRY_SYMLINK     'L'                             // Symbolic link. No HashCode.
+#define SD_DIR_DIGEST_ENTRY_OTHER       'O'                             // Other file types. No HashCode.
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// DIR_DIGEST_ENTRY - One entry (file or subdirectory) of a directory, as hashed into the directory digest.
+//
+typedef struct _DIR_DIGEST_ENTRY
+{
+    char    Type;                                                       // SD_DIR_DIGEST_ENTRY_*.
+    char    Name[SD_MAX_FILENAME_LENGTH];                               // Short name.
+    char    HashCode[SD_MAX_HASH_CODE_LENGTH + 1];                      // Hash code or digest (files, directories). "" if unknown.
+} DIR_DIGEST_ENTRY, *PDIR_DIGEST_ENTRY;
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// DirDigestEntryType
+//
+char
+DirDigestEntryType(
+    __in mode_t FileMode
+    );
+/*++
+Description:
+    The routine returns the type of directory entry (SD_DIR_DIGEST_ENTRY_*) of a file, given its mode (as returned by lstat()).
+Arguments:
+    - FileMode: The mode of the file.
+Return value:
+    The entry type.
+--*/
+
+
+
+//
+// DirDigestOfEntries
+//
+SDSTATUS
+DirDigestOfEntries(
+    __in HASH_ALGORITHM         Algorithm,
+    __inout DIR_DIGEST_ENTRY    *Entries,
+    __in DWORD                  NumberOfEntries,
+    __out char                  *DirDigest
+    );
+/*++
+Description:
+    The routine outputs the digest of a directory, given its NumberOfEntries entries (in any order; the routine sorts them by name).
+    If the hash code of a file or the digest of a subdirectory is unknown (""), the digest of the directory is unknown as well: the
+    routine outputs "", which never matches.
+Arguments:
+    - Algorithm: The hash algorithm.
+    - Entries: Pointer to the entries of the directory. Sorted by the routine.
+    - NumberOfEntries: Number of entries.
+    - DirDigest: Pointer to where the digest is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_DIR_DIGEST_H_
@@ -25,12 +25,22 @@ Header containing the essential SyncDir structure types and definitions. Require
 #include <sys/types.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <endian.h>
 
 #ifdef __cplusplus
     #include "SyncDirException.h"
     #include <iostream>
     #include <string>
     #include <unordered_map>
+    #include <unordered_set>
+    #include <deque>
+    #include <map>
+    #include <vector>
+    #include <thread>                                                           // Before the __in/__out macros (used by libstdc++).
+    #include <mutex>
+    #include <condition_variable>
+    #include <chrono>
+    #include <algorithm>
     
     using namespace std;
 #endif
@@ -49,12 +59,38 @@ Header containing the essential SyncDir structure types and definitions. Require
 //#define SD_STDLOG(fs) fs
 //  --> usage: SD_STDLOG(gLog), for a global file stream.
 
-#define SD_PACKET_DATA_SIZE 1024
+#define SD_DATA_FRAME_SIZE (4 * 1024 * 1024)                                    // Max. payload of the data frames sent (see PACKET_DATA_HEADER).
+#define SD_DATA_FRAME_MAX_SIZE (64 * 1024 * 1024)                               // Max. payload of the data frames accepted.
 #define SD_MAX_PATH_LENGTH 4096
 #define SD_MAX_FILENAME_LENGTH 256
 
 #define SD_SHORT_MSG_SIZE 20
-#define SD_HASH_CODE_LENGTH 32
+#define SD_MAX_HASH_CODE_LENGTH 64                                              // Longest hash code (hex chars), over all hash algorithms.
+
+#define SD_FILE_READ_BUFFER_SIZE (1024 * 1024)                                 // Size of the buffers used for reading file contents.
+#define SD_FILE_READ_BUFFER_ALIGNMENT 4096                                      // Page alignment of the file reading buffers.
+
+#define SD_PROTOCOL_MAGIC 'SDir'                                                // First field of PACKET_HELLO.
+#define SD_PROTOCOL_VERSION 18
+#define SD_SESSION_KEY_SIZE 16                                                  // Random bytes identifying the data connections of a session.
+#define SD_MAX_DATA_CONNECTIONS 16                                              // Max. data connections of a session (see PACKET_DATA_CONNECTION).
+#define SD_DATA_CONNECTION_TIMEOUT 5                                            // Seconds to open / accept the data connections of a session.
+
+#define SD_HASH_QUERY_MAX_HASHES 65536                                         // Max. hash codes of one PACKET_HASH_QUERY_HEADER.
+#define SD_DIR_DIGEST_MAX_DIRS 65536                                           // Max. directories of one round of PACKET_DIR_DIGEST.
+#define SD_BATCH_MAX_SIZE (16 * 1024 * 1024)                                    // Max. bytes of one batch accepted (see PACKET_BATCH_HEADER).
+
+#define SD_BATCH_FLAG_CREATE 0x1                                                // PACKET_BATCH_ENTRY flags: empty file created (no hash code).
+
+#define SD_DATA_FLAG_EOF 0x1                                                    // PACKET_DATA_HEADER flags: last frame of the file.
+#define SD_DATA_FLAG_COMPRESSED 0x2                                             // Content compressed with the codec of the session.
+#define SD_DATA_FLAG_HOLE 0x4                                                   // No content: DataSize bytes of hole (zeros).
+#define SD_DATA_HOLE_MAX_SIZE 0x80000000                                        // Max. DataSize of one hole frame.
+
+#define SD_DELTA_STRONG_HASH_SIZE 16                                            // Bytes of the block digests kept by delta transfers.
+#define SD_DELTA_OP_END 0                                                       // PACKET_DELTA_OP types.
+#define SD_DELTA_OP_LITERAL 1
+#define SD_DELTA_OP_COPY 2
 
 #define SUCCESS(x) (0 <= x)
 #define SUCCESS_KEEP_WARNING(x) (SUCCESS(x) ? x : STATUS_SUCCESS)               // Returns a success status. Includes warning, if case.
@@ -63,6 +99,7 @@ Header containing the essential SyncDir structure types and definitions. Require
 //#define TRUE 1
 //#define FALSE 0
 #define SD_MIN(a,b) (a <= b ? a : b)
+#define SD_MAX(a,b) (a >= b ? a : b)
 
 
 
@@ -100,6 +137,9 @@ typedef enum _OP_TYPE
     opFILMOVE,
     opMOVE,
     opMODIFY,
+    opMODIFYDATA,             // Content of a MODIFY answered earlier (see PACKET_MODIFY_REPLY).
+    opHASHQUERY,              // Which contents the server holds (see PACKET_HASH_QUERY_HEADER).
+    opMODIFYBATCH,            // Small files, with their contents (see PACKET_BATCH_HEADER).
     opUNKNOWN
 } OP_TYPE;
 
@@ -130,20 +170,248 @@ typedef struct _PACKET_OP
     WORD        RelativePathLength;                                             // Length of file's relative path.
     WORD        RealRelativePathLength;                                         // Length of file's real relative path (for ftSYMLINK only).
     WORD        OldRelativePathLength;                                          // Length of file's old relative path (for MOVE operations).
-    // char MD5Hash[32+1];    
 } PACKET_OP, *PPACKET_OP;
 
 
 
 //
-// PACKET_FILE - Packet used for transfering file content chunks.
+// PACKET_HELLO - Handshake packet, exchanged once, right after the connection is established. All fields in network byte order.
+//
+/*++
+The client sends its protocol version, the hash algorithms it supports and the one it prefers. The server replies with the algorithm
+chosen for the session (the algorithm of its hash index, if the client supports it), or with haUNKNOWN if they cannot agree.
+The client also asks for a compression codec of the data frames (COMPRESSION_CODEC); the server grants it if it supports it, or
+replies ccNONE (no compression). Finally, the client asks for a number of data connections (see PACKET_DATA_CONNECTION); the server
+grants at most as many, along with the key of the session.
+--*/
+typedef struct _PACKET_HELLO
+{
+    DWORD   Magic;                                                              // SD_PROTOCOL_MAGIC.
+    DWORD   ProtocolVersion;                                                    // SD_PROTOCOL_VERSION.
+    DWORD   SupportedHashAlgorithms;                                            // Mask of SD_HASH_ALGORITHM_BIT(HASH_ALGORITHM) flags.
+    DWORD   HashAlgorithm;                                                      // Client: preferred. Server: chosen for the session.
+    DWORD   CompressionCodec;                                                   // Client: requested. Server: chosen for the session.
+    DWORD   DataConnections;                                                    // Client: requested. Server: granted (0: none).
+    BYTE    SessionKey[SD_SESSION_KEY_SIZE];                                    // Server: random key of the session. Client: zeros.
+} PACKET_HELLO, *PPACKET_HELLO;
+
+
+
+//
+// PACKET_DATA_CONNECTION - First packet of a data connection, echoed by the server once accepted. Index in network byte order.
+//
+/*++
+Right after the handshake, the client opens the data connections granted, to the same server address, one after the other. Each one
+starts with a PACKET_DATA_CONNECTION carrying the key of the session; the server accepts it if the key matches, and echoes the packet.
+The data connections carry the contents of the whole files only (see PACKET_STRIPE_HEADER); everything else, including the order of
+the operations, stays on the first connection (the control connection). A data connection not accepted within
+SD_DATA_CONNECTION_TIMEOUT seconds is dropped: the session goes on with the ones accepted (possibly none).
+--*/
+typedef struct _PACKET_DATA_CONNECTION
+{
+    DWORD   Magic;                                                              // SD_PROTOCOL_MAGIC.
+    DWORD   Index;                                                              // 0 to DataConnections - 1.
+    BYTE    SessionKey[SD_SESSION_KEY_SIZE];                                    // As received in the PACKET_HELLO of the server.
+} PACKET_DATA_CONNECTION, *PPACKET_DATA_CONNECTION;
+
+
+
+//
+// PACKET_DIR_DIGEST - One directory of a startup reconciliation round. Followed by the relative path of the directory.
+//
+/*++
+Right after the handshake, the client compares its directory tree with the server one, from the main directory downwards. At each
+round, the client sends the number of directories (DWORD, network byte order, at most SD_DIR_DIGEST_MAX_DIRS), then one
+PACKET_DIR_DIGEST (and path) per directory. The server replies with one byte per directory: 1 if its digest is equal (identical
+subtree), 0 otherwise. The next round holds the subdirectories of the directories that differ (and the directories left over by a
+round at the limit). A round of 0 directories ends the reconciliation.
+--*/
+typedef struct _PACKET_DIR_DIGEST
+{
+    WORD    DirRelativePathLength;                                              // Network byte order. Excluding '\0'.
+    char    DirDigest[SD_MAX_HASH_CODE_LENGTH + 1];                             // Negotiated algorithm. "" if unknown (never equal).
+} PACKET_DIR_DIGEST, *PPACKET_DIR_DIGEST;
+
+
+
+//
+// PACKET_DATA_HEADER - Header of a data frame, used for transfering file contents. All fields in network byte order.
+//
+/*++
+A whole file is sent as its size (QWORD, big-endian), then as a sequence of data frames: one PACKET_DATA_HEADER, followed
+by exactly DataSize bytes of content (no padding). Frames hold up to SD_DATA_FRAME_SIZE bytes; the receiver accepts up to
+SD_DATA_FRAME_MAX_SIZE bytes. The last frame has the SD_DATA_FLAG_EOF flag (possibly with no content, e.g. if the file was
+truncated meanwhile). A frame with the SD_DATA_FLAG_COMPRESSED flag holds the size of its original content (DWORD, network byte
+order), then the content compressed with the codec of the session (see CompressBlock()): DataSize counts both.
+A frame with the SD_DATA_FLAG_HOLE flag has no content: DataSize is the length of a hole of a sparse file (within the file),
+that the receiver skips (the bytes read as zeros, without being allocated). A hole longer than SD_DATA_HOLE_MAX_SIZE is sent as
+several consecutive hole frames.
+--*/
+typedef struct _PACKET_DATA_HEADER
+{
+    DWORD   Flags;                                                              // SD_DATA_FLAG_* flags.
+    DWORD   DataSize;                                                           // Size of the content that follows, in bytes.
+} PACKET_DATA_HEADER, *PPACKET_DATA_HEADER;
+
+
+
+//
+// PACKET_MODIFY_REPLY - Answer of the server to a MODIFY (or FILMOVEDTO) operation. RequestId in network byte order.
 //
-typedef struct _PACKET_FILE
+/*++
+The client does not wait for the answer to a MODIFY before sending the next operations. After the hash code and the file size, each
+MODIFY carries a RequestId (DWORD, network byte order); the client keeps up to SD_CLT_PIPELINE_WINDOW of them in flight. The server
+answers each one as soon as it is received, in order: "File On Server" (local copy, done), or the way it wants the content ("File
+Delta", "File Chunks", "File Stripes", "File Resume", "File Not On Server"). The client sends the content later, as an opMODIFYDATA
+operation (same path, then the RequestId), and the server receives it as it answered. Operations other than MODIFY's are sent only
+when no MODIFY is in flight.
+"File Resume" answers a MODIFY whose content the server started to receive in an earlier session (connection lost): it holds the
+first Offset bytes of it, and asks for the rest only, as for "File Stripes" (see PACKET_STRIPE_HEADER), from Offset.
+--*/
+typedef struct _PACKET_MODIFY_REPLY
+{
+    DWORD   RequestId;                                                          // RequestId of the MODIFY answered.
+    DWORD   Reserved;                                                           // 0. Keeps Offset 8-byte aligned.
+    QWORD   Offset;                                                             // "File Resume": bytes already held (big-endian). 0 otherwise.
+    char    Message[SD_SHORT_MSG_SIZE];                                         // "File On Server", "File Delta", etc.
+} PACKET_MODIFY_REPLY, *PPACKET_MODIFY_REPLY;
+
+
+
+//
+// PACKET_STRIPE_HEADER - Start of a range of a whole file, sent on a data connection. All fields in network byte order.
+//
+/*++
+The server asks for the whole files in ranges ("File Stripes" instead of "File Not On Server", or instead of "Chunks Missing" after a
+chunk list, see PACKET_CHUNK): the opMODIFYDATA operation (path, RequestId) is followed by the number of ranges of the file (DWORD,
+network byte order) only. A client without data connections sends
+0 ranges, then the file on the control connection: its size (QWORD, big-endian) and its content (see PACKET_DATA_HEADER). For
+"File Resume", only the content from the Offset of the answer is sent: in ranges, or as its size and content. The content is split into
+ranges of SD_CLT_STRIPE_RANGE_SIZE bytes (a small file is one range), spread round-robin over the data connections. Each range is one
+PACKET_STRIPE_HEADER, then data frames (see PACKET_DATA_HEADER) holding at most Length bytes; the last one has the SD_DATA_FLAG_EOF
+flag. The server writes each range at its offset, as it arrives, and completes the opMODIFYDATA once all the ranges were received:
+the operations that follow on the control connection are executed after it, as without data connections.
+--*/
+typedef struct _PACKET_STRIPE_HEADER
+{
+    DWORD   RequestId;                                                          // RequestId of the MODIFY answered.
+    DWORD   Length;                                                             // Size of the range, in bytes.
+    QWORD   Offset;                                                             // Offset of the range in the file (big-endian).
+} PACKET_STRIPE_HEADER, *PPACKET_STRIPE_HEADER;
+
+
+
+//
+// PACKET_HASH_QUERY_HEADER - Batched query: which of the contents the server holds. All fields in network byte order.
+//
+/*++
+Before sending the operations of a batch, the client asks which of the contents to be sent by MODIFY's the server already holds, in
+one message: an opHASHQUERY operation (path "./"), then one PACKET_HASH_QUERY_HEADER, then NumberOfHashes items, each one being a
+hash code of the negotiated algorithm (including '\0') followed by the size of the content (QWORD, big-endian). The server
+replies with a bitmap of (NumberOfHashes + 7) / 8 bytes: bit (i % 8) of byte (i / 8) is set if it holds the content of item i.
+The answer is only a hint: the server still answers each MODIFY (see PACKET_MODIFY_REPLY), since the operations sent meanwhile may
+change what it holds.
+--*/
+typedef struct _PACKET_HASH_QUERY_HEADER
+{
+    DWORD   NumberOfHashes;                                                     // At most SD_HASH_QUERY_MAX_HASHES.
+} PACKET_HASH_QUERY_HEADER, *PPACKET_HASH_QUERY_HEADER;
+
+
+
+//
+// PACKET_BATCH_HEADER - Start of a batch of small files, with their contents (client to server). All fields in network byte order.
+//
+/*++
+The small regular files whose contents the server does not hold are not sent one MODIFY at a time: the client gathers them, and
+sends them in one message: an opMODIFYBATCH operation (path "./"), then one PACKET_BATCH_HEADER, then BatchSize bytes holding
+NumberOfEntries items. Each item is a PACKET_BATCH_ENTRY, the relative path (RelativePathLength chars, no '\0'), the hash code of
+the negotiated algorithm (including '\0'; zeros for SD_BATCH_FLAG_CREATE) and the FileSize bytes of the content.
+The server writes the files in order, in one pass, and does not answer: nothing has to be negotiated for a content it does not hold.
+--*/
+typedef struct _PACKET_BATCH_HEADER
+{
+    DWORD   NumberOfEntries;
+    DWORD   BatchSize;                                                          // Bytes following the header. At most SD_BATCH_MAX_SIZE.
+} PACKET_BATCH_HEADER, *PPACKET_BATCH_HEADER;
+
+
+
+//
+// PACKET_BATCH_ENTRY - One file of a batch (see PACKET_BATCH_HEADER). All fields in network byte order.
+//
+typedef struct _PACKET_BATCH_ENTRY
+{
+    WORD    RelativePathLength;
+    WORD    Flags;                                                              // SD_BATCH_FLAG_*.
+    DWORD   FileSize;                                                           // Bytes of content following the hash code.
+} PACKET_BATCH_ENTRY, *PPACKET_BATCH_ENTRY;
+
+
+
+//
+// PACKET_DELTA_HEADER - Start of the block signatures of a delta transfer (server to client). All fields in network byte order.
+//
+/*++
+When a modified file is not on the server, but the server has an older copy of it at the same path (large enough), the server replies
+"File Delta" and sends the signatures of the blocks of its copy: one PACKET_DELTA_HEADER, then NumberOfBlocks PACKET_DELTA_BLOCK's.
+The client replies with a stream of PACKET_DELTA_OP's (literal data, or references to blocks of the server copy), ended by
+SD_DELTA_OP_END. The server rebuilds the file, checks its hash code and replies "Delta OK", or "Delta Failed" (then the whole file is
+sent, in data frames).
+--*/
+typedef struct _PACKET_DELTA_HEADER
+{
+    DWORD   BlockSize;                                                          // Size of the blocks (the last, shorter one is not sent).
+    DWORD   NumberOfBlocks;                                                     // Number of PACKET_DELTA_BLOCK's that follow.
+} PACKET_DELTA_HEADER, *PPACKET_DELTA_HEADER;
+
+
+
+//
+// PACKET_DELTA_BLOCK - Signature of one block of the server copy of a file.
+//
+typedef struct _PACKET_DELTA_BLOCK
+{
+    DWORD   WeakChecksum;                                                       // Rolling checksum (network byte order).
+    BYTE    StrongHash[SD_DELTA_STRONG_HASH_SIZE];                              // Prefix of the block digest (negotiated algorithm).
+} PACKET_DELTA_BLOCK, *PPACKET_DELTA_BLOCK;
+
+
+
+//
+// PACKET_DELTA_OP - One instruction of a delta transfer (client to server). All fields in network byte order.
+//
+typedef struct _PACKET_DELTA_OP
+{
+    DWORD   Type;                                                               // SD_DELTA_OP_*.
+    DWORD   Value;                                                              // LITERAL: data size (followed by data). COPY: first block.
+    DWORD   Count;                                                              // COPY: number of consecutive blocks.
+} PACKET_DELTA_OP, *PPACKET_DELTA_OP;
+
+
+
+
+//
+// PACKET_CHUNK - One chunk of a chunk transfer (client to server).
+//
+/*++
+A modified file is sent along with its hash code and its size (QWORD, big-endian). When the content is not on the server, no older
+copy can be used for a delta, the file is large enough (SD_CDC_MIN_FILE_SIZE, up to SD_CDC_MAX_FILE_SIZE) and the server has a chunk
+index, the server replies "File Chunks". The client splits the file into content-defined chunks (see CdcChunksOfFile()) and sends
+their number (DWORD, network byte order), then one PACKET_CHUNK per chunk. A hole entry (empty hash code, up to SD_CDC_MAX_HOLE_SIZE
+bytes) stands for a hole of a sparse file or a chunk holding only zeros. The server replies "Chunks Missing", then one byte per
+chunk: 1 if it has the chunk (in any of its files, or earlier in the list, or a hole entry), 0 otherwise. The client sends the
+content of the missing chunks, in order: each run of consecutive missing chunks as data frames (see PACKET_DATA_HEADER) holding
+exactly the bytes of the run, the last one with the SD_DATA_FLAG_EOF flag. The server assembles the file, checks its hash code and
+replies "Chunks OK", or "Chunks Failed" (then the whole file is sent, as its size and data frames). The server may answer the chunk
+list with "Chunks Failed" instead (the file cannot be assembled): the whole file is sent at once. Or, if it has few of the chunks,
+with "File Stripes": the whole file is sent in ranges, as after a "File Stripes" answer to the MODIFY (see PACKET_STRIPE_HEADER).
+--*/
+typedef struct _PACKET_CHUNK
 {
-    BOOL    IsEOF;                                                              // Flag indicating if EOF was met.
-    DWORD   ChunkSize;                                                          // Size of the FileChunk data (from 0 to SD_PACKET_DATA_SIZE).
-    char    FileChunk[SD_PACKET_DATA_SIZE];                                     // File content.
-} PACKET_FILE, *PPACKET_FILE;
+    DWORD   ChunkSize;                                                          // Network byte order.
+    char    HashCode[SD_MAX_HASH_CODE_LENGTH + 1];                              // Negotiated algorithm.
+} PACKET_CHUNK, *PPACKET_CHUNK;
 
 
 
@@ -180,7 +448,7 @@ typedef struct _PACKET_OP_MODIFY
 {
     FILE_TYPE FileType;
     WORD PathLength;    // Including '\0'.
-    char MD5Hash[32+1];
+    char HashCode[SD_MAX_HASH_CODE_LENGTH + 1];
 } PACKET_OP_MODIFY, *PPACKET_OP_MODIFY;
 
 
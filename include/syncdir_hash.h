@@ -0,0 +1,333 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_HASH_H_
+#define _SYNCDIR_HASH_H_
+/*++
+Header of the source file providing the content hash framework. Every hash algorithm (provider) is used through the same streaming
+interface (HashInit, HashUpdate, HashFinal) and outputs its digest as a lowercase hexadecimal string (the "hash code").
+The client and the server agree on one algorithm when the connection is established (see PACKET_HELLO).
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+#include "syncdir_md5.h"
+#include "syncdir_murmur3.h"
+#include "syncdir_blake3.h"
+
+
+
+#define SD_HASH_ALGORITHM_BIT(Algorithm) (1 << (Algorithm))             // Algorithm flag, in masks of supported algorithms.
+#define SD_SUPPORTED_HASH_ALGORITHMS (SD_HASH_ALGORITHM_BIT(haMD5) | SD_HASH_ALGORITHM_BIT(haMURMUR3) | SD_HASH_ALGORITHM_BIT(haBLAKE3))
+
+#define SD_HASH_MAX_THREADS 0                                           // Max. threads hashing one large file. 0: number of online CPUs.
+#define SD_HASH_PARALLEL_MIN_SIZE (8 * SD_BLAKE3_SEGMENT_SIZE)          // Smaller files are hashed by the calling thread only.
+#define SD_HASH_BATCH_SIZE 64                                           // Max. files hashed together by HashOfFileBatch() (startup scans).
+#define SD_HASH_BATCH_MAX_FILE_SIZE (16 * 1024)                         // Larger files are hashed one by one, even in a batch.
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// HASH_ALGORITHM - Content hash algorithms (providers). Values are exchanged on the network: only append new ones.
+//
+typedef enum _HASH_ALGORITHM
+{
+    haMD5 = 0,                      // 128-bit. Compatibility (same hash codes as md5sum).
+    haMURMUR3 = 1,                  // MurmurHash3_x64_128. 128-bit, fast, non-cryptographic.
+    haBLAKE3 = 2,                   // 256-bit, collision-resistant tree hash. Vectorized, and multi-threaded for large files.
+    haUNKNOWN
+} HASH_ALGORITHM;
+
+
+
+//
+// HASH_PROVIDER - Description of a hash algorithm.
+//
+typedef struct _HASH_PROVIDER
+{
+    HASH_ALGORITHM  Algorithm;
+    const char      *Name;                                              // Human readable name (logs).
+    DWORD           DigestSize;                                         // In bytes. The hash code has 2 * DigestSize hex chars.
+} HASH_PROVIDER, *PHASH_PROVIDER;
+
+
+
+//
+// HASH_CONTEXT - Streaming state of one hash computation, for any of the algorithms.
+//
+typedef struct _HASH_CONTEXT
+{
+    HASH_ALGORITHM  Algorithm;
+    union
+    {
+        MD5_CONTEXT     Md5;
+        MURMUR3_CONTEXT Murmur3;
+        BLAKE3_CONTEXT  Blake3;
+    } Engine;
+} HASH_CONTEXT, *PHASH_CONTEXT;
+
+
+
+extern HASH_ALGORITHM gHashAlgorithm;                                   // Algorithm in use. Declaration only (extern).
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// GetHashProvider
+//
+const HASH_PROVIDER*
+GetHashProvider(
+    __in HASH_ALGORITHM Algorithm
+    );
+/*++
+Description:
+    The routine returns the description of the hash algorithm Algorithm.
+Arguments:
+    - Algorithm: The hash algorithm.
+Return value:
+    Pointer to the (static) provider description, or NULL if the algorithm is not supported.
+--*/
+
+
+
+//
+// HashCodeLength
+//
+DWORD
+HashCodeLength(
+    __in HASH_ALGORITHM Algorithm
+    );
+/*++
+Description:
+    The routine returns the length of the hash codes produced by Algorithm (number of hex chars, excluding '\0').
+Arguments:
+    - Algorithm: The hash algorithm.
+Return value:
+    The hash code length (at most SD_MAX_HASH_CODE_LENGTH), or 0 if the algorithm is not supported.
+--*/
+
+
+
+//
+// HashInit
+//
+SDSTATUS
+HashInit(
+    __out HASH_CONTEXT      *Context,
+    __in HASH_ALGORITHM     Algorithm
+    );
+/*++
+Description:
+    The routine initializes a hash computation with the algorithm Algorithm.
+Arguments:
+    - Context: Pointer to the context to be initialized. The caller provides the storage space.
+    - Algorithm: The hash algorithm.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. unsupported algorithm).
+--*/
+
+
+
+//
+// HashUpdate
+//
+void
+HashUpdate(
+    __inout HASH_CONTEXT    *Context,
+    __in const void         *Data,
+    __in size_t             DataLength
+    );
+/*++
+Description:
+    The routine adds DataLength bytes from Data to the hash computation represented by Context.
+Arguments:
+    - Context: Pointer to a context initialized with HashInit().
+    - Data: Pointer to the bytes to be hashed.
+    - DataLength: Number of bytes at Data.
+Return value:
+    None.
+--*/
+
+
+
+//
+// HashFinal
+//
+void
+HashFinal(
+    __inout HASH_CONTEXT    *Context,
+    __out char              *HashCode
+    );
+/*++
+Description:
+    The routine completes the hash computation and outputs the hash code (lowercase hex, '\0' terminated).
+Arguments:
+    - Context: Pointer to the context.
+    - HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+Return value:
+    None.
+--*/
+
+
+
+//
+// HashOfFileDescriptor
+//
+SDSTATUS
+HashOfFileDescriptor(
+    __in HASH_ALGORITHM     Algorithm,
+    __in __int32            FileDescriptor,
+    __out char              *HashCode
+    );
+/*++
+Description:
+    The routine outputs the hash code of the content of the file identified by FileDescriptor, which must be positioned at the start 
+    of the file. The content is streamed through a large page-aligned buffer. Large regular files are hashed by several threads, if 
+    the algorithm allows it (BLAKE3).
+Arguments:
+    - Algorithm: The hash algorithm.
+    - FileDescriptor: Descriptor of the file, open for reading.
+    - HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// HashAndReadFileDescriptor
+//
+SDSTATUS
+HashAndReadFileDescriptor(
+    __in HASH_ALGORITHM     Algorithm,
+    __in __int32            FileDescriptor,
+    __in size_t             ContentLimit,
+    __out BYTE              **Content,
+    __out QWORD             *ContentLength,
+    __out char              *HashCode
+    );
+/*++
+Description:
+    The routine reads the file identified by FileDescriptor (positioned at the start of the file) once, keeps its content in memory
+    and outputs its hash code, computed while reading. If the content exceeds ContentLimit bytes, it is hashed but not kept (the 
+    routine outputs NULL at Content), so that the caller can read it again from the same descriptor, only if needed.
+Arguments:
+    - Algorithm: The hash algorithm.
+    - FileDescriptor: Descriptor of the file, open for reading.
+    - ContentLimit: Maximum number of bytes kept in memory.
+    - Content: Pointer to where the routine outputs the address of the content (allocated by the routine, released by the caller with
+    free()), or NULL if the content was not kept.
+    - ContentLength: Pointer to where the routine outputs the number of bytes hashed (the file size, as read).
+    - HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// HashOfFile
+//
+SDSTATUS
+HashOfFile(
+    __in HASH_ALGORITHM     Algorithm,
+    __in const char         *FileFullPath,
+    __out char              *HashCode
+    );
+/*++
+Description:
+    The routine outputs the hash code of the content of the file at FileFullPath (symbolic links are followed).
+Arguments:
+    - Algorithm: The hash algorithm.
+    - FileFullPath: Pointer to the full path of the file.
+    - HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// HashMany
+//
+SDSTATUS
+HashMany(
+    __in HASH_ALGORITHM     Algorithm,
+    __in DWORD              NumberOfInputs,
+    __in const BYTE         **Inputs,
+    __in const size_t       *InputLengths,
+    __out char              (*HashCodes)[SD_MAX_HASH_CODE_LENGTH + 1]
+    );
+/*++
+Description:
+    The routine outputs the hash codes of NumberOfInputs independent inputs (e.g. the contents of many small files). MD5 and BLAKE3
+    hash several inputs at once, one per vector lane (multi-buffer); the other algorithms hash them one by one.
+Arguments:
+    - Algorithm: The hash algorithm.
+    - NumberOfInputs: Number of inputs.
+    - Inputs: Pointer to the NumberOfInputs pointers to the inputs.
+    - InputLengths: Pointer to the NumberOfInputs input lengths, in bytes.
+    - HashCodes: Pointer to where the NumberOfInputs hash codes are output.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// HashOfFileBatch
+//
+SDSTATUS
+HashOfFileBatch(
+    __in HASH_ALGORITHM     Algorithm,
+    __in DWORD              NumberOfFiles,
+    __in const char         **FileFullPaths,
+    __out char              (*HashCodes)[SD_MAX_HASH_CODE_LENGTH + 1],
+    __out_opt struct stat   *FileStats,
+    __out SDSTATUS          *Statuses
+    );
+/*++
+Description:
+    The routine outputs the hash codes of the contents of NumberOfFiles files (symbolic links are followed). The regular files of at
+    most SD_HASH_BATCH_MAX_FILE_SIZE bytes are read first and then hashed together by HashMany(); the other files are hashed one by
+    one, by HashOfFileDescriptor(). The failure of one file does not stop the others.
+Arguments:
+    - Algorithm: The hash algorithm.
+    - NumberOfFiles: Number of files. At most SD_HASH_BATCH_SIZE.
+    - FileFullPaths: Pointer to the NumberOfFiles full paths of the files.
+    - HashCodes: Pointer to where the NumberOfFiles hash codes are output.
+    - FileStats: Optional pointer to where the routine outputs the NumberOfFiles file statuses (as returned by fstat() before the
+    content was read).
+    - Statuses: Pointer to where the routine outputs the NumberOfFiles results (STATUS_SUCCESS or STATUS_FAIL, for each file).
+Return value:
+    STATUS_SUCCESS if all the files were hashed, STATUS_WARNING if some of them failed, STATUS_FAIL otherwise.
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_HASH_H_
@@ -0,0 +1,272 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_HASH_CACHE_H_
+#define _SYNCDIR_HASH_CACHE_H_
+/*++
+Header of the source file providing the persistent hash cache of the SyncDir client. The cache remembers the hash code of a file
+content together with the file identity (device, inode, size, modification and status change times, in nanoseconds), so that
+an unchanged file is not read again (e.g. at every client restart). The cache is a memory-mapped file, holding an open addressing
+hash table. It is only an optimization: it can be deleted at any time, and it is rebuilt if found invalid.
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+#include "syncdir_hash.h"
+#include <sys/mman.h>
+#include <pthread.h>
+
+
+
+#define SD_HASH_CACHE_MAGIC             'SDhc'
+#define SD_HASH_CACHE_VERSION           1                               // Increment at every change of the file layout.
+#define SD_HASH_CACHE_INITIAL_CAPACITY  4096                            // Number of entries (power of 2) of a new cache file.
+#define SD_HASH_CACHE_RACY_WINDOW_NS    (2ULL * 1000000000ULL)          // Files modified more recently are not cached (see below).
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// HASH_CACHE_HEADER - Start of the cache file. Followed by Capacity entries.
+//
+typedef struct _HASH_CACHE_HEADER
+{
+    DWORD   Magic;                                                      // SD_HASH_CACHE_MAGIC.
+    DWORD   Version;                                                    // SD_HASH_CACHE_VERSION.
+    QWORD   Capacity;                                                   // Number of entries. Power of 2.
+    QWORD   Count;                                                      // Number of used entries.
+} HASH_CACHE_HEADER, *PHASH_CACHE_HEADER;
+
+
+
+//
+// HASH_CACHE_ENTRY - Hash code of one file content, valid as long as the file identity is unchanged.
+//
+typedef struct _HASH_CACHE_ENTRY
+{
+    QWORD   Device;                                                     // Key: (Device, Inode).
+    QWORD   Inode;
+    QWORD   FileSize;                                                   // Validation: size and times must be unchanged.
+    QWORD   ModifyTimeNs;
+    QWORD   ChangeTimeNs;
+    DWORD   HashAlgorithm;                                              // HASH_ALGORITHM of HashCode.
+    DWORD   IsUsed;                                                     // Written last, when an entry is stored.
+    char    HashCode[SD_MAX_HASH_CODE_LENGTH + 1];
+} HASH_CACHE_ENTRY, *PHASH_CACHE_ENTRY;
+
+
+
+//
+// HASH_CACHE - The open cache (process memory).
+//
+typedef struct _HASH_CACHE
+{
+    __int32             FileDescriptor;                                 // -1 if the cache is not open (lookups always miss).
+    size_t              MapSize;
+    HASH_CACHE_HEADER   *Header;                                        // Start of the mapping.
+    HASH_CACHE_ENTRY    *Entries;                                       // Right after Header.
+    pthread_mutex_t     Lock;
+} HASH_CACHE, *PHASH_CACHE;
+
+
+
+extern HASH_CACHE gHashCache;       // declaration only (extern).
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// HashCacheOpen
+//
+SDSTATUS
+HashCacheOpen(
+    __in char   *CacheFilePath
+    );
+/*++
+Description:
+    The routine opens (creating it, if needed) the cache file at CacheFilePath and maps it in memory (gHashCache). An invalid cache
+    file (e.g. other version, truncated) is reset.
+Arguments:
+    - CacheFilePath: Pointer to the full path of the cache file.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (the cache stays closed, lookups miss).
+--*/
+
+
+
+//
+// HashCacheClose
+//
+void
+HashCacheClose(
+    void
+    );
+/*++
+Description:
+    The routine unmaps and closes the cache file, if open. The content is persisted by the kernel (shared mapping).
+Arguments:
+    None.
+Return value:
+    None.
+--*/
+
+
+
+//
+// HashCacheLookup
+//
+SDSTATUS
+HashCacheLookup(
+    __in const struct stat  *FileStat,
+    __in HASH_ALGORITHM     Algorithm,
+    __out char              *HashCode,
+    __out BOOL              *IsFound
+    );
+/*++
+Description:
+    The routine searches the cache for the hash code (computed with Algorithm) of the file described by FileStat. The hash code
+    is found only if the file identity (device, inode, size, modification and status change times) is unchanged since it was stored.
+Arguments:
+    - FileStat: Pointer to the status of the file (as returned by fstat()).
+    - Algorithm: The hash algorithm of the wanted hash code.
+    - HashCode: Pointer to where the hash code is output, if found. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is
+    provided by the caller.
+    - IsFound: Pointer to where the routine outputs TRUE if the hash code was found, FALSE otherwise.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// HashCacheStore
+//
+SDSTATUS
+HashCacheStore(
+    __in const struct stat  *FileStat,
+    __in HASH_ALGORITHM     Algorithm,
+    __in const char         *HashCode
+    );
+/*++
+Description:
+    The routine stores in the cache the hash code (computed with Algorithm) of the file described by FileStat, which must be the
+    status of the file taken before its content was read. Files modified within the last SD_HASH_CACHE_RACY_WINDOW_NS are not stored,
+    since a following modification could keep the same times (timestamp granularity).
+Arguments:
+    - FileStat: Pointer to the status of the file (as returned by fstat(), before hashing).
+    - Algorithm: The hash algorithm of HashCode.
+    - HashCode: Pointer to the hash code.
+Return value:
+    STATUS_SUCCESS on success (including when not stored, e.g. closed cache), STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// HashCacheIsOpen
+//
+BOOL
+HashCacheIsOpen(
+    void
+    );
+/*++
+Description:
+    The routine tells if the cache is open (i.e. if lookups can hit and stores are kept).
+Arguments:
+    None.
+Return value:
+    TRUE if the cache is open, FALSE otherwise.
+--*/
+
+
+
+//
+// HashCachePrehashFiles
+//
+SDSTATUS
+HashCachePrehashFiles(
+    __in HASH_ALGORITHM     Algorithm,
+    __in DWORD              NumberOfFiles,
+    __in const char         **FileFullPaths
+    );
+/*++
+Description:
+    The routine hashes NumberOfFiles files together (see HashOfFileBatch()) and stores their hash codes in the cache, if their
+    identities did not change while they were read. Used by the startup scan, for the small files not found in the cache.
+Arguments:
+    - Algorithm: The hash algorithm.
+    - NumberOfFiles: Number of files. At most SD_HASH_BATCH_SIZE.
+    - FileFullPaths: Pointer to the NumberOfFiles full paths of the files.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING if some of the files could not be hashed.
+--*/
+
+
+
+//
+// HashCacheHashOfFile
+//
+SDSTATUS
+HashCacheHashOfFile(
+    __in HASH_ALGORITHM     Algorithm,
+    __in const char         *FileFullPath,
+    __out char              *HashCode
+    );
+/*++
+Description:
+    The routine outputs the hash code of the content of the file at FileFullPath (symbolic links are followed): from the cache, if
+    the file is unchanged since its hash code was stored, otherwise by hashing the file (and storing the result).
+Arguments:
+    - Algorithm: The hash algorithm.
+    - FileFullPath: Pointer to the full path of the file.
+    - HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+
+//
+// IsSameFileIdentity
+//
+BOOL
+IsSameFileIdentity(
+    __in const struct stat  *FirstStat,
+    __in const struct stat  *SecondStat
+    );
+/*++
+Description:
+    The routine compares the identities (device, inode, size, modification and status change times) of two file status records.
+Arguments:
+    - FirstStat: Pointer to the first file status.
+    - SecondStat: Pointer to the second file status.
+Return value:
+    TRUE if the identities are equal, FALSE otherwise.
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_HASH_CACHE_H_
@@ -0,0 +1,148 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_MD5_H_
+#define _SYNCDIR_MD5_H_
+/*++
+Header of the source file providing the in-process MD5 engine (RFC 1321), used for hashing file contents on both SyncDir
+client and server, without spawning external processes.
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+
+
+
+#define SD_MD5_BLOCK_SIZE       64                                      // MD5 processes the message in 512-bit blocks.
+#define SD_MD5_DIGEST_SIZE      16                                      // 128-bit digest.
+#define SD_MD5_LANES            8                                       // Messages hashed at once by Md5HashMany().
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// MD5_CONTEXT - Streaming state of one MD5 computation.
+//
+typedef struct _MD5_CONTEXT
+{
+    DWORD   State[4];                                                   // Chaining variables A, B, C, D.
+    QWORD   TotalLength;                                                // Number of message bytes processed so far.
+    DWORD   BufferLength;                                               // Number of bytes pending in Buffer (less than a block).
+    BYTE    Buffer[SD_MD5_BLOCK_SIZE];                                  // Pending bytes of an incomplete block.
+} MD5_CONTEXT, *PMD5_CONTEXT;
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// Md5Init
+//
+void
+Md5Init(
+    __out MD5_CONTEXT   *Context
+    );
+/*++
+Description:
+    The routine initializes an MD5 context, before any data is hashed with Md5Update().
+Arguments:
+    - Context: Pointer to the context to be initialized. The caller provides the storage space.
+Return value:
+    None.
+--*/
+
+
+
+//
+// Md5Update
+//
+void
+Md5Update(
+    __inout MD5_CONTEXT *Context,
+    __in const void     *Data,
+    __in size_t         DataLength
+    );
+/*++
+Description:
+    The routine adds DataLength bytes from Data to the MD5 computation represented by Context. The routine can be called any number
+    of times, with chunks of any size, between Md5Init() and Md5Final().
+Arguments:
+    - Context: Pointer to an initialized MD5 context.
+    - Data: Pointer to the bytes to be hashed.
+    - DataLength: Number of bytes at Data.
+Return value:
+    None.
+--*/
+
+
+
+//
+// Md5Final
+//
+void
+Md5Final(
+    __inout MD5_CONTEXT *Context,
+    __out BYTE          *Digest
+    );
+/*++
+Description:
+    The routine completes the MD5 computation (padding and length) and outputs the 16 bytes digest. The context must be
+    re-initialized with Md5Init() before any new usage.
+Arguments:
+    - Context: Pointer to the MD5 context.
+    - Digest: Pointer to where the routine outputs the digest. Storage of at least SD_MD5_DIGEST_SIZE bytes is provided by the caller.
+Return value:
+    None.
+--*/
+
+
+
+//
+// Md5HashMany
+//
+void
+Md5HashMany(
+    __in DWORD          NumberOfInputs,
+    __in const BYTE     **Inputs,
+    __in const size_t   *InputLengths,
+    __out BYTE          (*Digests)[SD_MD5_DIGEST_SIZE]
+    );
+/*++
+Description:
+    The routine outputs the MD5 digests of NumberOfInputs independent messages, hashing SD_MD5_LANES messages at once (multi-buffer,
+    one message per vector lane). Meant for many small messages (e.g. small files).
+Arguments:
+    - NumberOfInputs: Number of messages.
+    - Inputs: Pointer to the NumberOfInputs pointers to the messages.
+    - InputLengths: Pointer to the NumberOfInputs message lengths, in bytes.
+    - Digests: Pointer to where the routine outputs the NumberOfInputs digests.
+Return value:
+    None.
+--*/
+
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_MD5_H_
@@ -0,0 +1,123 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_MURMUR3_H_
+#define _SYNCDIR_MURMUR3_H_
+/*++
+Header of the source file providing a streaming MurmurHash3 (x64, 128-bit variant) engine. It is a fast, non-cryptographic hash,
+used by SyncDir when content hashing speed matters more than collision resistance against crafted inputs.
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+
+
+
+#define SD_MURMUR3_BLOCK_SIZE   16                                      // MurmurHash3_x64_128 processes the input in 128-bit blocks.
+#define SD_MURMUR3_DIGEST_SIZE  16                                      // 128-bit digest.
+#define SD_MURMUR3_SEED         0                                       // Same seed on client and server.
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// MURMUR3_CONTEXT - Streaming state of one MurmurHash3_x64_128 computation.
+//
+typedef struct _MURMUR3_CONTEXT
+{
+    QWORD   H1;                                                         // The two 64-bit lanes of the hash state.
+    QWORD   H2;
+    QWORD   TotalLength;                                                // Number of message bytes processed so far.
+    DWORD   BufferLength;                                               // Number of bytes pending in Buffer (less than a block).
+    BYTE    Buffer[SD_MURMUR3_BLOCK_SIZE];                              // Pending bytes of an incomplete block.
+} MURMUR3_CONTEXT, *PMURMUR3_CONTEXT;
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// Murmur3Init
+//
+void
+Murmur3Init(
+    __out MURMUR3_CONTEXT   *Context
+    );
+/*++
+Description:
+    The routine initializes a MurmurHash3_x64_128 context (seed SD_MURMUR3_SEED), before any data is hashed with Murmur3Update().
+Arguments:
+    - Context: Pointer to the context to be initialized. The caller provides the storage space.
+Return value:
+    None.
+--*/
+
+
+
+//
+// Murmur3Update
+//
+void
+Murmur3Update(
+    __inout MURMUR3_CONTEXT *Context,
+    __in const void         *Data,
+    __in size_t             DataLength
+    );
+/*++
+Description:
+    The routine adds DataLength bytes from Data to the hash computation represented by Context. The result does not depend on how
+    the input is split between calls.
+Arguments:
+    - Context: Pointer to an initialized context.
+    - Data: Pointer to the bytes to be hashed.
+    - DataLength: Number of bytes at Data.
+Return value:
+    None.
+--*/
+
+
+
+//
+// Murmur3Final
+//
+void
+Murmur3Final(
+    __inout MURMUR3_CONTEXT *Context,
+    __out BYTE              *Digest
+    );
+/*++
+Description:
+    The routine completes the hash computation (tail and finalization mix) and outputs the 16 bytes digest: the first 64-bit lane,
+    then the second one, each in little-endian order.
+Arguments:
+    - Context: Pointer to the context.
+    - Digest: Pointer to where the routine outputs the digest. Storage of at least SD_MURMUR3_DIGEST_SIZE bytes is provided by the caller.
+Return value:
+    None.
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_MURMUR3_H_
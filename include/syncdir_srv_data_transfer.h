@@ -13,11 +13,23 @@
 
 #include "syncdir_srv_def_types.h"
 #include "syncdir_srv_hash_info_proc.h"
+#include "syncdir_delta.h"
 
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/random.h>
+#include <poll.h>
+#include <sys/xattr.h>
+#include <sys/statvfs.h>
+#include <sys/ioctl.h>
+
+
+
+#ifndef FICLONE                                                             // Reflink (Linux 4.5). Same as in <linux/fs.h>.
+    #define FICLONE _IOW(0x94, 9, int)
+#endif
 
 
 //
@@ -47,6 +59,74 @@ Return value:
 
 
 
+//
+// SrvNegotiateSessionWithClient
+//
+extern "C"                                                                  // Need it in syncdir_srv_main.h, so make it callable by C compiler.
+SDSTATUS
+SrvNegotiateSessionWithClient(
+    __in DWORD              SockConnID,
+    __inout STRIPE_RECEIVER &StripeReceiver
+    );
+/*++
+Description: 
+    The routine performs the handshake with a newly connected SyncDir client (see PACKET_HELLO). The server chooses the content hash 
+    algorithm of its hash index (gHashAlgorithm), provided that the client supports it. Otherwise, the client is told that no common
+    algorithm exists. The compression codec requested by the client is granted if supported (gCompressionCodec). The data 
+    connections requested are granted up to SD_SRV_DATA_CONNECTIONS, with a random key for the session.
+Arguments:
+    - SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+    - StripeReceiver: Data connections of the session. Receives the number of data connections granted and the key of the session.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. not a SyncDir client, or no common hash algorithm).
+--*/
+
+
+
+//
+// SrvAcceptDataConnections
+//
+extern "C"                                                                  // Need it in syncdir_srv_main.h, so make it callable by C compiler.
+SDSTATUS
+SrvAcceptDataConnections(
+    __in __int32            SrvSock,
+    __inout STRIPE_RECEIVER &StripeReceiver
+    );
+/*++
+Description: 
+    The routine accepts the data connections granted to the client at handshake (see PACKET_DATA_CONNECTION), on the listening
+    socket, during at most SD_DATA_CONNECTION_TIMEOUT seconds, and starts their receiving threads. The connections which do not 
+    present the key of the session, in order, are closed.
+Arguments:
+    - SrvSock: Listening socket of the server.
+    - StripeReceiver: Data connections of the session (see SrvNegotiateSessionWithClient()).
+Return value: 
+    STATUS_SUCCESS on success, STATUS_WARNING if fewer data connections were accepted (the session goes on with these), STATUS_FAIL
+    otherwise.
+--*/
+
+
+
+//
+// SrvCloseDataConnections
+//
+extern "C"                                                                  // Need it in syncdir_srv_main.h, so make it callable by C compiler.
+void
+SrvCloseDataConnections(
+    __inout STRIPE_RECEIVER &StripeReceiver
+    );
+/*++
+Description: 
+    The routine closes the data connections of the session, waits for their receiving threads to end and removes the files whose
+    ranges were not all received.
+Arguments:
+    - StripeReceiver: Data connections of the session.
+Return value: 
+    None.
+--*/
+
+
+
 //
 // RecvPacketOpAndFilePathFromClient
 //
@@ -70,13 +150,36 @@ Return value:
 --*/
 
 
+//
+// SrvReconcileDirDigestsWithClient
+//
+extern "C"                                                                  // Need it in syncdir_srv_main.h, so make it callable by C compiler.
+SDSTATUS
+SrvReconcileDirDigestsWithClient(
+    __in char                                                   *MainDirFullPath,
+    __in const std::unordered_map<std::string, HASH_INFO>       & HashInfoHMap,
+    __in DWORD                                                  SockConnID
+    );
+/*++
+Description: 
+    The routine answers the startup reconciliation of a newly connected SyncDir client (see PACKET_DIR_DIGEST): it computes the
+    digests of the server directories, then tells, for every directory queried by the client, if the digests are equal.
+Arguments:
+    - MainDirFullPath: Pointer to the full path of the server main directory.
+    - HashInfoHMap: Reference to the structure containing the file hash information.
+    - SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
 //
 // RecvFileFromClient
 //
 SDSTATUS
 RecvFileFromClient(
     __in char       *FileFullPath,
-    __out DWORD     *FileSize,
+    __out QWORD     *FileSize,
     __in DWORD      SockConnID
     );
 /*++
@@ -87,6 +190,35 @@ Arguments:
     - FileFullPath: Pointer to the full path where the routine stores the received file.
     - FileSize: Pointer to where the routine outputs the size of the received file. The caller must provide the storage space. 
     - SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (the server copy is left as it was). STATUS_WARNING if the file was
+    put in place, but does not hold the content announced (shorter, or its size could not be set).
+--*/
+
+
+
+//
+// RecvDeltaFromClient
+//
+SDSTATUS
+RecvDeltaFromClient(
+    __in char       *FileFullPath,
+    __in __int32    OldFileDescriptor,
+    __in const char *HashCode,
+    __out QWORD     *FileSize,
+    __in DWORD      SockConnID
+    );
+/*++
+Description: 
+    The routine receives a modified file as a delta against the server copy (see PACKET_DELTA_HEADER): it sends the block signatures
+    of the server copy, then rebuilds the file from the literal data and block references sent by the client. The rebuilt file
+    replaces the server copy only if it has the expected hash code; otherwise, the whole file is received.
+Arguments:
+    - FileFullPath: Pointer to the full path of the file (server copy, replaced by the received file).
+    - OldFileDescriptor: Descriptor of the server copy, open for reading.
+    - HashCode: Pointer to the hash code of the new content, as sent by the client.
+    - FileSize: Pointer to where the routine outputs the size of the received file. The caller must provide the storage space. 
+    - SockConnID: Descriptor representing the socket connection with the SyncDir client application.
 Return value: 
     STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
     was achieved, but related issues were encountered (information is logged, thereby).
@@ -94,6 +226,66 @@ Return value:
 
 
 
+//
+// RecvChunksFromClient
+//
+SDSTATUS
+RecvChunksFromClient(
+    __in char                                           *MainDirFullPath,
+    __in char                                           *FileFullPath,
+    __in const char                                     *FileRelativePath,
+    __in const char                                     *HashCode,
+    __inout std::unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap,
+    __inout STRIPE_RECEIVER                             & StripeReceiver,
+    __in DWORD                                          RequestId,
+    __out QWORD                                         *FileSize,
+    __in DWORD                                          SockConnID
+    );
+/*++
+Description: 
+    The routine receives a file as a list of content-defined chunks (see PACKET_CHUNK): the chunks found in the chunk index (checked
+    by their hash codes) are copied from the server files, and only the other ones are received. The assembled file replaces the
+    server file only if it has the expected hash code; otherwise, the whole file is received. If less than SD_SRV_CHUNKS_MIN_SAVING
+    percent of the file is found and data connections are open, the whole file is received in ranges instead. The chunks of the file
+    are then indexed.
+Arguments:
+    - MainDirFullPath: Pointer to the full path of the server main directory.
+    - FileFullPath: Pointer to the full path of the file (replaced by the received file).
+    - FileRelativePath: Pointer to the relative path of the file.
+    - HashCode: Pointer to the hash code of the new content, as sent by the client.
+    - ChunkInfoHMap: Reference to the chunk index (key: hash code of the chunk). Stale locations are dropped.
+    - StripeReceiver: Reference to the state of the data connections of the session.
+    - RequestId: Request ID of the MODIFY answered (for the ranges).
+    - FileSize: Pointer to where the routine outputs the size of the received file. The caller must provide the storage space. 
+    - SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+    was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+
+
+
+//
+// SendBufferToClient
+//
+SDSTATUS
+SendBufferToClient(
+    __in const void     *Buffer,
+    __in size_t         BufferSize,
+    __in DWORD          SockConnID
+    );
+/*++
+Description: 
+    The routine sends BufferSize bytes to the client, resuming partial sends.
+Arguments:
+    - Buffer: Pointer to the data.
+    - BufferSize: Number of bytes to send.
+    - SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
 //
 // RecvAndExecuteOperationFromClient
 //
@@ -102,6 +294,9 @@ SDSTATUS
 RecvAndExecuteOperationFromClient(
     __in char                                           *MainDirFullPath,
     __inout std::unordered_map<std::string, HASH_INFO>  & HashInfoHMap,
+    __inout std::unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap,
+    __inout std::unordered_map<DWORD, PENDING_TRANSFER> & PendingTransferHMap,
+    __inout STRIPE_RECEIVER                             & StripeReceiver,
     __in DWORD                                          SockConnID
     );
 /*++
@@ -112,6 +307,9 @@ Arguments:
     - MainDirFullPath: Pointer to the full path of the server main directory, where the file operations are executed (the server 
     application sees this directory as its own "root" path).
     - HashInfoHMap: Reference to the structure containing the file hash information, including file paths, hash codes and file sizes.
+    - ChunkInfoHMap: Reference to the chunk index (locations of the chunks stored on the server, by hash code).
+    - PendingTransferHMap: Reference to the MODIFY's answered whose content is still to be received (by request ID).
+    - StripeReceiver: Reference to the data connections of the session (whole files received in ranges).
     - SockConnID: Descriptor representing the socket connection with the SyncDir client application.
 Return value: 
     STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
@@ -119,6 +317,45 @@ Return value:
 --*/
 
 
+//
+// ReleasePendingTransfers
+//
+extern "C"                                                                  // Need it in syncdir_srv_main.h, so make it callable by C compiler.
+void
+ReleasePendingTransfers(
+    __inout std::unordered_map<DWORD, PENDING_TRANSFER> & PendingTransferHMap
+    );
+/*++
+Description: 
+    The routine drops the MODIFY's whose content was not received (e.g. when the connection is closed), closing their files.
+Arguments:
+    - PendingTransferHMap: Reference to the MODIFY's answered whose content is still to be received (by request ID).
+Return value: 
+    None.
+--*/
+
+
+//
+// CommitReceivedFiles
+//
+extern "C"                                                                  // Need it in syncdir_srv_main.h, so make it callable by C compiler.
+SDSTATUS
+CommitReceivedFiles(
+    __in char       *MainDirFullPath
+    );
+/*++
+Description: 
+    The routine syncs to disk the files received since the last call (group commit): their contents and their directory entries,
+    in one syncfs() of the file system of the main directory, instead of one fsync() per file. It is called when the client pauses
+    (end of a batch of operations), when too many files wait (SD_SRV_GROUP_COMMIT_FILES, SD_SRV_GROUP_COMMIT_SIZE), and when the
+    session ends. Nothing is done if no file waits, or if SD_SRV_GROUP_COMMIT is FALSE.
+Arguments:
+    - MainDirFullPath: Pointer to the full path of the server main directory.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (the files stay counted, for the next call).
+--*/
+
+
 
 
 
@@ -22,6 +22,12 @@ extern "C"
     #include "syncdir_utile.h"
 #endif
 
+#include "syncdir_hash.h"
+#include "syncdir_dir_digest.h"
+#include "syncdir_cdc.h"
+#include "syncdir_compress.h"
+#include "syncdir_uring.h"
+
 
 
 #ifdef __cplusplus                                                  // Declaration only.
@@ -33,6 +39,31 @@ extern "C"
 
 
 #define SD_MAX_CONNECTIONS 1
+#define SD_SRV_HASH_ALGORITHM haBLAKE3                                // Algorithm of the server hash index (see HASH_ALGORITHM).
+#define SD_SRV_INDEXER_THREADS 0                                        // Hashing threads of the startup indexer. 0: number of CPUs.
+#define SD_SRV_INDEXER_QUEUE_SIZE 1024                                  // Max. files waiting to be hashed (walker is paused beyond).
+#define SD_SRV_INDEXER_PROGRESS_INTERVAL 5                              // Seconds between two progress reports of the indexer.
+#define SD_SRV_SPLICE_RECV TRUE                                         // Receive whole files with splice() (no user space copies).
+#define SD_SRV_SPLICE_PIPE_SIZE (1024 * 1024)                           // Pipe size for splice(). At most SD_FILE_READ_BUFFER_SIZE.
+#define SD_SRV_IO_URING TRUE                                            // Write the content received through buffers with io_uring.
+#define SD_SRV_WRITE_QUEUE_DEPTH 8                                      // Writes in flight (1 - SD_URING_MAX_QUEUE_DEPTH).
+#define SD_SRV_DATA_CONNECTIONS 8                                       // Max. data connections granted to the client (striping).
+#define SD_SRV_CHUNKS_MIN_SAVING 25                                     // Chunk transfer: min. % of the file found on the server, or ranges.
+#define SD_SRV_PARTIAL_SUFFIX ".syncdir_partial"                        // Whole file (or chunks) being received: <file><suffix>, renamed.
+#define SD_SRV_PARTIAL_CHECKPOINT_SIZE (64 * 1024 * 1024)               // Bytes received between two checkpoints of a partial file.
+#define SD_SRV_PARTIAL_XATTR_CONTENT "user.syncdir.content"             // Partial file: "<hash code> <size>" of the content received.
+#define SD_SRV_PARTIAL_XATTR_OFFSET "user.syncdir.offset"               // Partial file: bytes received and synced (checkpoint).
+#define SD_SRV_TEMP_SUFFIX ".syncdir_temp"                              // Whole file received (no O_TMPFILE): <file><suffix>, renamed.
+#define SD_SRV_PREALLOCATE TRUE                                         // Reserve the announced size of a received file (fallocate()).
+#define SD_SRV_GROUP_COMMIT TRUE                                        // Sync the received files to disk, a batch at once (syncfs()).
+#define SD_SRV_GROUP_COMMIT_IDLE_MS 100                                 // Client silent this long: end of its batch, files synced.
+#define SD_SRV_GROUP_COMMIT_FILES 1024                                  // Files received: synced at the latest after this many ...
+#define SD_SRV_GROUP_COMMIT_SIZE (1024 * 1024 * 1024)                   // ... or this many bytes.
+#define SD_SRV_REFLINK_COPY TRUE                                        // Local copies share the blocks of the source (FICLONE).
+#define SD_SRV_COPY_CHUNK_SIZE (64 * 1024 * 1024)                       // Bytes per copy_file_range() of a local copy.
+#define SD_SRV_KEEPALIVE_IDLE 60                                        // Seconds of silence before probing the client (lost peer).
+#define SD_SRV_KEEPALIVE_INTERVAL 10                                    // Seconds between two probes.
+#define SD_SRV_KEEPALIVE_PROBES 6                                       // Probes unanswered: the connection is dropped.
 
 
 
@@ -44,11 +75,132 @@ extern "C"
 //
 typedef struct _HASH_INFO
 {
-    std::string     HashCode;                                           // Hash sum of the file content. Length: SD_HASH_CODE_LENGTH + 1
+    std::string     HashCode;                                           // Hash code of the file content (algorithm: gHashAlgorithm).
     std::string     FileRelativePath;                                   // Relative path of the file (relative to SyncDir main directory).
-    DWORD           FileSize;                                           // Size of the file (in bytes).
+    QWORD           FileSize;                                           // Size of the file (in bytes).
 } HASH_INFO, *PHASH_INFO;
 
+
+
+//
+// CHUNK_INFO - Location of a chunk stored on the server (see CdcChunksOfFile()). Indexed by the hash code of the chunk.
+//
+/*++
+The locations are not updated when files are moved, deleted or overwritten: a chunk is read and its hash code checked before it is
+used, and stale locations are dropped then.
+--*/
+typedef struct _CHUNK_INFO
+{
+    std::string     FileRelativePath;                                   // Relative path of a file holding the chunk.
+    QWORD           Offset;                                             // Offset of the chunk in the file.
+    DWORD           Size;                                               // Size of the chunk (in bytes).
+} CHUNK_INFO, *PCHUNK_INFO;
+
+
+
+//
+// PENDING_TRANSFER - MODIFY answered by the server, whose content was not received yet (see PACKET_MODIFY_REPLY). Indexed by the
+// request ID of the MODIFY.
+//
+typedef struct _PENDING_TRANSFER
+{
+    std::string     FileRelativePath;
+    std::string     HashCode;                                           // Hash code of the content announced by the client.
+    QWORD           ClientFileSize;
+    __int32         OldFileDescriptor;                                  // Server copy, for a delta transfer ("File Delta"). -1 otherwise.
+    BOOL            IsChunkTransfer;                                    // "File Chunks".
+    BOOL            IsStripeTransfer;                                   // "File Stripes" or "File Resume" (see STRIPE_TRANSFER).
+} PENDING_TRANSFER, *PPENDING_TRANSFER;
+
+
+
+//
+// HASH_INDEX_ITEM - One file to be hashed by the startup indexer (see BuildHashInfoForEachFile).
+//
+typedef struct _HASH_INDEX_ITEM
+{
+    QWORD           Sequence;                                           // Order of the directory walk. Results are merged in this order.
+    std::string     FileFullPath;
+    HASH_INFO       HashInfo;                                           // Path and size set by the walker, hash code by a worker.
+    std::vector<CDC_CHUNK>  Chunks;                                     // Set by a worker, for files of at least SD_CDC_MIN_FILE_SIZE B.
+} HASH_INDEX_ITEM, *PHASH_INDEX_ITEM;
+
+
+
+//
+// HASH_INDEXER - State shared by the directory walker and the hashing workers of the startup indexer.
+//
+typedef struct _HASH_INDEXER
+{
+    std::mutex                      Lock;                               // Protects all the fields below.
+    std::condition_variable         QueueNotEmpty;                      // Signaled for workers: new item, or walk done.
+    std::condition_variable         QueueNotFull;                       // Signaled for the walker.
+    std::condition_variable         ItemDone;                           // Signaled for the progress reporter.
+    std::deque<HASH_INDEX_ITEM>     Queue;                              // Bounded (SD_SRV_INDEXER_QUEUE_SIZE).
+    std::vector<HASH_INDEX_ITEM>    Results;                            // Hashed files, in completion order.
+    BOOL                            IsWalkDone;
+    QWORD                           SubmittedFiles;
+    QWORD                           SubmittedBytes;
+    QWORD                           HashedFiles;
+    QWORD                           HashedBytes;
+    QWORD                           FailedFiles;
+    std::chrono::steady_clock::time_point   StartTime;
+    std::chrono::steady_clock::time_point   LastReportTime;
+} HASH_INDEXER, *PHASH_INDEXER;
+
+
+
+//
+// STRIPE_TRANSFER - Whole file received into a partial file, in ranges over the data connections (see PACKET_STRIPE_HEADER) or on the
+// control connection. Indexed by the request ID of the MODIFY.
+//
+/*++
+The partial file is resumable if its content is identified in extended attributes (SD_SRV_PARTIAL_XATTR_CONTENT): the offset up to
+which all the bytes were received is then synced to disk and recorded (SD_SRV_PARTIAL_XATTR_OFFSET) every
+SD_SRV_PARTIAL_CHECKPOINT_SIZE bytes, and when the transfer is interrupted. A later MODIFY of the same content resumes from there.
+--*/
+typedef struct _STRIPE_TRANSFER
+{
+    std::string     TempFullPath;                                       // <file>SD_SRV_PARTIAL_SUFFIX. Renamed when complete.
+    QWORD           FileSize;                                           // Announced by the client (MODIFY).
+    QWORD           StartOffset;                                        // Bytes held before the transfer ("File Resume"), or 0.
+    DWORD           ReceivedRanges;
+    QWORD           ReceivedBytes;                                      // Including StartOffset.
+    QWORD           ContiguousEnd;                                      // All the bytes before were received.
+    QWORD           DurableOffset;                                      // Last checkpoint.
+    std::map<QWORD, QWORD>  RangeEnds;                                  // Ranges received beyond ContiguousEnd (offset -> end).
+    BOOL            IsResumable;
+} STRIPE_TRANSFER, *PSTRIPE_TRANSFER;
+
+
+
+//
+// GROUP_COMMIT - Files published since the last sync to disk (see CommitReceivedFiles()). Used by the control thread only.
+//
+typedef struct _GROUP_COMMIT
+{
+    DWORD           Files;
+    QWORD           Bytes;
+} GROUP_COMMIT, *PGROUP_COMMIT;
+
+
+
+//
+// STRIPE_RECEIVER - State shared by the control thread and the receiving threads of the data connections (see PACKET_DATA_CONNECTION).
+//
+typedef struct _STRIPE_RECEIVER
+{
+    std::mutex                      Lock;                               // Protects the transfers and the fields below.
+    std::condition_variable         RangeDone;                          // Signaled for the control thread: range received, or failure.
+    std::vector<__int32>            Socks;                              // Accepted data connections, by index.
+    std::vector<std::thread>        Receivers;                          // See StripeReceiverWorker().
+    std::unordered_map<DWORD, STRIPE_TRANSFER>  Transfers;
+    DWORD                           GrantedConnections;                 // To the client, at handshake.
+    BYTE                            SessionKey[SD_SESSION_KEY_SIZE];
+    BOOL                            IsClosing;
+    BOOL                            IsFailed;                           // A data connection failed: its ranges will not come.
+} STRIPE_RECEIVER, *PSTRIPE_RECEIVER;
+
 #endif //--> #ifdef __cplusplus
 // *********************** C++ only (end) ***********************
 
@@ -102,7 +102,7 @@ SDSTATUS
 InsertHashInfoOfFile(
     __in const char   *FileRelativePath,
     __in const char   *HashCode,
-    __in DWORD  FileSize,
+    __in QWORD  FileSize,
     __inout std::unordered_map<std::string, HASH_INFO> & HashInfoHMap
     );
 /*++
@@ -120,6 +120,112 @@ Return value:
 --*/
 
 
+//
+// ChunksOfServerFile
+//
+SDSTATUS
+ChunksOfServerFile(
+    __in const char                 *FileFullPath,
+    __out std::vector<CDC_CHUNK>    & Chunks
+    );
+/*++
+Description: 
+    The routine splits a server file into content-defined chunks (see CdcChunksOfFile()), for the chunk index. Only the regular files
+    of SD_CDC_MIN_FILE_SIZE to SD_CDC_MAX_FILE_SIZE bytes are chunked; for the other files, no chunk is output.
+Arguments:
+    - FileFullPath: Pointer to the full path of the file.
+    - Chunks: Reference to where the routine outputs the chunks of the file.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
+//
+// InsertChunkInfosOfFile
+//
+void
+InsertChunkInfosOfFile(
+    __in const char                                     *FileRelativePath,
+    __in const std::vector<CDC_CHUNK>                   & Chunks,
+    __inout std::unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap
+    );
+/*++
+Description: 
+    The routine inserts in the chunk index ChunkInfoHMap the locations of the chunks of the file at path FileRelativePath. The newest
+    location of a chunk replaces the existing one.
+Arguments:
+    - FileRelativePath: Pointer to the file relative path.
+    - Chunks: Reference to the chunks of the file.
+    - ChunkInfoHMap: Reference to the chunk index (key: hash code of the chunk).
+Return value: 
+    None.
+--*/
+
+
+//
+// ReportHashIndexerProgress
+//
+void
+ReportHashIndexerProgress(
+    __inout HASH_INDEXER    &Indexer,
+    __in BOOL               IsForced
+    );
+/*++
+Description: 
+    The routine logs the progress and the throughput of the startup indexer, if at least SD_SRV_INDEXER_PROGRESS_INTERVAL seconds
+    passed since the previous report, or if IsForced is TRUE. The caller holds Indexer.Lock.
+Arguments:
+    - Indexer: Reference to the indexer state.
+    - IsForced: TRUE to report regardless of the time passed since the previous report.
+Return value: 
+    None.
+--*/
+
+
+
+//
+// HashIndexerWorker
+//
+void
+HashIndexerWorker(
+    __inout HASH_INDEXER    *Indexer
+    );
+/*++
+Description: 
+    Routine of the hashing threads of the startup indexer. It takes files from the indexer queue and hashes them (algorithm:
+    gHashAlgorithm), until the queue is empty and the directory walk is done. The hashed files are appended to Indexer->Results.
+Arguments:
+    - Indexer: Pointer to the indexer state.
+Return value: 
+    None.
+--*/
+
+
+
+//
+// WalkDirForHashIndexer
+//
+SDSTATUS
+WalkDirForHashIndexer(
+    __in const char         *DirFullPath,
+    __in const char         *DirRelativePath,
+    __inout HASH_INDEXER    &Indexer
+    );
+/*++
+Description: 
+    The routine walks (recursively) the DirFullPath directory and its subdirectories, and submits every non-directory file to the 
+    hashing workers of the startup indexer. The routine waits while the indexer queue is full (SD_SRV_INDEXER_QUEUE_SIZE files).
+Arguments:
+    - DirFullPath: Pointer to the string containing the full path of the directory.
+    - DirRelativePath: Pointer to the string containing the relative path of the directory.
+    - Indexer: Reference to the indexer state.
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+    was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+
+
+
 //
 // BuildHashInfoForEachFile
 //
@@ -128,23 +234,54 @@ SDSTATUS
 BuildHashInfoForEachFile(
     __in const char    *DirFullPath,
     __in const char    *DirRelativePath,
-    __out std::unordered_map<std::string, HASH_INFO> & HashInfoHMap    
+    __out std::unordered_map<std::string, HASH_INFO> & HashInfoHMap,
+    __out std::unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap
     );
 /*++
 Description: 
     The routine builds the map containing all the HASH_INFO structures of every file inside the DirFullPath directory and its
-    subdirectories. These structures are made accessible through the hash code of the file (e.g. using MD5 algorithm) and thorugh the file 
-    relative path.
+    subdirectories. These structures are made accessible through the hash code of the file (algorithm: gHashAlgorithm) and thorugh the file 
+    relative path. The files are hashed in parallel (SD_SRV_INDEXER_THREADS workers, fed by a directory walker through a bounded queue),
+    and the results are merged into HashInfoHMap by the calling thread, in the order of the walk. The chunks of the large files are
+    indexed in ChunkInfoHMap.
 Arguments:
     - DirFullPath: Reference to the string containing the full path of the directory.
     - DirRelativePath: Reference to the string containing the relative path of the directory.
     - HahsInfoHMap: Reference to the map where the routine stores all the HASH_INFO structures.
+    - ChunkInfoHMap: Reference to the map where the routine stores the CHUNK_INFO structures (key: hash code of the chunk).
 Return value: 
     STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
     was achieved, but related issues were encountered (information is logged, thereby).
 --*/
 
 
+//
+// BuildDirDigestsOfServerTree
+//
+SDSTATUS
+BuildDirDigestsOfServerTree(
+    __in const char                                         *DirFullPath,
+    __in const char                                         *DirRelativePath,
+    __in const std::unordered_map<std::string, HASH_INFO>   & HashInfoHMap,
+    __inout std::unordered_map<std::string, std::string>    & DirDigestHMap,
+    __out std::string                                       & DirDigest
+    );
+/*++
+Description: 
+    The routine computes the digests (see DirDigestOfEntries()) of the DirFullPath directory and of all its subdirectories, with
+    the content hash codes of the files taken from HashInfoHMap (no file is read). The digests are stored in DirDigestHMap, by the
+    relative paths of the directories.
+Arguments:
+    - DirFullPath: Pointer to the string containing the full path of the directory.
+    - DirRelativePath: Pointer to the string containing the relative path of the directory.
+    - HashInfoHMap: Reference to the map of the HASH_INFO structures of the server files.
+    - DirDigestHMap: Reference to the hash map where the routine stores the digests (key: relative path of the directory).
+    - DirDigest: Reference to where the routine outputs the digest of the DirFullPath directory ("" if unknown).
+Return value: 
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+
+
 
 #endif // _SYNCDIR_SRV_HASH_INFO_PROC_H_
 
@@ -20,6 +20,8 @@ Header for the source file of the SyncDir server launch routine.
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <signal.h>
 
 
 
@@ -73,6 +75,51 @@ SrvReturnListeningSocket(
     );
 
 
+//
+// SrvNegotiateSessionWithClient
+//
+extern                                                              // From syncdir_srv_data_transfer.h.
+SDSTATUS
+SrvNegotiateSessionWithClient(
+    __in DWORD              SockConnID,
+    __inout STRIPE_RECEIVER &StripeReceiver
+    );
+
+
+//
+// SrvAcceptDataConnections
+//
+extern                                                              // From syncdir_srv_data_transfer.h.
+SDSTATUS
+SrvAcceptDataConnections(
+    __in __int32            SrvSock,
+    __inout STRIPE_RECEIVER &StripeReceiver
+    );
+
+
+//
+// SrvCloseDataConnections
+//
+extern                                                              // From syncdir_srv_data_transfer.h.
+void
+SrvCloseDataConnections(
+    __inout STRIPE_RECEIVER &StripeReceiver
+    );
+
+
+//
+// SrvReconcileDirDigestsWithClient
+//
+extern                                                              // From syncdir_srv_data_transfer.h.
+SDSTATUS
+SrvReconcileDirDigestsWithClient(
+    __in char                                                   *MainDirFullPath,
+    __in const std::unordered_map<std::string, HASH_INFO>       & HashInfoHMap,
+    __in DWORD                                                  SockConnID
+    );
+
+
+
 //
 // RecvAndExecuteOperationFromClient
 //
@@ -81,10 +128,33 @@ SDSTATUS
 RecvAndExecuteOperationFromClient(
     __in char                                           *MainDirFullPath,
     __inout std::unordered_map<std::string, HASH_INFO>  & HashInfoHMap,
+    __inout std::unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap,
+    __inout std::unordered_map<DWORD, PENDING_TRANSFER> & PendingTransferHMap,
+    __inout STRIPE_RECEIVER                             & StripeReceiver,
     __in DWORD                                          SockConnID
     );
 
 
+//
+// ReleasePendingTransfers
+//
+extern                                                              // From syncdir_srv_data_transfer.h.
+void
+ReleasePendingTransfers(
+    __inout std::unordered_map<DWORD, PENDING_TRANSFER> & PendingTransferHMap
+    );
+
+
+//
+// CommitReceivedFiles
+//
+extern                                                              // From syncdir_srv_data_transfer.h.
+SDSTATUS
+CommitReceivedFiles(
+    __in char       *MainDirFullPath
+    );
+
+
 //
 // BuildHashInfoForEachFile
 //
@@ -93,7 +163,8 @@ SDSTATUS
 BuildHashInfoForEachFile(
     __in const char * DirFullPath,
     __in const char * DirRelativePath,
-    __out unordered_map<std::string, HASH_INFO> & HashInfoHMap    
+    __out unordered_map<std::string, HASH_INFO> & HashInfoHMap,
+    __out unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap
     );
 
 
@@ -0,0 +1,207 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#ifndef _SYNCDIR_URING_H_
+#define _SYNCDIR_URING_H_
+/*++
+Header of the source file providing the asynchronous file I/O of SyncDir, on io_uring: several reads (client) or writes (server) of a
+file are in flight at once, instead of one at a time, so a fast device (NVMe) is kept busy. The caller owns a fixed set of buffers,
+registered with the kernel (no mapping of the pages on each operation), and has at most one operation in flight per buffer. The ring
+is driven by the system calls themselves (no liburing needed); if the kernel does not provide io_uring (Linux 6.1 or later, for
+IORING_SETUP_DEFER_TASKRUN) or forbids it, the setup fails and the caller keeps its synchronous path (pread(), write()).
+--*/
+
+
+
+#include "syncdir_essential_def_types.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#ifdef __NR_io_uring_setup
+    #include <linux/io_uring.h>
+#endif
+
+
+
+#define SD_URING_MAX_QUEUE_DEPTH 64                                     // Max. operations in flight (buffers) of a ring.
+
+
+
+#ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
+extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
+{
+#endif
+
+
+
+//
+// URING - An io_uring instance and the buffers of its operations. Used by the thread that set it up, only.
+//
+typedef struct _URING
+{
+    __int32         RingFd;                                             // -1: not set up (see UringSetup()).
+    void            *SqRing;                                            // Mappings of the rings shared with the kernel.
+    size_t          SqRingSize;
+    void            *CqRing;                                            // NULL if the same mapping as SqRing (single mmap).
+    size_t          CqRingSize;
+    void            *Sqes;                                              // Array of the submission queue entries.
+    size_t          SqesSize;
+    unsigned        *SqTail;                                            // Pointers into the rings (see struct io_sqring_offsets).
+    unsigned        *SqMask;
+    unsigned        *SqArray;
+    unsigned        *CqHead;
+    unsigned        *CqTail;
+    unsigned        *CqMask;
+    void            *Cqes;
+    DWORD           QueueDepth;                                         // Number of buffers.
+    BYTE            *Buffers[SD_URING_MAX_QUEUE_DEPTH];                 // Owned by the caller.
+    DWORD           BufferSize;
+    BOOL            IsRegistered;                                       // Buffers registered (fixed reads/writes).
+    BOOL            IsPending[SD_URING_MAX_QUEUE_DEPTH];                // Operation in flight on the buffer.
+    __int32         Results[SD_URING_MAX_QUEUE_DEPTH];                  // Result of the last operation completed on the buffer.
+} URING, *PURING;
+
+
+
+//
+// Interfaces:
+//
+
+
+//
+// UringSetup
+//
+SDSTATUS
+UringSetup(
+    __out URING         *Uring,
+    __in DWORD          QueueDepth,
+    __in BYTE           **Buffers,
+    __in DWORD          BufferSize
+    );
+/*++
+Description:
+    The routine creates an io_uring instance for QueueDepth operations in flight, one on each of the given buffers, and registers the
+    buffers with the kernel. If the buffers cannot be registered (e.g. RLIMIT_MEMLOCK), the ring is used all the same, with plain
+    reads and writes.
+Arguments:
+    - Uring: Pointer to the URING to set up. On failure, it is left not set up (RingFd is -1): UringTeardown() is harmless.
+    - QueueDepth: Number of buffers (at most SD_URING_MAX_QUEUE_DEPTH).
+    - Buffers: Array of QueueDepth pointers to the buffers, of BufferSize bytes each. They must outlive the ring.
+    - BufferSize: Size of each buffer, in bytes.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (io_uring not available: the caller does synchronous I/O).
+--*/
+
+
+
+//
+// UringTeardown
+//
+void
+UringTeardown(
+    __inout URING       *Uring
+    );
+/*++
+Description:
+    The routine waits for the operations still in flight (the kernel may still use the buffers), then destroys the ring. The buffers
+    are left to the caller.
+Arguments:
+    - Uring: Pointer to the URING (set up or not).
+Return value:
+    None.
+--*/
+
+
+
+//
+// UringSubmitRead
+//
+SDSTATUS
+UringSubmitRead(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __in __int32        FileDescriptor,
+    __in DWORD          Length,
+    __in QWORD          Offset
+    );
+/*++
+Description:
+    The routine starts reading Length bytes of the file, at Offset, into the buffer BufferIndex, and returns without waiting for the
+    read (see UringWaitBuffer()). No operation may be in flight on the buffer.
+Arguments:
+    - Uring: Pointer to the URING.
+    - BufferIndex: Index of the buffer (less than the queue depth).
+    - FileDescriptor: The file to read.
+    - Length: Number of bytes to read (at most the size of the buffer).
+    - Offset: Offset in the file.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (the read was not started).
+--*/
+
+
+
+//
+// UringSubmitWrite
+//
+SDSTATUS
+UringSubmitWrite(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __in __int32        FileDescriptor,
+    __in DWORD          Length,
+    __in QWORD          Offset
+    );
+/*++
+Description:
+    The routine starts writing the first Length bytes of the buffer BufferIndex to the file, at Offset (the offset of the file is not
+    used, nor moved), and returns without waiting for the write. Same as UringSubmitRead(), otherwise.
+Arguments:
+    - Uring: Pointer to the URING.
+    - BufferIndex: Index of the buffer (less than the queue depth).
+    - FileDescriptor: The file to write.
+    - Length: Number of bytes to write (at most the size of the buffer).
+    - Offset: Offset in the file.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (the write was not started).
+--*/
+
+
+
+//
+// UringWaitBuffer
+//
+SDSTATUS
+UringWaitBuffer(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __out __int32       *Result
+    );
+/*++
+Description:
+    The routine waits for the operation in flight on the buffer BufferIndex to complete (the completions of the other buffers met
+    meanwhile are recorded). If no operation is in flight on the buffer, it returns at once.
+Arguments:
+    - Uring: Pointer to the URING.
+    - BufferIndex: Index of the buffer (less than the queue depth).
+    - Result: Pointer to where the routine outputs the result of the last operation on the buffer: the number of bytes read or
+    written (fewer than requested: end of file, or disk full), or -errno.
+Return value:
+    STATUS_SUCCESS on success, STATUS_FAIL otherwise (the ring failed: the operation may still be in flight).
+--*/
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+
+
+
+#endif //--> #ifndef _SYNCDIR_URING_H_
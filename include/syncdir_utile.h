@@ -18,12 +18,23 @@ Header of the source file providing useful routines, for diverse SyncDir tasks.
 
 
 
+//
+// READ_QUOTA_ROUTINE - Limiter of the file reads (see FileReadQuota()).
+//
+typedef size_t (*READ_QUOTA_ROUTINE)(size_t Wanted);
+
+
+
 #ifdef __cplusplus                  // Because it contains functions written in C. So let C++ compiler know how to call these.
 extern "C"                          // Need "ifdef __cplusplus", since C compiler does not recognize extern "C".
 {
 #endif
 
 
+extern READ_QUOTA_ROUTINE gReadQuotaRoutine;    // declaration only (extern).
+
+
+
 //
 // Interfaces:
 //
@@ -125,26 +136,46 @@ Return value:
 
 
 //
-// MD5HashOfFile
+// BytesToHexString
 //
-SDSTATUS
-MD5HashOfFile(
-    __in char   *FileFullPath,
-    __out char  *MD5Hash
+void
+BytesToHexString(
+    __in const BYTE *Bytes,
+    __in DWORD      NumberOfBytes,
+    __out char      *HexString
     );
 /*++
 Description: 
-    The routine outputs the MD5 hash for a given file content. The hash is output at the address pointed by MD5Hash.
-    The file is identified by FileFullPath.
+    The routine converts NumberOfBytes bytes to their lowercase hexadecimal representation (2 characters per byte, '\0' terminated).
 Arguments:
-    - FileFullPath: Pointer to the full path of the file.
-    - MD5Hash: Pointer containing the address where the MD5 hash of the file is output.
+    - Bytes: Pointer to the bytes to be converted.
+    - NumberOfBytes: Number of bytes at Bytes.
+    - HexString: Pointer to where the string is output. Storage of at least 2 * NumberOfBytes + 1 characters is provided by the caller.
 Return value: 
-    STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+    None.
 --*/
 
 
 
+//
+// FileReadQuota
+//
+size_t
+FileReadQuota(
+    __in size_t     Wanted
+    );
+/*++
+Description: 
+    The routine returns how many of the Wanted bytes a file read may request now, as allowed by gReadQuotaRoutine (e.g. the read
+    limits of the client, see GovernorReadQuota()): the caller reads at most this many bytes, then asks again for the rest. The
+    routine may wait. Without gReadQuotaRoutine (e.g. server), all the Wanted bytes are allowed at once.
+Arguments:
+    - Wanted: Number of bytes the caller is about to read.
+Return value: 
+    The number of bytes allowed (at most Wanted; not 0, unless Wanted is 0).
+--*/
+
+
 
 //
 // ExecuteShellCommand
@@ -0,0 +1,1330 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_blake3.h"
+#include "syncdir_utile.h"
+#include <pthread.h>
+
+
+
+//
+// BLAKE3 domain separation flags.
+//
+#define BLAKE3_CHUNK_START  (1 << 0)
+#define BLAKE3_CHUNK_END    (1 << 1)
+#define BLAKE3_PARENT       (1 << 2)
+#define BLAKE3_ROOT         (1 << 3)
+
+#define BLAKE3_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))         // Works for both scalars and vectors.
+
+#define BLAKE3_G(v, a, b, c, d, mx, my)                                 \
+    v[a] = v[a] + v[b] + (mx);                                          \
+    v[d] = BLAKE3_ROTR(v[d] ^ v[a], 16);                                \
+    v[c] = v[c] + v[d];                                                 \
+    v[b] = BLAKE3_ROTR(v[b] ^ v[c], 12);                                \
+    v[a] = v[a] + v[b] + (my);                                          \
+    v[d] = BLAKE3_ROTR(v[d] ^ v[a], 8);                                 \
+    v[c] = v[c] + v[d];                                                 \
+    v[b] = BLAKE3_ROTR(v[b] ^ v[c], 7);
+
+
+
+static const DWORD gBlake3IV[8] =
+{
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+//
+// Message word order for each of the 7 rounds (the permutation applied 0 to 6 times).
+//
+static const BYTE gBlake3MsgSchedule[7][16] =
+{
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+
+
+//
+// BLAKE3_DWORD_VECTOR - One 32-bit word of SD_BLAKE3_SIMD_DEGREE independent chunks (GCC vector extension). The compiler maps it
+// on the widest available vector registers (e.g. 2 x SSE2, or 1 x AVX2 for the AVX2 clone of Blake3CompressChunks()).
+//
+typedef DWORD BLAKE3_DWORD_VECTOR __attribute__ ((vector_size (4 * SD_BLAKE3_SIMD_DEGREE)));
+
+
+
+//
+// BLAKE3_OUTPUT - Inputs of the last compression of a node (chunk or parent). Kept apart, since the node may be the root.
+//
+typedef struct _BLAKE3_OUTPUT
+{
+    DWORD   InputChainingValue[8];
+    BYTE    Block[SD_BLAKE3_BLOCK_SIZE];
+    QWORD   Counter;
+    BYTE    BlockLength;
+    BYTE    Flags;
+} BLAKE3_OUTPUT, *PBLAKE3_OUTPUT;
+
+
+
+//
+// BLAKE3_SEGMENT_JOB - Work shared by the threads of Blake3HashOfFileDescriptorParallel().
+//
+typedef struct _BLAKE3_SEGMENT_JOB
+{
+    __int32     FileDescriptor;
+    QWORD       FileSize;
+    QWORD       NumberOfSegments;
+    QWORD       NextSegment;                                            // Next segment to be taken by a thread (atomic).
+    DWORD       (*SegmentChainingValues)[8];                            // One chaining value per segment.
+    BOOL        HasFailed;                                              // Set by any thread which fails (atomic).
+} BLAKE3_SEGMENT_JOB, *PBLAKE3_SEGMENT_JOB;
+
+
+
+//
+// BLAKE3_LANE - One input hashed by Blake3HashMany(), in one vector lane.
+//
+typedef struct _BLAKE3_LANE
+{
+    DWORD           Index;                                              // Index of the input (-1: lane not used).
+    const BYTE      *Input;
+    size_t          InputLength;
+    QWORD           NumberOfChunks;                                     // At least 1 (the empty input has one empty chunk).
+    QWORD           Chunk;                                              // Current chunk.
+    DWORD           Block;                                              // Current block of the current chunk.
+    DWORD           BlocksInChunk;
+    BYTE            BlockBuffer[SD_BLAKE3_BLOCK_SIZE];                  // Zero padded copy of a partial block.
+    BLAKE3_CONTEXT  Context;                                            // Subtree stack, for inputs of more than one chunk.
+} BLAKE3_LANE, *PBLAKE3_LANE;
+
+
+
+//
+// Blake3LoadWord
+//
+static inline DWORD
+Blake3LoadWord(
+    __in const BYTE *Bytes
+    )
+/*++
+Description: The routine reads a 32-bit little-endian word, independently of the host byte order and alignment.
+--*/
+{
+    return (DWORD) Bytes[0] | ((DWORD) Bytes[1] << 8) | ((DWORD) Bytes[2] << 16) | ((DWORD) Bytes[3] << 24);
+} // Blake3LoadWord()
+
+
+
+//
+// Blake3StoreWords
+//
+static inline void
+Blake3StoreWords(
+    __in const DWORD    *Words,
+    __in DWORD          NumberOfWords,
+    __out BYTE          *Bytes
+    )
+/*++
+Description: The routine writes NumberOfWords 32-bit words in little-endian order.
+--*/
+{
+    DWORD i;
+
+    for (i = 0; i < NumberOfWords; i ++)
+    {
+        Bytes[4 * i + 0] = (BYTE) (Words[i]);
+        Bytes[4 * i + 1] = (BYTE) (Words[i] >> 8);
+        Bytes[4 * i + 2] = (BYTE) (Words[i] >> 16);
+        Bytes[4 * i + 3] = (BYTE) (Words[i] >> 24);
+    }
+} // Blake3StoreWords()
+
+
+
+//
+// Blake3Compress
+//
+static void
+Blake3Compress(
+    __inout DWORD       *ChainingValue,
+    __in const BYTE     *Block,
+    __in BYTE           BlockLength,
+    __in QWORD          Counter,
+    __in BYTE           Flags
+    )
+/*++
+Description: The routine applies the BLAKE3 compression function on one 64 bytes block and replaces the 8 words at ChainingValue
+with the first half of the output (which is all SyncDir needs: chaining values and 32 bytes root digests).
+
+- ChainingValue: Pointer to the input chaining value, overwritten with the output one.
+- Block: Pointer to the 64 bytes block (zero padded, if BlockLength is smaller).
+- BlockLength: Number of meaningful bytes in Block.
+- Counter: Chunk counter (0 for parent nodes).
+- Flags: Domain separation flags.
+
+Return value: None.
+--*/
+{
+    DWORD           m[16];
+    DWORD           v[16];
+    const BYTE      *s;
+    DWORD           i;
+
+    for (i = 0; i < 16; i ++)
+    {
+        m[i] = Blake3LoadWord(Block + 4 * i);
+    }
+
+    for (i = 0; i < 8; i ++)
+    {
+        v[i] = ChainingValue[i];
+    }
+    v[8] = gBlake3IV[0];
+    v[9] = gBlake3IV[1];
+    v[10] = gBlake3IV[2];
+    v[11] = gBlake3IV[3];
+    v[12] = (DWORD) Counter;
+    v[13] = (DWORD) (Counter >> 32);
+    v[14] = (DWORD) BlockLength;
+    v[15] = (DWORD) Flags;
+
+    for (i = 0; i < 7; i ++)
+    {
+        s = gBlake3MsgSchedule[i];
+
+        // Columns.
+        BLAKE3_G(v, 0, 4,  8, 12, m[s[0]],  m[s[1]])
+        BLAKE3_G(v, 1, 5,  9, 13, m[s[2]],  m[s[3]])
+        BLAKE3_G(v, 2, 6, 10, 14, m[s[4]],  m[s[5]])
+        BLAKE3_G(v, 3, 7, 11, 15, m[s[6]],  m[s[7]])
+
+        // Diagonals.
+        BLAKE3_G(v, 0, 5, 10, 15, m[s[8]],  m[s[9]])
+        BLAKE3_G(v, 1, 6, 11, 12, m[s[10]], m[s[11]])
+        BLAKE3_G(v, 2, 7,  8, 13, m[s[12]], m[s[13]])
+        BLAKE3_G(v, 3, 4,  9, 14, m[s[14]], m[s[15]])
+    }
+
+    for (i = 0; i < 8; i ++)
+    {
+        ChainingValue[i] = v[i] ^ v[i + 8];
+    }
+} // Blake3Compress()
+
+
+
+//
+// Blake3CompressChunks
+//
+__attribute__ ((target_clones ("avx2", "default")))
+static void
+Blake3CompressChunks(
+    __in const BYTE     *Chunks,
+    __in QWORD          ChunkCounter,
+    __out DWORD         (*ChainingValues)[8]
+    )
+/*++
+Description: The routine hashes SD_BLAKE3_SIMD_DEGREE consecutive full chunks at once, one chunk per vector lane, and outputs their
+(non-root) chaining values. The 16 blocks of each chunk are compressed in lock step, so every operation of the compression function
+processes all the chunks with one vector instruction. The function is compiled twice (AVX2 and default) and the loader picks the
+variant matching the CPU.
+
+- Chunks: Pointer to SD_BLAKE3_SIMD_DEGREE * SD_BLAKE3_CHUNK_SIZE bytes.
+- ChunkCounter: Index of the first chunk in the whole input.
+- ChainingValues: Pointer to where the routine outputs the SD_BLAKE3_SIMD_DEGREE chaining values.
+
+Return value: None.
+--*/
+{
+    BLAKE3_DWORD_VECTOR cv[8];
+    BLAKE3_DWORD_VECTOR m[16];
+    BLAKE3_DWORD_VECTOR v[16];
+    BLAKE3_DWORD_VECTOR counterLow;
+    BLAKE3_DWORD_VECTOR counterHigh;
+    const BYTE          *s;
+    DWORD               block, lane, i;
+    BYTE                flags;
+
+    for (i = 0; i < 8; i ++)
+    {
+        for (lane = 0; lane < SD_BLAKE3_SIMD_DEGREE; lane ++)
+        {
+            cv[i][lane] = gBlake3IV[i];
+        }
+    }
+    for (lane = 0; lane < SD_BLAKE3_SIMD_DEGREE; lane ++)
+    {
+        counterLow[lane] = (DWORD) (ChunkCounter + lane);
+        counterHigh[lane] = (DWORD) ((ChunkCounter + lane) >> 32);
+    }
+
+    for (block = 0; block < SD_BLAKE3_CHUNK_SIZE / SD_BLAKE3_BLOCK_SIZE; block ++)
+    {
+        flags = (0 == block) ? BLAKE3_CHUNK_START : 0;
+        if (SD_BLAKE3_CHUNK_SIZE / SD_BLAKE3_BLOCK_SIZE - 1 == block)
+        {
+            flags = flags | BLAKE3_CHUNK_END;
+        }
+
+        // Transpose: message word i of every lane.
+
+        for (i = 0; i < 16; i ++)
+        {
+            for (lane = 0; lane < SD_BLAKE3_SIMD_DEGREE; lane ++)
+            {
+                m[i][lane] = Blake3LoadWord(Chunks + lane * SD_BLAKE3_CHUNK_SIZE + block * SD_BLAKE3_BLOCK_SIZE + 4 * i);
+            }
+        }
+
+        for (i = 0; i < 8; i ++)
+        {
+            v[i] = cv[i];
+        }
+        for (lane = 0; lane < SD_BLAKE3_SIMD_DEGREE; lane ++)
+        {
+            v[8][lane] = gBlake3IV[0];
+            v[9][lane] = gBlake3IV[1];
+            v[10][lane] = gBlake3IV[2];
+            v[11][lane] = gBlake3IV[3];
+            v[14][lane] = SD_BLAKE3_BLOCK_SIZE;
+            v[15][lane] = flags;
+        }
+        v[12] = counterLow;
+        v[13] = counterHigh;
+
+        for (i = 0; i < 7; i ++)
+        {
+            s = gBlake3MsgSchedule[i];
+
+            BLAKE3_G(v, 0, 4,  8, 12, m[s[0]],  m[s[1]])
+            BLAKE3_G(v, 1, 5,  9, 13, m[s[2]],  m[s[3]])
+            BLAKE3_G(v, 2, 6, 10, 14, m[s[4]],  m[s[5]])
+            BLAKE3_G(v, 3, 7, 11, 15, m[s[6]],  m[s[7]])
+
+            BLAKE3_G(v, 0, 5, 10, 15, m[s[8]],  m[s[9]])
+            BLAKE3_G(v, 1, 6, 11, 12, m[s[10]], m[s[11]])
+            BLAKE3_G(v, 2, 7,  8, 13, m[s[12]], m[s[13]])
+            BLAKE3_G(v, 3, 4,  9, 14, m[s[14]], m[s[15]])
+        }
+
+        for (i = 0; i < 8; i ++)
+        {
+            cv[i] = v[i] ^ v[i + 8];
+        }
+    }
+
+    // Transpose back.
+
+    for (lane = 0; lane < SD_BLAKE3_SIMD_DEGREE; lane ++)
+    {
+        for (i = 0; i < 8; i ++)
+        {
+            ChainingValues[lane][i] = cv[i][lane];
+        }
+    }
+} // Blake3CompressChunks()
+
+
+
+//
+// Blake3CompressLanes
+//
+__attribute__ ((target_clones ("avx2", "default")))
+static void
+Blake3CompressLanes(
+    __inout BLAKE3_DWORD_VECTOR *ChainingValues,
+    __in const BYTE             **Blocks,
+    __in const QWORD            *Counters,
+    __in const BYTE             *BlockLengths,
+    __in const BYTE             *Flags
+    )
+/*++
+Description: The routine applies the compression function on SD_BLAKE3_SIMD_DEGREE blocks of independent inputs at once, one block
+per vector lane, each lane with its own chaining value, counter, block length and flags (see Blake3HashMany()). The function is
+compiled twice (AVX2 and default) and the loader picks the variant matching the CPU.
+
+- ChainingValues: Pointer to the 8 words of the chaining values of all the lanes (input and output).
+- Blocks: Pointer to the SD_BLAKE3_SIMD_DEGREE pointers to the 64 bytes blocks (zero padded).
+- Counters: Pointer to the counters of the lanes.
+- BlockLengths: Pointer to the block lengths of the lanes.
+- Flags: Pointer to the flags of the lanes.
+
+Return value: None.
+--*/
+{
+    BLAKE3_DWORD_VECTOR m[16];
+    BLAKE3_DWORD_VECTOR v[16];
+    const BYTE          *s;
+    DWORD               lane, i;
+
+    for (i = 0; i < 16; i ++)
+    {
+        for (lane = 0; lane < SD_BLAKE3_SIMD_DEGREE; lane ++)
+        {
+            m[i][lane] = Blake3LoadWord(Blocks[lane] + 4 * i);
+        }
+    }
+
+    for (i = 0; i < 8; i ++)
+    {
+        v[i] = ChainingValues[i];
+    }
+    for (lane = 0; lane < SD_BLAKE3_SIMD_DEGREE; lane ++)
+    {
+        v[8][lane] = gBlake3IV[0];
+        v[9][lane] = gBlake3IV[1];
+        v[10][lane] = gBlake3IV[2];
+        v[11][lane] = gBlake3IV[3];
+        v[12][lane] = (DWORD) Counters[lane];
+        v[13][lane] = (DWORD) (Counters[lane] >> 32);
+        v[14][lane] = BlockLengths[lane];
+        v[15][lane] = Flags[lane];
+    }
+
+    for (i = 0; i < 7; i ++)
+    {
+        s = gBlake3MsgSchedule[i];
+
+        BLAKE3_G(v, 0, 4,  8, 12, m[s[0]],  m[s[1]])
+        BLAKE3_G(v, 1, 5,  9, 13, m[s[2]],  m[s[3]])
+        BLAKE3_G(v, 2, 6, 10, 14, m[s[4]],  m[s[5]])
+        BLAKE3_G(v, 3, 7, 11, 15, m[s[6]],  m[s[7]])
+
+        BLAKE3_G(v, 0, 5, 10, 15, m[s[8]],  m[s[9]])
+        BLAKE3_G(v, 1, 6, 11, 12, m[s[10]], m[s[11]])
+        BLAKE3_G(v, 2, 7,  8, 13, m[s[12]], m[s[13]])
+        BLAKE3_G(v, 3, 4,  9, 14, m[s[14]], m[s[15]])
+    }
+
+    for (i = 0; i < 8; i ++)
+    {
+        ChainingValues[i] = v[i] ^ v[i + 8];
+    }
+} // Blake3CompressLanes()
+
+
+
+//
+// Blake3OutputChainingValue
+//
+static void
+Blake3OutputChainingValue(
+    __in const BLAKE3_OUTPUT    *Output,
+    __out DWORD                 *ChainingValue
+    )
+/*++
+Description: The routine outputs the chaining value of a non-root node.
+--*/
+{
+    memcpy(ChainingValue, Output->InputChainingValue, 8 * sizeof(DWORD));
+    Blake3Compress(ChainingValue, Output->Block, Output->BlockLength, Output->Counter, Output->Flags);
+} // Blake3OutputChainingValue()
+
+
+
+//
+// Blake3OutputRootDigest
+//
+static void
+Blake3OutputRootDigest(
+    __in const BLAKE3_OUTPUT    *Output,
+    __out BYTE                  *Digest
+    )
+/*++
+Description: The routine outputs the 32 bytes digest, finalizing the node as the root of the tree.
+--*/
+{
+    DWORD words[8];
+
+    memcpy(words, Output->InputChainingValue, sizeof(words));
+    Blake3Compress(words, Output->Block, Output->BlockLength, 0, Output->Flags | BLAKE3_ROOT);
+    Blake3StoreWords(words, 8, Digest);
+} // Blake3OutputRootDigest()
+
+
+
+//
+// Blake3ParentOutput
+//
+static void
+Blake3ParentOutput(
+    __in const DWORD    *LeftChainingValue,
+    __in const DWORD    *RightChainingValue,
+    __out BLAKE3_OUTPUT *Output
+    )
+/*++
+Description: The routine prepares the last (and only) compression of a parent node, from the chaining values of its children.
+--*/
+{
+    memcpy(Output->InputChainingValue, gBlake3IV, sizeof(gBlake3IV));
+    Blake3StoreWords(LeftChainingValue, 8, Output->Block);
+    Blake3StoreWords(RightChainingValue, 8, Output->Block + 32);
+    Output->Counter = 0;
+    Output->BlockLength = SD_BLAKE3_BLOCK_SIZE;
+    Output->Flags = BLAKE3_PARENT;
+} // Blake3ParentOutput()
+
+
+
+//
+// Blake3ChunkStateInit
+//
+static void
+Blake3ChunkStateInit(
+    __out BLAKE3_CHUNK_STATE    *Chunk,
+    __in QWORD                  ChunkCounter
+    )
+{
+    memcpy(Chunk->ChainingValue, gBlake3IV, sizeof(gBlake3IV));
+    Chunk->ChunkCounter = ChunkCounter;
+    Chunk->BlockLength = 0;
+    Chunk->BlocksCompressed = 0;
+} // Blake3ChunkStateInit()
+
+
+
+//
+// Blake3ChunkStateLength
+//
+static inline DWORD
+Blake3ChunkStateLength(
+    __in const BLAKE3_CHUNK_STATE   *Chunk
+    )
+{
+    return SD_BLAKE3_BLOCK_SIZE * (DWORD) Chunk->BlocksCompressed + (DWORD) Chunk->BlockLength;
+} // Blake3ChunkStateLength()
+
+
+
+//
+// Blake3ChunkStateStartFlag
+//
+static inline BYTE
+Blake3ChunkStateStartFlag(
+    __in const BLAKE3_CHUNK_STATE   *Chunk
+    )
+{
+    return (0 == Chunk->BlocksCompressed) ? BLAKE3_CHUNK_START : 0;
+} // Blake3ChunkStateStartFlag()
+
+
+
+//
+// Blake3ChunkStateUpdate
+//
+static void
+Blake3ChunkStateUpdate(
+    __inout BLAKE3_CHUNK_STATE  *Chunk,
+    __in const BYTE             *Input,
+    __in size_t                 InputLength
+    )
+/*++
+Description: The routine adds InputLength bytes to the current chunk. The caller guarantees that the chunk does not overflow.
+The last block of the chunk is always kept pending, since it must be compressed with the CHUNK_END flag.
+--*/
+{
+    size_t toCopy;
+
+    while (0 != InputLength)
+    {
+        // Compress the pending block, since more input follows.
+
+        if (SD_BLAKE3_BLOCK_SIZE == Chunk->BlockLength)
+        {
+            Blake3Compress(Chunk->ChainingValue, Chunk->Block, SD_BLAKE3_BLOCK_SIZE, Chunk->ChunkCounter,
+                Blake3ChunkStateStartFlag(Chunk));
+            Chunk->BlocksCompressed ++;
+            Chunk->BlockLength = 0;
+        }
+
+        // Compress whole blocks directly from the input, while more input follows.
+
+        while (0 == Chunk->BlockLength && SD_BLAKE3_BLOCK_SIZE < InputLength)
+        {
+            Blake3Compress(Chunk->ChainingValue, Input, SD_BLAKE3_BLOCK_SIZE, Chunk->ChunkCounter, Blake3ChunkStateStartFlag(Chunk));
+            Chunk->BlocksCompressed ++;
+            Input = Input + SD_BLAKE3_BLOCK_SIZE;
+            InputLength = InputLength - SD_BLAKE3_BLOCK_SIZE;
+        }
+
+        toCopy = SD_MIN((size_t) (SD_BLAKE3_BLOCK_SIZE - Chunk->BlockLength), InputLength);
+        memcpy(Chunk->Block + Chunk->BlockLength, Input, toCopy);
+        Chunk->BlockLength = (BYTE) (Chunk->BlockLength + toCopy);
+        Input = Input + toCopy;
+        InputLength = InputLength - toCopy;
+    }
+} // Blake3ChunkStateUpdate()
+
+
+
+//
+// Blake3ChunkStateOutput
+//
+static void
+Blake3ChunkStateOutput(
+    __in const BLAKE3_CHUNK_STATE   *Chunk,
+    __out BLAKE3_OUTPUT             *Output
+    )
+/*++
+Description: The routine prepares the last compression of the current chunk (its pending block, zero padded, with CHUNK_END).
+--*/
+{
+    memcpy(Output->InputChainingValue, Chunk->ChainingValue, sizeof(Chunk->ChainingValue));
+    memcpy(Output->Block, Chunk->Block, Chunk->BlockLength);
+    memset(Output->Block + Chunk->BlockLength, 0, SD_BLAKE3_BLOCK_SIZE - Chunk->BlockLength);
+    Output->Counter = Chunk->ChunkCounter;
+    Output->BlockLength = Chunk->BlockLength;
+    Output->Flags = Blake3ChunkStateStartFlag(Chunk) | BLAKE3_CHUNK_END;
+} // Blake3ChunkStateOutput()
+
+
+
+//
+// Blake3InitAt
+//
+static void
+Blake3InitAt(
+    __out BLAKE3_CONTEXT    *Context,
+    __in QWORD              ChunkCounterBase
+    )
+/*++
+Description: The routine initializes a context hashing the subtree which starts at chunk ChunkCounterBase of the whole input.
+--*/
+{
+    Blake3ChunkStateInit(&Context->Chunk, ChunkCounterBase);
+    Context->ChunkCounterBase = ChunkCounterBase;
+    Context->StackLength = 0;
+} // Blake3InitAt()
+
+
+
+//
+// Blake3PushChunkChainingValue
+//
+static void
+Blake3PushChunkChainingValue(
+    __inout BLAKE3_CONTEXT  *Context,
+    __in DWORD              *ChainingValue,
+    __in QWORD              TotalChunks
+    )
+/*++
+Description: The routine pushes the chaining value of a complete chunk on the subtree stack. Each trailing 0 bit of the number of
+complete chunks (TotalChunks, relative to the context start) marks a complete subtree, which is merged into its parent.
+--*/
+{
+    BLAKE3_OUTPUT parentOutput;
+
+    while (0 == (TotalChunks & 1))
+    {
+        Context->StackLength --;
+        Blake3ParentOutput(Context->Stack[Context->StackLength], ChainingValue, &parentOutput);
+        Blake3OutputChainingValue(&parentOutput, ChainingValue);
+        TotalChunks = TotalChunks >> 1;
+    }
+
+    memcpy(Context->Stack[Context->StackLength], ChainingValue, 8 * sizeof(DWORD));
+    Context->StackLength ++;
+} // Blake3PushChunkChainingValue()
+
+
+
+//
+// Blake3FinalOutput
+//
+static void
+Blake3FinalOutput(
+    __in const BLAKE3_CONTEXT   *Context,
+    __out BLAKE3_OUTPUT         *Output
+    )
+/*++
+Description: The routine merges the current chunk with all the pending subtrees (right to left) and prepares the output of the
+top node. The context is not modified.
+--*/
+{
+    DWORD   chainingValue[8];
+    DWORD   i;
+
+    Blake3ChunkStateOutput(&Context->Chunk, Output);
+
+    for (i = Context->StackLength; 0 < i; i --)
+    {
+        Blake3OutputChainingValue(Output, chainingValue);
+        Blake3ParentOutput(Context->Stack[i - 1], chainingValue, Output);
+    }
+} // Blake3FinalOutput()
+
+
+
+//
+// Blake3Init
+//
+void
+Blake3Init(
+    __out BLAKE3_CONTEXT    *Context
+    )
+/*++
+Description: The routine initializes a BLAKE3 context, before any data is hashed with Blake3Update().
+
+- Context: Pointer to the context to be initialized. The caller provides the storage space.
+
+Return value: None.
+--*/
+{
+    Blake3InitAt(Context, 0);
+} // Blake3Init()
+
+
+
+//
+// Blake3Update
+//
+void
+Blake3Update(
+    __inout BLAKE3_CONTEXT  *Context,
+    __in const void         *Data,
+    __in size_t             DataLength
+    )
+/*++
+Description: The routine adds DataLength bytes from Data to the hash computation represented by Context. A chunk is closed only when
+more input follows, since the last chunk of the input is finalized differently (see Blake3Final()). Runs of whole chunks are hashed
+SD_BLAKE3_SIMD_DEGREE at a time (see Blake3CompressChunks()).
+
+- Context: Pointer to an initialized context.
+- Data: Pointer to the bytes to be hashed.
+- DataLength: Number of bytes at Data.
+
+Return value: None.
+--*/
+{
+    const BYTE      *input;
+    size_t          toHash;
+    DWORD           chainingValue[8];
+    BLAKE3_OUTPUT   chunkOutput;
+    QWORD           totalChunks;
+    DWORD           chunkChainingValues[SD_BLAKE3_SIMD_DEGREE][8];
+    DWORD           i;
+
+    input = (const BYTE*) Data;
+
+    while (0 != DataLength)
+    {
+        // Close the full current chunk, since more input follows.
+
+        if (SD_BLAKE3_CHUNK_SIZE == Blake3ChunkStateLength(&Context->Chunk))
+        {
+            Blake3ChunkStateOutput(&Context->Chunk, &chunkOutput);
+            Blake3OutputChainingValue(&chunkOutput, chainingValue);
+
+            totalChunks = Context->Chunk.ChunkCounter + 1;
+            Blake3PushChunkChainingValue(Context, chainingValue, totalChunks - Context->ChunkCounterBase);
+            Blake3ChunkStateInit(&Context->Chunk, totalChunks);
+        }
+
+        // Fast path: hash several whole chunks at once, directly from the input, while more input follows them.
+
+        while (0 == Blake3ChunkStateLength(&Context->Chunk) && SD_BLAKE3_SIMD_DEGREE * SD_BLAKE3_CHUNK_SIZE < DataLength)
+        {
+            Blake3CompressChunks(input, Context->Chunk.ChunkCounter, chunkChainingValues);
+
+            for (i = 0; i < SD_BLAKE3_SIMD_DEGREE; i ++)
+            {
+                totalChunks = Context->Chunk.ChunkCounter + i + 1;
+                Blake3PushChunkChainingValue(Context, chunkChainingValues[i], totalChunks - Context->ChunkCounterBase);
+            }
+            Blake3ChunkStateInit(&Context->Chunk, Context->Chunk.ChunkCounter + SD_BLAKE3_SIMD_DEGREE);
+
+            input = input + SD_BLAKE3_SIMD_DEGREE * SD_BLAKE3_CHUNK_SIZE;
+            DataLength = DataLength - SD_BLAKE3_SIMD_DEGREE * SD_BLAKE3_CHUNK_SIZE;
+        }
+
+        toHash = SD_MIN((size_t) (SD_BLAKE3_CHUNK_SIZE - Blake3ChunkStateLength(&Context->Chunk)), DataLength);
+        Blake3ChunkStateUpdate(&Context->Chunk, input, toHash);
+        input = input + toHash;
+        DataLength = DataLength - toHash;
+    }
+} // Blake3Update()
+
+
+
+//
+// Blake3Final
+//
+void
+Blake3Final(
+    __inout BLAKE3_CONTEXT  *Context,
+    __out BYTE              *Digest
+    )
+/*++
+Description: The routine completes the hash computation (merges the pending subtrees up to the root) and outputs the 32 bytes digest.
+
+- Context: Pointer to the context.
+- Digest: Pointer to where the routine outputs the digest. Storage of at least SD_BLAKE3_DIGEST_SIZE bytes is provided by the caller.
+
+Return value: None.
+--*/
+{
+    BLAKE3_OUTPUT output;
+
+    Blake3FinalOutput(Context, &output);
+    Blake3OutputRootDigest(&output, Digest);
+} // Blake3Final()
+
+
+
+//
+// Blake3LaneStartChunk
+//
+static void
+Blake3LaneStartChunk(
+    __inout BLAKE3_LANE         *Lane,
+    __inout BLAKE3_DWORD_VECTOR *ChainingValues,
+    __in DWORD                  LaneIndex
+    )
+/*++
+Description: The routine prepares the lane LaneIndex for hashing the chunk Lane->Chunk of its input.
+--*/
+{
+    size_t  chunkLength;
+    DWORD   i;
+
+    chunkLength = SD_MIN((size_t) SD_BLAKE3_CHUNK_SIZE, Lane->InputLength - (size_t) Lane->Chunk * SD_BLAKE3_CHUNK_SIZE);
+
+    Lane->Block = 0;
+    Lane->BlocksInChunk = (0 == chunkLength) ? 1 : (DWORD) ((chunkLength + SD_BLAKE3_BLOCK_SIZE - 1) / SD_BLAKE3_BLOCK_SIZE);
+
+    for (i = 0; i < 8; i ++)
+    {
+        ChainingValues[i][LaneIndex] = gBlake3IV[i];
+    }
+} // Blake3LaneStartChunk()
+
+
+
+//
+// Blake3LaneStart
+//
+static void
+Blake3LaneStart(
+    __out BLAKE3_LANE           *Lane,
+    __inout BLAKE3_DWORD_VECTOR *ChainingValues,
+    __in DWORD                  LaneIndex,
+    __in DWORD                  Index,
+    __in const BYTE             *Input,
+    __in size_t                 InputLength
+    )
+/*++
+Description: The routine assigns the input Index (Input, InputLength) to the vector lane LaneIndex.
+--*/
+{
+    Lane->Index = Index;
+    Lane->Input = Input;
+    Lane->InputLength = InputLength;
+    Lane->NumberOfChunks = (0 == InputLength) ? 1 : (InputLength + SD_BLAKE3_CHUNK_SIZE - 1) / SD_BLAKE3_CHUNK_SIZE;
+    Lane->Chunk = 0;
+
+    Blake3InitAt(&Lane->Context, 0);
+    Blake3LaneStartChunk(Lane, ChainingValues, LaneIndex);
+} // Blake3LaneStart()
+
+
+
+//
+// Blake3HashMany
+//
+void
+Blake3HashMany(
+    __in DWORD          NumberOfInputs,
+    __in const BYTE     **Inputs,
+    __in const size_t   *InputLengths,
+    __out BYTE          (*Digests)[SD_BLAKE3_DIGEST_SIZE]
+    )
+/*++
+Description: The routine outputs the BLAKE3 digests of NumberOfInputs independent inputs, hashing SD_BLAKE3_SIMD_DEGREE inputs at once
+(multi-buffer: one input per vector lane, see Blake3CompressLanes()). A lane which completes its input takes the next one, so inputs
+of different lengths keep all the lanes busy. Inputs of one chunk (up to 1 KB) are hashed entirely in the lanes, root compression
+included. For longer inputs, the chunks are hashed in the lanes and only the tree merge (one parent compression per chunk) and the
+root are computed by the scalar code.
+
+- NumberOfInputs: Number of inputs.
+- Inputs: Pointer to the NumberOfInputs pointers to the inputs.
+- InputLengths: Pointer to the NumberOfInputs input lengths, in bytes.
+- Digests: Pointer to where the routine outputs the NumberOfInputs digests.
+
+Return value: None.
+--*/
+{
+    BLAKE3_LANE         *lanes;
+    BLAKE3_LANE         *lane;
+    BLAKE3_DWORD_VECTOR chainingValues[8];
+    const BYTE          *blocks[SD_BLAKE3_SIMD_DEGREE];
+    QWORD               counters[SD_BLAKE3_SIMD_DEGREE];
+    BYTE                blockLengths[SD_BLAKE3_SIMD_DEGREE];
+    BYTE                flags[SD_BLAKE3_SIMD_DEGREE];
+    BYTE                unusedBlock[SD_BLAKE3_BLOCK_SIZE];
+    DWORD               chainingValue[8];
+    size_t              offset;
+    DWORD               nextInput;
+    DWORD               activeLanes;
+    DWORD               laneIndex, i;
+
+    lanes = (BLAKE3_LANE*) malloc(SD_BLAKE3_SIMD_DEGREE * sizeof(BLAKE3_LANE));    // Subtree stacks: too large for the stack.
+    if (NULL == lanes)
+    {
+        // Fallback: one input at a time.
+        for (i = 0; i < NumberOfInputs; i ++)
+        {
+            BLAKE3_CONTEXT context;
+
+            Blake3Init(&context);
+            Blake3Update(&context, Inputs[i], InputLengths[i]);
+            Blake3Final(&context, Digests[i]);
+        }
+        return;
+    }
+
+    memset(unusedBlock, 0, sizeof(unusedBlock));
+    memset(chainingValues, 0, sizeof(chainingValues));
+    nextInput = 0;
+    activeLanes = 0;
+
+    for (laneIndex = 0; laneIndex < SD_BLAKE3_SIMD_DEGREE; laneIndex ++)
+    {
+        lanes[laneIndex].Index = (DWORD) -1;
+        if (nextInput < NumberOfInputs)
+        {
+            Blake3LaneStart(&lanes[laneIndex], chainingValues, laneIndex, nextInput, Inputs[nextInput], InputLengths[nextInput]);
+            nextInput ++;
+            activeLanes ++;
+        }
+    }
+
+    while (0 != activeLanes)
+    {
+        // Next block of every lane.
+
+        for (laneIndex = 0; laneIndex < SD_BLAKE3_SIMD_DEGREE; laneIndex ++)
+        {
+            lane = &lanes[laneIndex];
+
+            while ((DWORD) -1 != lane->Index)
+            {
+                offset = (size_t) lane->Chunk * SD_BLAKE3_CHUNK_SIZE + (size_t) lane->Block * SD_BLAKE3_BLOCK_SIZE;
+                blockLengths[laneIndex] = (BYTE) SD_MIN((size_t) SD_BLAKE3_BLOCK_SIZE, lane->InputLength - offset);
+
+                if (lane->Block + 1 < lane->BlocksInChunk || 1 == lane->NumberOfChunks || lane->Chunk + 1 < lane->NumberOfChunks)
+                {
+                    break;                                              // Block for the lanes.
+                }
+
+                // Last block of an input of several chunks: hand the chunk over to the (scalar) tree merge and root.
+
+                for (i = 0; i < 8; i ++)
+                {
+                    lane->Context.Chunk.ChainingValue[i] = chainingValues[i][laneIndex];
+                }
+                lane->Context.Chunk.ChunkCounter = lane->Chunk;
+                lane->Context.Chunk.BlocksCompressed = (BYTE) lane->Block;
+                lane->Context.Chunk.BlockLength = blockLengths[laneIndex];
+                memcpy(lane->Context.Chunk.Block, lane->Input + offset, blockLengths[laneIndex]);
+                Blake3Final(&lane->Context, Digests[lane->Index]);
+
+                lane->Index = (DWORD) -1;
+                activeLanes --;
+
+                if (nextInput < NumberOfInputs)
+                {
+                    Blake3LaneStart(lane, chainingValues, laneIndex, nextInput, Inputs[nextInput], InputLengths[nextInput]);
+                    nextInput ++;
+                    activeLanes ++;
+                }
+            }
+
+            if ((DWORD) -1 == lane->Index)
+            {
+                blocks[laneIndex] = unusedBlock;
+                counters[laneIndex] = 0;
+                blockLengths[laneIndex] = 0;
+                flags[laneIndex] = 0;
+                continue;
+            }
+
+            if (SD_BLAKE3_BLOCK_SIZE == blockLengths[laneIndex])
+            {
+                blocks[laneIndex] = lane->Input + offset;
+            }
+            else
+            {
+                memcpy(lane->BlockBuffer, lane->Input + offset, blockLengths[laneIndex]);
+                memset(lane->BlockBuffer + blockLengths[laneIndex], 0, SD_BLAKE3_BLOCK_SIZE - blockLengths[laneIndex]);
+                blocks[laneIndex] = lane->BlockBuffer;
+            }
+
+            counters[laneIndex] = lane->Chunk;
+            flags[laneIndex] = (0 == lane->Block) ? BLAKE3_CHUNK_START : 0;
+            if (lane->Block + 1 == lane->BlocksInChunk)
+            {
+                flags[laneIndex] = flags[laneIndex] | BLAKE3_CHUNK_END;
+                if (1 == lane->NumberOfChunks)
+                {
+                    flags[laneIndex] = flags[laneIndex] | BLAKE3_ROOT;  // Single chunk: the chunk is the root.
+                }
+            }
+        }
+
+        if (0 == activeLanes)
+        {
+            break;
+        }
+
+        Blake3CompressLanes(chainingValues, blocks, counters, blockLengths, flags);
+
+        // Advance the lanes. Output the completed inputs and refill their lanes.
+
+        for (laneIndex = 0; laneIndex < SD_BLAKE3_SIMD_DEGREE; laneIndex ++)
+        {
+            lane = &lanes[laneIndex];
+
+            if ((DWORD) -1 == lane->Index)
+            {
+                continue;
+            }
+
+            lane->Block ++;
+            if (lane->Block < lane->BlocksInChunk)
+            {
+                continue;
+            }
+
+            for (i = 0; i < 8; i ++)
+            {
+                chainingValue[i] = chainingValues[i][laneIndex];
+            }
+
+            if (1 < lane->NumberOfChunks)
+            {
+                // Complete (non-last) chunk: push its chaining value, continue with the next chunk.
+
+                Blake3PushChunkChainingValue(&lane->Context, chainingValue, lane->Chunk + 1);
+                lane->Chunk ++;
+                Blake3LaneStartChunk(lane, chainingValues, laneIndex);
+                continue;
+            }
+
+            Blake3StoreWords(chainingValue, 8, Digests[lane->Index]);
+
+            lane->Index = (DWORD) -1;
+            activeLanes --;
+
+            if (nextInput < NumberOfInputs)
+            {
+                Blake3LaneStart(lane, chainingValues, laneIndex, nextInput, Inputs[nextInput], InputLengths[nextInput]);
+                nextInput ++;
+                activeLanes ++;
+            }
+        }
+    }
+
+    free(lanes);
+} // Blake3HashMany()
+
+
+
+//
+// Blake3MergeSegments
+//
+static void
+Blake3MergeSegments(
+    __in DWORD      (*SegmentChainingValues)[8],
+    __in QWORD      NumberOfSegments,
+    __out DWORD     *ChainingValue
+    )
+/*++
+Description: The routine merges the chaining values of NumberOfSegments consecutive segments into the chaining value of their
+common (non-root) subtree. The BLAKE3 tree is left-balanced: the left subtree holds the largest power of 2 number of segments which
+is smaller than NumberOfSegments. (All segments except the last one are full, so segment borders are subtree borders.)
+--*/
+{
+    QWORD           leftSegments;
+    DWORD           leftChainingValue[8];
+    DWORD           rightChainingValue[8];
+    BLAKE3_OUTPUT   parentOutput;
+
+    if (1 == NumberOfSegments)
+    {
+        memcpy(ChainingValue, SegmentChainingValues[0], 8 * sizeof(DWORD));
+        return;
+    }
+
+    leftSegments = (QWORD) 1 << (63 - __builtin_clzll(NumberOfSegments - 1));
+
+    Blake3MergeSegments(SegmentChainingValues, leftSegments, leftChainingValue);
+    Blake3MergeSegments(SegmentChainingValues + leftSegments, NumberOfSegments - leftSegments, rightChainingValue);
+
+    Blake3ParentOutput(leftChainingValue, rightChainingValue, &parentOutput);
+    Blake3OutputChainingValue(&parentOutput, ChainingValue);
+} // Blake3MergeSegments()
+
+
+
+//
+// Blake3SegmentWorker
+//
+static void*
+Blake3SegmentWorker(
+    __in void   *Argument
+    )
+/*++
+Description: Thread routine. The routine takes segments from the shared job, until none is left (or a thread failed), reads each of
+them in its own buffer and outputs the segment's subtree chaining value.
+
+- Argument: Pointer to the shared BLAKE3_SEGMENT_JOB.
+
+Return value: NULL.
+--*/
+{
+    BLAKE3_SEGMENT_JOB  *job;
+    BYTE                *segmentBuffer;
+    BLAKE3_CONTEXT      context;
+    BLAKE3_OUTPUT       output;
+    QWORD               segment;
+    QWORD               segmentOffset;
+    size_t              segmentLength;
+    size_t              readLength;
+    ssize_t             readBytes;
+
+    job = (BLAKE3_SEGMENT_JOB*) Argument;
+    segmentBuffer = NULL;
+
+    if (0 != posix_memalign((void**) &segmentBuffer, SD_FILE_READ_BUFFER_ALIGNMENT, SD_BLAKE3_SEGMENT_SIZE))
+    {
+        printf("[SyncDir] Error: Blake3SegmentWorker(): Error at posix_memalign().\n");
+        __atomic_store_n(&job->HasFailed, TRUE, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    while (FALSE == __atomic_load_n(&job->HasFailed, __ATOMIC_RELAXED))
+    {
+        segment = __atomic_fetch_add(&job->NextSegment, 1, __ATOMIC_RELAXED);
+        if (job->NumberOfSegments <= segment)
+        {
+            break;
+        }
+
+        segmentOffset = segment * SD_BLAKE3_SEGMENT_SIZE;
+        segmentLength = (size_t) SD_MIN((QWORD) SD_BLAKE3_SEGMENT_SIZE, job->FileSize - segmentOffset);
+
+
+        // Read the whole segment.
+
+        readLength = 0;
+        while (readLength < segmentLength)
+        {
+            readBytes = pread(job->FileDescriptor, segmentBuffer + readLength, FileReadQuota(segmentLength - readLength), 
+                              segmentOffset + readLength);
+            if (readBytes < 0 && EINTR == errno)
+            {
+                continue;
+            }
+            if (readBytes <= 0)
+            {
+                perror("[SyncDir] Error: Blake3SegmentWorker(): Error at pread() (or the file was truncated).\n");
+                __atomic_store_n(&job->HasFailed, TRUE, __ATOMIC_RELAXED);
+                break;
+            }
+            readLength = readLength + readBytes;
+        }
+        if (readLength < segmentLength)
+        {
+            break;
+        }
+
+
+        // Hash the segment as the subtree starting at its first chunk.
+
+        Blake3InitAt(&context, segmentOffset / SD_BLAKE3_CHUNK_SIZE);
+        Blake3Update(&context, segmentBuffer, segmentLength);
+        Blake3FinalOutput(&context, &output);
+        Blake3OutputChainingValue(&output, job->SegmentChainingValues[segment]);
+    }
+
+    free(segmentBuffer);
+    return NULL;
+} // Blake3SegmentWorker()
+
+
+
+//
+// Blake3HashOfFileDescriptorParallel
+//
+SDSTATUS
+Blake3HashOfFileDescriptorParallel(
+    __in __int32    FileDescriptor,
+    __in QWORD      FileSize,
+    __in DWORD      NumberOfThreads,
+    __out BYTE      *Digest
+    )
+/*++
+Description: The routine outputs the BLAKE3 digest of the first FileSize bytes of the file identified by FileDescriptor. The file is
+split in segments of SD_BLAKE3_SEGMENT_SIZE bytes, hashed as independent subtrees by NumberOfThreads threads (the calling thread
+included). The segment chaining values are merged into the root at the end.
+
+- FileDescriptor: Descriptor of the file, open for reading.
+- FileSize: Number of bytes to be hashed. The file must not shrink while it is hashed.
+- NumberOfThreads: Number of threads hashing segments (at least 1).
+- Digest: Pointer to where the routine outputs the digest. Storage of at least SD_BLAKE3_DIGEST_SIZE bytes is provided by the caller.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS            status;
+    BLAKE3_SEGMENT_JOB  job;
+    pthread_t           *threads;
+    DWORD               numberOfStartedThreads;
+    DWORD               leftChainingValue[8];
+    DWORD               rightChainingValue[8];
+    BLAKE3_OUTPUT       rootOutput;
+    QWORD               leftSegments;
+    DWORD               i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    threads = NULL;
+    numberOfStartedThreads = 0;
+    memset(&job, 0, sizeof(job));
+
+    // Parameter validation.
+
+    if (FileDescriptor < 0)
+    {
+        printf("[SyncDir] Error: Blake3HashOfFileDescriptorParallel(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (FileSize <= SD_BLAKE3_SEGMENT_SIZE)
+    {
+        printf("[SyncDir] Error: Blake3HashOfFileDescriptorParallel(): Invalid parameter 2 (a single segment is hashed by streaming).\n");
+        return STATUS_FAIL;
+    }
+    if (0 == NumberOfThreads)
+    {
+        printf("[SyncDir] Error: Blake3HashOfFileDescriptorParallel(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == Digest)
+    {
+        printf("[SyncDir] Error: Blake3HashOfFileDescriptorParallel(): Invalid parameter 4.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    job.FileDescriptor = FileDescriptor;
+    job.FileSize = FileSize;
+    job.NumberOfSegments = (FileSize + SD_BLAKE3_SEGMENT_SIZE - 1) / SD_BLAKE3_SEGMENT_SIZE;
+    job.NextSegment = 0;
+    job.HasFailed = FALSE;
+
+    job.SegmentChainingValues = (DWORD (*)[8]) malloc(job.NumberOfSegments * 8 * sizeof(DWORD));
+    if (NULL == job.SegmentChainingValues)
+    {
+        printf("[SyncDir] Error: Blake3HashOfFileDescriptorParallel(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_Blake3HashOfFileDescriptorParallel;
+    }
+
+    NumberOfThreads = (DWORD) SD_MIN((QWORD) NumberOfThreads, job.NumberOfSegments);
+
+    threads = (pthread_t*) malloc(NumberOfThreads * sizeof(pthread_t));
+    if (NULL == threads)
+    {
+        printf("[SyncDir] Error: Blake3HashOfFileDescriptorParallel(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_Blake3HashOfFileDescriptorParallel;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+
+    // Hash the segments: NumberOfThreads - 1 helper threads, plus the calling thread.
+    // If a helper thread cannot be started, the others (at least the calling thread) take over its share.
+
+    for (i = 1; i < NumberOfThreads; i ++)
+    {
+        if (0 != pthread_create(&threads[numberOfStartedThreads], NULL, Blake3SegmentWorker, &job))
+        {
+            printf("[SyncDir] Warning: Blake3HashOfFileDescriptorParallel(): Error at pthread_create(). Continuing with %u threads ...\n",
+                numberOfStartedThreads + 1);
+            break;
+        }
+        numberOfStartedThreads ++;
+    }
+
+    Blake3SegmentWorker(&job);
+
+    for (i = 0; i < numberOfStartedThreads; i ++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    numberOfStartedThreads = 0;
+
+    if (TRUE == job.HasFailed)
+    {
+        printf("[SyncDir] Error: Blake3HashOfFileDescriptorParallel(): Failed to hash all file segments.\n");
+        status = STATUS_FAIL;
+        goto cleanup_Blake3HashOfFileDescriptorParallel;
+    }
+
+
+    // Merge the segment subtrees. There are at least 2 segments, so the root is a parent node.
+
+    leftSegments = (QWORD) 1 << (63 - __builtin_clzll(job.NumberOfSegments - 1));
+
+    Blake3MergeSegments(job.SegmentChainingValues, leftSegments, leftChainingValue);
+    Blake3MergeSegments(job.SegmentChainingValues + leftSegments, job.NumberOfSegments - leftSegments, rightChainingValue);
+
+    Blake3ParentOutput(leftChainingValue, rightChainingValue, &rootOutput);
+    Blake3OutputRootDigest(&rootOutput, Digest);
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_Blake3HashOfFileDescriptorParallel:
+
+    if (SUCCESS(status))
+    {
+        free(threads);
+        threads = NULL;
+        free(job.SegmentChainingValues);
+        job.SegmentChainingValues = NULL;
+    }
+    else
+    {
+        free(threads);
+        threads = NULL;
+        free(job.SegmentChainingValues);
+        job.SegmentChainingValues = NULL;
+    }
+
+    return status;
+} // Blake3HashOfFileDescriptorParallel()
@@ -0,0 +1,591 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#define _GNU_SOURCE                                                     // SEEK_DATA, SEEK_HOLE.
+
+#include "syncdir_cdc.h"
+#include "syncdir_utile.h"
+
+
+
+#define SD_CDC_GEAR_SEED 0x5344434443444330ULL                          // Fixed: the client and the server need the same table.
+#define SD_CDC_READ_BUFFER_SIZE (SD_FILE_READ_BUFFER_SIZE + SD_CDC_MAX_CHUNK_SIZE)    // Content read, for the chunks of a file descriptor.
+
+
+
+static QWORD            gCdcGearTable[256];                             // Random value of each byte, for the rolling gear hash.
+static QWORD            gCdcMaskSmall;                                  // Harder boundary condition, before the normal size.
+static QWORD            gCdcMaskLarge;                                  // Easier boundary condition, after the normal size.
+static pthread_once_t   gCdcInitOnce = PTHREAD_ONCE_INIT;
+
+
+
+//
+// CdcSpreadMask
+//
+static QWORD
+CdcSpreadMask(
+    __in DWORD NumberOfBits
+    )
+/*++
+Description: The routine returns a mask of NumberOfBits bits, spread over the bits 16-63 of the gear hash (as FastCDC does). Bit k of
+the hash depends on the last k + 1 bytes, so the high bits give a window of at least 16 bytes.
+
+- NumberOfBits: Number of bits set. At least 2.
+
+Return value: The mask.
+--*/
+{
+    QWORD   mask;
+    DWORD   i;
+
+    mask = 0;
+    for (i = 0; i < NumberOfBits; i ++)
+    {
+        mask |= 1ULL << (63 - (i * 47) / (NumberOfBits - 1));
+    }
+
+    return mask;
+} // CdcSpreadMask()
+
+
+
+//
+// CdcInit
+//
+static void
+CdcInit(
+    void
+    )
+/*++
+Description: The routine fills the gear table (splitmix64 sequence, from a fixed seed) and the masks. Normalized chunking (level 2):
+the mask before the normal size has 2 more bits than log2(SD_CDC_AVG_CHUNK_SIZE), the one after it 2 less, so the chunk sizes
+concentrate around the normal size. Called once, by pthread_once().
+
+Return value: None.
+--*/
+{
+    QWORD   state;
+    QWORD   value;
+    DWORD   averageBits;
+    DWORD   i;
+
+    state = SD_CDC_GEAR_SEED;
+    for (i = 0; i < 256; i ++)
+    {
+        state += 0x9E3779B97F4A7C15ULL;
+        value = state;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        gCdcGearTable[i] = value ^ (value >> 31);
+    }
+
+    for (averageBits = 0; (1U << averageBits) < SD_CDC_AVG_CHUNK_SIZE; averageBits ++);
+
+    gCdcMaskSmall = CdcSpreadMask(averageBits + 2);
+    gCdcMaskLarge = CdcSpreadMask(averageBits - 2);
+} // CdcInit()
+
+
+
+//
+// CdcIsZeroChunk
+//
+static inline BOOL
+CdcIsZeroChunk(
+    __in const BYTE     *Data,
+    __in DWORD          Size
+    )
+/*++
+Description: The routine checks whether the content of a chunk is only zeros (a hole of a sparse file, or zeros written).
+
+Return value: TRUE if the chunk holds only zeros, FALSE otherwise.
+--*/
+{
+    return (0 == Size || (0 == Data[0] && 0 == memcmp(Data, Data + 1, Size - 1))) ? TRUE : FALSE;
+} // CdcIsZeroChunk()
+
+
+
+//
+// CdcHashChunks
+//
+static SDSTATUS
+CdcHashChunks(
+    __in HASH_ALGORITHM     Algorithm,
+    __in const BYTE         *Data,
+    __in QWORD              DataOffset,
+    __inout CDC_CHUNK       *Chunks,
+    __in DWORD              NumberOfChunks
+    )
+/*++
+Description: The routine computes the hash codes of NumberOfChunks chunks, whose content is in Data. The chunks are hashed together,
+SD_HASH_BATCH_SIZE at a time (see HashMany()). The chunks holding only zeros are not hashed: they are holes (empty hash code).
+
+- Algorithm: The hash algorithm.
+- Data: Pointer to the content of the chunks.
+- DataOffset: Offset in the file of the first byte of Data.
+- Chunks: Pointer to the chunks. Their hash codes are output.
+- NumberOfChunks: Number of chunks.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS    status;
+    const BYTE  *inputs[SD_HASH_BATCH_SIZE];
+    size_t      inputLengths[SD_HASH_BATCH_SIZE];
+    char        hashCodes[SD_HASH_BATCH_SIZE][SD_MAX_HASH_CODE_LENGTH + 1];
+    DWORD       batchIndexes[SD_HASH_BATCH_SIZE];
+    DWORD       chunksInBatch;
+    DWORD       i;
+    DWORD       j;
+
+    for (i = 0; i < NumberOfChunks; )
+    {
+        for (chunksInBatch = 0; i < NumberOfChunks && chunksInBatch < SD_HASH_BATCH_SIZE; i ++)
+        {
+            if (TRUE == CdcIsZeroChunk(Data + (Chunks[i].Offset - DataOffset), Chunks[i].Size))
+            {
+                Chunks[i].HashCode[0] = 0;
+                continue;
+            }
+            batchIndexes[chunksInBatch] = i;
+            inputs[chunksInBatch] = Data + (Chunks[i].Offset - DataOffset);
+            inputLengths[chunksInBatch] = Chunks[i].Size;
+            chunksInBatch ++;
+        }
+        if (0 == chunksInBatch)
+        {
+            continue;
+        }
+
+        status = HashMany(Algorithm, chunksInBatch, inputs, inputLengths, hashCodes);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: CdcHashChunks(): HashMany() failed.\n");
+            return STATUS_FAIL;
+        }
+
+        for (j = 0; j < chunksInBatch; j ++)
+        {
+            strcpy(Chunks[batchIndexes[j]].HashCode, hashCodes[j]);
+        }
+    }
+
+    return STATUS_SUCCESS;
+} // CdcHashChunks()
+
+
+
+//
+// CdcAddChunk
+//
+static CDC_CHUNK*
+CdcAddChunk(
+    __inout CDC_CHUNK   **Chunks,
+    __inout DWORD       *NumberOfChunks,
+    __inout DWORD       *MaxChunks,
+    __in QWORD          FileSize
+    )
+/*++
+Description: The routine appends an entry to the array of chunks of a file, growing the array if it is full (first size from the
+size of the file, then doubled).
+
+Return value: Pointer to the new entry, or NULL on failure (the array is left as it was).
+--*/
+{
+    CDC_CHUNK   *newChunks;
+    DWORD       maxChunks;
+
+    if (*NumberOfChunks == *MaxChunks)
+    {
+        maxChunks = (0 == *MaxChunks) ? (DWORD) (FileSize / SD_CDC_AVG_CHUNK_SIZE + 16) : 2 * (*MaxChunks);
+        newChunks = (CDC_CHUNK*) realloc(*Chunks, (size_t) maxChunks * sizeof(CDC_CHUNK));
+        if (NULL == newChunks)
+        {
+            printf("[SyncDir] Error: CdcAddChunk(): Error at realloc().\n");
+            return NULL;
+        }
+        *Chunks = newChunks;
+        *MaxChunks = maxChunks;
+    }
+
+    (*NumberOfChunks) ++;
+
+    return (*Chunks) + (*NumberOfChunks - 1);
+} // CdcAddChunk()
+
+
+
+//
+// CdcNextChunkSize
+//
+DWORD
+CdcNextChunkSize(
+    __in const BYTE *Data,
+    __in size_t     Length
+    )
+/*++
+Description: The routine returns the size of the chunk starting at Data (FastCDC). The gear hash is rolled over the bytes after the
+minimum size (the first SD_CDC_MIN_CHUNK_SIZE bytes are skipped: no cut point there), and a boundary is found when the bits of the
+mask are all zero. The harder mask is used up to the normal size, the easier one after it; the chunk is cut at the maximum size
+anyway. The boundary depends only on the bytes of the chunk.
+
+- Data: Pointer to the start of the chunk.
+- Length: Number of bytes available at Data: at least SD_CDC_MAX_CHUNK_SIZE, unless Data holds the end of the file.
+
+Return value: The size of the chunk, in bytes (at most SD_CDC_MAX_CHUNK_SIZE, and at most Length).
+--*/
+{
+    QWORD   fingerprint;
+    size_t  maxSize;
+    size_t  normalSize;
+    size_t  i;
+
+    pthread_once(&gCdcInitOnce, CdcInit);
+
+    if (Length <= SD_CDC_MIN_CHUNK_SIZE)
+    {
+        return (DWORD) Length;
+    }
+
+    maxSize = SD_MIN(Length, (size_t) SD_CDC_MAX_CHUNK_SIZE);
+    normalSize = SD_MIN(maxSize, (size_t) SD_CDC_AVG_CHUNK_SIZE);
+    fingerprint = 0;
+
+    for (i = SD_CDC_MIN_CHUNK_SIZE; i < normalSize; i ++)
+    {
+        fingerprint = (fingerprint << 1) + gCdcGearTable[Data[i]];
+        if (0 == (fingerprint & gCdcMaskSmall))
+        {
+            return (DWORD) (i + 1);
+        }
+    }
+    for (; i < maxSize; i ++)
+    {
+        fingerprint = (fingerprint << 1) + gCdcGearTable[Data[i]];
+        if (0 == (fingerprint & gCdcMaskLarge))
+        {
+            return (DWORD) (i + 1);
+        }
+    }
+
+    return (DWORD) maxSize;
+} // CdcNextChunkSize()
+
+
+
+//
+// CdcChunksOfRange
+//
+static SDSTATUS
+CdcChunksOfRange(
+    __in HASH_ALGORITHM     Algorithm,
+    __in __int32            FileDescriptor,
+    __in_opt const BYTE     *FileContent,
+    __in QWORD              Offset,
+    __in QWORD              Length,
+    __in QWORD              FileSize,
+    __in_opt BYTE           *Buffer,
+    __inout CDC_CHUNK       **Chunks,
+    __inout DWORD           *NumberOfChunks,
+    __inout DWORD           *MaxChunks
+    )
+/*++
+Description: The routine splits Length bytes of the content of a file, from Offset, into chunks (see CdcNextChunkSize()), and appends
+them to the array of chunks, with their hash codes. If FileContent is NULL, the range is read into Buffer (SD_CDC_READ_BUFFER_SIZE 
+bytes): the chunks that are whole in the buffer are cut and hashed, then the rest of the data is moved to the start of the buffer and
+the buffer is refilled.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. the file was truncated meanwhile).
+--*/
+{
+    SDSTATUS    status;
+    const BYTE  *data;
+    CDC_CHUNK   *chunk;
+    DWORD       firstNewChunk;
+    size_t      dataLength;
+    size_t      position;
+    QWORD       dataOffset;
+    QWORD       rangeEnd;
+    ssize_t     readBytes;
+    BOOL        isEndOfRange;
+
+    if (NULL == FileContent)
+    {
+        data = Buffer;
+        dataLength = 0;
+    }
+    else
+    {
+        data = FileContent + Offset;
+        dataLength = (size_t) Length;
+    }
+    dataOffset = Offset;
+    rangeEnd = Offset + Length;
+    position = 0;
+
+    for (;;)
+    {
+        // Refill the buffer (the content in memory is already whole).
+
+        if (NULL == FileContent)
+        {
+            memmove(Buffer, Buffer + position, dataLength - position);
+            dataOffset += position;
+            dataLength -= position;
+            position = 0;
+
+            while (dataLength < SD_CDC_READ_BUFFER_SIZE && dataOffset + dataLength < rangeEnd)
+            {
+                readBytes = pread(FileDescriptor, Buffer + dataLength, FileReadQuota((size_t) SD_MIN((QWORD) (SD_CDC_READ_BUFFER_SIZE - 
+                                  dataLength), rangeEnd - dataOffset - dataLength)), dataOffset + dataLength);
+                if (readBytes <= 0)
+                {
+                    perror("[SyncDir] Error: CdcChunksOfRange(): Error at pread() (or file truncated).\n");
+                    return STATUS_FAIL;
+                }
+                dataLength += readBytes;
+            }
+        }
+
+        if (position == dataLength)
+        {
+            break;
+        }
+        isEndOfRange = (dataOffset + dataLength == rangeEnd);
+
+
+        // Cut the chunks that are whole in the data.
+
+        firstNewChunk = *NumberOfChunks;
+        while (position < dataLength && (isEndOfRange || dataLength - position >= SD_CDC_MAX_CHUNK_SIZE))
+        {
+            chunk = CdcAddChunk(Chunks, NumberOfChunks, MaxChunks, FileSize);
+            if (NULL == chunk)
+            {
+                printf("[SyncDir] Error: CdcChunksOfRange(): CdcAddChunk() failed.\n");
+                return STATUS_FAIL;
+            }
+
+            chunk->Offset = dataOffset + position;
+            chunk->Size = CdcNextChunkSize(data + position, dataLength - position);
+            position += chunk->Size;
+        }
+
+        status = CdcHashChunks(Algorithm, data, dataOffset, (*Chunks) + firstNewChunk, *NumberOfChunks - firstNewChunk);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: CdcChunksOfRange(): CdcHashChunks() failed.\n");
+            return STATUS_FAIL;
+        }
+    }
+
+    return STATUS_SUCCESS;
+} // CdcChunksOfRange()
+
+
+
+//
+// CdcChunksOfFile
+//
+SDSTATUS
+CdcChunksOfFile(
+    __in HASH_ALGORITHM     Algorithm,
+    __in __int32            FileDescriptor,
+    __in_opt const BYTE     *FileContent,
+    __in QWORD              FileSize,
+    __out CDC_CHUNK         **Chunks,
+    __out DWORD             *NumberOfChunks
+    )
+/*++
+Description: The routine splits the content of a file into chunks (see CdcChunksOfRange()) and outputs them, with their hash codes.
+The chunks holding only zeros are holes: their hash code is empty. If the file is sparse (fewer blocks allocated than its size), its
+holes are not read: the data extents are found with lseek(SEEK_DATA/SEEK_HOLE) on FileDescriptor and chunked one by one, and each hole
+is output as hole chunks of up to SD_CDC_MAX_HOLE_SIZE bytes. A file too fragmented for SD_CDC_MAX_CHUNKS chunks is chunked whole.
+
+- Algorithm: The hash algorithm of the chunk hash codes.
+- FileDescriptor: Descriptor of the file, open for reading. Used to read the content only if FileContent is NULL.
+- FileContent: Optional. Pointer to the content of the file (FileSize bytes).
+- FileSize: Size of the file, in bytes.
+- Chunks: Pointer to where the routine outputs the array of chunks (allocated by the routine, freed by the caller with free()).
+- NumberOfChunks: Pointer to where the routine outputs the number of chunks.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. the file was truncated meanwhile).
+--*/
+{
+    SDSTATUS    status;
+    BYTE        *buffer;
+    CDC_CHUNK   *chunks;
+    CDC_CHUNK   *chunk;
+    DWORD       numberOfChunks;
+    DWORD       maxChunks;
+    QWORD       position;
+    QWORD       dataStart;
+    QWORD       dataEnd;
+    QWORD       holeOffset;
+    off_t       seekOffset;
+    struct stat fileStat;
+    BOOL        isSparse;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    buffer = NULL;
+    chunks = NULL;
+    numberOfChunks = 0;
+    maxChunks = 0;
+    dataEnd = 0;
+    isSparse = FALSE;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: CdcChunksOfFile(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (FileDescriptor < 0 && NULL == FileContent)
+    {
+        printf("[SyncDir] Error: CdcChunksOfFile(): Invalid parameters 2-3.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == Chunks)
+    {
+        printf("[SyncDir] Error: CdcChunksOfFile(): Invalid parameter 5.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == NumberOfChunks)
+    {
+        printf("[SyncDir] Error: CdcChunksOfFile(): Invalid parameter 6.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    *Chunks = NULL;
+    *NumberOfChunks = 0;
+
+    if (NULL == FileContent)
+    {
+        buffer = (BYTE*) malloc(SD_CDC_READ_BUFFER_SIZE);
+        if (NULL == buffer)
+        {
+            printf("[SyncDir] Error: CdcChunksOfFile(): Error at malloc().\n");
+            status = STATUS_FAIL;
+            goto cleanup_CdcChunksOfFile;
+        }
+    }
+
+    if (0 <= FileDescriptor && 0 == fstat(FileDescriptor, &fileStat) && S_ISREG(fileStat.st_mode) && 
+        (QWORD) fileStat.st_blocks * 512 < FileSize)
+    {
+        isSparse = TRUE;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    // Sparse file: the holes, then the data extent after each one.
+
+    for (position = 0; TRUE == isSparse && position < FileSize; position = dataEnd)
+    {
+        seekOffset = lseek(FileDescriptor, (off_t) position, SEEK_DATA);
+        if (seekOffset < 0 && ENXIO != errno)                           // Holes not reported by the file system.
+        {
+            isSparse = FALSE;
+            break;
+        }
+        dataStart = (seekOffset < 0) ? FileSize : SD_MIN((QWORD) seekOffset, FileSize);     // ENXIO: hole up to the end.
+        seekOffset = (dataStart < FileSize) ? lseek(FileDescriptor, (off_t) dataStart, SEEK_HOLE) : (off_t) FileSize;
+        dataEnd = (seekOffset < 0) ? FileSize : SD_MIN((QWORD) seekOffset, FileSize);
+        if (dataStart < position || (dataStart < FileSize && dataEnd <= dataStart))         // Changed meanwhile.
+        {
+            isSparse = FALSE;
+            break;
+        }
+
+        for (holeOffset = position; holeOffset < dataStart; holeOffset += chunk->Size)
+        {
+            chunk = CdcAddChunk(&chunks, &numberOfChunks, &maxChunks, FileSize);
+            if (NULL == chunk)
+            {
+                printf("[SyncDir] Error: CdcChunksOfFile(): CdcAddChunk() failed.\n");
+                status = STATUS_FAIL;
+                goto cleanup_CdcChunksOfFile;
+            }
+            chunk->Offset = holeOffset;
+            chunk->Size = (DWORD) SD_MIN(dataStart - holeOffset, (QWORD) SD_CDC_MAX_HOLE_SIZE);
+            chunk->HashCode[0] = 0;
+        }
+
+        status = CdcChunksOfRange(Algorithm, FileDescriptor, FileContent, dataStart, dataEnd - dataStart, FileSize, buffer, &chunks, 
+                                  &numberOfChunks, &maxChunks);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: CdcChunksOfFile(): CdcChunksOfRange() failed.\n");
+            status = STATUS_FAIL;
+            goto cleanup_CdcChunksOfFile;
+        }
+
+        if (numberOfChunks > SD_CDC_MAX_CHUNKS)                         // Too fragmented.
+        {
+            isSparse = FALSE;
+            break;
+        }
+    }
+
+
+    // Otherwise, the whole content.
+
+    if (FALSE == isSparse)
+    {
+        numberOfChunks = 0;
+
+        status = CdcChunksOfRange(Algorithm, FileDescriptor, FileContent, 0, FileSize, FileSize, buffer, &chunks, &numberOfChunks, 
+                                  &maxChunks);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: CdcChunksOfFile(): CdcChunksOfRange() failed.\n");
+            status = STATUS_FAIL;
+            goto cleanup_CdcChunksOfFile;
+        }
+    }
+
+    *Chunks = chunks;
+    *NumberOfChunks = numberOfChunks;
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_CdcChunksOfFile:
+
+    if (SUCCESS(status))
+    {
+        free(buffer);
+        buffer = NULL;
+    }
+    else
+    {
+        free(buffer);
+        buffer = NULL;
+        free(chunks);
+        chunks = NULL;
+    }
+
+    return status;
+} // CdcChunksOfFile()
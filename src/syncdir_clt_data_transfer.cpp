@@ -10,6 +10,10 @@
 
 
 
+static STRIPE_SENDER gStripeSender;                                     // Data connections of the session (see CltOpenDataConnections()).
+
+
+
 
 //
 // CltReturnConnectedSocket
@@ -33,12 +37,14 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
     SDSTATUS            status;    
     struct sockaddr_in  srvAddr;
     BOOL                bReuseAddr;
+    __int32             zeroCopyOption;
     __int32             returnValue;
 
     // PREINIT.
 
     status = STATUS_FAIL;
     bReuseAddr = TRUE;
+    zeroCopyOption = 0;
     returnValue = -1;
 
     // Parameter validation.
@@ -107,6 +113,17 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
             throw SyncDirException();
         }
 
+        // Enable MSG_ZEROCOPY sends (see SendFileToServer()). Not fatal: older kernels do not support it, the data is copied then.
+        if (SD_CLT_ZERO_COPY)
+        {
+            zeroCopyOption = 1;
+            returnValue = setsockopt((*CltSock), SOL_SOCKET, SO_ZEROCOPY, &zeroCopyOption, sizeof(zeroCopyOption));
+            if (returnValue < 0)
+            {
+                printf("[SyncDir] Warning: CltReturnConnectedSocket(): SO_ZEROCOPY not supported. Sending with copies.\n");
+            }
+        }
+
         // Connect to server.
         returnValue = connect((*CltSock), (struct sockaddr*) &srvAddr, sizeof(srvAddr));
         if (returnValue < 0)
@@ -163,47 +180,43 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
 
 
 //
-// SendFileToServer
+// CltNegotiateSessionWithServer
 //
 SDSTATUS
-SendFileToServer(
-    __in DWORD      FileSize,
-    __in char       *FileFullPath,
+CltNegotiateSessionWithServer(
     __in __int32    CltSock
     )
 /*++
-Description: The routine sends the content of a file to a server address.
+Description: The routine performs the handshake with the SyncDir server, right after connection (see PACKET_HELLO). The client 
+announces its supported hash algorithms and its preferred one (SD_CLT_HASH_ALGORITHM); the server chooses. On success, gHashAlgorithm
+holds the content hash algorithm of the session and gCompressionCodec the compression codec (SD_CLT_COMPRESSION_CODEC, if granted).
+The number of data connections granted and the key of the session are kept for CltOpenDataConnections().
 
-- FileSize: Size of the file, in bytes.
-- FileFullPath: Pointer to the string containing the full path of the file (absolute path). 
 - CltSock: Descriptor representing the socket connection with the SyncDir server application.
 
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. no common hash algorithm).
 --*/
 {
     SDSTATUS        status;
-    FILE            *fileStream;
+    PACKET_HELLO    helloPacket;
     __int32         sentBytes;
-    __int32         readBytes;
-    DWORD           totalSentBytes;
-    PACKET_FILE     packet;
+    __int32         recvBytes;
+    HASH_ALGORITHM  chosenAlgorithm;
+    DWORD           chosenCodec;
 
     // PREINIT.
 
     status = STATUS_FAIL;
-    fileStream = NULL;
     sentBytes = -1;
-    readBytes = -1;
-    totalSentBytes = 0;
-    packet.ChunkSize = 0;
-    packet.FileChunk[0] = 0;
-    packet.IsEOF = TRUE;
+    recvBytes = -1;
+    chosenAlgorithm = haUNKNOWN;
+    chosenCodec = ccNONE;
 
     // Parameter validation.
 
-    if (NULL == FileFullPath || 0 == FileFullPath[0])
+    if (CltSock < 0)
     {
-        printf("[SyncDir] Error: SendFileToServer(): Invalid parameter 2. \n");
+        printf("[SyncDir] Error: CltNegotiateSessionWithServer(): Invalid parameter 1.\n");
         return STATUS_FAIL;
     }
 
@@ -212,126 +225,94 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
     {
         // INIT.
 
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: Sending file of size [%d B] to server. \n", FileSize);
+        helloPacket.Magic = htonl(SD_PROTOCOL_MAGIC);
+        helloPacket.ProtocolVersion = htonl(SD_PROTOCOL_VERSION);
+        helloPacket.SupportedHashAlgorithms = htonl(SD_SUPPORTED_HASH_ALGORITHMS);
+        helloPacket.HashAlgorithm = htonl(SD_CLT_HASH_ALGORITHM);
+        helloPacket.CompressionCodec = htonl(SD_CLT_COMPRESSION_CODEC);
+        helloPacket.DataConnections = htonl(SD_MIN(SD_CLT_DATA_CONNECTIONS, SD_MAX_DATA_CONNECTIONS));
+        memset(helloPacket.SessionKey, 0, SD_SESSION_KEY_SIZE);
 
 
-        // Send file size.
 
-        FileSize = htonl(FileSize);                                                     // Machine (local) byte order to network order.
-        
-        sentBytes = send(CltSock, &FileSize, sizeof(FileSize), 0);
-        if (sizeof(FileSize) != sentBytes)
+        //
+        // Main processing:
+        //
+
+
+        // Send the client hello.
+
+        sentBytes = send(CltSock, &helloPacket, sizeof(PACKET_HELLO), 0);
+        if (sizeof(PACKET_HELLO) != sentBytes)
         {
-            if (sentBytes < 0)
-            {
-                perror("[SyncDir] Error: SendFileToServer(): Error at sending to server (file size). Abandoning ...\n");
-            }
-            else
-            {
-                printf("[SyncDir] Error: SendFileToServer(): Numbers of sent/to-send bytes do not match (file size).\n");
-            }
+            perror("[SyncDir] Error: CltNegotiateSessionWithServer(): Error at sending the hello packet to server.\n");
             status = STATUS_FAIL;
             throw SyncDirException();
         }
 
 
-        // Open file.
+        // Receive the server decision.
 
-        fileStream = fopen(FileFullPath, "rb");                                             // Binary file reading.
-        if (NULL == fileStream)
+        recvBytes = recv(CltSock, &helloPacket, sizeof(PACKET_HELLO), MSG_WAITALL);
+        if (sizeof(PACKET_HELLO) != recvBytes)
         {
-            perror("[SyncDir] Error: SendFileToServer(): Error at file opening.\n");
-            status = STATUS_WARNING;
-            // File may not exist anymore, or has been moved/renamed by the user.
-
-            // Fault tolerance.
-            // Send 0 to server (i.e. "end of file receiving").
-
-            packet.IsEOF = TRUE;
-            packet.ChunkSize = 0;
-            packet.FileChunk[0] = 0;
-
-            sentBytes = send(CltSock, &packet, sizeof(packet), 0);                            // Send packet to server.
-            if (sizeof(packet) != sentBytes)
-            {
-                perror("[SyncDir] Error: SendFileToServer(): Error at sending to server (0, at file open). Abandoning ...\n");
-                status = STATUS_FAIL;
-                throw SyncDirException();
-            }
-
-            // End fault tolerance with warning.
-            status = STATUS_WARNING;
+            perror("[SyncDir] Error: CltNegotiateSessionWithServer(): Error at receiving the hello packet from server.\n");
+            status = STATUS_FAIL;
             throw SyncDirException();
         }
 
-        totalSentBytes = 0;
-
-
-        // --> INIT (end).
-
-
-
-        //
-        // Main processing:
-        //
-
-
-
-        // Read file chunks.
-        // Send file chunks to server.
-        // Note: "fread() does not distinguish between end-of-file and error".
-
-        while (1) 
+        if (SD_PROTOCOL_MAGIC != ntohl(helloPacket.Magic))
         {
-            readBytes = fread(packet.FileChunk, 1, SD_PACKET_DATA_SIZE, fileStream);             // 0 == EOF or Error. 
-
-
-            packet.ChunkSize = readBytes;
-            totalSentBytes = totalSentBytes + packet.ChunkSize; 
-
-
-            // Exit condition. If EOF was met, or if all file was sent. 
-            // If 0, it means EOF or an error appeared (e.g. file was truncated). Abandon transfer.
-
-            if (0 == packet.ChunkSize || packet.ChunkSize < SD_PACKET_DATA_SIZE || (__int32) FileSize - (__int32) totalSentBytes <= 0)
-            {                
-                packet.IsEOF = TRUE;
-            }
-            else
-            {
-                packet.IsEOF = FALSE;
-            }
+            printf("[SyncDir] Error: CltNegotiateSessionWithServer(): The peer is not a SyncDir server (or has an older version).\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
 
+        if (SD_PROTOCOL_VERSION != ntohl(helloPacket.ProtocolVersion))
+        {
+            printf("[SyncDir] Error: CltNegotiateSessionWithServer(): The server uses protocol version %u (client: %u).\n",
+                ntohl(helloPacket.ProtocolVersion), SD_PROTOCOL_VERSION);
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
 
-            sentBytes = send(CltSock, &packet, sizeof(packet), 0);                            // Send file chunk to server.
-            if (sizeof(packet) != sentBytes)
-            {
-                if (sentBytes < 0)
-                {
-                    perror("[SyncDir] Error: SendFileToServer(): Error at sending to server (file chunk). Abandoning ...\n");   
-                }
-                else
-                {
-                    printf("[SyncDir] Error: SendFileToServer(): Numbers of sent/to-send bytes do not match (file chunk).\n");
-                }
-                status = STATUS_FAIL;
-                throw SyncDirException();                   
-            }
+        chosenAlgorithm = (HASH_ALGORITHM) ntohl(helloPacket.HashAlgorithm);
+        if (NULL == GetHashProvider(chosenAlgorithm) || 0 == (SD_SUPPORTED_HASH_ALGORITHMS & SD_HASH_ALGORITHM_BIT(chosenAlgorithm)))
+        {
+            printf("[SyncDir] Error: CltNegotiateSessionWithServer(): No common hash algorithm with the server (server supports mask "
+                "0x%x).\n", ntohl(helloPacket.SupportedHashAlgorithms));
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
 
+        chosenCodec = ntohl(helloPacket.CompressionCodec);
+        if (ccNONE != chosenCodec && SD_CLT_COMPRESSION_CODEC != chosenCodec)
+        {
+            printf("[SyncDir] Error: CltNegotiateSessionWithServer(): The server chose a compression codec not requested [%u].\n", chosenCodec);
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
 
-            if (TRUE == packet.IsEOF)
-            {
-                fprintf(g_SD_STDLOG, "[SyncDir] Info: SendFileToServer(): EOF was met. Ending file transfer. \n");
-                break;
-            }
+        if (ntohl(helloPacket.DataConnections) > SD_MIN(SD_CLT_DATA_CONNECTIONS, SD_MAX_DATA_CONNECTIONS))
+        {
+            printf("[SyncDir] Error: CltNegotiateSessionWithServer(): The server granted more data connections than requested [%u].\n", 
+                ntohl(helloPacket.DataConnections));
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
 
-        } //--> while (1)
+        gHashAlgorithm = chosenAlgorithm;
+        gCompressionCodec = (COMPRESSION_CODEC) chosenCodec;
+        gStripeSender.GrantedConnections = ntohl(helloPacket.DataConnections);
+        memcpy(gStripeSender.SessionKey, helloPacket.SessionKey, SD_SESSION_KEY_SIZE);
 
+        printf("[SyncDir] Info: Session negotiated with the server (protocol version %u). Content hash algorithm: %s. Compression: %s. "
+            "Data connections: %u.\n", ntohl(helloPacket.ProtocolVersion), GetHashProvider(gHashAlgorithm)->Name, 
+            GetCompressionCodecName(gCompressionCodec), gStripeSender.GrantedConnections);
 
 
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: File sent to server. \n");
 
-        // If here, everything is ok.
+        // If here, everything worked fine.
         status = STATUS_SUCCESS;
 
     } // --> __try
@@ -342,12 +323,12 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
     }
     __catch (const std::exception &e)
     {
-        cout << "[SyncDir] Error: SendFileToServer(): Standard Exception caught: " << e.what() << "\n";        
+        cout << "[SyncDir] Error: CltNegotiateSessionWithServer(): Standard Exception caught: " << e.what() << "\n";        
         status = STATUS_FAIL;
     }
     __catch (...)
     {
-        printf("[SyncDir] Error: SendFileToServer(): Unkown exception.\n");
+        printf("[SyncDir] Error: CltNegotiateSessionWithServer(): Unkown exception.\n");
         status = STATUS_FAIL;
     }
 
@@ -355,65 +336,163 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
     // UNINIT. Cleanup.
     if (SUCCESS(status))
     {
-        if (NULL != fileStream)
-        {
-            fclose(fileStream);
-            fileStream = NULL;
-        }
+        // Nothing to clean for the moment.
     }
     else
     {
-        if (NULL != fileStream)
+        // Nothing to clean for the moment.
+    }
+
+    return status;
+} // CltNegotiateSessionWithServer()
+
+
+//
+// ReleaseStripeRanges
+//
+static void
+ReleaseStripeRanges(
+    __inout STRIPE_FILE *File,
+    __in DWORD          NumberOfRanges
+    )
+/*++
+Description: The routine counts NumberOfRanges ranges of File as done (sent, or dropped), and releases the file with its last range:
+it closes the file and frees its content. The caller holds gStripeSender.Lock.
+--*/
+{
+    File->RemainingRanges = File->RemainingRanges - SD_MIN(NumberOfRanges, File->RemainingRanges);
+    if (0 != File->RemainingRanges)
+    {
+        return;
+    }
+
+    if (File->FileDescriptor >= 0)
+    {
+        close(File->FileDescriptor);
+        File->FileDescriptor = -1;
+    }
+    free(File->FileContent);
+    File->FileContent = NULL;
+    delete File;
+} // ReleaseStripeRanges()
+
+
+
+//
+// StripeSenderWorker
+//
+static void
+StripeSenderWorker(
+    __inout STRIPE_CONNECTION *Connection
+    )
+/*++
+Description: Routine of the sending thread of a data connection. It takes the ranges queued for the connection, in order, and sends
+each one: its PACKET_STRIPE_HEADER, then its content (see SendFileRangeToServer()). Once a data connection fails, the ranges left are
+dropped: the server cannot complete these files, so the session ends (the connection is shut down, for the server to know at once).
+The thread ends when the connection is closed and its queue is empty.
+--*/
+{
+    STRIPE_RANGE            range;
+    PACKET_STRIPE_HEADER    header;
+    BOOL                    isFailed;
+
+    while (1)
+    {
+        // Get the next range. It stays queued (and counted) until sent.
+
+        {
+            std::unique_lock<std::mutex> lock(gStripeSender.Lock);
+
+            gStripeSender.QueueNotEmpty.wait(lock, [Connection] { return !Connection->Queue.empty() || TRUE == gStripeSender.IsClosing; });
+            if (Connection->Queue.empty())
+            {
+                break;                                                      // Closing, nothing left.
+            }
+            range = Connection->Queue.front();
+            isFailed = gStripeSender.IsFailed;
+        }
+
+
+        // Send it (outside the lock).
+
+        if (FALSE == isFailed)
+        {
+            header.RequestId = htonl(range.RequestId);
+            header.Length = htonl(range.Length);
+            header.Offset = htobe64(range.Offset);
+
+            if (!(SUCCESS(SendBufferToServer(&header, sizeof(header), Connection->Sock))) || 
+                !(SUCCESS(SendFileRangeToServer(range.Offset, range.Length, range.File->FileDescriptor, range.File->FileContent, 
+                                                Connection->Sock))))
+            {
+                printf("[SyncDir] Error: StripeSenderWorker(): Failed to send the range [%u B at %llu] of file [%s]. Dropping the "
+                    "data connections ...\n", range.Length, (unsigned long long) range.Offset, range.File->RelativePath.c_str());
+                shutdown(Connection->Sock, SHUT_RDWR);
+                isFailed = TRUE;
+            }
+        }
+
+
+        // Release the range (and the file, with its last range).
+
         {
-            fclose(fileStream);
-            fileStream = NULL;
+            std::lock_guard<std::mutex> lock(gStripeSender.Lock);
+
+            Connection->Queue.pop_front();
+            gStripeSender.QueuedBytes = gStripeSender.QueuedBytes - range.Length;
+            if (TRUE == isFailed)
+            {
+                gStripeSender.IsFailed = TRUE;
+            }
+            ReleaseStripeRanges(range.File, 1);
         }
+        gStripeSender.QueueNotFull.notify_all();
     }
+} // StripeSenderWorker()
 
-    return status;
-} // SendFileToServer()
 
 
 //
-// SendPacketOpAndFilePathToServer
+// CltOpenDataConnections
 //
 SDSTATUS
-SendPacketOpAndFilePathToServer(
-    __in PACKET_OP  *OpToSend,
-    __in char       *FileRelativePath,
-    __in __int32    CltSock
+CltOpenDataConnections(
+    __in    DWORD   SrvPort, 
+    __in    char    *SrvIP
     )
 /*++
-Description: The routine sends to a server address the following: a packet containing information for an operation and the relative
-path of the file concerned by the operation.
+Description: The routine opens, one after the other, the data connections granted by the server at handshake (see 
+PACKET_DATA_CONNECTION): it connects to the server address, sends the key of the session and waits for the echo of the server (at
+most SD_DATA_CONNECTION_TIMEOUT seconds). The first failure ends the opening: the session goes on with the data connections opened
+so far (none: the whole files are sent on the control connection). Then the sending threads are started (see StripeSenderWorker()).
 
-- OpToSend: Pointer to the packet containing the operation information.
-- FileRelativePath: Pointer to the string containing the relative path of the file.
-- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+- SrvPort: Server port to connect to.
+- SrvIP: Server IP address to connect to (in human readable format "x.x.x.x").
 
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+Return value: STATUS_SUCCESS on success, STATUS_WARNING if some data connections could not be opened, STATUS_FAIL on invalid 
+parameters.
 --*/
 {
-    SDSTATUS status;
-    __int32 sentBytes;
+    SDSTATUS                status;
+    PACKET_DATA_CONNECTION  identity;
+    PACKET_DATA_CONNECTION  echo;
+    struct timeval          timeout;
+    __int32                 dataSock;
+    __int32                 recvBytes;
+    DWORD                   index;
 
-    static QWORD opCount = 0;
-    
     // PREINIT.
 
     status = STATUS_FAIL;
-    sentBytes = -1;
+    dataSock = -1;
+    recvBytes = -1;
+    index = 0;
 
     // Parameter validation.
 
-    if (NULL == OpToSend)
-    {
-        printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Invalid parameter 1. \n");
-        return STATUS_FAIL;        
-    }
-    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
+    if (NULL == SrvIP)
     {
-        printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Invalid parameter 2. \n");
+        printf("[SyncDir] Error: CltOpenDataConnections(): Invalid parameter 2.\n");
         return STATUS_FAIL;
     }
 
@@ -421,61 +500,72 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
     __try
     {
         // INIT.
-        // --
 
-        opCount ++;
-        fprintf(g_SD_STDLOG, "[#%lu] ----------------------------------------\n", opCount);
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: Sending: - Operation type: [%d]. \n", OpToSend->OperationType);
+        timeout.tv_sec = SD_DATA_CONNECTION_TIMEOUT;
+        timeout.tv_usec = 0;
+        gStripeSender.NextConnection = 0;
+        gStripeSender.QueuedBytes = 0;
+        gStripeSender.IsClosing = FALSE;
+        gStripeSender.IsFailed = FALSE;
 
 
-        // 
+
+        //
         // Main processing:
         //
 
 
+        // Open the data connections, one after the other.
 
-        // Send operation to server.
-
-        sentBytes = send(CltSock, OpToSend, sizeof(PACKET_OP), 0);
-        if (sizeof(PACKET_OP) != sentBytes)
+        for (index = 0; index < gStripeSender.GrantedConnections; index++)
         {
-            if (sentBytes < 0)
+            status = CltReturnConnectedSocket(&dataSock, SrvPort, SrvIP);
+            if (!(SUCCESS(status)))
             {
-                perror("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Error at sending to server (OpToSend). Abandoning ...\n");
+                printf("[SyncDir] Warning: CltOpenDataConnections(): Failed at CltReturnConnectedSocket() for data connection [%u].\n", index);
+                break;
             }
-            else
+
+            identity.Magic = htonl(SD_PROTOCOL_MAGIC);
+            identity.Index = htonl(index);
+            memcpy(identity.SessionKey, gStripeSender.SessionKey, SD_SESSION_KEY_SIZE);
+
+            setsockopt(dataSock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            status = SendBufferToServer(&identity, sizeof(identity), dataSock);
+            recvBytes = SUCCESS(status) ? recv(dataSock, &echo, sizeof(echo), MSG_WAITALL) : -1;
+            if (sizeof(echo) != recvBytes || 0 != memcmp(&identity, &echo, sizeof(echo)))
             {
-                printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Numbers of sent/to-send bytes do not match (OpToSend).\n");
+                printf("[SyncDir] Warning: CltOpenDataConnections(): The server did not accept data connection [%u].\n", index);
+                close(dataSock);
+                dataSock = -1;
+                break;
             }
-            status = STATUS_FAIL;
-            throw SyncDirException();            
-        }
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: Operation (PACKET_OP) was successfully sent to server. \n");
 
+            timeout.tv_sec = 0;                                                 // No timeout for the transfers.
+            setsockopt(dataSock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            timeout.tv_sec = SD_DATA_CONNECTION_TIMEOUT;
 
+            gStripeSender.Connections.emplace_back();
+            gStripeSender.Connections.back().Sock = dataSock;
+            dataSock = -1;
+        }
 
-        // Send file relative path to server.
 
-        sentBytes = send(CltSock, FileRelativePath, OpToSend->RelativePathLength + 1, 0);
-        if (OpToSend->RelativePathLength + 1 != sentBytes)
+        // Start the sending threads.
+
+        for (STRIPE_CONNECTION &connection : gStripeSender.Connections)
         {
-            if (sentBytes < 0)
-            {
-                perror("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Error at sending to server (file path). Abandoning ...\n");
-            }
-            else
-            {
-                printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Numbers of sent/to-send bytes do not match (file path).\n");
-            }
-            status = STATUS_FAIL;
-            throw SyncDirException();            
-        }    
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: File relative path was successfully sent to server. \n");
+            connection.Sender = std::thread(StripeSenderWorker, &connection);
+        }
 
+        printf("[SyncDir] Info: [%u/%u] data connections opened. \n", (DWORD) gStripeSender.Connections.size(), 
+            gStripeSender.GrantedConnections);
 
 
-        // If here, everything is ok.
-        status = STATUS_SUCCESS;
+
+        // If here, everything worked fine.
+        status = (gStripeSender.Connections.size() < gStripeSender.GrantedConnections) ? STATUS_WARNING : STATUS_SUCCESS;
 
     } // --> __try
     __catch (const SyncDirException &e)
@@ -485,12 +575,12 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
     }
     __catch (const std::exception &e)
     {
-        cout << "[SyncDir] Error: SendPacketOpAndFilePathToServer(): Standard Exception caught: " << e.what() << "\n";        
+        cout << "[SyncDir] Error: CltOpenDataConnections(): Standard Exception caught: " << e.what() << "\n";        
         status = STATUS_FAIL;
     }
     __catch (...)
     {
-        printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Unkown exception.\n");
+        printf("[SyncDir] Error: CltOpenDataConnections(): Unkown exception.\n");
         status = STATUS_FAIL;
     }
 
@@ -498,65 +588,117 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
     // UNINIT. Cleanup.
     if (SUCCESS(status))
     {
-        // Nothing to clean for the moment.
+        // Nothing to clean for the moment. The data connections are closed by CltCloseDataConnections().
     }
     else
     {
-        // Nothing to clean for the moment.
+        CltCloseDataConnections();
     }
 
     return status;
-} // SendPacketOpAndFilePathToServer()
+} // CltOpenDataConnections()
 
 
 
 //
-// SendCreateToServer
+// CltCloseDataConnections
 //
-SDSTATUS
-SendCreateToServer(
-    __in PACKET_OP  *OpToSend,
-    __in char       *FileRelativePath,
-    __in char       *FileRealRelativePath,
-    __in __int32    CltSock
+void
+CltCloseDataConnections(
+    void
     )
 /*++
-Description: The routine sends a file create operation to a server address.
-Together with the operation information (OpToSend), the routine sends the relative path (FileRelativePath) and the real
-relative path (FileRealRelativePath) of the file concerned by the operation.
-
-- OpToSend: Pointer to the packet containing the operation information.
-- FileRelativePath: Pointer to the relative path of the file.
-- FileRealRelativePath: Pointer to the real relative path of the file (i.e. all subpaths resolved, no symbolic links).
-- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+Description: The routine lets the sending threads send the ranges queued (or drop them, once a data connection failed), waits for
+them to end and closes the data connections.
 
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
-was achieved, but related issues were encountered (information is logged, thereby).
+Return value: None.
 --*/
 {
-    SDSTATUS status;
-    __int32 sentBytes;
+    {
+        std::lock_guard<std::mutex> lock(gStripeSender.Lock);
 
-    // PREINIT.
+        gStripeSender.IsClosing = TRUE;
+    }
+    gStripeSender.QueueNotEmpty.notify_all();
 
-    status = STATUS_FAIL;
-    sentBytes = -1;
+    for (STRIPE_CONNECTION &connection : gStripeSender.Connections)
+    {
+        if (connection.Sender.joinable())
+        {
+            connection.Sender.join();
+        }
+        if (connection.Sock >= 0)
+        {
+            close(connection.Sock);
+            connection.Sock = -1;
+        }
+    }
+
+    gStripeSender.Connections.clear();
+    gStripeSender.QueuedBytes = 0;
+    gStripeSender.IsClosing = FALSE;
+    gStripeSender.IsFailed = FALSE;
+} // CltCloseDataConnections()
+
+
+
+
+//
+// BuildDirDigestsOfClientTree
+//
+SDSTATUS
+BuildDirDigestsOfClientTree(
+    __in const char                                         *DirFullPath,
+    __in const char                                         *DirRelativePath,
+    __inout std::unordered_map<std::string, std::string>    & DirDigestHMap,
+    __inout std::unordered_map<std::string, std::vector<std::string> > & SubdirsHMap,
+    __out std::string                                       & DirDigest
+    )
+/*++
+Description: The routine computes (post-order) the digests of the DirFullPath directory and of all its subdirectories, and stores them
+in DirDigestHMap, by the relative paths of the directories (same encoding as BuildDirDigestsOfServerTree()). The content hash codes of
+the files are taken from the hash cache whenever possible (see HashCacheHashOfFile()), so that an unchanged tree is not read again. A
+file that cannot be hashed makes the digest unknown (""): such a directory is synchronized as before (all its events are sent).
+The tree is listed from the file system rather than from the watch tree, so that the digests match exactly what the server lists.
+
+- DirFullPath: Pointer to the string containing the full path of the directory.
+- DirRelativePath: Pointer to the string containing the relative path of the directory.
+- DirDigestHMap: Reference to the hash map where the routine stores the digests (key: relative path of the directory).
+- SubdirsHMap: Reference to the hash map where the routine stores the relative paths of the subdirectories of each directory.
+- DirDigest: Reference to where the routine outputs the digest of the DirFullPath directory ("" if unknown).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS                        status;
+    DIR                             *dirStream;
+    struct dirent                   *file;
+    struct stat                     fileStat;
+    std::vector<DIR_DIGEST_ENTRY>   entries;
+    DIR_DIGEST_ENTRY                entry;
+    char                            fileFullPath[SD_MAX_PATH_LENGTH];
+    char                            fileRelativePath[SD_MAX_PATH_LENGTH];
+    char                            dirDigest[SD_MAX_HASH_CODE_LENGTH + 1];
+    std::string                     childDigest;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    dirStream = NULL;
+    file = NULL;
+    dirDigest[0] = 0;
+    DirDigest.clear();
 
     // Parameter validation.
 
-    if (NULL == OpToSend)
-    {
-        printf("[SyncDir] Error: SendCreateToServer(): Invalid parameter 1. \n");
-        return STATUS_FAIL;        
-    }
-    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
+    if (NULL == DirFullPath || 0 == DirFullPath[0])
     {
-        printf("[SyncDir] Error: SendCreateToServer(): Invalid parameter 2. \n");
+        printf("[SyncDir] Error: BuildDirDigestsOfClientTree(): Invalid parameter 1.\n");
         return STATUS_FAIL;
     }
-    if (NULL == FileRealRelativePath || (0 != OpToSend->RealRelativePathLength && 0 == FileRealRelativePath[0]))
+    if (NULL == DirRelativePath || 0 == DirRelativePath[0])
     {
-        printf("[SyncDir] Error: SendCreateToServer(): Invalid parameter 3. \n");
+        printf("[SyncDir] Error: BuildDirDigestsOfClientTree(): Invalid parameter 2.\n");
         return STATUS_FAIL;
     }
 
@@ -564,46 +706,65 @@ was achieved, but related issues were encountered (information is logged, thereb
     __try
     {
         // INIT.
-        // --
-
-
-        // Main processing:
-
-        // Send first 2 information to server:
-        // - operation info
-        // - file path
 
-        status = SendPacketOpAndFilePathToServer(OpToSend, FileRelativePath, CltSock);
-        if (!(SUCCESS(status)))
+        dirStream = opendir(DirFullPath);
+        if (NULL == dirStream)
         {
-            printf("[SyncDir] Error: SendCreateToServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
-            status = STATUS_FAIL;
+            perror("[SyncDir] Warning: BuildDirDigestsOfClientTree(): Could not execute opendir(). Digest unknown.\n");
+            printf("The error was for path [%s] \n", DirFullPath);
+            status = STATUS_SUCCESS;
             throw SyncDirException();
         }
 
-        // Send sym link's real path to server.
 
-        if (ftSYMLINK == OpToSend->FileType)
+        // Main processing:
+
+        while (NULL != (file = readdir(dirStream)))
         {
-            sentBytes = send(CltSock, FileRealRelativePath, OpToSend->RealRelativePathLength + 1, 0);
-            if (OpToSend->RealRelativePathLength + 1 != sentBytes)
+            if (0 == strcmp(".", file->d_name) || 0 == strcmp("..", file->d_name))
             {
-                if (sentBytes < 0)        
+                continue;
+            }
+
+            snprintf(fileFullPath, SD_MAX_PATH_LENGTH, "%s/%s", DirFullPath, file->d_name);
+            snprintf(fileRelativePath, SD_MAX_PATH_LENGTH, "%s/%s", DirRelativePath, file->d_name);
+
+            if (lstat(fileFullPath, &fileStat) < 0)
+            {
+                continue;
+            }
+
+            memset(&entry, 0, sizeof(entry));
+            entry.Type = DirDigestEntryType(fileStat.st_mode);
+            snprintf(entry.Name, sizeof(entry.Name), "%s", file->d_name);
+
+            if (SD_DIR_DIGEST_ENTRY_DIRECTORY == entry.Type)
+            {
+                status = BuildDirDigestsOfClientTree(fileFullPath, fileRelativePath, DirDigestHMap, SubdirsHMap, childDigest);
+                if (!(SUCCESS(status)))
                 {
-                    perror("[SyncDir] Error: SendCreateToServer(): Error at sending to server (real file path). Abandoning ...\n");
+                    printf("[SyncDir] Error: BuildDirDigestsOfClientTree(): Recursive call failed. \n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
                 }
-                else
-                {
-                    printf("[SyncDir] Error: SendCreateToServer(): Numbers of sent/to-send bytes do not match (real file path).\n");
-                }            
-                status = STATUS_FAIL;
-                throw SyncDirException(); 
+                snprintf(entry.HashCode, sizeof(entry.HashCode), "%s", childDigest.c_str());
+                SubdirsHMap[DirRelativePath].push_back(fileRelativePath);
+            }
+            if (SD_DIR_DIGEST_ENTRY_FILE == entry.Type)
+            {
+                HashCacheHashOfFile(gHashAlgorithm, fileFullPath, entry.HashCode);        // "" on fail (unknown).
             }
-            fprintf(g_SD_STDLOG, "[SyncDir] Info: Symbolic link (+ real path) sent successfully to server. \n");
-        }    
 
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: Create operation sent successfully to server. \n");
+            entries.push_back(entry);
+        }
 
+        status = DirDigestOfEntries(gHashAlgorithm, entries.data(), (DWORD) entries.size(), dirDigest);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: BuildDirDigestsOfClientTree(): DirDigestOfEntries() failed. \n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
 
 
         // If here, everything is ok.
@@ -617,12 +778,12 @@ was achieved, but related issues were encountered (information is logged, thereb
     }
     __catch (const std::exception &e)
     {
-        cout << "[SyncDir] Error: SendCreateToServer(): Standard Exception caught: " << e.what() << "\n";        
+        cout << "[SyncDir] Error: BuildDirDigestsOfClientTree(): Standard Exception caught: " << e.what() << "\n";        
         status = STATUS_FAIL;
     }
     __catch (...)
     {
-        printf("[SyncDir] Error: SendCreateToServer(): Unkown exception.\n");
+        printf("[SyncDir] Error: BuildDirDigestsOfClientTree(): Unkown exception.\n");
         status = STATUS_FAIL;
     }
 
@@ -630,63 +791,99 @@ was achieved, but related issues were encountered (information is logged, thereb
     // UNINIT. Cleanup.
     if (SUCCESS(status))
     {
-        // Nothing to clean for the moment.
+        if (NULL != dirStream)
+        {
+            closedir(dirStream);
+            dirStream = NULL;
+        }
+
+        DirDigest.assign(dirDigest);
+        DirDigestHMap[DirRelativePath] = DirDigest;
     }
     else
     {
-        // Nothing to clean for the moment.
+        if (NULL != dirStream)
+        {
+            closedir(dirStream);
+            dirStream = NULL;
+        }
     }
 
     return status;
-} // SendCreateToServer()
+} // BuildDirDigestsOfClientTree()
+
+
 
 
 //
-// SendMoveToServer
+// ReconcileDirDigestsWithServer
 //
 SDSTATUS
-SendMoveToServer(
-    __in PACKET_OP  *OpToSend,
-    __in char       *FileNewRelativePath,
-    __in char       *FileOldRelativePath,
-    __in __int32    CltSock
+ReconcileDirDigestsWithServer(
+    __in DIR_WATCH                                          *Watches,
+    __inout std::unordered_map<std::string, FILE_INFO>      &FileInfoHMap,
+    __in __int32                                            CltSock
     )
 /*++
-Description: The routine sends a file move operation to a server address.
-Together with the operation information (OpToSend), the routine sends the new relative path (FileNewRelativePath) and the old 
-relative path (FileOldRelativePath) of the file concerned by the operation.
-
-- OpToSend: Pointer to the packet containing the operation information.
-- FileNewRelativePath: Pointer to the new relative path of the file.
-- FileOldRelativePath: Pointer to the old relative path of the file.
+Description: The routine compares the directory tree of the client with the server one, using Merkle directory digests (see
+PACKET_DIR_DIGEST and BuildDirDigestsOfClientTree()). It starts with the main directory and, round after round, queries only the
+subdirectories of the directories that differ: reconnecting to an up to date server costs one round trip, whatever the number of
+files. The events (FileInfo's) of the directories found identical on the server, and of everything below them, are removed from
+FileInfoHMap, so that neither hash codes nor contents are sent for them. The events of the directories that differ are kept (and
+sent as before).
+
+- Watches: Pointer to the array of directory watches (index 0: main directory).
+- FileInfoHMap: Reference to the hash map of FILE_INFO structures built for all the files (see BuildEventsForAllSubdirFiles()).
 - CltSock: Descriptor representing the socket connection with the SyncDir server application.
 
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
-was achieved, but related issues were encountered (information is logged, thereby).
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
 --*/
 {
-    SDSTATUS status;
-    __int32 sentBytes;
+    SDSTATUS                                        status;
+    std::unordered_map<std::string, std::string>    dirDigestHMap;
+    std::unordered_map<std::string, std::vector<std::string> > subdirsHMap;
+    std::unordered_set<std::string>                 inSyncDirs;
+    std::vector<std::string>                        crtRound;
+    std::vector<std::string>                        nextRound;
+    std::vector<char>                               message;
+    std::vector<BYTE>                               replies;
+    std::string                                     rootDigest;
+    std::string                                     auxString;
+    PACKET_DIR_DIGEST                               digestPacket;
+    const char                                      *dirRelativePath;
+    DWORD                                           numberOfDirs;
+    DWORD                                           numberOfDirsInRound;
+    DWORD                                           numberOfRounds;
+    DWORD                                           numberOfQueriedDirs;
+    size_t                                          numberOfSkippedEvents;
+    size_t                                          offset;
+    size_t                                          separator;
+    ssize_t                                         sentBytes;
+    ssize_t                                         recvBytes;
+    DWORD                                           i;
 
     // PREINIT.
+
     status = STATUS_FAIL;
+    dirRelativePath = NULL;
+    numberOfDirs = 0;
+    numberOfDirsInRound = 0;
+    numberOfRounds = 0;
+    numberOfQueriedDirs = 0;
+    numberOfSkippedEvents = 0;
     sentBytes = -1;
+    recvBytes = -1;
 
     // Parameter validation.
 
-    if (NULL == OpToSend)
-    {
-        printf("[SyncDir] Error: SendMoveToServer(): Invalid parameter 1. \n");
-        return STATUS_FAIL;        
-    }
-    if (NULL == FileNewRelativePath || 0 == FileNewRelativePath[0])
+    if (NULL == Watches || 0 == Watches[0].DirFullPath[0])
     {
-        printf("[SyncDir] Error: SendMoveToServer(): Invalid parameter 2. \n");
+        printf("[SyncDir] Error: ReconcileDirDigestsWithServer(): Invalid parameter 1.\n");
         return STATUS_FAIL;
     }
-    if (NULL == FileOldRelativePath || 0 == FileOldRelativePath[0])
+    if (CltSock < 0)
     {
-        printf("[SyncDir] Error: SendMoveToServer(): Invalid parameter 3. \n");
+        printf("[SyncDir] Error: ReconcileDirDigestsWithServer(): Invalid parameter 3.\n");
         return STATUS_FAIL;
     }
 
@@ -694,41 +891,127 @@ was achieved, but related issues were encountered (information is logged, thereb
     __try
     {
         // INIT.
-        // --
 
-        // Main processing:
+        // Digests of all the client directories.
 
-        // Send first 2 information to server:
-        // - operation info
-        // - file path
-        
-        status = SendPacketOpAndFilePathToServer(OpToSend, FileNewRelativePath, CltSock);
+        status = BuildDirDigestsOfClientTree(Watches[0].DirFullPath, ".", dirDigestHMap, subdirsHMap, rootDigest);
         if (!(SUCCESS(status)))
         {
-            printf("[SyncDir] Error: SendMoveToServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
+            printf("[SyncDir] Error: ReconcileDirDigestsWithServer(): Failed to execute BuildDirDigestsOfClientTree(). \n");
             status = STATUS_FAIL;
             throw SyncDirException();
         }
 
-        // Send old path to server (file to be moved on the server).
-        
-        sentBytes = send(CltSock, FileOldRelativePath, OpToSend->OldRelativePathLength + 1, 0);
-        if (OpToSend->OldRelativePathLength + 1 != sentBytes)
+        crtRound.push_back(".");
+
+
+
+        //
+        // Main processing:
+        //
+
+
+        // Rounds: query the digests of crtRound (at most SD_DIR_DIGEST_MAX_DIRS, the others are left for the next round); the 
+        // subdirectories of the ones that differ form the next round. The last round is empty (it ends the reconciliation on the server).
+
+        while (1)
         {
-            if (sentBytes < 0)        
+            // Build the query: count, then (packet, path) for each directory.
+
+            numberOfDirsInRound = (DWORD) SD_MIN(crtRound.size(), (size_t) SD_DIR_DIGEST_MAX_DIRS);
+            numberOfDirs = htonl(numberOfDirsInRound);
+            message.assign((const char*) &numberOfDirs, (const char*) &numberOfDirs + sizeof(DWORD));
+
+            for (i = 0; i < numberOfDirsInRound; i++)
             {
-                perror("[SyncDir] Error: SendMoveToServer(): Error at sending to server (old file path). Abandoning ...\n");
-            }        
+                dirRelativePath = crtRound[i].c_str();
+
+                memset(&digestPacket, 0, sizeof(PACKET_DIR_DIGEST));
+                digestPacket.DirRelativePathLength = htons((WORD) strlen(dirRelativePath));
+                snprintf(digestPacket.DirDigest, sizeof(digestPacket.DirDigest), "%s", dirDigestHMap[dirRelativePath].c_str());
+
+                message.insert(message.end(), (const char*) &digestPacket, (const char*) &digestPacket + sizeof(PACKET_DIR_DIGEST));
+                message.insert(message.end(), dirRelativePath, dirRelativePath + strlen(dirRelativePath) + 1);
+            }
+
+
+            // Send it whole.
+
+            for (offset = 0; offset < message.size(); offset += sentBytes)
+            {
+                sentBytes = send(CltSock, message.data() + offset, message.size() - offset, 0);
+                if (sentBytes <= 0)
+                {
+                    perror("[SyncDir] Error: ReconcileDirDigestsWithServer(): Error at sending the directory digests to server.\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+
+            if (crtRound.empty())
+            {
+                break;                                                      // End of reconciliation.
+            }
+
+
+            // Receive one byte per directory: 1 if identical on the server.
+
+            replies.resize(numberOfDirsInRound);
+            recvBytes = recv(CltSock, replies.data(), replies.size(), MSG_WAITALL);
+            if ((ssize_t) replies.size() != recvBytes)
+            {
+                perror("[SyncDir] Error: ReconcileDirDigestsWithServer(): Error at receiving the digest comparisons from server.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            nextRound.assign(crtRound.begin() + numberOfDirsInRound, crtRound.end());
+            for (i = 0; i < numberOfDirsInRound; i++)
+            {
+                if (1 == replies[i])
+                {
+                    inSyncDirs.insert(crtRound[i]);
+                }
+                else
+                {
+                    nextRound.insert(nextRound.end(), subdirsHMap[crtRound[i]].begin(), subdirsHMap[crtRound[i]].end());
+                }
+            }
+
+            numberOfRounds ++;
+            numberOfQueriedDirs += numberOfDirsInRound;
+            crtRound.swap(nextRound);
+        }
+
+
+        // Drop the events of the files inside identical directories (at any depth), and of the identical directories themselves.
+
+        for (auto it = FileInfoHMap.begin(); FileInfoHMap.end() != it; )
+        {
+            auxString = it->first;
+            while (0 == inSyncDirs.count(auxString) && std::string::npos != (separator = auxString.rfind('/')))
+            {
+                auxString.resize(separator);                                // Parent directory.
+            }
+
+            if (0 != inSyncDirs.count(auxString))
+            {
+                it = FileInfoHMap.erase(it);
+                numberOfSkippedEvents ++;
+            }
             else
             {
-                printf("[SyncDir] Error: SendMoveToServer(): Numbers of sent/to-send bytes do not match (old file path).\n");
-            }                    
-            status = STATUS_FAIL;
-            throw SyncDirException();
+                it ++;
+            }
         }
 
+        printf("[SyncDir] Info: Startup reconciliation: [%u] directories compared in [%u] rounds, [%zu] identical subtrees, [%zu] "
+            "events skipped, [%zu] events left.\n", numberOfQueriedDirs, numberOfRounds, inSyncDirs.size(), numberOfSkippedEvents, 
+            FileInfoHMap.size());
 
-        // If here, everything is ok.
+
+
+        // If here, everything worked fine.
         status = STATUS_SUCCESS;
 
     } // --> __try
@@ -739,12 +1022,12 @@ was achieved, but related issues were encountered (information is logged, thereb
     }
     __catch (const std::exception &e)
     {
-        cout << "[SyncDir] Error: SendMoveToServer(): Standard Exception caught: " << e.what() << "\n";        
+        cout << "[SyncDir] Error: ReconcileDirDigestsWithServer(): Standard Exception caught: " << e.what() << "\n";        
         status = STATUS_FAIL;
     }
     __catch (...)
     {
-        printf("[SyncDir] Error: SendMoveToServer(): Unkown exception.\n");
+        printf("[SyncDir] Error: ReconcileDirDigestsWithServer(): Unkown exception.\n");
         status = STATUS_FAIL;
     }
 
@@ -760,153 +1043,3596 @@ was achieved, but related issues were encountered (information is logged, thereb
     }
 
     return status;
-} // SendMoveToServer()
+} // ReconcileDirDigestsWithServer()
 
 
 
 
 //
-// SendModifyToServer
+// SendDataFrameToServer
 //
-SDSTATUS
-SendModifyToServer(
-    __in PACKET_OP  *OpToSend,
-    __in char       *FileRelativePath,
-    __in char       *FileFullPath,
-    __in DWORD      FileSize,
-    __in __int32    CltSock
+static SDSTATUS
+SendDataFrameToServer(
+    __in DWORD          Flags,
+    __in const BYTE     *Data,
+    __in DWORD          DataSize,
+    __in __int32        CltSock
     )
 /*++
-Description: The routine sends a file modify operation to a server address.
-Together with the operation information (OpToSend), the routine sends the relative path (FileRelativePath) and the full 
-path (FileFullPath) of the file concerned by the operation.
-
-- OpToSend: Pointer to the packet containing the operation information.
-- FileRelativePath: Pointer to the relative path of the file (relative to the main directory).
-- FileFullPath: Pointer to the full path of the file.
-- FileSize: Size of the file concerned by the operation.
-- CltSock: Descriptor representing the socket connection with the SyncDir server application.
-
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
-was achieved, but related issues were encountered (information is logged, thereby).
+Description: The routine sends one data frame (see PACKET_DATA_HEADER): the header and the DataSize bytes of Data, gathered by one
+sendmsg() call. A sendmsg() may transfer fewer bytes than requested: the routine resumes until the whole frame is sent. Each call
+offers only the bytes of Data allowed by the send rate limit (see GovernorSendQuota()).
 --*/
 {
-    SDSTATUS    status;
-    __int32     sentBytes;
-    __int32     recvReturn;
-    char        bufferIn[SD_SHORT_MSG_SIZE];
-    char        md5Hash[SD_HASH_CODE_LENGTH + 1];
-
-    // PREINIT.
-
-    status = STATUS_FAIL;
-    sentBytes = -1;
-    recvReturn = -1;
-    bufferIn[0] = 0;
-    md5Hash[0] = 0;
+    PACKET_DATA_HEADER  header;
+    struct iovec        vectors[2];
+    struct msghdr       message;
+    DWORD               vectorIndex;
+    ssize_t             sentBytes;
+    size_t              dataLeft;
+
+    header.Flags = htonl(Flags);
+    header.DataSize = htonl(DataSize);
+
+    vectors[0].iov_base = &header;
+    vectors[0].iov_len = sizeof(PACKET_DATA_HEADER);
+    vectors[1].iov_base = (void*) Data;
+    vectors[1].iov_len = DataSize;
+    vectorIndex = 0;
+
+    while (vectorIndex < 2)
+    {
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = vectors + vectorIndex;
+        message.msg_iovlen = 2 - vectorIndex;
+
+        dataLeft = vectors[1].iov_len;
+        vectors[1].iov_len = GovernorSendQuota(dataLeft);
+        sentBytes = sendmsg(CltSock, &message, 0);
+        vectors[1].iov_len = dataLeft;
+        if (sentBytes <= 0)
+        {
+            perror("[SyncDir] Error: SendDataFrameToServer(): Error at sending to server (data frame).\n");
+            return STATUS_FAIL;
+        }
 
-    // Parameter validation.
+        // Skip what was sent.
 
-    if (NULL == OpToSend)
-    {
-        printf("[SyncDir] Error: SendModifyToServer(): Invalid parameter 1. \n");
-        return STATUS_FAIL;        
-    }
-    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
-    {
-        printf("[SyncDir] Error: SendModifyToServer(): Invalid parameter 2. \n");
-        return STATUS_FAIL;
-    }
-    if (NULL == FileFullPath || 0 == FileFullPath[0])
-    {
-        printf("[SyncDir] Error: SendModifyToServer(): Invalid parameter 3. \n");
-        return STATUS_FAIL;
+        while (vectorIndex < 2 && (size_t) sentBytes >= vectors[vectorIndex].iov_len)
+        {
+            sentBytes = sentBytes - vectors[vectorIndex].iov_len;
+            vectorIndex ++;
+        }
+        if (vectorIndex < 2)
+        {
+            vectors[vectorIndex].iov_base = (BYTE*) vectors[vectorIndex].iov_base + sentBytes;
+            vectors[vectorIndex].iov_len = vectors[vectorIndex].iov_len - sentBytes;
+        }
     }
 
+    return STATUS_SUCCESS;
+} // SendDataFrameToServer()
 
 
-    __try
-    {
-        // INIT.
-        // --
 
 
-        //
+//
+// SendCompressedFrameToServer
+//
+static
+SDSTATUS
+SendCompressedFrameToServer(
+    __in DWORD          Flags,
+    __in const BYTE     *Data,
+    __in DWORD          DataSize,
+    __in BYTE           *CompressedBuffer,
+    __in __int32        CltSock,
+    __inout QWORD       *WireBytes
+    )
+/*++
+Description: The routine sends one data frame compressed with the codec of the session (see SD_DATA_FLAG_COMPRESSED). The compressed
+frame is built in CompressedBuffer (at least DataSize bytes): the original size, then the compressed content. If the content does
+not shrink, the frame is sent as it is. WireBytes is increased by the number of content bytes sent.
+--*/
+{
+    size_t      compressedSize;
+    DWORD       originalSizeNetOrder;
+
+    compressedSize = 0;
+    if (sizeof(DWORD) < DataSize)
+    {
+        compressedSize = CompressBlock(gCompressionCodec, Data, DataSize, CompressedBuffer + sizeof(DWORD), DataSize - sizeof(DWORD) - 1);
+    }
+
+    if (0 == compressedSize)
+    {
+        (*WireBytes) = (*WireBytes) + DataSize;
+        return SendDataFrameToServer(Flags, Data, DataSize, CltSock);
+    }
+
+    originalSizeNetOrder = htonl(DataSize);
+    memcpy(CompressedBuffer, &originalSizeNetOrder, sizeof(DWORD));
+
+    (*WireBytes) = (*WireBytes) + sizeof(DWORD) + compressedSize;
+    return SendDataFrameToServer(Flags | SD_DATA_FLAG_COMPRESSED, CompressedBuffer, sizeof(DWORD) + compressedSize, CltSock);
+} // SendCompressedFrameToServer()
+
+
+
+
+//
+// SendDataHeaderToServer
+//
+static
+SDSTATUS
+SendDataHeaderToServer(
+    __in DWORD          Flags,
+    __in DWORD          DataSize,
+    __in __int32        CltSock
+    )
+/*++
+Description: The routine sends the header of a data frame (see PACKET_DATA_HEADER) whose content is sent separately (sendfile() or 
+MSG_ZEROCOPY), or of a frame without content (hole). MSG_MORE keeps the header in the socket buffer until the content follows, so they
+still share the same segments.
+--*/
+{
+    PACKET_DATA_HEADER  header;
+    size_t              offset;
+    ssize_t             sentBytes;
+
+    header.Flags = htonl(Flags);
+    header.DataSize = htonl(DataSize);
+
+    for (offset = 0; offset < sizeof(PACKET_DATA_HEADER); offset += sentBytes)
+    {
+        sentBytes = send(CltSock, (BYTE*) &header + offset, sizeof(PACKET_DATA_HEADER) - offset, 
+                         (0 == DataSize || (SD_DATA_FLAG_HOLE & Flags)) ? 0 : MSG_MORE);
+        if (sentBytes <= 0)
+        {
+            perror("[SyncDir] Error: SendDataHeaderToServer(): Error at sending to server (data frame header).\n");
+            return STATUS_FAIL;
+        }
+    }
+
+    return STATUS_SUCCESS;
+} // SendDataHeaderToServer()
+
+
+
+
+//
+// SendFileFrameToServer
+//
+static
+SDSTATUS
+SendFileFrameToServer(
+    __in DWORD          Flags,
+    __in __int32        FileDescriptor,
+    __in QWORD          Offset,
+    __in DWORD          DataSize,
+    __in __int32        CltSock,
+    __out DWORD         *ContentBytes
+    )
+/*++
+Description: The routine sends one data frame whose content (DataSize bytes, from Offset) is moved by sendfile() from the page cache 
+of the file straight to the socket, without copies through user space buffers. If sendfile() is not supported for the file, the rest
+of the frame is read with pread() and sent with send(). The header already announced DataSize bytes: if the file was truncated 
+meanwhile, the frame is completed with zeros. ContentBytes receives the number of bytes that were actually taken from the file.
+Each sendfile() moves only the bytes allowed by both the send and the read limits (see GovernorSendQuota(), FileReadQuota()).
+--*/
+{
+    BYTE        buffer[64 * 1024];
+    off_t       fileOffset;
+    DWORD       frameBytes;
+    ssize_t     readBytes;
+    ssize_t     sentBytes;
+    size_t      bufferOffset;
+    BOOL        bUseSendfile;
+
+    (*ContentBytes) = 0;
+    fileOffset = Offset;
+    frameBytes = 0;
+    bUseSendfile = TRUE;
+
+    if (!(SUCCESS(SendDataHeaderToServer(Flags, DataSize, CltSock))))
+    {
+        return STATUS_FAIL;
+    }
+
+    while (frameBytes < DataSize)
+    {
+        readBytes = -1;
+
+        if (bUseSendfile)
+        {
+            sentBytes = sendfile(CltSock, FileDescriptor, &fileOffset, FileReadQuota(GovernorSendQuota(DataSize - frameBytes)));
+            if (0 < sentBytes)
+            {
+                frameBytes = frameBytes + sentBytes;
+                continue;
+            }
+            if (sentBytes < 0 && (EINVAL == errno || ENOSYS == errno || EOPNOTSUPP == errno))
+            {
+                bUseSendfile = FALSE;                                   // E.g. file system without sendfile() support.
+                continue;
+            }
+            if (sentBytes < 0)
+            {
+                perror("[SyncDir] Error: SendFileFrameToServer(): Error at sendfile().\n");
+                return STATUS_FAIL;
+            }
+            readBytes = 0;                                              // EOF (the file was truncated meanwhile).
+        }
+        else
+        {
+            readBytes = pread(FileDescriptor, buffer, FileReadQuota(SD_MIN((size_t) (DataSize - frameBytes), sizeof(buffer))), fileOffset);
+            if (readBytes < 0)
+            {
+                perror("[SyncDir] Error: SendFileFrameToServer(): Error at file reading.\n");
+                return STATUS_FAIL;
+            }
+        }
+
+        if (0 == readBytes)
+        {
+            break;
+        }
+
+        for (bufferOffset = 0; bufferOffset < (size_t) readBytes; bufferOffset += sentBytes)
+        {
+            sentBytes = send(CltSock, buffer + bufferOffset, GovernorSendQuota(readBytes - bufferOffset), 0);
+            if (sentBytes <= 0)
+            {
+                perror("[SyncDir] Error: SendFileFrameToServer(): Error at sending to server (data frame).\n");
+                return STATUS_FAIL;
+            }
+        }
+        fileOffset = fileOffset + readBytes;
+        frameBytes = frameBytes + readBytes;
+    }
+
+    (*ContentBytes) = frameBytes;
+
+    // Complete the frame with zeros, if the file was truncated.
+
+    memset(buffer, 0, sizeof(buffer));
+    while (frameBytes < DataSize)
+    {
+        sentBytes = send(CltSock, buffer, GovernorSendQuota(SD_MIN((size_t) (DataSize - frameBytes), sizeof(buffer))), 0);
+        if (sentBytes <= 0)
+        {
+            perror("[SyncDir] Error: SendFileFrameToServer(): Error at sending to server (frame padding).\n");
+            return STATUS_FAIL;
+        }
+        frameBytes = frameBytes + sentBytes;
+    }
+
+    return STATUS_SUCCESS;
+} // SendFileFrameToServer()
+
+
+
+
+//
+// SendZeroCopyFrameToServer
+//
+static
+SDSTATUS
+SendZeroCopyFrameToServer(
+    __in DWORD          Flags,
+    __in const BYTE     *Data,
+    __in DWORD          DataSize,
+    __in __int32        CltSock,
+    __inout DWORD       *ZeroCopySends
+    )
+/*++
+Description: The routine sends one data frame whose content is sent with MSG_ZEROCOPY: the kernel transmits straight from the pages 
+of Data, which must not be changed or freed until the completions are received (see WaitZeroCopyCompletions()). Each successful
+MSG_ZEROCOPY send() is counted in ZeroCopySends. If the kernel is short of memory for pinning the pages (ENOBUFS), the data is copied.
+Each send() offers only the bytes allowed by the send rate limit (see GovernorSendQuota()).
+--*/
+{
+    DWORD       offset;
+    size_t      allowedBytes;
+    ssize_t     sentBytes;
+
+    if (!(SUCCESS(SendDataHeaderToServer(Flags, DataSize, CltSock))))
+    {
+        return STATUS_FAIL;
+    }
+
+    for (offset = 0; offset < DataSize; offset += sentBytes)
+    {
+        allowedBytes = GovernorSendQuota(DataSize - offset);
+        sentBytes = send(CltSock, Data + offset, allowedBytes, MSG_ZEROCOPY);
+        if (sentBytes < 0 && ENOBUFS == errno)
+        {
+            sentBytes = send(CltSock, Data + offset, allowedBytes, 0);
+        }
+        else if (0 < sentBytes)
+        {
+            (*ZeroCopySends) ++;
+        }
+        if (sentBytes <= 0)
+        {
+            perror("[SyncDir] Error: SendZeroCopyFrameToServer(): Error at sending to server (data frame).\n");
+            return STATUS_FAIL;
+        }
+    }
+
+    return STATUS_SUCCESS;
+} // SendZeroCopyFrameToServer()
+
+
+
+
+//
+// WaitZeroCopyCompletions
+//
+static
+SDSTATUS
+WaitZeroCopyCompletions(
+    __in __int32        CltSock,
+    __in DWORD          ZeroCopySends
+    )
+/*++
+Description: The routine waits until the kernel releases the pages of all the ZeroCopySends MSG_ZEROCOPY sends of the caller. Each 
+completion notification, read from the error queue of the socket, covers a range [ee_info, ee_data] of sends.
+--*/
+{
+    BYTE                        control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+    struct msghdr               message;
+    struct cmsghdr              *cmsg;
+    struct sock_extended_err    *extendedErr;
+    struct pollfd               pollFd;
+    DWORD                       completedSends;
+    __int32                     returnValue;
+
+    completedSends = 0;
+
+    while (completedSends < ZeroCopySends)
+    {
+        memset(&message, 0, sizeof(message));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        returnValue = recvmsg(CltSock, &message, MSG_ERRQUEUE);
+        if (returnValue < 0)
+        {
+            if (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)
+            {
+                perror("[SyncDir] Error: WaitZeroCopyCompletions(): Error at reading the socket error queue.\n");
+                return STATUS_FAIL;
+            }
+
+            pollFd.fd = CltSock;
+            pollFd.events = 0;                                          // POLLERR is always reported.
+            pollFd.revents = 0;
+            if (poll(&pollFd, 1, 1000) < 0 && EINTR != errno)
+            {
+                perror("[SyncDir] Error: WaitZeroCopyCompletions(): Error at poll().\n");
+                return STATUS_FAIL;
+            }
+            continue;
+        }
+
+        for (cmsg = CMSG_FIRSTHDR(&message); NULL != cmsg; cmsg = CMSG_NXTHDR(&message, cmsg))
+        {
+            if (!((SOL_IP == cmsg->cmsg_level && IP_RECVERR == cmsg->cmsg_type) || 
+                (SOL_IPV6 == cmsg->cmsg_level && IPV6_RECVERR == cmsg->cmsg_type)))
+            {
+                continue;
+            }
+            extendedErr = (struct sock_extended_err*) CMSG_DATA(cmsg);
+            if (SO_EE_ORIGIN_ZEROCOPY != extendedErr->ee_origin || 0 != extendedErr->ee_errno)
+            {
+                continue;
+            }
+            completedSends = completedSends + (extendedErr->ee_data - extendedErr->ee_info + 1);
+        }
+    }
+
+    return STATUS_SUCCESS;
+} // WaitZeroCopyCompletions()
+
+
+
+
+//
+// ReadAheadWorker
+//
+static void
+ReadAheadWorker(
+    __inout READ_AHEAD *ReadAhead
+    )
+/*++
+Description: Routine of the reader thread of a large range (see SendFileRangeToServer()). It reads the range in frames of up to 
+SD_DATA_FRAME_SIZE bytes, into the SD_CLT_READ_QUEUE_DEPTH buffers in turns: the next frames are read while the previous one is
+compressed or sent. With SD_CLT_IO_URING (if the kernel provides io_uring), the reads of all the free buffers are in flight at once
+(see UringSubmitRead()); otherwise, the frames are read one at a time (pread()). The thread ends after the last frame (end of the 
+range, or a short read: the file was truncated), or when the sender stops.
+--*/
+{
+    QWORD       position;                                               // End of the frames read.
+    QWORD       submitPosition;                                         // End of the frames read or being read (io_uring).
+    DWORD       frameSizes[SD_CLT_READ_QUEUE_DEPTH];                    // Size of the read in flight on each buffer (io_uring).
+    DWORD       frameSize;
+    DWORD       readSoFar;
+    ssize_t     readBytes;
+    __int32     result;
+    DWORD       slot;                                                   // Oldest buffer: the next one to be filled.
+    DWORD       inFlight;                                               // Reads in flight, on the buffers from slot on.
+    DWORD       submitSlot;
+    DWORD       freeSlots;
+    DWORD       i;
+    BOOL        bUseRing;
+    BOOL        isLast;
+
+    position = 0;
+    submitPosition = 0;
+    readBytes = 0;
+    slot = 0;
+    inFlight = 0;
+    submitSlot = 0;
+    isLast = FALSE;
+    bUseRing = (SD_CLT_IO_URING && SUCCESS(UringSetup(&ReadAhead->Ring, SD_CLT_READ_QUEUE_DEPTH, ReadAhead->Buffers, 
+                SD_DATA_FRAME_SIZE))) ? TRUE : FALSE;
+
+    while (FALSE == isLast)
+    {
+        {
+            std::unique_lock<std::mutex> lock(ReadAhead->Lock);
+
+            ReadAhead->Changed.wait(lock, [&]{ return TRUE == ReadAhead->IsStopping || 0 < inFlight || FALSE == ReadAhead->IsFull[slot]; });
+            if (TRUE == ReadAhead->IsStopping)
+            {
+                break;
+            }
+            for (freeSlots = 0; inFlight + freeSlots < SD_CLT_READ_QUEUE_DEPTH && 
+                 FALSE == ReadAhead->IsFull[(slot + inFlight + freeSlots) % SD_CLT_READ_QUEUE_DEPTH]; freeSlots ++);
+        }
+
+        result = 0;
+        if (bUseRing)
+        {
+            // Start the reads of the free buffers, in turns, then wait for the oldest one. A free buffer stays free (only this 
+            // thread fills the buffers).
+
+            for (i = 0; i < freeSlots && submitPosition < ReadAhead->Length; i ++)
+            {
+                submitSlot = (slot + inFlight) % SD_CLT_READ_QUEUE_DEPTH;
+                frameSizes[submitSlot] = (DWORD) FileReadQuota((size_t) SD_MIN(ReadAhead->Length - submitPosition, (QWORD) SD_DATA_FRAME_SIZE));
+                if (!(SUCCESS(UringSubmitRead(&ReadAhead->Ring, submitSlot, ReadAhead->FileDescriptor, frameSizes[submitSlot], 
+                                              ReadAhead->Offset + submitPosition))))
+                {
+                    break;
+                }
+                submitPosition = submitPosition + frameSizes[submitSlot];
+                inFlight ++;
+            }
+
+            if (0 == inFlight)                                          // Nothing in flight: the reading goes on synchronously.
+            {
+                printf("[SyncDir] Warning: ReadAheadWorker(): io_uring read not started. Reading synchronously.\n");
+                bUseRing = FALSE;
+            }
+        }
+
+        if (bUseRing)
+        {
+            frameSize = frameSizes[slot];
+            if (!(SUCCESS(UringWaitBuffer(&ReadAhead->Ring, slot, &result))))
+            {
+                result = -EIO;
+            }
+            inFlight --;
+            if (result < 0)
+            {
+                printf("[SyncDir] Error: ReadAheadWorker(): Error at file reading (%s). Ending file transfer.\n", strerror(-result));
+            }
+        }
+        else
+        {
+            frameSize = (DWORD) SD_MIN(ReadAhead->Length - position, (QWORD) SD_DATA_FRAME_SIZE);
+        }
+
+        // Synchronous reads: the whole frame. After io_uring: the rest of a short read, if any.
+
+        for (readSoFar = (result > 0) ? (DWORD) result : 0; result >= 0 && readSoFar < frameSize; readSoFar += readBytes)
+        {
+            readBytes = pread(ReadAhead->FileDescriptor, ReadAhead->Buffers[slot] + readSoFar, FileReadQuota(frameSize - readSoFar), 
+                              ReadAhead->Offset + position + readSoFar);
+            if (readBytes <= 0)                                         // 0 == EOF (e.g. file was truncated).
+            {
+                if (readBytes < 0)
+                {
+                    perror("[SyncDir] Error: ReadAheadWorker(): Error at file reading. Ending file transfer.\n");
+                }
+                break;
+            }
+        }
+        position = position + readSoFar;
+        isLast = (readSoFar < frameSize || position >= ReadAhead->Length) ? TRUE : FALSE;
+
+        {
+            std::lock_guard<std::mutex> lock(ReadAhead->Lock);
+
+            ReadAhead->Sizes[slot] = readSoFar;
+            ReadAhead->IsLast[slot] = isLast;
+            ReadAhead->IsFull[slot] = TRUE;
+        }
+        ReadAhead->Changed.notify_all();
+        slot = (slot + 1) % SD_CLT_READ_QUEUE_DEPTH;
+    }
+
+    UringTeardown(&ReadAhead->Ring);                                    // Waits for the reads still in flight (beyond the last frame).
+} // ReadAheadWorker()
+
+
+
+
+//
+// StopReadAhead
+//
+static void
+StopReadAhead(
+    __inout READ_AHEAD *ReadAhead
+    )
+/*++
+Description: The routine stops the reader thread of a range (if still running), waits for it, and releases the READ_AHEAD.
+--*/
+{
+    DWORD   i;
+
+    {
+        std::lock_guard<std::mutex> lock(ReadAhead->Lock);
+        ReadAhead->IsStopping = TRUE;
+    }
+    ReadAhead->Changed.notify_all();
+    if (ReadAhead->Reader.joinable())
+    {
+        ReadAhead->Reader.join();
+    }
+    for (i = 0; i < SD_CLT_READ_QUEUE_DEPTH; i ++)
+    {
+        free(ReadAhead->Buffers[i]);
+    }
+    delete ReadAhead;
+} // StopReadAhead()
+
+
+
+
+//
+// SendFileRangeToServer
+//
+SDSTATUS
+SendFileRangeToServer(
+    __in QWORD          Offset,
+    __in QWORD          Length,
+    __in __int32        FileDescriptor,
+    __in_opt const BYTE *FileContent,
+    __in __int32        CltSock
+    )
+/*++
+Description: The routine sends Length bytes of the content of a file, from Offset, as data frames (see PACKET_DATA_HEADER): a whole
+file (see SendFileToServer()), or one range of it (see PACKET_STRIPE_HEADER). The content is taken from FileContent, if the caller 
+already has it in memory (read while hashing), otherwise it is read from FileDescriptor (pread(), so the routine may run in parallel
+on the same file).
+The content is sent in data frames of up to SD_DATA_FRAME_SIZE bytes, without padding. With SD_CLT_ZERO_COPY, the content is not
+copied through user space buffers: sendfile() for the file descriptor, MSG_ZEROCOPY for the content in memory.
+If a compression codec was negotiated (gCompressionCodec), the start of the range is compressed first, as a sample: if it does not 
+save SD_COMPRESSION_MIN_SAVING percent (e.g. images, archives), the range is sent uncompressed; otherwise, each frame is compressed.
+With SD_CLT_SPARSE_FILES, the holes of a sparse file (fewer blocks allocated than its size) are not read: the data extents are found
+with lseek(SEEK_DATA/SEEK_HOLE) on FileDescriptor, the frames stop at their ends, and each hole is sent as a frame holding its length
+only (SD_DATA_FLAG_HOLE).
+A range of at least SD_CLT_LARGE_FILE_MIN_SIZE bytes read from FileDescriptor is streamed: the kernel is advised of the sequential
+reading (POSIX_FADV_SEQUENTIAL), and, when it goes through user space buffers (compression, or no SD_CLT_ZERO_COPY), a reader thread 
+reads the next frames into SD_CLT_READ_QUEUE_DEPTH aligned buffers while the current one is sent (see ReadAheadWorker()).
+If the file is truncated meanwhile, the last frame (SD_DATA_FLAG_EOF) comes early.
+
+- Offset: Offset of the first byte to send, in the file.
+- Length: Number of bytes to send.
+- FileDescriptor: Descriptor of the file, open for reading. Used only if FileContent is NULL.
+- FileContent: Optional. Pointer to the content of the whole file (at least Offset + Length bytes).
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (connection failure).
+--*/
+{
+    SDSTATUS        status;
+    ssize_t         readBytes;
+    DWORD           readSoFar;
+    QWORD           totalSentBytes;
+    DWORD           frameSize;
+    DWORD           frameFlags;
+    DWORD           contentBytes;
+    DWORD           zeroCopySends;
+    __int32         zeroCopyOption;
+    socklen_t       optionLength;
+    BOOL            bZeroCopy;
+    BOOL            bCompress;
+    BOOL            bSparse;
+    BOOL            bReadAhead;
+    DWORD           readSlot;
+    DWORD           i;
+    DWORD           sampleSize;
+    QWORD           wireBytes;
+    DWORD           holeBytes;
+    QWORD           position;
+    QWORD           rangeEnd;
+    QWORD           dataStart;
+    QWORD           dataEnd;
+    off_t           seekOffset;
+    struct stat     fileStat;
+    BYTE            *buffer;
+    BYTE            *compressedBuffer;
+    const BYTE      *frameData;
+    READ_AHEAD      *readAhead;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    readBytes = -1;
+    readSoFar = 0;
+    totalSentBytes = 0;
+    frameSize = 0;
+    frameFlags = 0;
+    contentBytes = 0;
+    zeroCopySends = 0;
+    zeroCopyOption = 0;
+    optionLength = sizeof(zeroCopyOption);
+    bZeroCopy = FALSE;
+    bCompress = FALSE;
+    bSparse = FALSE;
+    bReadAhead = FALSE;
+    readSlot = 0;
+    i = 0;
+    sampleSize = 0;
+    wireBytes = 0;
+    holeBytes = 0;
+    position = 0;
+    rangeEnd = (QWORD) Offset + Length;
+    dataStart = 0;
+    dataEnd = 0;
+    seekOffset = 0;
+    buffer = NULL;
+    compressedBuffer = NULL;
+    frameData = NULL;
+    readAhead = NULL;
+
+    // Parameter validation.
+
+    if (NULL == FileContent && FileDescriptor < 0)
+    {
+        printf("[SyncDir] Error: SendFileRangeToServer(): Invalid parameter 3. \n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+
+        // Compression: only if the sample (start of the range) compresses well enough. Already compressed formats are sent as they are.
+
+        if (ccNONE != gCompressionCodec && SD_COMPRESSION_MIN_FILE_SIZE <= Length)
+        {
+            compressedBuffer = (BYTE*) malloc((size_t) SD_MIN(Length, (QWORD) SD_DATA_FRAME_SIZE));
+            if (NULL == FileContent)
+            {
+                buffer = (BYTE*) malloc((size_t) SD_MIN(Length, (QWORD) SD_DATA_FRAME_SIZE) + 1);
+            }
+            if (NULL == compressedBuffer || (NULL == FileContent && NULL == buffer))
+            {
+                printf("[SyncDir] Error: SendFileRangeToServer(): Error at malloc().\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            sampleSize = (DWORD) SD_MIN(Length, (QWORD) SD_COMPRESSION_SAMPLE_SIZE);
+            frameData = FileContent + Offset;
+            if (NULL == FileContent)
+            {
+                for (readSoFar = 0; readSoFar < sampleSize; readSoFar += readBytes)
+                {
+                    readBytes = pread(FileDescriptor, buffer + readSoFar, FileReadQuota(sampleSize - readSoFar), Offset + readSoFar);
+                    if (readBytes <= 0)
+                    {
+                        break;                                              // The frames loop handles it.
+                    }
+                }
+                sampleSize = readSoFar;
+                frameData = buffer;
+            }
+
+            bCompress = (0 != CompressBlock(gCompressionCodec, frameData, sampleSize, compressedBuffer, 
+                sampleSize - (sampleSize * SD_COMPRESSION_MIN_SAVING) / 100)) ? TRUE : FALSE;
+
+            if (!bCompress)
+            {
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: SendFileRangeToServer(): Content does not compress. Sending uncompressed. \n");
+                free(compressedBuffer);
+                compressedBuffer = NULL;
+                if (SD_CLT_ZERO_COPY)
+                {
+                    free(buffer);
+                    buffer = NULL;
+                }
+            }
+        }
+
+        // Zero-copy: sendfile() for the file descriptors; MSG_ZEROCOPY for the contents in memory, if the socket has SO_ZEROCOPY.
+
+        if (SD_CLT_ZERO_COPY && !bCompress && NULL != FileContent && SD_CLT_ZERO_COPY_MIN_SIZE <= Length)
+        {
+            if (0 == getsockopt(CltSock, SOL_SOCKET, SO_ZEROCOPY, &zeroCopyOption, &optionLength) && 0 != zeroCopyOption)
+            {
+                bZeroCopy = TRUE;
+            }
+        }
+
+        if (NULL == FileContent && !SD_CLT_ZERO_COPY && NULL == buffer)
+        {
+            buffer = (BYTE*) malloc((size_t) SD_MIN(Length, (QWORD) SD_DATA_FRAME_SIZE) + 1);
+            if (NULL == buffer)
+            {
+                printf("[SyncDir] Error: SendFileRangeToServer(): Error at malloc().\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+
+
+        // Sparse file: fewer blocks allocated than its size. Its holes are skipped (the file descriptor finds them, even if the 
+        // content is in memory).
+
+        if (SD_CLT_SPARSE_FILES && 0 <= FileDescriptor && 0 == fstat(FileDescriptor, &fileStat) && S_ISREG(fileStat.st_mode) &&
+            (QWORD) fileStat.st_blocks * 512 < (QWORD) fileStat.st_size)
+        {
+            bSparse = TRUE;
+        }
+
+
+        // Large range read from the file: sequential reading advised; through user space buffers, the frames are read ahead (see 
+        // ReadAheadWorker()).
+
+        if (NULL == FileContent && SD_CLT_LARGE_FILE_MIN_SIZE <= Length)
+        {
+            posix_fadvise(FileDescriptor, (off_t) Offset, (off_t) Length, POSIX_FADV_SEQUENTIAL);  // Advice only, errors are ignored.
+
+            if ((bCompress || !SD_CLT_ZERO_COPY) && !bSparse)
+            {
+                readAhead = new READ_AHEAD();
+                readAhead->FileDescriptor = FileDescriptor;
+                readAhead->Offset = Offset;
+                readAhead->Length = Length;
+                readAhead->Ring.RingFd = -1;
+                for (i = 0; i < SD_CLT_READ_QUEUE_DEPTH; i ++)
+                {
+                    if (0 != posix_memalign((void**) &readAhead->Buffers[i], SD_FILE_READ_BUFFER_ALIGNMENT, SD_DATA_FRAME_SIZE))
+                    {
+                        printf("[SyncDir] Error: SendFileRangeToServer(): Error at posix_memalign().\n");
+                        status = STATUS_FAIL;
+                        throw SyncDirException();
+                    }
+                }
+                readAhead->Reader = std::thread(ReadAheadWorker, readAhead);
+                bReadAhead = TRUE;
+            }
+        }
+
+
+        totalSentBytes = 0;
+
+
+        // --> INIT (end).
+
+
+
+        //
+        // Main processing:
+        //
+
+
+
+        // Get file frames (from memory, or read from the file).
+        // Send file frames to server.
+
+        while (1) 
+        {
+            frameSize = (DWORD) SD_MIN(Length - totalSentBytes, (QWORD) SD_DATA_FRAME_SIZE);
+            frameFlags = 0;
+
+            // Sparse file: at the end of a data extent, find the next one. The hole before it is sent as its length only.
+
+            if (bSparse)
+            {
+                position = (QWORD) Offset + totalSentBytes;
+                if (position >= dataEnd && position < rangeEnd)             // Next data extent.
+                {
+                    seekOffset = lseek(FileDescriptor, (off_t) position, SEEK_DATA);
+                    if (seekOffset < 0)                                     // ENXIO: no data up to the end of the file.
+                    {
+                        dataStart = (0 == fstat(FileDescriptor, &fileStat)) ? SD_MAX(SD_MIN((QWORD) fileStat.st_size, rangeEnd), 
+                                                                                     position) : position;
+                        dataEnd = dataStart;                                // Hole up to the end (before rangeEnd: truncated).
+                    }
+                    else
+                    {
+                        dataStart = SD_MIN((QWORD) seekOffset, rangeEnd);
+                        seekOffset = lseek(FileDescriptor, (off_t) dataStart, SEEK_HOLE);
+                        dataEnd = (seekOffset < 0) ? rangeEnd : SD_MIN((QWORD) seekOffset, rangeEnd);
+                    }
+                }
+
+                if (dataStart > position || dataEnd <= dataStart)           // Hole before it (frames of bounded length).
+                {
+                    holeBytes = (DWORD) SD_MIN(dataStart - position, (QWORD) SD_DATA_HOLE_MAX_SIZE);
+                    totalSentBytes = totalSentBytes + holeBytes;
+                    frameFlags = (totalSentBytes >= Length || (dataEnd <= dataStart && position + holeBytes >= dataStart)) ? 
+                                 SD_DATA_FLAG_EOF : 0;
+
+                    status = SendDataHeaderToServer(SD_DATA_FLAG_HOLE | frameFlags, holeBytes, CltSock);
+                    if (!(SUCCESS(status)))
+                    {
+                        printf("[SyncDir] Error: SendFileRangeToServer(): SendDataHeaderToServer() failed (hole). Abandoning ...\n");
+                        status = STATUS_FAIL;
+                        throw SyncDirException();
+                    }
+
+                    if (SD_DATA_FLAG_EOF & frameFlags)
+                    {
+                        fprintf(g_SD_STDLOG, "[SyncDir] Info: SendFileRangeToServer(): EOF was met (hole). Ending file transfer. \n");
+                        break;
+                    }
+                    continue;
+                }
+                frameSize = (DWORD) SD_MIN((QWORD) frameSize, dataEnd - position);
+            }
+
+            if (NULL != FileContent)
+            {
+                frameData = FileContent + Offset + totalSentBytes;
+            }
+            else if (SD_CLT_ZERO_COPY && !bCompress)
+            {
+                // The content goes from the page cache to the socket (sendfile()).
+
+                frameFlags = (totalSentBytes + frameSize >= Length) ? SD_DATA_FLAG_EOF : 0;
+
+                status = SendFileFrameToServer(frameFlags, FileDescriptor, Offset + totalSentBytes, frameSize, CltSock, 
+                    &contentBytes);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: SendFileRangeToServer(): SendFileFrameToServer() failed. Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                totalSentBytes = totalSentBytes + frameSize;
+
+                if (contentBytes < frameSize)                               // Fault tolerance: the file was truncated meanwhile.
+                {
+                    printf("[SyncDir] Warning: SendFileRangeToServer(): File truncated while sending. Ending file transfer.\n");
+                    if (!(SD_DATA_FLAG_EOF & frameFlags))
+                    {
+                        frameFlags = SD_DATA_FLAG_EOF;
+                        status = SendDataFrameToServer(frameFlags, NULL, 0, CltSock);
+                        if (!(SUCCESS(status)))
+                        {
+                            printf("[SyncDir] Error: SendFileRangeToServer(): SendDataFrameToServer() failed. Abandoning ...\n");
+                            status = STATUS_FAIL;
+                            throw SyncDirException();
+                        }
+                    }
+                }
+
+                if (SD_DATA_FLAG_EOF & frameFlags)
+                {
+                    fprintf(g_SD_STDLOG, "[SyncDir] Info: SendFileRangeToServer(): EOF was met. Ending file transfer. \n");
+                    break;
+                }
+                continue;
+            }
+            else if (bReadAhead)
+            {
+                // The frame was read ahead (the reader thread reads the next one meanwhile).
+
+                {
+                    std::unique_lock<std::mutex> lock(readAhead->Lock);
+
+                    readAhead->Changed.wait(lock, [&]{ return TRUE == readAhead->IsFull[readSlot]; });
+                    frameSize = readAhead->Sizes[readSlot];
+                    frameFlags = (TRUE == readAhead->IsLast[readSlot]) ? SD_DATA_FLAG_EOF : 0;
+                }
+                frameData = readAhead->Buffers[readSlot];
+            }
+            else
+            {
+                for (readSoFar = 0; readSoFar < frameSize; readSoFar += readBytes)
+                {
+                    readBytes = pread(FileDescriptor, buffer + readSoFar, FileReadQuota(frameSize - readSoFar), 
+                                      Offset + totalSentBytes + readSoFar);
+                    if (readBytes <= 0)                                     // 0 == EOF (e.g. file was truncated).
+                    {
+                        if (readBytes < 0)
+                        {
+                            perror("[SyncDir] Error: SendFileRangeToServer(): Error at file reading. Ending file transfer.\n");
+                        }
+                        frameFlags = SD_DATA_FLAG_EOF;
+                        break;
+                        // Fault tolerance: end the transfer (the server receives what was sent so far).
+                    }
+                }
+                frameSize = readSoFar;
+                frameData = buffer;
+            }
+
+            totalSentBytes = totalSentBytes + frameSize; 
+
+
+            // Exit condition. If EOF was met, or if all file was sent. 
+
+            if (totalSentBytes >= Length)
+            {                
+                frameFlags = SD_DATA_FLAG_EOF;
+            }
+
+
+            if (bCompress)
+            {
+                status = SendCompressedFrameToServer(frameFlags, frameData, frameSize, compressedBuffer, CltSock, &wireBytes);
+            }
+            else if (bZeroCopy)
+            {
+                status = SendZeroCopyFrameToServer(frameFlags, frameData, frameSize, CltSock, &zeroCopySends);
+            }
+            else
+            {
+                status = SendDataFrameToServer(frameFlags, frameData, frameSize, CltSock);  // Send file frame to server.
+            }
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendFileRangeToServer(): Sending the data frame failed. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();                   
+            }
+
+            if (bReadAhead)                                                 // Frame sent: its buffer can be read into again.
+            {
+                {
+                    std::lock_guard<std::mutex> lock(readAhead->Lock);
+                    readAhead->IsFull[readSlot] = FALSE;
+                }
+                readAhead->Changed.notify_all();
+                readSlot = (readSlot + 1) % SD_CLT_READ_QUEUE_DEPTH;
+            }
+
+
+            if (SD_DATA_FLAG_EOF & frameFlags)
+            {
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: SendFileRangeToServer(): EOF was met. Ending file transfer. \n");
+                break;
+            }
+
+        } //--> while (1)
+
+
+        // FileContent belongs to the caller, who may free it on return: wait until the kernel no longer uses its pages.
+
+        if (0 < zeroCopySends)
+        {
+            status = WaitZeroCopyCompletions(CltSock, zeroCopySends);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendFileRangeToServer(): WaitZeroCopyCompletions() failed. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+
+        if (bCompress)
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Content sent to server, compressed: [%llu/%llu B] on the wire. \n", 
+                (unsigned long long) wireBytes, (unsigned long long) totalSentBytes);
+        }
+        else
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Content sent to server. \n");
+        }
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SendFileRangeToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SendFileRangeToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        if (NULL != readAhead)
+        {
+            StopReadAhead(readAhead);
+            readAhead = NULL;
+        }
+        free(buffer);                                                   // The file (descriptor or content) belongs to the caller.
+        buffer = NULL;
+        free(compressedBuffer);
+        compressedBuffer = NULL;
+    }
+    else
+    {
+        if (NULL != readAhead)
+        {
+            StopReadAhead(readAhead);                                   // The reader may still be waiting for a buffer.
+            readAhead = NULL;
+        }
+        free(buffer);                                                   // The file (descriptor or content) belongs to the caller.
+        buffer = NULL;
+        free(compressedBuffer);
+        compressedBuffer = NULL;
+    }
+
+    return status;
+} // SendFileRangeToServer()
+
+
+
+
+//
+// SendFileToServer
+//
+SDSTATUS
+SendFileToServer(
+    __in QWORD          FileSize,
+    __in __int32        FileDescriptor,
+    __in_opt const BYTE *FileContent,
+    __in __int32        CltSock
+    )
+/*++
+Description: The routine sends the content of a file to a server address: the size of the file (QWORD, big-endian), then the 
+whole content, in data frames (see SendFileRangeToServer()). The content is taken from FileContent, if the caller already has it in
+memory (read while hashing), otherwise it is read from FileDescriptor, starting at offset 0.
+
+- FileSize: Size of the file, in bytes.
+- FileDescriptor: Descriptor of the file, open for reading. Used only if FileContent is NULL.
+- FileContent: Optional. Pointer to the content of the file (FileSize bytes).
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS        status;
+    QWORD           fileSizeNetOrder;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    fileSizeNetOrder = 0;
+
+    // Parameter validation.
+
+    if (NULL == FileContent && FileDescriptor < 0)
+    {
+        printf("[SyncDir] Error: SendFileToServer(): Invalid parameter 2. \n");
+        return STATUS_FAIL;
+    }
+
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: Sending file of size [%llu B] to server. \n", (unsigned long long) FileSize);
+
+
+    // Send file size.
+
+    fileSizeNetOrder = htobe64(FileSize);                                           // Machine (local) byte order to network order.
+
+    status = SendBufferToServer(&fileSizeNetOrder, sizeof(fileSizeNetOrder), CltSock);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: SendFileToServer(): Error at sending to server (file size). Abandoning ...\n");
+        return STATUS_FAIL;
+    }
+
+
+    // Send the content.
+
+    status = SendFileRangeToServer(0, FileSize, FileDescriptor, FileContent, CltSock);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: SendFileToServer(): SendFileRangeToServer() failed. Abandoning ...\n");
+        return STATUS_FAIL;
+    }
+
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: File sent to server. \n");
+
+    return STATUS_SUCCESS;
+} // SendFileToServer()
+
+
+
+
+//
+// AppendDeltaOp
+//
+static void
+AppendDeltaOp(
+    __inout std::vector<BYTE>   &Message,
+    __in DWORD                  Type,
+    __in DWORD                  Value,
+    __in DWORD                  Count,
+    __in_opt const BYTE         *Literal
+    )
+/*++
+Description: The routine appends one delta instruction (PACKET_DELTA_OP, network byte order) to Message, followed by its Value bytes
+of literal data, for SD_DELTA_OP_LITERAL.
+--*/
+{
+    PACKET_DELTA_OP op;
+
+    op.Type = htonl(Type);
+    op.Value = htonl(Value);
+    op.Count = htonl(Count);
+
+    Message.insert(Message.end(), (const BYTE*) &op, (const BYTE*) &op + sizeof(PACKET_DELTA_OP));
+    if (SD_DELTA_OP_LITERAL == Type && NULL != Literal)
+    {
+        Message.insert(Message.end(), Literal, Literal + Value);
+    }
+} // AppendDeltaOp()
+
+
+
+
+//
+// AppendDeltaLiteral
+//
+static void
+AppendDeltaLiteral(
+    __inout std::vector<BYTE>   &Message,
+    __in const BYTE             *Literal,
+    __in size_t                 LiteralSize,
+    __inout DWORD               *CopyStart,
+    __inout DWORD               *CopyCount
+    )
+/*++
+Description: The routine appends literal data to Message, in SD_DELTA_OP_LITERAL instructions of at most SD_DELTA_MAX_LITERAL_SIZE
+bytes. The pending run of block copies (CopyStart, CopyCount), if any, is appended first, to keep the order of the file.
+--*/
+{
+    size_t  offset;
+    DWORD   chunkSize;
+
+    if (0 == LiteralSize)
+    {
+        return;
+    }
+
+    if (0 != (*CopyCount))
+    {
+        AppendDeltaOp(Message, SD_DELTA_OP_COPY, (*CopyStart), (*CopyCount), NULL);
+        (*CopyCount) = 0;
+    }
+
+    for (offset = 0; offset < LiteralSize; offset += chunkSize)
+    {
+        chunkSize = (DWORD) SD_MIN(LiteralSize - offset, (size_t) SD_DELTA_MAX_LITERAL_SIZE);
+        AppendDeltaOp(Message, SD_DELTA_OP_LITERAL, chunkSize, 0, Literal + offset);
+    }
+} // AppendDeltaLiteral()
+
+
+
+
+//
+// SendDeltaToServer
+//
+SDSTATUS
+SendDeltaToServer(
+    __in QWORD          FileSize,
+    __in __int32        FileDescriptor,
+    __in_opt const BYTE *FileContent,
+    __in __int32        CltSock
+    )
+/*++
+Description: The routine sends the content of a file as a delta against the server copy (rsync algorithm, see PACKET_DELTA_HEADER).
+It receives the block signatures of the server copy and indexes them (see DeltaBuildIndex()). Then a window slides over the content
+(from FileContent, or read from FileDescriptor by SD_FILE_READ_BUFFER_SIZE bytes): each window matching a block is sent as a block
+reference (consecutive blocks as one run), and the data between the matches is sent as literals. Finally, if the server reports that
+the rebuilt file does not have the expected hash code (e.g. the file changed meanwhile), the whole file is sent.
+
+- FileSize: Size of the file, in bytes.
+- FileDescriptor: Descriptor of the file, open for reading. Used only if FileContent is NULL.
+- FileContent: Optional. Pointer to the content of the file (FileSize bytes).
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS                        status;
+    PACKET_DELTA_HEADER             header;
+    std::vector<PACKET_DELTA_BLOCK> blocks;
+    DELTA_INDEX                     index;
+    std::vector<BYTE>               message;
+    BYTE                            *readBuffer;
+    const BYTE                      *data;
+    size_t                          dataLength;
+    size_t                          readBufferSize;
+    QWORD                           readOffset;
+    BOOL                            isEOF;
+    size_t                          position;
+    size_t                          literalStart;
+    DWORD                           checksum;
+    BOOL                            isChecksumValid;
+    DWORD                           blockIndex;
+    DWORD                           copyStart;
+    DWORD                           copyCount;
+    QWORD                           matchedBytes;
+    ssize_t                         readBytes;
+    ssize_t                         recvBytes;
+    char                            bufferIn[SD_SHORT_MSG_SIZE];
+    DWORD                           i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    memset(&index, 0, sizeof(index));
+    readBuffer = NULL;
+    data = NULL;
+    dataLength = 0;
+    readBufferSize = 0;
+    readOffset = 0;
+    isEOF = FALSE;
+    position = 0;
+    literalStart = 0;
+    checksum = 0;
+    isChecksumValid = FALSE;
+    blockIndex = SD_DELTA_NO_MATCH;
+    copyStart = 0;
+    copyCount = 0;
+    matchedBytes = 0;
+    readBytes = -1;
+    recvBytes = -1;
+    bufferIn[0] = 0;
+
+    // Parameter validation.
+
+    if (NULL == FileContent && FileDescriptor < 0)
+    {
+        printf("[SyncDir] Error: SendDeltaToServer(): Invalid parameter 2. \n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+
+        // Receive the block signatures of the server copy.
+
+        recvBytes = recv(CltSock, &header, sizeof(PACKET_DELTA_HEADER), MSG_WAITALL);
+        if (sizeof(PACKET_DELTA_HEADER) != recvBytes)
+        {
+            perror("[SyncDir] Error: SendDeltaToServer(): Error at receiving the delta header from server.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+        header.BlockSize = ntohl(header.BlockSize);
+        header.NumberOfBlocks = ntohl(header.NumberOfBlocks);
+
+        if (header.BlockSize < SD_DELTA_MIN_BLOCK_SIZE || header.BlockSize > SD_DELTA_MAX_BLOCK_SIZE || 
+            header.NumberOfBlocks > 0xFFFFFFFF / SD_DELTA_MIN_BLOCK_SIZE)
+        {
+            printf("[SyncDir] Error: SendDeltaToServer(): Invalid delta header [%u B x %u blocks].\n", header.BlockSize, 
+                header.NumberOfBlocks);
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        blocks.resize(header.NumberOfBlocks);
+        if (0 != header.NumberOfBlocks)
+        {
+            recvBytes = recv(CltSock, blocks.data(), blocks.size() * sizeof(PACKET_DELTA_BLOCK), MSG_WAITALL);
+            if ((ssize_t) (blocks.size() * sizeof(PACKET_DELTA_BLOCK)) != recvBytes)
+            {
+                perror("[SyncDir] Error: SendDeltaToServer(): Error at receiving the block signatures from server.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+        for (i = 0; i < header.NumberOfBlocks; i++)
+        {
+            blocks[i].WeakChecksum = ntohl(blocks[i].WeakChecksum);
+        }
+
+        status = DeltaBuildIndex(gHashAlgorithm, header.BlockSize, header.NumberOfBlocks, blocks.data(), &index);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SendDeltaToServer(): DeltaBuildIndex() failed.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // Content: from memory, or read by windows.
+
+        if (NULL != FileContent)
+        {
+            data = FileContent;
+            dataLength = (size_t) FileSize;
+            isEOF = TRUE;
+        }
+        else
+        {
+            readBufferSize = header.BlockSize + SD_FILE_READ_BUFFER_SIZE;
+            readBuffer = (BYTE*) malloc(readBufferSize);
+            if (NULL == readBuffer)
+            {
+                printf("[SyncDir] Error: SendDeltaToServer(): Error at malloc().\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            data = readBuffer;
+        }
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Sending delta of file of size [%llu B] against [%u] blocks of [%u B]. \n", 
+            (unsigned long long) FileSize, header.NumberOfBlocks, header.BlockSize);
+
+
+
+        //
+        // Main processing:
+        //
+
+        while (1)
+        {
+            // Send the instructions by large messages (also between matches: the literals of a large file are not all kept).
+
+            if (message.size() >= SD_FILE_READ_BUFFER_SIZE)
+            {
+                status = SendBufferToServer(message.data(), message.size(), CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: SendDeltaToServer(): SendBufferToServer() failed (delta).\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                message.clear();
+            }
+
+
+            // Read more content, if the window does not fit. The data before the window is not needed anymore: append it as literal.
+
+            if (FALSE == isEOF && position + header.BlockSize > dataLength)
+            {
+                AppendDeltaLiteral(message, data + literalStart, position - literalStart, &copyStart, &copyCount);
+
+                memmove(readBuffer, readBuffer + position, dataLength - position);
+                dataLength = dataLength - position;
+                position = 0;
+                literalStart = 0;
+                isChecksumValid = FALSE;
+
+                while (dataLength < readBufferSize && readOffset < FileSize)
+                {
+                    readBytes = pread(FileDescriptor, readBuffer + dataLength, FileReadQuota((size_t) SD_MIN((QWORD) (readBufferSize - 
+                        dataLength), FileSize - readOffset)), readOffset);
+                    if (readBytes <= 0)
+                    {
+                        perror("[SyncDir] Warning: SendDeltaToServer(): Error at file reading (or file truncated). Ending the delta.\n");
+                        isEOF = TRUE;
+                        break;
+                        // Fault tolerance: the server detects the mismatch, and the whole file is sent.
+                    }
+                    dataLength = dataLength + readBytes;
+                    readOffset = readOffset + readBytes;
+                }
+                if (readOffset >= FileSize)
+                {
+                    isEOF = TRUE;
+                }
+            }
+
+
+            // Next match.
+
+            status = DeltaFindMatch(&index, data, dataLength, &position, &checksum, &isChecksumValid, &blockIndex);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendDeltaToServer(): DeltaFindMatch() failed.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            if (SD_DELTA_NO_MATCH == blockIndex)
+            {
+                if (TRUE == isEOF)
+                {
+                    break;
+                }
+                continue;
+            }
+
+            AppendDeltaLiteral(message, data + literalStart, position - literalStart, &copyStart, &copyCount);
+
+            if (0 != copyCount && copyStart + copyCount == blockIndex)
+            {
+                copyCount ++;
+            }
+            else
+            {
+                if (0 != copyCount)
+                {
+                    AppendDeltaOp(message, SD_DELTA_OP_COPY, copyStart, copyCount, NULL);
+                }
+                copyStart = blockIndex;
+                copyCount = 1;
+            }
+
+            position = position + header.BlockSize;
+            literalStart = position;
+            isChecksumValid = FALSE;
+            matchedBytes = matchedBytes + header.BlockSize;
+
+        } //--> while (1)
+
+
+        // The rest is literal. Then end.
+
+        AppendDeltaLiteral(message, data + literalStart, dataLength - literalStart, &copyStart, &copyCount);
+        if (0 != copyCount)
+        {
+            AppendDeltaOp(message, SD_DELTA_OP_COPY, copyStart, copyCount, NULL);
+        }
+        AppendDeltaOp(message, SD_DELTA_OP_END, 0, 0, NULL);
+
+        status = SendBufferToServer(message.data(), message.size(), CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SendDeltaToServer(): SendBufferToServer() failed (delta end).\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // Result of the reconstruction.
+
+        recvBytes = recv(CltSock, bufferIn, SD_SHORT_MSG_SIZE, MSG_WAITALL);
+        if (SD_SHORT_MSG_SIZE != recvBytes)
+        {
+            perror("[SyncDir] Error: SendDeltaToServer(): Error at receiving the delta result from server.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+        bufferIn[SD_SHORT_MSG_SIZE - 1] = 0;
+
+        if (0 == strcmp(bufferIn, "Delta OK"))
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Delta sent: [%llu/%llu B] matched on the server. \n", (unsigned long long) matchedBytes, 
+                (unsigned long long) FileSize);
+        }
+        else
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied '%s'. Sending the whole file ... \n", bufferIn);
+
+            status = SendFileToServer(FileSize, FileDescriptor, FileContent, CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendDeltaToServer(): SendFileToServer() failed.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SendDeltaToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SendDeltaToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        DeltaFreeIndex(&index);
+        free(readBuffer);
+        readBuffer = NULL;
+    }
+    else
+    {
+        DeltaFreeIndex(&index);
+        free(readBuffer);
+        readBuffer = NULL;
+    }
+
+    return status;
+} // SendDeltaToServer()
+
+
+
+
+
+//
+// SendChunksToServer
+//
+SDSTATUS
+SendChunksToServer(
+    __in QWORD          FileSize,
+    __in __int32        FileDescriptor,
+    __in_opt const BYTE *FileContent,
+    __in __int32        CltSock,
+    __out BOOL          *IsStripeAsked
+    )
+/*++
+Description: The routine sends the content of a file as a list of content-defined chunks (see PACKET_CHUNK). The file is split into
+chunks (from FileContent, or read from FileDescriptor), and their sizes and hash codes are sent. The server replies which chunks it
+already has (in any of its files); the content of the other ones is sent, in order: each run of consecutive missing chunks as one
+range of the file (see SendFileRangeToServer()). Finally, if the server reports that the assembled file does not have the expected
+hash code (e.g. the file changed meanwhile), or that it cannot assemble it, the whole file is sent. If the server has few of the
+chunks, it replies "File Stripes" to the chunk list instead: the routine returns, and the caller sends the file in ranges.
+
+- FileSize: Size of the file, in bytes.
+- FileDescriptor: Descriptor of the file, open for reading. Used only if FileContent is NULL.
+- FileContent: Optional. Pointer to the content of the file (FileSize bytes).
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+- IsStripeAsked: Pointer to where the routine outputs TRUE if the server asked for the file in ranges ("File Stripes").
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS            status;
+    CDC_CHUNK           *chunks;
+    DWORD               numberOfChunks;
+    PACKET_CHUNK        packetChunk;
+    std::vector<BYTE>   message;
+    std::vector<BYTE>   isChunkOnServer;
+    QWORD               sentChunkBytes;
+    QWORD               runLength;
+    BOOL                isChunkRunsAsked;
+    BOOL                isWholeFileAsked;
+    ssize_t             recvBytes;
+    char                bufferIn[SD_SHORT_MSG_SIZE];
+    DWORD               i;
+    DWORD               j;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    chunks = NULL;
+    numberOfChunks = 0;
+    memset(&packetChunk, 0, sizeof(packetChunk));
+    sentChunkBytes = 0;
+    runLength = 0;
+    isChunkRunsAsked = FALSE;
+    isWholeFileAsked = FALSE;
+    recvBytes = -1;
+    bufferIn[0] = 0;
+    j = 0;
+
+    // Parameter validation.
+
+    if (NULL == FileContent && FileDescriptor < 0)
+    {
+        printf("[SyncDir] Error: SendChunksToServer(): Invalid parameter 2. \n");
+        return STATUS_FAIL;
+    }
+    if (NULL == IsStripeAsked)
+    {
+        printf("[SyncDir] Error: SendChunksToServer(): Invalid parameter 5. \n");
+        return STATUS_FAIL;
+    }
+
+    (*IsStripeAsked) = FALSE;
+
+
+    __try
+    {
+        // INIT.
+
+        // Split the file into chunks.
+
+        status = CdcChunksOfFile(gHashAlgorithm, FileDescriptor, FileContent, FileSize, &chunks, &numberOfChunks);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Warning: SendChunksToServer(): CdcChunksOfFile() failed. Sending no chunk.\n");
+            numberOfChunks = 0;
+            // Fault tolerance: the server detects the mismatch, and the whole file is sent.
+        }
+
+
+
+        //
+        // Main processing:
+        //
+
+        // Send the chunk list.
+
+        message.resize(sizeof(DWORD));
+        *((DWORD*) message.data()) = htonl(numberOfChunks);
+
+        for (i = 0; i < numberOfChunks; i++)
+        {
+            packetChunk.ChunkSize = htonl(chunks[i].Size);
+            strcpy(packetChunk.HashCode, chunks[i].HashCode);
+            message.insert(message.end(), (const BYTE*) &packetChunk, (const BYTE*) &packetChunk + sizeof(PACKET_CHUNK));
+        }
+
+        status = SendBufferToServer(message.data(), message.size(), CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SendChunksToServer(): SendBufferToServer() failed (chunk list).\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+        message.clear();
+
+
+        // Which chunks does the server have ? If it cannot assemble the file, it asks for the whole file at once. If it has few of
+        // them, it asks for the whole file in ranges (over the data connections), sent by the caller.
+
+        recvBytes = recv(CltSock, bufferIn, SD_SHORT_MSG_SIZE, MSG_WAITALL);
+        if (SD_SHORT_MSG_SIZE != recvBytes)
+        {
+            perror("[SyncDir] Error: SendChunksToServer(): Error at receiving the chunks answer from server.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+        bufferIn[SD_SHORT_MSG_SIZE - 1] = 0;
+
+        isChunkRunsAsked = (0 == strcmp(bufferIn, "Chunks Missing")) ? TRUE : FALSE;
+        (*IsStripeAsked) = (0 == strcmp(bufferIn, "File Stripes")) ? TRUE : FALSE;
+        isWholeFileAsked = (FALSE == isChunkRunsAsked && FALSE == (*IsStripeAsked)) ? TRUE : FALSE;
+
+        isChunkOnServer.resize(numberOfChunks);
+        if (TRUE == isChunkRunsAsked && 0 != numberOfChunks)
+        {
+            recvBytes = recv(CltSock, isChunkOnServer.data(), numberOfChunks, MSG_WAITALL);
+            if ((ssize_t) numberOfChunks != recvBytes)
+            {
+                perror("[SyncDir] Error: SendChunksToServer(): Error at receiving the chunks on server.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+
+
+        // Send the other chunks: each run of consecutive missing chunks as one range of the file, in data frames (see 
+        // SendFileRangeToServer(): zero-copy, read ahead, compressed, as for a whole file).
+
+        for (i = 0; TRUE == isChunkRunsAsked && i < numberOfChunks; i = j)
+        {
+            if (0 != isChunkOnServer[i])
+            {
+                j = i + 1;
+                continue;
+            }
+            for (j = i + 1; j < numberOfChunks && 0 == isChunkOnServer[j]; j++)
+            {
+                // Up to the next chunk on the server.
+            }
+            runLength = chunks[j - 1].Offset + chunks[j - 1].Size - chunks[i].Offset;
+
+            status = SendFileRangeToServer(chunks[i].Offset, runLength, FileDescriptor, FileContent, CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendChunksToServer(): SendFileRangeToServer() failed (chunks).\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            sentChunkBytes = sentChunkBytes + runLength;
+        }
+
+
+        // Result of the assembly.
+
+        if (TRUE == isChunkRunsAsked)
+        {
+            recvBytes = recv(CltSock, bufferIn, SD_SHORT_MSG_SIZE, MSG_WAITALL);
+            if (SD_SHORT_MSG_SIZE != recvBytes)
+            {
+                perror("[SyncDir] Error: SendChunksToServer(): Error at receiving the chunks result from server.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            bufferIn[SD_SHORT_MSG_SIZE - 1] = 0;
+
+            if (0 == strcmp(bufferIn, "Chunks OK"))
+            {
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Chunks sent: [%llu/%llu B] in [%u] chunks were not on the server. \n", 
+                    (unsigned long long) sentChunkBytes, (unsigned long long) FileSize, numberOfChunks);
+            }
+            else
+            {
+                isWholeFileAsked = TRUE;
+            }
+        }
+
+        if (TRUE == isWholeFileAsked)
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied '%s'. Sending the whole file ... \n", bufferIn);
+
+            status = SendFileToServer(FileSize, FileDescriptor, FileContent, CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendChunksToServer(): SendFileToServer() failed.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SendChunksToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SendChunksToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        free(chunks);
+        chunks = NULL;
+    }
+    else
+    {
+        free(chunks);
+        chunks = NULL;
+    }
+
+    return status;
+} // SendChunksToServer()
+
+
+
+
+//
+// SendBufferToServer
+//
+SDSTATUS
+SendBufferToServer(
+    __in const void     *Buffer,
+    __in size_t         BufferSize,
+    __in __int32        CltSock
+    )
+/*++
+Description: The routine sends BufferSize bytes to the server. A send() may transfer fewer bytes than requested (e.g. full socket
+buffer): the routine resumes until all the bytes are sent. Each send() offers only the bytes allowed by the send rate limit (see
+GovernorSendQuota()).
+
+- Buffer: Pointer to the data.
+- BufferSize: Number of bytes to send.
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    size_t      offset;
+    ssize_t     sentBytes;
+
+    // Parameter validation.
+
+    if (NULL == Buffer && 0 != BufferSize)
+    {
+        printf("[SyncDir] Error: SendBufferToServer(): Invalid parameter 1. \n");
+        return STATUS_FAIL;
+    }
+
+    for (offset = 0; offset < BufferSize; offset += sentBytes)
+    {
+        sentBytes = send(CltSock, (const BYTE*) Buffer + offset, GovernorSendQuota(BufferSize - offset), 0);
+        if (sentBytes <= 0)
+        {
+            perror("[SyncDir] Error: SendBufferToServer(): Error at sending to server.\n");
+            return STATUS_FAIL;
+        }
+    }
+
+    return STATUS_SUCCESS;
+} // SendBufferToServer()
+
+
+//
+// SendPacketOpAndFilePathToServer
+//
+SDSTATUS
+SendPacketOpAndFilePathToServer(
+    __in PACKET_OP  *OpToSend,
+    __in char       *FileRelativePath,
+    __in __int32    CltSock
+    )
+/*++
+Description: The routine sends to a server address the following: a packet containing information for an operation and the relative
+path of the file concerned by the operation.
+
+- OpToSend: Pointer to the packet containing the operation information.
+- FileRelativePath: Pointer to the string containing the relative path of the file.
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS status;
+    __int32 sentBytes;
+
+    static QWORD opCount = 0;
+    
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    sentBytes = -1;
+
+    // Parameter validation.
+
+    if (NULL == OpToSend)
+    {
+        printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Invalid parameter 1. \n");
+        return STATUS_FAIL;        
+    }
+    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
+    {
+        printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Invalid parameter 2. \n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+        opCount ++;
+        fprintf(g_SD_STDLOG, "[#%lu] ----------------------------------------\n", opCount);
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Sending: - Operation type: [%d]. \n", OpToSend->OperationType);
+
+
+        // 
+        // Main processing:
+        //
+
+
+
+        // Send operation to server.
+
+        sentBytes = send(CltSock, OpToSend, sizeof(PACKET_OP), 0);
+        if (sizeof(PACKET_OP) != sentBytes)
+        {
+            if (sentBytes < 0)
+            {
+                perror("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Error at sending to server (OpToSend). Abandoning ...\n");
+            }
+            else
+            {
+                printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Numbers of sent/to-send bytes do not match (OpToSend).\n");
+            }
+            status = STATUS_FAIL;
+            throw SyncDirException();            
+        }
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Operation (PACKET_OP) was successfully sent to server. \n");
+
+
+
+        // Send file relative path to server.
+
+        sentBytes = send(CltSock, FileRelativePath, OpToSend->RelativePathLength + 1, 0);
+        if (OpToSend->RelativePathLength + 1 != sentBytes)
+        {
+            if (sentBytes < 0)
+            {
+                perror("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Error at sending to server (file path). Abandoning ...\n");
+            }
+            else
+            {
+                printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Numbers of sent/to-send bytes do not match (file path).\n");
+            }
+            status = STATUS_FAIL;
+            throw SyncDirException();            
+        }    
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: File relative path was successfully sent to server. \n");
+
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SendPacketOpAndFilePathToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SendPacketOpAndFilePathToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        // Nothing to clean for the moment.
+    }
+
+    return status;
+} // SendPacketOpAndFilePathToServer()
+
+
+
+//
+// SendCreateToServer
+//
+SDSTATUS
+SendCreateToServer(
+    __in PACKET_OP  *OpToSend,
+    __in char       *FileRelativePath,
+    __in char       *FileRealRelativePath,
+    __in __int32    CltSock
+    )
+/*++
+Description: The routine sends a file create operation to a server address.
+Together with the operation information (OpToSend), the routine sends the relative path (FileRelativePath) and the real
+relative path (FileRealRelativePath) of the file concerned by the operation.
+
+- OpToSend: Pointer to the packet containing the operation information.
+- FileRelativePath: Pointer to the relative path of the file.
+- FileRealRelativePath: Pointer to the real relative path of the file (i.e. all subpaths resolved, no symbolic links).
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+{
+    SDSTATUS status;
+    __int32 sentBytes;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    sentBytes = -1;
+
+    // Parameter validation.
+
+    if (NULL == OpToSend)
+    {
+        printf("[SyncDir] Error: SendCreateToServer(): Invalid parameter 1. \n");
+        return STATUS_FAIL;        
+    }
+    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
+    {
+        printf("[SyncDir] Error: SendCreateToServer(): Invalid parameter 2. \n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileRealRelativePath || (0 != OpToSend->RealRelativePathLength && 0 == FileRealRelativePath[0]))
+    {
+        printf("[SyncDir] Error: SendCreateToServer(): Invalid parameter 3. \n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+
+        // Main processing:
+
+        // Send first 2 information to server:
+        // - operation info
+        // - file path
+
+        status = SendPacketOpAndFilePathToServer(OpToSend, FileRelativePath, CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SendCreateToServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        // Send sym link's real path to server.
+
+        if (ftSYMLINK == OpToSend->FileType)
+        {
+            sentBytes = send(CltSock, FileRealRelativePath, OpToSend->RealRelativePathLength + 1, 0);
+            if (OpToSend->RealRelativePathLength + 1 != sentBytes)
+            {
+                if (sentBytes < 0)        
+                {
+                    perror("[SyncDir] Error: SendCreateToServer(): Error at sending to server (real file path). Abandoning ...\n");
+                }
+                else
+                {
+                    printf("[SyncDir] Error: SendCreateToServer(): Numbers of sent/to-send bytes do not match (real file path).\n");
+                }            
+                status = STATUS_FAIL;
+                throw SyncDirException(); 
+            }
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Symbolic link (+ real path) sent successfully to server. \n");
+        }    
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Create operation sent successfully to server. \n");
+
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SendCreateToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SendCreateToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        // Nothing to clean for the moment.
+    }
+
+    return status;
+} // SendCreateToServer()
+
+
+//
+// SendMoveToServer
+//
+SDSTATUS
+SendMoveToServer(
+    __in PACKET_OP  *OpToSend,
+    __in char       *FileNewRelativePath,
+    __in char       *FileOldRelativePath,
+    __in __int32    CltSock
+    )
+/*++
+Description: The routine sends a file move operation to a server address.
+Together with the operation information (OpToSend), the routine sends the new relative path (FileNewRelativePath) and the old 
+relative path (FileOldRelativePath) of the file concerned by the operation.
+
+- OpToSend: Pointer to the packet containing the operation information.
+- FileNewRelativePath: Pointer to the new relative path of the file.
+- FileOldRelativePath: Pointer to the old relative path of the file.
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+{
+    SDSTATUS status;
+    __int32 sentBytes;
+
+    // PREINIT.
+    status = STATUS_FAIL;
+    sentBytes = -1;
+
+    // Parameter validation.
+
+    if (NULL == OpToSend)
+    {
+        printf("[SyncDir] Error: SendMoveToServer(): Invalid parameter 1. \n");
+        return STATUS_FAIL;        
+    }
+    if (NULL == FileNewRelativePath || 0 == FileNewRelativePath[0])
+    {
+        printf("[SyncDir] Error: SendMoveToServer(): Invalid parameter 2. \n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileOldRelativePath || 0 == FileOldRelativePath[0])
+    {
+        printf("[SyncDir] Error: SendMoveToServer(): Invalid parameter 3. \n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+        // Main processing:
+
+        // Send first 2 information to server:
+        // - operation info
+        // - file path
+        
+        status = SendPacketOpAndFilePathToServer(OpToSend, FileNewRelativePath, CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SendMoveToServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        // Send old path to server (file to be moved on the server).
+        
+        sentBytes = send(CltSock, FileOldRelativePath, OpToSend->OldRelativePathLength + 1, 0);
+        if (OpToSend->OldRelativePathLength + 1 != sentBytes)
+        {
+            if (sentBytes < 0)        
+            {
+                perror("[SyncDir] Error: SendMoveToServer(): Error at sending to server (old file path). Abandoning ...\n");
+            }        
+            else
+            {
+                printf("[SyncDir] Error: SendMoveToServer(): Numbers of sent/to-send bytes do not match (old file path).\n");
+            }                    
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SendMoveToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SendMoveToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        // Nothing to clean for the moment.
+    }
+
+    return status;
+} // SendMoveToServer()
+
+
+
+
+//
+// RecvModifyReplyFromServer
+//
+static SDSTATUS
+RecvModifyReplyFromServer(
+    __inout MODIFY_PIPELINE     &Pipeline,
+    __in __int32                CltSock
+    )
+/*++
+Description: The routine receives the next answer of the server (PACKET_MODIFY_REPLY): the one of the oldest MODIFY in flight that
+was not answered yet. The answers come in the order of the MODIFY's; another request ID means the connection is out of sync.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    PACKET_MODIFY_REPLY     reply;
+    ssize_t                 recvBytes;
+    size_t                  index;
+
+    for (index = 0; index < Pipeline.Pending.size() && TRUE == Pipeline.Pending[index].IsReplyReceived; index ++);
+    if (index >= Pipeline.Pending.size())
+    {
+        printf("[SyncDir] Error: RecvModifyReplyFromServer(): No MODIFY waiting for an answer. \n");
+        return STATUS_FAIL;
+    }
+
+    recvBytes = recv(CltSock, &reply, sizeof(reply), MSG_WAITALL);
+    if (sizeof(reply) != recvBytes)
+    {
+        perror("[SyncDir] Error: RecvModifyReplyFromServer(): Error at receiving from server. \n");
+        return STATUS_FAIL;
+    }
+    if (ntohl(reply.RequestId) != Pipeline.Pending[index].RequestId)
+    {
+        printf("[SyncDir] Error: RecvModifyReplyFromServer(): Answer to request [%u] received, [%u] expected. \n", 
+               ntohl(reply.RequestId), Pipeline.Pending[index].RequestId);
+        return STATUS_FAIL;
+    }
+
+    if (be64toh(reply.Offset) >= SD_MAX(Pipeline.Pending[index].FileSize, 1ULL))
+    {
+        printf("[SyncDir] Error: RecvModifyReplyFromServer(): Invalid offset [%llu] to resume request [%u] from. \n", 
+               (unsigned long long) be64toh(reply.Offset), Pipeline.Pending[index].RequestId);
+        return STATUS_FAIL;
+    }
+
+    memcpy(Pipeline.Pending[index].Reply, reply.Message, SD_SHORT_MSG_SIZE);
+    Pipeline.Pending[index].Reply[SD_SHORT_MSG_SIZE - 1] = 0;              // Never trust the peer's terminator.
+    Pipeline.Pending[index].ResumeOffset = be64toh(reply.Offset);
+    Pipeline.Pending[index].IsReplyReceived = TRUE;
+
+    return STATUS_SUCCESS;
+} // RecvModifyReplyFromServer()
+
+
+
+//
+// ReleaseOldestPendingModify
+//
+static void
+ReleaseOldestPendingModify(
+    __inout MODIFY_PIPELINE &Pipeline
+    )
+/*++
+Description: The routine removes the oldest MODIFY in flight from the pipeline, closing its file and freeing its content.
+--*/
+{
+    PENDING_MODIFY  *pending;
+
+    pending = &Pipeline.Pending.front();
+    if (NULL != pending->FileContent)
+    {
+        Pipeline.ContentBytes = Pipeline.ContentBytes - pending->FileSize;
+        free(pending->FileContent);
+        pending->FileContent = NULL;
+    }
+    if (pending->FileDescriptor >= 0)
+    {
+        close(pending->FileDescriptor);
+        pending->FileDescriptor = -1;
+    }
+    Pipeline.Pending.pop_front();
+} // ReleaseOldestPendingModify()
+
+
+
+//
+// SendModifyBatchToServer
+//
+static SDSTATUS
+SendModifyBatchToServer(
+    __inout MODIFY_PIPELINE     &Pipeline,
+    __in __int32                CltSock
+    )
+/*++
+Description: The routine sends the small files gathered in the batch of the pipeline (see PACKET_BATCH_HEADER), then empties the 
+batch. The server does not answer. Nothing is sent for an empty batch.
+--*/
+{
+    SDSTATUS            status;
+    PACKET_OP           opToSend;
+    PACKET_BATCH_HEADER batchHeader;
+    char                batchPath[] = "./";
+
+    if (0 == Pipeline.BatchEntries)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    status = InitOperationPacket(&opToSend);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: SendModifyBatchToServer(): Failed to execute InitOperationPacket(). \n");
+        return STATUS_FAIL;
+    }
+    opToSend.OperationType = opMODIFYBATCH;
+    opToSend.FileType = ftDIRECTORY;
+    opToSend.RelativePathLength = strlen(batchPath);
+
+    status = SendPacketOpAndFilePathToServer(&opToSend, batchPath, CltSock);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: SendModifyBatchToServer(): Error at 1st or 2nd send to server. \n");
+        return STATUS_FAIL;
+    }
+
+
+    // The header was reserved at the start of the batch: the header and the files go in one message.
+
+    batchHeader.NumberOfEntries = htonl(Pipeline.BatchEntries);
+    batchHeader.BatchSize = htonl((DWORD) (Pipeline.Batch.size() - sizeof(PACKET_BATCH_HEADER)));
+    memcpy(Pipeline.Batch.data(), &batchHeader, sizeof(batchHeader));
+
+    status = SendBufferToServer(Pipeline.Batch.data(), Pipeline.Batch.size(), CltSock);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: SendModifyBatchToServer(): Error at sending the batch to server. \n");
+        return STATUS_FAIL;
+    }
+
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: Batch sent: [%u] small files in [%zu B]. \n", Pipeline.BatchEntries, Pipeline.Batch.size());
+
+    Pipeline.Batch.clear();
+    Pipeline.BatchEntries = 0;
+    Pipeline.BatchPaths.clear();
+
+    return STATUS_SUCCESS;
+} // SendModifyBatchToServer()
+
+
+
+//
+// AppendFileToModifyBatch
+//
+static SDSTATUS
+AppendFileToModifyBatch(
+    __inout MODIFY_PIPELINE     &Pipeline,
+    __in const char             *FileRelativePath,
+    __in_opt const char         *HashCode,
+    __in_opt const BYTE         *FileContent,
+    __in DWORD                  FileSize,
+    __in __int32                CltSock
+    )
+/*++
+Description: The routine adds a small file to the batch of the pipeline (see PACKET_BATCH_ENTRY). The batch is sent first if the
+file does not fit in it. A NULL HashCode adds an empty file created (SD_BATCH_FLAG_CREATE).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the batch could not be sent).
+--*/
+{
+    PACKET_BATCH_ENTRY  batchEntry;
+    DWORD               hashCodeLength;
+    size_t              pathLength;
+    size_t              entrySize;
+    size_t              offset;
+
+    hashCodeLength = HashCodeLength(gHashAlgorithm);
+    pathLength = strlen(FileRelativePath);
+    entrySize = sizeof(PACKET_BATCH_ENTRY) + pathLength + hashCodeLength + 1 + FileSize;
+
+    if (0 != Pipeline.BatchEntries && Pipeline.Batch.size() + entrySize > SD_CLT_BATCH_MAX_SIZE)
+    {
+        if (!(SUCCESS(SendModifyBatchToServer(Pipeline, CltSock))))
+        {
+            printf("[SyncDir] Error: AppendFileToModifyBatch(): SendModifyBatchToServer() failed. \n");
+            return STATUS_FAIL;
+        }
+    }
+    if (0 == Pipeline.BatchEntries)
+    {
+        Pipeline.Batch.assign(sizeof(PACKET_BATCH_HEADER), 0);                 // Filled in when sent.
+    }
+
+    batchEntry.RelativePathLength = htons((WORD) pathLength);
+    batchEntry.Flags = htons((NULL == HashCode) ? SD_BATCH_FLAG_CREATE : 0);
+    batchEntry.FileSize = htonl(FileSize);
+
+    offset = Pipeline.Batch.size();
+    Pipeline.Batch.resize(offset + entrySize, 0);
+    memcpy(Pipeline.Batch.data() + offset, &batchEntry, sizeof(batchEntry));
+    offset = offset + sizeof(batchEntry);
+    memcpy(Pipeline.Batch.data() + offset, FileRelativePath, pathLength);
+    offset = offset + pathLength;
+    if (NULL != HashCode)
+    {
+        memcpy(Pipeline.Batch.data() + offset, HashCode, hashCodeLength + 1);
+    }
+    offset = offset + hashCodeLength + 1;
+    if (0 != FileSize)
+    {
+        memcpy(Pipeline.Batch.data() + offset, FileContent, FileSize);
+    }
+
+    Pipeline.BatchEntries ++;
+    Pipeline.BatchPaths.insert(FileRelativePath);
+
+    return STATUS_SUCCESS;
+} // AppendFileToModifyBatch()
+
+
+
+//
+// StripeFileToServer
+//
+static SDSTATUS
+StripeFileToServer(
+    __inout MODIFY_PIPELINE     &Pipeline,
+    __in __int32                CltSock
+    )
+/*++
+Description: The routine sends the content of the oldest MODIFY in flight over the data connections (see PACKET_STRIPE_HEADER), from
+its ResumeOffset ("File Resume"; 0 otherwise): the number of ranges on the control connection (after the opMODIFYDATA operation, sent
+by the caller), then the ranges are queued round-robin for the data connections. While SD_CLT_STRIPE_QUEUE_LIMIT bytes are queued, the routine waits for ranges to be sent.
+The file and its content move from the PENDING_MODIFY to a STRIPE_FILE, released by the sending threads with its last range.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (failure of the control connection or of a data connection).
+--*/
+{
+    SDSTATUS        status;
+    PENDING_MODIFY  *pending;
+    STRIPE_FILE     *file;
+    STRIPE_RANGE    range;
+    QWORD           contentSize;
+    DWORD           numberOfRanges;
+    DWORD           numberOfRangesNetOrder;
+    DWORD           index;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    pending = &Pipeline.Pending.front();
+    file = NULL;
+    contentSize = pending->FileSize - pending->ResumeOffset;
+    numberOfRanges = (DWORD) SD_MAX(contentSize / SD_CLT_STRIPE_RANGE_SIZE + ((0 != contentSize % SD_CLT_STRIPE_RANGE_SIZE) ? 1 : 0), 1ULL);
+    numberOfRangesNetOrder = htonl(numberOfRanges);
+    index = 0;
+
+
+    __try
+    {
+        // INIT.
+
+        file = new STRIPE_FILE;
+        file->RelativePath = pending->RelativePath;
+        file->FileDescriptor = -1;
+        file->FileContent = NULL;
+        file->FileSize = pending->FileSize;
+        file->RemainingRanges = numberOfRanges;
+
+
+
+        //
+        // Main processing:
+        //
+
+
+        // Announce the ranges.
+
+        status = SendBufferToServer(&numberOfRangesNetOrder, sizeof(DWORD), CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: StripeFileToServer(): Error at sending to server (number of ranges). Abandoning ...\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // The file and its content now belong to the sending threads.
+
+        file->FileDescriptor = pending->FileDescriptor;
+        file->FileContent = pending->FileContent;
+        if (NULL != pending->FileContent)
+        {
+            Pipeline.ContentBytes = Pipeline.ContentBytes - pending->FileSize;
+        }
+        pending->FileDescriptor = -1;
+        pending->FileContent = NULL;
+
+        if (NULL == file->FileContent && SD_CLT_LARGE_FILE_MIN_SIZE <= contentSize)
+        {
+            // The ranges are read in parallel, but mostly in order: let the kernel read ahead (advice only, errors are ignored).
+            posix_fadvise(file->FileDescriptor, (off_t) pending->ResumeOffset, (off_t) contentSize, POSIX_FADV_SEQUENTIAL);
+        }
+
+
+        // Queue the ranges, round-robin.
+
+        range.RequestId = pending->RequestId;
+        range.File = file;
+
+        for (index = 0; index < numberOfRanges; index++)
+        {
+            range.Offset = pending->ResumeOffset + (QWORD) index * SD_CLT_STRIPE_RANGE_SIZE;
+            range.Length = (DWORD) SD_MIN(pending->FileSize - range.Offset, (QWORD) SD_CLT_STRIPE_RANGE_SIZE);
+
+            {
+                std::unique_lock<std::mutex> lock(gStripeSender.Lock);
+
+                gStripeSender.QueueNotFull.wait(lock, [&range] { return 0 == gStripeSender.QueuedBytes || TRUE == gStripeSender.IsFailed ||
+                                                                        gStripeSender.QueuedBytes + range.Length <= SD_CLT_STRIPE_QUEUE_LIMIT; });
+                if (TRUE == gStripeSender.IsFailed)
+                {
+                    ReleaseStripeRanges(file, numberOfRanges - index);         // The ranges not queued.
+                    file = NULL;
+                    printf("[SyncDir] Error: StripeFileToServer(): A data connection failed. Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+
+                gStripeSender.Connections[gStripeSender.NextConnection].Queue.push_back(range);
+                gStripeSender.NextConnection = (gStripeSender.NextConnection + 1) % (DWORD) gStripeSender.Connections.size();
+                gStripeSender.QueuedBytes = gStripeSender.QueuedBytes + range.Length;
+            }
+            gStripeSender.QueueNotEmpty.notify_all();
+        }
+        file = NULL;                                                    // Released by the sending threads.
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: StripeFileToServer(): [%llu B] queued in [%u] ranges (request [%u]). \n", 
+            (unsigned long long) contentSize, numberOfRanges, pending->RequestId);
+
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: StripeFileToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: StripeFileToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        if (NULL != file)                                               // The ranges not queued.
+        {
+            std::lock_guard<std::mutex> lock(gStripeSender.Lock);
+            ReleaseStripeRanges(file, numberOfRanges - index);
+            file = NULL;
+        }
+    }
+
+    return status;
+} // StripeFileToServer()
+
+
+
+//
+// CompleteModifiesOnServer
+//
+SDSTATUS
+CompleteModifiesOnServer(
+    __inout MODIFY_PIPELINE     &Pipeline,
+    __in size_t                 MaxInFlight,
+    __in __int32                CltSock
+    )
+/*++
+Description: The routine completes the oldest MODIFY operations in flight, until at most MaxInFlight remain: it receives the answer
+of the server to each one, and sends the content (as an opMODIFYDATA operation) only if the server does not have it. The content is
+sent whole (see SendFileToServer(), or StripeFileToServer() if the server asks for ranges, "File Stripes", and data connections are
+open), as a delta (see SendDeltaToServer()) or as the missing chunks (see SendChunksToServer(); if the server finds few of them, it asks
+for the file in ranges instead, as for "File Stripes"), as the server asked. For "File Resume", only the content the server does
+not hold yet is sent, as for "File Stripes".
+Delta and chunk transfers start with data from the server (block signatures, chunk requests). The server sends it after the answers
+to all the MODIFY's sent before: these answers are received first.
+
+- Pipeline: Reference to the MODIFY operations in flight.
+- MaxInFlight: Number of operations that may stay in flight (0: complete all of them, and send the batch of small files).
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING is returned if some contents could not be sent
+(e.g. volatile files), as for the MODIFY's sent in the stop-and-wait way.
+--*/
+{
+    SDSTATUS        status;
+    SDSTATUS        transferStatus;
+    PENDING_MODIFY  *pending;
+    PACKET_OP       opData;
+    DWORD           requestIdNetwork;
+    DWORD           numberOfRangesNetOrder;
+    QWORD           contentSizeNetOrder;
+    BOOL            isStripeAsked;
+    BOOL            isTransferFailed;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    transferStatus = STATUS_FAIL;
+    pending = NULL;
+    requestIdNetwork = 0;
+    numberOfRangesNetOrder = 0;
+    contentSizeNetOrder = 0;
+    isStripeAsked = FALSE;
+    isTransferFailed = FALSE;
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+
+        //
+        // Main processing:
+        //
+
+
+        // Completing all of them: the batched small files go first (no answer to wait for).
+
+        if (0 == MaxInFlight)
+        {
+            status = SendModifyBatchToServer(Pipeline, CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: CompleteModifiesOnServer(): SendModifyBatchToServer() failed. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+
+        while (Pipeline.Pending.size() > MaxInFlight)
+        {
+            pending = &Pipeline.Pending.front();
+
+
+            // Receive the answers, up to the one of the oldest MODIFY.
+
+            while (FALSE == pending->IsReplyReceived)
+            {
+                status = RecvModifyReplyFromServer(Pipeline, CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: CompleteModifiesOnServer(): RecvModifyReplyFromServer() failed. Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+
+            if (0 == strcmp(pending->Reply, "File On Server"))
+            {
+                // Yes: File contents exist on server.
+                // ==> Do nothing. The server did a local copy.
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file on server' for [%s]. No action needed. \n", 
+                        pending->RelativePath.c_str());
+
+                ReleaseOldestPendingModify(Pipeline);
+                continue;
+            }
+            if (0 == strcmp(pending->Reply, "File Resume"))
+            {
+                // The server holds the start of the content (transfer interrupted in an earlier session).
+                // ==> Send the rest only, as for 'file stripes'.
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file resume' for [%s]: [%llu/%llu B] already received. \n", 
+                        pending->RelativePath.c_str(), (unsigned long long) pending->ResumeOffset, (unsigned long long) pending->FileSize);
+                snprintf(pending->Reply, SD_SHORT_MSG_SIZE, "File Stripes");
+            }
+            if (0 != strcmp(pending->Reply, "File Not On Server") && 0 != strcmp(pending->Reply, "File Stripes") && 
+                0 != strcmp(pending->Reply, "File Delta") && 0 != strcmp(pending->Reply, "File Chunks"))
+            {
+                printf("[SyncDir] Error: CompleteModifiesOnServer(): Unknown answer [%s] from server. Abandoning ...\n", pending->Reply);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+
+            // Delta and chunk transfers: receive the answers to all the MODIFY's in flight, which come before the transfer data.
+
+            if (0 != strcmp(pending->Reply, "File Not On Server") && 0 != strcmp(pending->Reply, "File Stripes"))
+            {
+                while (FALSE == Pipeline.Pending.back().IsReplyReceived)
+                {
+                    status = RecvModifyReplyFromServer(Pipeline, CltSock);
+                    if (!(SUCCESS(status)))
+                    {
+                        printf("[SyncDir] Error: CompleteModifiesOnServer(): RecvModifyReplyFromServer() failed. Abandoning ...\n");
+                        status = STATUS_FAIL;
+                        throw SyncDirException();
+                    }
+                }
+            }
+
+
+            // The file was not opened (content expected on the server, see QueryContentsOnServer()): open it now.
+
+            if (pending->FileDescriptor < 0 && NULL == pending->FileContent)
+            {
+                pending->FileDescriptor = open(pending->FullPath.c_str(), O_RDONLY | O_CLOEXEC);
+                if (pending->FileDescriptor < 0)
+                {
+                    perror("[SyncDir] Error: CompleteModifiesOnServer(): Error at file opening. Content not sent ...\n");
+                    isTransferFailed = TRUE;
+                    ReleaseOldestPendingModify(Pipeline);
+                    continue;
+                    // Just warning, for fault tolerance (volatile files). The server drops the request at disconnection.
+                }
+            }
+
+
+            // Announce the content: opMODIFYDATA, the file path, then the request ID (network byte order).
+
+            opData = pending->Operation;
+            opData.OperationType = opMODIFYDATA;
+            opData.RealRelativePathLength = 0;
+            opData.OldRelativePathLength = 0;
+
+            status = SendPacketOpAndFilePathToServer(&opData, (char*) pending->RelativePath.c_str(), CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: CompleteModifiesOnServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            requestIdNetwork = htonl(pending->RequestId);
+            status = SendBufferToServer(&requestIdNetwork, sizeof(DWORD), CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: CompleteModifiesOnServer(): Error at sending to server (request ID). Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+
+            // Send the content, as the server asked. If few chunks are on the server, it asks for the file in ranges instead.
+
+            if (0 == strcmp(pending->Reply, "File Chunks"))
+            {
+                // The server may have parts of the content, in any of its files.
+                // ==> Send only the chunks it does not have.
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file chunks'. Preparing to send the missing chunks ... \n");
+
+                transferStatus = SendChunksToServer(pending->FileSize, pending->FileDescriptor, pending->FileContent, CltSock, 
+                                                    &isStripeAsked);
+                if (!(SUCCESS(transferStatus)))
+                {
+                    printf("[SyncDir] Error: CompleteModifiesOnServer(): SendChunksToServer() failed.\n");
+                    isTransferFailed = TRUE;
+                    // Just warning, for fault tolerance (as for SendFileToServer()).
+                }
+                else if (TRUE == isStripeAsked)
+                {
+                    snprintf(pending->Reply, SD_SHORT_MSG_SIZE, "File Stripes");
+                }
+            }
+            if (0 == strcmp(pending->Reply, "File Stripes") && !gStripeSender.Connections.empty())
+            {
+                // No: File does not exist on server. The server takes it over the data connections.
+                // ==> Send file, in ranges over the data connections.
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file stripes'. Sending file over the data connections ... \n");
+
+                status = StripeFileToServer(Pipeline, CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: CompleteModifiesOnServer(): StripeFileToServer() failed. Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                    // The server waits for the ranges: the session cannot go on.
+                }
+            }
+            else if (0 == strcmp(pending->Reply, "File Stripes"))
+            {
+                // No: File does not exist on server. But no data connection was opened on this side.
+                // ==> Send file, on the control connection (no ranges).
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file stripes'. Preparing to send file (no data connections) ... \n");
+
+                numberOfRangesNetOrder = 0;
+                status = SendBufferToServer(&numberOfRangesNetOrder, sizeof(DWORD), CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: CompleteModifiesOnServer(): Error at sending to server (number of ranges). Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+
+                contentSizeNetOrder = htobe64(pending->FileSize - pending->ResumeOffset);
+                status = SendBufferToServer(&contentSizeNetOrder, sizeof(QWORD), CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: CompleteModifiesOnServer(): Error at sending to server (content size). Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+
+                transferStatus = SendFileRangeToServer(pending->ResumeOffset, pending->FileSize - pending->ResumeOffset, 
+                                                       pending->FileDescriptor, pending->FileContent, CltSock);
+                if (!(SUCCESS(transferStatus)))
+                {
+                    printf("[SyncDir] Error: CompleteModifiesOnServer(): SendFileRangeToServer() failed.\n");
+                    isTransferFailed = TRUE;
+                    // Just warning, for fault tolerance.
+                }
+            }
+            else if (0 == strcmp(pending->Reply, "File Not On Server"))      
+            {
+                // No: File does not exist on server.
+                // ==> Send file.
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file not on server'. Preparing to send file ... \n");
+
+                transferStatus = SendFileToServer(pending->FileSize, pending->FileDescriptor, pending->FileContent, CltSock);
+                if (!(SUCCESS(transferStatus)))
+                {
+                    printf("[SyncDir] Error: CompleteModifiesOnServer(): SendFileToServer() failed.\n");
+                    isTransferFailed = TRUE;
+                    // Just warning, for fault tolerance. Sending files can be interrupted if files are volatile (e.g. temporary, backup).
+                }
+            }
+            if (0 == strcmp(pending->Reply, "File Delta"))
+            {
+                // The server has an older copy of the file.
+                // ==> Send only the differences.
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file delta'. Preparing to send the differences ... \n");
+
+                transferStatus = SendDeltaToServer(pending->FileSize, pending->FileDescriptor, pending->FileContent, CltSock);
+                if (!(SUCCESS(transferStatus)))
+                {
+                    printf("[SyncDir] Error: CompleteModifiesOnServer(): SendDeltaToServer() failed.\n");
+                    isTransferFailed = TRUE;
+                    // Just warning, for fault tolerance (as for SendFileToServer()).
+                }
+            }
+
+            ReleaseOldestPendingModify(Pipeline);
+        }
+
+
+        // If here, everything is ok.
+        status = (TRUE == isTransferFailed) ? STATUS_WARNING : STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: CompleteModifiesOnServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: CompleteModifiesOnServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        // Nothing to clean for the moment. The caller releases the pipeline (see ReleaseModifyPipeline()).
+    }
+
+    return status;
+} // CompleteModifiesOnServer()
+
+
+
+//
+// ReleaseModifyPipeline
+//
+void
+ReleaseModifyPipeline(
+    __inout MODIFY_PIPELINE &Pipeline
+    )
+/*++
+Description: The routine drops all the MODIFY operations in flight (e.g. after a failure), closing their files and freeing their 
+contents, and the batch of small files. Nothing is sent to the server.
+
+- Pipeline: Reference to the MODIFY operations in flight.
+
+Return value: None.
+--*/
+{
+    while (!Pipeline.Pending.empty())
+    {
+        ReleaseOldestPendingModify(Pipeline);
+    }
+    Pipeline.ContentBytes = 0;
+    Pipeline.Batch.clear();
+    Pipeline.BatchEntries = 0;
+    Pipeline.BatchPaths.clear();
+} // ReleaseModifyPipeline()
+
+
+
+
+//
+// SendModifyToServer
+//
+SDSTATUS
+SendModifyToServer(
+    __in PACKET_OP  *OpToSend,
+    __in char       *FileRelativePath,
+    __in char       *FileFullPath,
+    __in QWORD                  FileSize,
+    __in_opt const char         *HashCodeOnServer,
+    __inout MODIFY_PIPELINE     &Pipeline,
+    __in __int32                CltSock
+    )
+/*++
+Description: The routine sends a file modify operation to a server address.
+Together with the operation information (OpToSend), the routine sends the relative path (FileRelativePath) and the full 
+path (FileFullPath) of the file concerned by the operation.
+The routine does not wait for the answer of the server: the operation stays in flight (in Pipeline), and its content is sent later, 
+by CompleteModifiesOnServer(), only if the server does not have it. Up to SD_CLT_PIPELINE_WINDOW operations are kept in flight.
+The file is read once: its content is kept in memory (up to SD_CLT_SINGLE_PASS_BUFFER_LIMIT bytes) while the hash code is computed, 
+and the same bytes are sent if the server does not have the content already. Larger files are hashed, then read again from the same 
+open file only if the server does not have them. If the server has an older copy of the file, only the differences are sent (see 
+SendDeltaToServer()); otherwise, for large files, only the chunks the server does not have (see SendChunksToServer()).
+If the server holds the content already (HashCodeOnServer, see QueryContentsOnServer()) and the file did not change since it was 
+hashed, the file is not even opened.
+Small regular files the server does not hold are not sent as MODIFY's: they are added, with their contents, to the batch of the 
+pipeline (see AppendFileToModifyBatch()), sent by CompleteModifiesOnServer().
+
+- OpToSend: Pointer to the packet containing the operation information.
+- FileRelativePath: Pointer to the relative path of the file (relative to the main directory).
+- FileFullPath: Pointer to the full path of the file.
+- FileSize: Size of the file concerned by the operation (as known when the event was processed; the size actually sent is the 
+one read).
+- HashCodeOnServer: Hash code of the file content, if the server holds it (see QueryContentsOnServer()). NULL otherwise.
+- Pipeline: Reference to the MODIFY operations in flight. The operation is added to it.
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+{
+    SDSTATUS    status;
+    char        hashCode[SD_MAX_HASH_CODE_LENGTH + 1];
+    char        hashAndSize[SD_MAX_HASH_CODE_LENGTH + 1 + sizeof(QWORD) + sizeof(DWORD)];
+    DWORD       hashCodeLength;
+    QWORD       fileSizeNetwork;
+    DWORD       requestIdNetwork;
+    size_t      index;
+    PENDING_MODIFY pendingModify;
+    __int32     fileDescriptor;
+    BYTE        *fileContent;
+    QWORD       fileContentLength;
+    size_t      readSoFar;
+    ssize_t     readBytes;
+    struct stat fileStat;
+    struct stat fileStatAfterRead;
+    BOOL        isHashCached;
+    BOOL        isContentOnServer;
+    BOOL        isBatched;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    hashCode[0] = 0;
+    hashAndSize[0] = 0;
+    hashCodeLength = HashCodeLength(gHashAlgorithm);
+    fileSizeNetwork = 0;
+    requestIdNetwork = 0;
+    index = 0;
+    fileDescriptor = -1;
+    fileContent = NULL;
+    fileContentLength = 0;
+    readSoFar = 0;
+    readBytes = -1;
+    isHashCached = FALSE;
+    isContentOnServer = FALSE;
+    isBatched = FALSE;
+
+    // Parameter validation.
+
+    if (NULL == OpToSend)
+    {
+        printf("[SyncDir] Error: SendModifyToServer(): Invalid parameter 1. \n");
+        return STATUS_FAIL;        
+    }
+    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
+    {
+        printf("[SyncDir] Error: SendModifyToServer(): Invalid parameter 2. \n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileFullPath || 0 == FileFullPath[0])
+    {
+        printf("[SyncDir] Error: SendModifyToServer(): Invalid parameter 3. \n");
+        return STATUS_FAIL;
+    }
+
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+
+        //
+        // Main processing:
+        //
+
+
+        // Content held by the server: no need to open the file, if it did not change since it was hashed.
+
+        isContentOnServer = (NULL != HashCodeOnServer && 0 == lstat(FileFullPath, &fileStat) && S_ISREG(fileStat.st_mode) && 
+                             SUCCESS(HashCacheLookup(&fileStat, gHashAlgorithm, hashCode, &isHashCached)) && TRUE == isHashCached && 
+                             0 == strcmp(hashCode, HashCodeOnServer)) ? TRUE : FALSE;
+
+
+        // Otherwise, open the file (once, for both hashing and sending).
+
+        if (FALSE == isContentOnServer)
+        {
+            fileDescriptor = open(FileFullPath, O_RDONLY | O_CLOEXEC);
+            if (fileDescriptor < 0)
+            {
+                perror("[SyncDir] Error: SendModifyToServer(): Error at file opening. Skipping the operation ...\n");
+                status = STATUS_WARNING;
+                throw SyncDirException();
+                // Just warning, for fault tolerance. Nothing was sent yet, and volatile files (e.g. temporary) may vanish before hashing.
+            }
+
+
+            if (fstat(fileDescriptor, &fileStat) < 0)
+            {
+                perror("[SyncDir] Error: SendModifyToServer(): Error at fstat(). Skipping the operation ...\n");
+                status = STATUS_WARNING;
+                throw SyncDirException();
+            }
+        }
+
+
+        // Get hash of the file: from the hash cache, if the file identity did not change since it was hashed.
+
+        status = HashCacheLookup(&fileStat, gHashAlgorithm, hashCode, &isHashCached);
+        if (!(SUCCESS(status)))
+        {
+            isHashCached = FALSE;
+        }
+
+        if (TRUE == isHashCached)
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: SendModifyToServer(): Hash code found in the hash cache. \n");
+            fileContentLength = fileStat.st_size;
+        }
+        else
+        {
+            // Otherwise, hash the content. Keep the content read meanwhile, if small enough.
+
+            status = HashAndReadFileDescriptor(gHashAlgorithm, fileDescriptor, SD_CLT_SINGLE_PASS_BUFFER_LIMIT, &fileContent, 
+                                               &fileContentLength, hashCode);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendModifyToServer(): HashAndReadFileDescriptor() failed. Skipping the operation ...\n");
+                status = STATUS_WARNING;
+                throw SyncDirException();
+                // Just warning, for fault tolerance. Nothing was sent yet.
+            }
+
+            // Remember the hash code, only if the file did not change while being read.
+
+            if (S_ISREG(fileStat.st_mode) && 0 == fstat(fileDescriptor, &fileStatAfterRead) && 
+                TRUE == IsSameFileIdentity(&fileStat, &fileStatAfterRead) && (QWORD) fileStat.st_size == fileContentLength)
+            {
+                HashCacheStore(&fileStat, gHashAlgorithm, hashCode);
+            }
+        }
+        if (fileContentLength != FileSize)
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: SendModifyToServer(): File size changed meanwhile [%llu B -> %llu B]. \n", 
+                    (unsigned long long) FileSize, (unsigned long long) fileContentLength);
+        }
+
+
+        // Small regular file whose content the server does not hold: sent in the batch (see AppendFileToModifyBatch()), without a 
+        // MODIFY to answer. Not if the same content is in flight: the server will hold it (local copy).
+
+        isBatched = (ftNONDIR == OpToSend->FileType && S_ISREG(fileStat.st_mode) && fileContentLength <= SD_CLT_BATCH_MAX_FILE_SIZE && 
+                     (NULL == HashCodeOnServer || 0 != strcmp(hashCode, HashCodeOnServer))) ? TRUE : FALSE;
+
+        for (index = 0; TRUE == isBatched && index < Pipeline.Pending.size(); index ++)
+        {
+            if (0 == strcmp(Pipeline.Pending[index].HashCode, hashCode))
+            {
+                isBatched = FALSE;
+            }
+        }
+
+
+        // Keep the operations on a file in order: if a MODIFY of the same file is in flight, complete the pipeline up to it.
+        // Same for a MODIFY of the same content: the server then has it (local copy, instead of a transfer).
+
+        for (index = Pipeline.Pending.size(); index > 0; index --)
+        {
+            if (Pipeline.Pending[index - 1].RelativePath == FileRelativePath || 0 == strcmp(Pipeline.Pending[index - 1].HashCode, hashCode))
+            {
+                status = CompleteModifiesOnServer(Pipeline, Pipeline.Pending.size() - index, CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: SendModifyToServer(): CompleteModifiesOnServer() failed (same file or content). Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                break;
+            }
+        }
+
+
+        if (TRUE == isBatched)
+        {
+            // Content not read while hashing (hash cache): read it now, from the same open file.
+
+            if (NULL == fileContent)
+            {
+                fileContent = (BYTE*) malloc(fileContentLength + 1);
+                if (NULL == fileContent)
+                {
+                    printf("[SyncDir] Error: SendModifyToServer(): Memory allocation failed. Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                for (readSoFar = 0; readSoFar < fileContentLength; readSoFar += readBytes)
+                {
+                    readBytes = pread(fileDescriptor, fileContent + readSoFar, FileReadQuota(fileContentLength - readSoFar), readSoFar);
+                    if (readBytes <= 0)
+                    {
+                        break;
+                    }
+                }
+                if (readSoFar != fileContentLength)
+                {
+                    perror("[SyncDir] Error: SendModifyToServer(): Error at file reading (file changed meanwhile?). Skipping the operation ...\n");
+                    status = STATUS_WARNING;
+                    throw SyncDirException();
+                    // Just warning, for fault tolerance. Nothing was sent yet.
+                }
+            }
+
+            status = AppendFileToModifyBatch(Pipeline, FileRelativePath, hashCode, fileContent, (DWORD) fileContentLength, CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendModifyToServer(): AppendFileToModifyBatch() failed. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+        else
+        {
+            // Keep the operations on a file in order: a batch holding the same file is sent first.
+
+            if (Pipeline.BatchPaths.end() != Pipeline.BatchPaths.find(FileRelativePath))
+            {
+                status = SendModifyBatchToServer(Pipeline, CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: SendModifyToServer(): SendModifyBatchToServer() failed (same file). Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+
+
+            // Make room in the pipeline: complete the oldest MODIFY's if the window is full, or if they hold too much memory.
+
+            while (Pipeline.Pending.size() >= SD_CLT_PIPELINE_WINDOW || 
+                   (NULL != fileContent && !Pipeline.Pending.empty() && 
+                    Pipeline.ContentBytes + fileContentLength > (QWORD) SD_CLT_PIPELINE_MEMORY_LIMIT))
+            {
+                status = CompleteModifiesOnServer(Pipeline, Pipeline.Pending.size() - 1, CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: SendModifyToServer(): CompleteModifiesOnServer() failed. Abandoning ...\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+
+
+            // Send first 2 information to server:
+            // - operation info
+            // - file path
+        
+            status = SendPacketOpAndFilePathToServer(OpToSend, FileRelativePath, CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendModifyToServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+
+            // Send hash to server (hash code of the negotiated algorithm, including '\0'), then the file size (QWORD) and the request 
+            // ID (network byte order). One message: the server answers only after all of them.
+
+            memcpy(hashAndSize, hashCode, hashCodeLength + 1);
+            fileSizeNetwork = htobe64(fileContentLength);
+            memcpy(hashAndSize + hashCodeLength + 1, &fileSizeNetwork, sizeof(QWORD));
+            requestIdNetwork = htonl(Pipeline.NextRequestId);
+            memcpy(hashAndSize + hashCodeLength + 1 + sizeof(QWORD), &requestIdNetwork, sizeof(DWORD));
+
+            status = SendBufferToServer(hashAndSize, hashCodeLength + 1 + sizeof(QWORD) + sizeof(DWORD), CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: SendModifyToServer(): Error at sending to server (hash code, file size, request ID). Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();  
+            }
+
+
+            // Do not wait for the answer: the operation stays in flight. The pipeline takes over the open file and its content.
+
+            pendingModify.RequestId = Pipeline.NextRequestId;
+            pendingModify.Operation = *OpToSend;
+            pendingModify.RelativePath.assign(FileRelativePath);
+            pendingModify.FullPath.assign(FileFullPath);
+            memcpy(pendingModify.HashCode, hashCode, sizeof(pendingModify.HashCode));
+            pendingModify.FileDescriptor = fileDescriptor;
+            pendingModify.FileContent = fileContent;
+            pendingModify.FileSize = fileContentLength;
+            pendingModify.IsReplyReceived = FALSE;
+            pendingModify.Reply[0] = 0;
+            pendingModify.ResumeOffset = 0;
+
+            Pipeline.Pending.push_back(pendingModify);
+            Pipeline.NextRequestId ++;
+            if (NULL != fileContent)
+            {
+                Pipeline.ContentBytes = Pipeline.ContentBytes + fileContentLength;
+            }
+            fileDescriptor = -1;
+            fileContent = NULL;
+        }
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SendModifyToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SendModifyToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        free(fileContent);
+        fileContent = NULL;
+        if (fileDescriptor >= 0)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+    }
+    else
+    {
+        free(fileContent);
+        fileContent = NULL;
+        if (fileDescriptor >= 0)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+    }
+
+    return status;
+} // SendModifyToServer()
+
+
+
+//
+// SendDeleteToServer
+//
+SDSTATUS
+SendDeleteToServer(
+    __in PACKET_OP  *OpToSend,
+    __in char       *FileRelativePath,
+    __in __int32    CltSock
+    )
+/*++
+Description: The routine sends a file delete operation to a server address.
+Together with the operation information (OpToSend), the routine sends the new relative path (FileRelativePath) of the file 
+concerned by the operation.
+
+- OpToSend: Pointer to the packet containing the operation information.
+- FileRelativePath: Pointer to the relative path of the file.
+- CltSock: Descriptor representing the socket connection with the SyncDir server application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+{
+    SDSTATUS status;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+
+    // Parameter validation.
+
+    if (NULL == OpToSend)
+    {
+        printf("[SyncDir] Error: SendDeleteToServer(): Invalid parameter 1. \n");
+        return STATUS_FAIL;        
+    }
+    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
+    {
+        printf("[SyncDir] Error: SendDeleteToServer(): Invalid parameter 2. \n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+
         // Main processing:
-        //
+
+        // Send first 2 information to server:
+        // - operation info
+        // - file path
+
+        status = SendPacketOpAndFilePathToServer(OpToSend, FileRelativePath, CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SendDeleteToServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }           
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SendDeleteToServer(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SendDeleteToServer(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        // Nothing to clean for the moment.
+    }
+
+    return status;
+} // SendDeleteToServer()
+
+
+
+//
+// InitOperationPacket
+//
+SDSTATUS
+InitOperationPacket(
+    __out PACKET_OP *Packet
+    )
+/*++
+Description: The routine initializes to neutral values a PACKET_OP structure.
+
+- Packet: Pointer to the structure to be initialized. The caller provides the structure space.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS status;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+
+    // Parameter validation.
+
+    if (NULL == Packet)
+    {
+        printf("[SyncDir] Error: InitOperationPacket(): Invalid parameter 1. \n");        
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+
+        // Main processing:
+
+        // Set a "preinit" value for each field of the packet.
+
+        Packet->OperationType = opUNKNOWN;
+        Packet->FileType = ftUNKNOWN;
+        Packet->RelativePathLength = 0;
+        Packet->RealRelativePathLength = 0;
+        Packet->OldRelativePathLength = 0;
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: InitOperationPacket(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: InitOperationPacket(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
 
 
-        // Get hash of the file.
-        
-        status = MD5HashOfFile(FileFullPath, md5Hash);
-        if (!(SUCCESS(status)))
-        {
-            perror("[SyncDir] Error: SendModifyToServer(): MD5HashOfFile() failed.\n");
-            status = STATUS_FAIL;
-            throw SyncDirException();
-        }
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        // Nothing to clean for the moment.
+    }
 
+    return status;
+} // InitOperationPacket()
 
-        // Send first 2 information to server:
-        // - operation info
-        // - file path
-        
-        status = SendPacketOpAndFilePathToServer(OpToSend, FileRelativePath, CltSock);
-        if (!(SUCCESS(status)))
-        {
-            printf("[SyncDir] Error: SendModifyToServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
-            status = STATUS_FAIL;
-            throw SyncDirException();
-        }
 
 
-        // Send hash to server.
-        
-        sentBytes = send(CltSock, md5Hash, SD_HASH_CODE_LENGTH + 1, 0);
-        if (SD_HASH_CODE_LENGTH + 1 != sentBytes)
-        {
-            if (sentBytes < 0)        
-            {
-                perror("[SyncDir] Error: SendModifyToServer(): Error at sending to server (MD5 hash). Abandoning ...\n");
-            }
-            else
-            {
-                printf("[SyncDir] Error: SendModifyToServer(): Numbers of sent/to-send bytes do not match (MD5 hash).\n");
-            }            
-            status = STATUS_FAIL;
-            throw SyncDirException();  
-        }
+//
+// PreprocessEventFileInfosBeforeSending
+//
+SDSTATUS
+PreprocessEventFileInfosBeforeSending(
+    __inout std::unordered_map<std::string, FILE_INFO>      &FileInfoHMap,
+    __out std::set<DWORD>                                   &SetOfDepths  
+    )
+/*++
+Description: The routine performs a preprocessing of the file information related to events, that is found in the FileInfoHMap
+structure. As a result, the routine outputs a set containing the depth of each FileInfo's associated file (depth in the watch tree 
+that monitors the system directories).
 
+- FileInfoHMap: Reference to the hash map containing the file information related to events (i.e. FILE_INFO structures).
+- SetOfDepths: Reference to the set of depths filled by the routine. Caller provided.
 
-        // Receive answer from server: File content exists already on server ?
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS status;
+    FILE_INFO *fileInfo;
 
-        recvReturn = recv(CltSock, bufferIn, SD_SHORT_MSG_SIZE, 0);
-        if (recvReturn < 0)        
-        {
-            perror("[SyncDir] Error: SendModifyToServer(): Error at receiving from server. Abandoning ...\n");
-            status = STATUS_FAIL;
-            throw SyncDirException();
-        }
-        if (0 == strcmp(bufferIn, "File On Server"))
-        {
-            // Yes: File contents exist on server.
-            // ==> Do nothing. The server will do a local copy.
-            fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file on server'. No action needed. \n");
-        }
-        if (0 == strcmp(bufferIn, "File Not On Server"))      
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    fileInfo = NULL;
+
+    // Parameter validation.
+
+    if (FileInfoHMap.size() <= 0)
+    {
+        printf("[SyncDir] Error: PreprocessEventFileInfosBeforeSending(): Invalid parameter 1. \n");
+        return STATUS_FAIL;
+    }
+    if (0 != SetOfDepths.size())
+    {
+        printf("[SyncDir] Error: PreprocessEventFileInfosBeforeSending(): Invalid parameter 1. \n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+
+        // 
+        // Main processing:
+        //
+
+        // Collect the depths of all the FileInfo parent nodes in the watch tree.
+
+        for (auto it = FileInfoHMap.begin(); it != FileInfoHMap.end(); it ++)
         {
-            // No: File does not exist on server.
-            // ==> Send file.
-            fprintf(g_SD_STDLOG, "[SyncDir] Info: Server replied 'file not on server'. Preparing to send file ... \n");
-            
-            status = SendFileToServer(FileSize, FileFullPath, CltSock);
-            if (!(SUCCESS(status)))
+            fileInfo = &(it->second);
+
+            if (ftDIRECTORY == fileInfo->FileType)
             {
-                printf("[SyncDir] Error: SendModifyToServer(): SendFileToServer() failed.\n");
-                status = STATUS_WARNING;
-                throw SyncDirException();
-                // Just warning, for fault tolerance. Sending files can be interrupted if files are volatile (e.g. temporary, backup).
+                SetOfDepths.insert(1 + fileInfo->WatchNodeOfParent->Depth);
             }
+
+
+            // Note: The following action (setting WasDeleted for the "moved from" FileInfos) is commented because it is now performed
+            //  directly when updating the server (step 3, in Main Processing, at SendAllFileInfoEventsToServer() ).
+
+            // // Mark "deleted" all FileInfo's of MOVED_FROM operations (i.e. moved outside of SyncDir main directory).
+            // if ( TRUE == fileInfo->WasMovedFromOnly && 0 != fileInfo->MovementCookie )      // If moved outside of the main directory.
+            // {
+            //    fileInfo->WasDeleted = TRUE;
+            // }
         }
 
 
@@ -921,12 +4647,12 @@ was achieved, but related issues were encountered (information is logged, thereb
     }
     __catch (const std::exception &e)
     {
-        cout << "[SyncDir] Error: SendModifyToServer(): Standard Exception caught: " << e.what() << "\n";        
+        cout << "[SyncDir] Error: PreprocessEventFileInfosBeforeSending(): Standard Exception caught: " << e.what() << "\n";        
         status = STATUS_FAIL;
     }
     __catch (...)
     {
-        printf("[SyncDir] Error: SendModifyToServer(): Unkown exception.\n");
+        printf("[SyncDir] Error: PreprocessEventFileInfosBeforeSending(): Unkown exception.\n");
         status = STATUS_FAIL;
     }
 
@@ -942,71 +4668,281 @@ was achieved, but related issues were encountered (information is logged, thereb
     }
 
     return status;
-} // SendModifyToServer()
+} // PreprocessEventFileInfosBeforeSending()
 
 
 
 //
-// SendDeleteToServer
+// IsModifyOfFileInfo
+//
+static BOOL
+IsModifyOfFileInfo(
+    __in const FILE_INFO *FileInfo
+    )
+/*++
+Description: The routine tells if the events of a FileInfo are sent as a MODIFY (possibly after a MOVE), see 
+SendAllFileInfoEventsToServer().
+--*/
+{
+    if (TRUE == FileInfo->WasDeleted || TRUE == FileInfo->WasMovedFromOnly || ftDIRECTORY == FileInfo->FileType)
+    {
+        return FALSE;
+    }
+    if (TRUE == FileInfo->WasMovedFromAndTo)
+    {
+        return FileInfo->WasModified;
+    }
+    return (TRUE == FileInfo->WasMovedToOnly || TRUE == FileInfo->WasModified) ? TRUE : FALSE;
+} // IsModifyOfFileInfo()
+
+
+
+//
+// IsBatchedCreateOfFileInfo
+//
+static BOOL
+IsBatchedCreateOfFileInfo(
+    __in const FILE_INFO *FileInfo
+    )
+/*++
+Description: The routine tells if the events of a FileInfo are sent as the creation of an empty regular file, in the batch of small
+files (see AppendFileToModifyBatch()), instead of a CREATE.
+--*/
+{
+    return (0 != SD_CLT_BATCH_MAX_FILE_SIZE && ftNONDIR == FileInfo->FileType && TRUE == FileInfo->WasCreated && 
+            FALSE == FileInfo->WasDeleted && FALSE == FileInfo->WasMovedFromOnly && FALSE == FileInfo->WasMovedToOnly && 
+            FALSE == FileInfo->WasMovedFromAndTo && FALSE == FileInfo->WasModified) ? TRUE : FALSE;
+} // IsBatchedCreateOfFileInfo()
+
+
+
+//
+// QueryContentsOnServer
 //
 SDSTATUS
-SendDeleteToServer(
-    __in PACKET_OP  *OpToSend,
-    __in char       *FileRelativePath,
-    __in __int32    CltSock
+QueryContentsOnServer(
+    __in char                                               *MainDirFullPath,
+    __inout std::unordered_map<std::string, FILE_INFO>      &FileInfoHMap,
+    __in __int32                                            CltSock
     )
 /*++
-Description: The routine sends a file delete operation to a server address.
-Together with the operation information (OpToSend), the routine sends the new relative path (FileRelativePath) of the file 
-concerned by the operation.
+Description: The routine asks the server, in one message, which of the contents to be sent by MODIFY's it already holds (see 
+PACKET_HASH_QUERY_HEADER), and sets the HashCode and IsContentOnServer fields of the FileInfo's accordingly.
+Only the hash codes known without reading the files are sent: the ones of the hash cache. The small regular files not found in the 
+cache are hashed first, together (see HashCachePrehashFiles()). The MODIFY's of the contents held by the server are then sent 
+without opening the files (see SendModifyToServer()).
 
-- OpToSend: Pointer to the packet containing the operation information.
-- FileRelativePath: Pointer to the relative path of the file.
+- MainDirFullPath: Pointer to the full path of the main directory monitored by SyncDir client application.
+- FileInfoHMap: Reference to the hash map containing the file information related to system events.
 - CltSock: Descriptor representing the socket connection with the SyncDir server application.
 
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
-was achieved, but related issues were encountered (information is logged, thereby).
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
 --*/
 {
-    SDSTATUS status;
+    SDSTATUS                    status;
+    PACKET_OP                   opToSend;
+    PACKET_HASH_QUERY_HEADER    queryHeader;
+    char                        fileFullPath[SD_MAX_PATH_LENGTH];
+    char                        hashCode[SD_MAX_HASH_CODE_LENGTH + 1];
+    char                        queryPath[] = "./";
+    const char                  *prehashFileFullPaths[SD_HASH_BATCH_SIZE];
+    DWORD                       numberOfPrehashFiles;
+    DWORD                       hashCodeLength;
+    DWORD                       itemSize;
+    QWORD                       fileSizeNetwork;
+    DWORD                       numberOfHashes;
+    DWORD                       numberOfHits;
+    BYTE                        *queryBuffer;
+    BYTE                        *bitmap;
+    ssize_t                     recvBytes;
+    BOOL                        isHashCached;
+    size_t                      i;
+    size_t                      first;
+    struct stat                 fileStat;
+    struct timespec             now;
+    std::vector<FILE_INFO*>     fileInfos;
+    std::vector<struct stat>    fileStats;
+    std::vector<std::string>    fileFullPaths;
+    std::vector<FILE_INFO*>     queriedFileInfos;
 
     // PREINIT.
 
     status = STATUS_FAIL;
+    fileFullPath[0] = 0;
+    hashCode[0] = 0;
+    numberOfPrehashFiles = 0;
+    hashCodeLength = HashCodeLength(gHashAlgorithm);
+    itemSize = hashCodeLength + 1 + sizeof(QWORD);
+    fileSizeNetwork = 0;
+    numberOfHashes = 0;
+    numberOfHits = 0;
+    queryBuffer = NULL;
+    bitmap = NULL;
+    isHashCached = FALSE;
 
     // Parameter validation.
 
-    if (NULL == OpToSend)
-    {
-        printf("[SyncDir] Error: SendDeleteToServer(): Invalid parameter 1. \n");
-        return STATUS_FAIL;        
-    }
-    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
+    if (NULL == MainDirFullPath || 0 == MainDirFullPath[0])
     {
-        printf("[SyncDir] Error: SendDeleteToServer(): Invalid parameter 2. \n");
+        printf("[SyncDir] Error: QueryContentsOnServer(): Invalid parameter 1.\n");
         return STATUS_FAIL;
     }
 
 
-    __try
-    {
-        // INIT.
-        // --
+    __try
+    {
+        // INIT.
+        // --
+
+
+        //
+        // Main processing:
+        //
+
+
+        // The regular files of the MODIFY's.
+
+        for (auto &it : FileInfoHMap)
+        {
+            it.second.IsContentOnServer = FALSE;
+
+            if (FALSE == IsModifyOfFileInfo(&it.second))
+            {
+                continue;
+            }
+
+            sprintf(fileFullPath, "%s/%s", MainDirFullPath, it.second.RelativePath + 2);                   // +2 to skip "./" 
+            if (lstat(fileFullPath, &fileStat) < 0 || !S_ISREG(fileStat.st_mode))
+            {
+                continue;
+            }
+
+            it.second.FileSize = fileStat.st_size;                                                          // Cost, for the schedule.
+            fileInfos.push_back(&it.second);
+            fileStats.push_back(fileStat);
+            fileFullPaths.push_back(fileFullPath);
+        }
+
+
+        // Hash the small files not found in the hash cache, together. Skip the files modified too recently to be cached.
+
+        clock_gettime(CLOCK_REALTIME, &now);
+
+        for (i = 0; i < fileInfos.size() && TRUE == HashCacheIsOpen(); i ++)
+        {
+            if (SD_HASH_BATCH_MAX_FILE_SIZE >= fileStats[i].st_size && 
+                (QWORD) (now.tv_sec - fileStats[i].st_mtim.tv_sec) * 1000000000ULL > SD_HASH_CACHE_RACY_WINDOW_NS + 1000000000ULL &&
+                SUCCESS(HashCacheLookup(&fileStats[i], gHashAlgorithm, hashCode, &isHashCached)) && FALSE == isHashCached)
+            {
+                prehashFileFullPaths[numberOfPrehashFiles] = fileFullPaths[i].c_str();
+                numberOfPrehashFiles ++;
+            }
+            if (SD_HASH_BATCH_SIZE == numberOfPrehashFiles || (i + 1 == fileInfos.size() && 0 < numberOfPrehashFiles))
+            {
+                if (!(SUCCESS(HashCachePrehashFiles(gHashAlgorithm, numberOfPrehashFiles, prehashFileFullPaths))))
+                {
+                    printf("[SyncDir] Warning: QueryContentsOnServer(): HashCachePrehashFiles() failed. Continuing execution...\n");
+                }
+                numberOfPrehashFiles = 0;
+            }
+        }
+
+
+        // Query the server, for the hash codes of the cache. At most SD_HASH_QUERY_MAX_HASHES per message.
+
+        queryBuffer = (BYTE*) malloc(sizeof(PACKET_HASH_QUERY_HEADER) + SD_MIN(fileInfos.size(), (size_t) SD_HASH_QUERY_MAX_HASHES) * itemSize);
+        bitmap = (BYTE*) malloc((SD_MIN(fileInfos.size(), (size_t) SD_HASH_QUERY_MAX_HASHES) + 7) / 8 + 1);
+        if (NULL == queryBuffer || NULL == bitmap)
+        {
+            printf("[SyncDir] Error: QueryContentsOnServer(): Memory allocation failed.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        for (first = 0; first < fileInfos.size(); )
+        {
+            numberOfHashes = 0;
+            queriedFileInfos.clear();
+
+            for (i = first; i < fileInfos.size() && SD_HASH_QUERY_MAX_HASHES > numberOfHashes; i ++)
+            {
+                if (!(SUCCESS(HashCacheLookup(&fileStats[i], gHashAlgorithm, fileInfos[i]->HashCode, &isHashCached))) || 
+                    FALSE == isHashCached)
+                {
+                    fileInfos[i]->HashCode[0] = 0;
+                    continue;
+                }
+
+                memcpy(queryBuffer + sizeof(PACKET_HASH_QUERY_HEADER) + numberOfHashes * itemSize, fileInfos[i]->HashCode, hashCodeLength + 1);
+                fileSizeNetwork = htobe64((QWORD) fileStats[i].st_size);
+                memcpy(queryBuffer + sizeof(PACKET_HASH_QUERY_HEADER) + numberOfHashes * itemSize + hashCodeLength + 1, &fileSizeNetwork, 
+                       sizeof(QWORD));
+                queriedFileInfos.push_back(fileInfos[i]);
+                numberOfHashes ++;
+            }
+            first = i;
+
+            if (0 == numberOfHashes)
+            {
+                continue;
+            }
+
+
+            // Send the operation, then the header and the items (one message).
+
+            status = InitOperationPacket(&opToSend);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: QueryContentsOnServer(): Failed to execute InitOperationPacket(). Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            opToSend.OperationType = opHASHQUERY;
+            opToSend.FileType = ftDIRECTORY;
+            opToSend.RelativePathLength = strlen(queryPath);
+
+            status = SendPacketOpAndFilePathToServer(&opToSend, queryPath, CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: QueryContentsOnServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            queryHeader.NumberOfHashes = htonl(numberOfHashes);
+            memcpy(queryBuffer, &queryHeader, sizeof(queryHeader));
+
+            status = SendBufferToServer(queryBuffer, sizeof(PACKET_HASH_QUERY_HEADER) + numberOfHashes * itemSize, CltSock);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: QueryContentsOnServer(): Error at sending the hash codes to server. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
 
+            // Receive the bitmap.
 
-        // Main processing:
+            recvBytes = recv(CltSock, bitmap, (numberOfHashes + 7) / 8, MSG_WAITALL);
+            if ((ssize_t) ((numberOfHashes + 7) / 8) != recvBytes)
+            {
+                perror("[SyncDir] Error: QueryContentsOnServer(): Error at receiving the bitmap from server. Abandoning ...\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
 
-        // Send first 2 information to server:
-        // - operation info
-        // - file path
+            for (i = 0; i < numberOfHashes; i ++)
+            {
+                if (0 != (bitmap[i / 8] & (1 << (i % 8))))
+                {
+                    queriedFileInfos[i]->IsContentOnServer = TRUE;
+                    numberOfHits ++;
+                }
+            }
+        }
 
-        status = SendPacketOpAndFilePathToServer(OpToSend, FileRelativePath, CltSock);
-        if (!(SUCCESS(status)))
-        {
-            printf("[SyncDir] Error: SendDeleteToServer(): Error at 1st or 2nd send to server. Abandoning ...\n");
-            status = STATUS_FAIL;
-            throw SyncDirException();
-        }           
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: QueryContentsOnServer(): [%u/%zu] contents of the MODIFY's already on the server. \n", 
+                numberOfHits, fileInfos.size());
 
 
         // If here, everything is ok.
@@ -1020,12 +4956,12 @@ was achieved, but related issues were encountered (information is logged, thereb
     }
     __catch (const std::exception &e)
     {
-        cout << "[SyncDir] Error: SendDeleteToServer(): Standard Exception caught: " << e.what() << "\n";        
+        cout << "[SyncDir] Error: QueryContentsOnServer(): Standard Exception caught: " << e.what() << "\n";        
         status = STATUS_FAIL;
     }
     __catch (...)
     {
-        printf("[SyncDir] Error: SendDeleteToServer(): Unkown exception.\n");
+        printf("[SyncDir] Error: QueryContentsOnServer(): Unkown exception.\n");
         status = STATUS_FAIL;
     }
 
@@ -1033,208 +4969,215 @@ was achieved, but related issues were encountered (information is logged, thereb
     // UNINIT. Cleanup.
     if (SUCCESS(status))
     {
-        // Nothing to clean for the moment.
+        free(queryBuffer);
+        queryBuffer = NULL;
+        free(bitmap);
+        bitmap = NULL;
     }
     else
     {
-        // Nothing to clean for the moment.
+        free(queryBuffer);
+        queryBuffer = NULL;
+        free(bitmap);
+        bitmap = NULL;
     }
 
     return status;
-} // SendDeleteToServer()
+} // QueryContentsOnServer()
+
 
 
 
 //
-// InitOperationPacket
+// LoadPathPriorities
 //
-SDSTATUS
-InitOperationPacket(
-    __out PACKET_OP *Packet
+static void
+LoadPathPriorities(
+    __in char                           *MainDirFullPath,
+    __out std::vector<PATH_PRIORITY>    &PathPriorities
     )
 /*++
-Description: The routine initializes to neutral values a PACKET_OP structure.
-
-- Packet: Pointer to the structure to be initialized. The caller provides the structure space.
-
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+Description: The routine reads the path priorities file (<main directory><SD_CLT_PRIORITIES_SUFFIX>), if any: one "<priority> <path>"
+line per path (relative to the main directory; a file, or a directory and everything below it). Lines starting with '#' are 
+comments. Without the file, all the paths have the priority 0. The file is read at every sending of the events, so that it can be
+changed at any time.
 --*/
 {
-    SDSTATUS status;
-
-    // PREINIT.
-
-    status = STATUS_FAIL;
+    FILE            *prioritiesFile;
+    char            prioritiesFullPath[SD_MAX_PATH_LENGTH];
+    char            line[SD_MAX_PATH_LENGTH + 32];
+    char            *path;
+    char            *end;
+    long            priority;
+    PATH_PRIORITY   pathPriority;
 
-    // Parameter validation.
+    PathPriorities.clear();
 
-    if (NULL == Packet)
+    if (0 == SD_CLT_PRIORITIES_SUFFIX[0] || 0 == strcmp(MainDirFullPath, "/"))
     {
-        printf("[SyncDir] Error: InitOperationPacket(): Invalid parameter 1. \n");        
-        return STATUS_FAIL;
+        return;
     }
 
-
-    __try
+    snprintf(prioritiesFullPath, SD_MAX_PATH_LENGTH, "%s%s", MainDirFullPath, SD_CLT_PRIORITIES_SUFFIX);
+    prioritiesFile = fopen(prioritiesFullPath, "r");
+    if (NULL == prioritiesFile)
     {
-        // INIT.
-        // --
-
-
-        // Main processing:
+        return;                                                     // No priorities declared.
+    }
 
-        // Set a "preinit" value for each field of the packet.
+    while (NULL != fgets(line, sizeof(line), prioritiesFile))
+    {
+        line[strcspn(line, "\r\n")] = 0;
 
-        Packet->OperationType = opUNKNOWN;
-        Packet->FileType = ftUNKNOWN;
-        Packet->RelativePathLength = 0;
-        Packet->RealRelativePathLength = 0;
-        Packet->OldRelativePathLength = 0;
+        priority = strtol(line, &end, 10);
+        path = end + strspn(end, " \t");
+        if ('#' == line[strspn(line, " \t")] || end == line || path == end || 0 == path[0])
+        {
+            continue;                                               // Comment, empty or invalid line.
+        }
 
+        // Same form as the relative paths of the FileInfo's: "./<path>", no trailing '/'.
 
-        // If here, everything is ok.
-        status = STATUS_SUCCESS;
+        if (0 == strncmp(path, "./", 2))
+        {
+            path = path + 2;
+        }
+        pathPriority.RelativePath = std::string("./") + path;
+        while (2 < pathPriority.RelativePath.size() && '/' == pathPriority.RelativePath.back())
+        {
+            pathPriority.RelativePath.pop_back();
+        }
+        pathPriority.Priority = (__int32) SD_MAX(SD_MIN(priority, (long) INT32_MAX), (long) INT32_MIN);
 
-    } // --> __try
-    __catch (const SyncDirException &e)
-    {
-        cout << e.what() << "\n";        
-        //status = STATUS_FAIL;
-    }
-    __catch (const std::exception &e)
-    {
-        cout << "[SyncDir] Error: InitOperationPacket(): Standard Exception caught: " << e.what() << "\n";        
-        status = STATUS_FAIL;
-    }
-    __catch (...)
-    {
-        printf("[SyncDir] Error: InitOperationPacket(): Unkown exception.\n");
-        status = STATUS_FAIL;
+        PathPriorities.push_back(pathPriority);
     }
 
+    fclose(prioritiesFile);
 
-    // UNINIT. Cleanup.
-    if (SUCCESS(status))
-    {
-        // Nothing to clean for the moment.
-    }
-    else
-    {
-        // Nothing to clean for the moment.
-    }
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: LoadPathPriorities(): [%zu] path priorities declared. \n", PathPriorities.size());
+} // LoadPathPriorities()
 
-    return status;
-} // InitOperationPacket()
 
 
 
 //
-// PreprocessEventFileInfosBeforeSending
+// PriorityOfPath
 //
-SDSTATUS
-PreprocessEventFileInfosBeforeSending(
-    __inout std::unordered_map<std::string, FILE_INFO>      &FileInfoHMap,
-    __out std::set<DWORD>                                   &SetOfDepths  
+static __int32
+PriorityOfPath(
+    __in const char                         *RelativePath,
+    __in const std::vector<PATH_PRIORITY>   &PathPriorities
     )
 /*++
-Description: The routine performs a preprocessing of the file information related to events, that is found in the FileInfoHMap
-structure. As a result, the routine outputs a set containing the depth of each FileInfo's associated file (depth in the watch tree 
-that monitors the system directories).
-
-- FileInfoHMap: Reference to the hash map containing the file information related to events (i.e. FILE_INFO structures).
-- SetOfDepths: Reference to the set of depths filled by the routine. Caller provided.
-
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+Description: The routine returns the priority of a file: the one declared for the longest path matching it (the file itself, or a
+directory above it), see LoadPathPriorities(). 0 if none matches.
 --*/
 {
-    SDSTATUS status;
-    FILE_INFO *fileInfo;
-
-    // PREINIT.
-
-    status = STATUS_FAIL;
-    fileInfo = NULL;
+    __int32     priority;
+    size_t      matchLength;
+    size_t      length;
 
-    // Parameter validation.
+    priority = 0;
+    matchLength = 0;
 
-    if (FileInfoHMap.size() <= 0)
-    {
-        printf("[SyncDir] Error: PreprocessEventFileInfosBeforeSending(): Invalid parameter 1. \n");
-        return STATUS_FAIL;
-    }
-    if (0 != SetOfDepths.size())
+    for (const PATH_PRIORITY &pathPriority : PathPriorities)
     {
-        printf("[SyncDir] Error: PreprocessEventFileInfosBeforeSending(): Invalid parameter 1. \n");
-        return STATUS_FAIL;
+        length = pathPriority.RelativePath.size();
+        if (length > matchLength && 0 == strncmp(RelativePath, pathPriority.RelativePath.c_str(), length) && 
+            (0 == RelativePath[length] || '/' == RelativePath[length] || 2 == length))
+        {
+            priority = pathPriority.Priority;
+            matchLength = length;
+        }
     }
 
+    return priority;
+} // PriorityOfPath()
 
-    __try
-    {
-        // INIT.
-        // --
-
-
-        // 
-        // Main processing:
-        //
-
-        // Collect the depths of all the FileInfo parent nodes in the watch tree.
 
-        for (auto it = FileInfoHMap.begin(); it != FileInfoHMap.end(); it ++)
-        {
-            fileInfo = &(it->second);
 
-            if (ftDIRECTORY == fileInfo->FileType)
-            {
-                SetOfDepths.insert(1 + fileInfo->WatchNodeOfParent->Depth);
-            }
 
+//
+// ScheduleFileInfoTransfers
+//
+static void
+ScheduleFileInfoTransfers(
+    __in char                                                   *MainDirFullPath,
+    __in std::unordered_map<std::string, FILE_INFO>             &FileInfoHMap,
+    __out std::vector<std::string>                              &Schedule
+    )
+/*++
+Description: The routine outputs the order in which the FileInfo's are sent (their keys, in Schedule). A large file must not delay 
+the small changes recorded with it, so the contents go shortest first: 
+- The directories (if any left) first, then the operations without content to send (deletions, moves, creations), by the priority
+  of their paths (see LoadPathPriorities()), highest first, then oldest events first: they are cheap, and the contents sent
+  afterwards may depend on them (e.g. a new file where another one was moved from). A file moved and modified is scheduled twice:
+  its MOVE with these operations, its content with the others, so that a file created at its old path does not precede the MOVE.
+- Then the contents to send (MODIFY's), by the priority of their paths, highest first, then by their estimated cost, lowest first: 
+  the bytes to send (0 if the server holds the content, see QueryContentsOnServer()), minus SD_CLT_SCHEDULE_AGING_RATE bytes per 
+  second waited since the first event of the file, so that large files are not postponed forever.
+--*/
+{
+    std::vector<PATH_PRIORITY>          pathPriorities;
+    std::vector<SCHEDULED_TRANSFER>     transfers;
+    SCHEDULED_TRANSFER                  transfer;
+    struct timespec                     now;
+    QWORD                               waitedTime;
+    size_t                              numberOfContents;
+
+    LoadPathPriorities(MainDirFullPath, pathPriorities);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    numberOfContents = 0;
+
+    transfers.reserve(FileInfoHMap.size());
+    for (auto &it : FileInfoHMap)
+    {
+        waitedTime = ((QWORD) now.tv_sec > it.second.FirstEventTime) ? (QWORD) now.tv_sec - it.second.FirstEventTime : 0;
 
-            // Note: The following action (setting WasDeleted for the "moved from" FileInfos) is commented because it is now performed
-            //  directly when updating the server (step 3, in Main Processing, at SendAllFileInfoEventsToServer() ).
+        transfer.RelativePath = it.first;
+        transfer.Class = (ftDIRECTORY == it.second.FileType) ? 0 : ((TRUE == IsModifyOfFileInfo(&it.second)) ? 2 : 1);
+        transfer.Priority = PriorityOfPath(it.second.RelativePath, pathPriorities);
 
-            // // Mark "deleted" all FileInfo's of MOVED_FROM operations (i.e. moved outside of SyncDir main directory).
-            // if ( TRUE == fileInfo->WasMovedFromOnly && 0 != fileInfo->MovementCookie )      // If moved outside of the main directory.
-            // {
-            //    fileInfo->WasDeleted = TRUE;
-            // }
+        if (2 == transfer.Class && TRUE == it.second.WasMovedFromAndTo)         // The MOVE first, with no content.
+        {
+            transfer.Class = 1;
+            transfer.Cost = -(__int64) SD_MIN(waitedTime, (QWORD) INT64_MAX / 2 / SD_CLT_SCHEDULE_AGING_RATE) * SD_CLT_SCHEDULE_AGING_RATE;
+            transfers.push_back(transfer);
+            transfer.Class = 2;
         }
 
+        transfer.Cost = ((2 == transfer.Class && FALSE == it.second.IsContentOnServer) ? 
+                         (__int64) SD_MIN(it.second.FileSize, (QWORD) INT64_MAX / 2) : 0) - 
+                        (__int64) SD_MIN(waitedTime, (QWORD) INT64_MAX / 2 / SD_CLT_SCHEDULE_AGING_RATE) * SD_CLT_SCHEDULE_AGING_RATE;
+        transfers.push_back(transfer);
 
-        // If here, everything is ok.
-        status = STATUS_SUCCESS;
-
-    } // --> __try
-    __catch (const SyncDirException &e)
-    {
-        cout << e.what() << "\n";        
-        //status = STATUS_FAIL;
-    }
-    __catch (const std::exception &e)
-    {
-        cout << "[SyncDir] Error: PreprocessEventFileInfosBeforeSending(): Standard Exception caught: " << e.what() << "\n";        
-        status = STATUS_FAIL;
-    }
-    __catch (...)
-    {
-        printf("[SyncDir] Error: PreprocessEventFileInfosBeforeSending(): Unkown exception.\n");
-        status = STATUS_FAIL;
+        numberOfContents = numberOfContents + ((2 == transfer.Class) ? 1 : 0);
     }
 
-
-    // UNINIT. Cleanup.
-    if (SUCCESS(status))
+    std::stable_sort(transfers.begin(), transfers.end(), [](const SCHEDULED_TRANSFER &First, const SCHEDULED_TRANSFER &Second)
     {
-        // Nothing to clean for the moment.
-    }
-    else
+        if (First.Class != Second.Class)
+        {
+            return First.Class < Second.Class;
+        }
+        if (First.Priority != Second.Priority)
+        {
+            return First.Priority > Second.Priority;
+        }
+        return First.Cost < Second.Cost;
+    });
+
+    Schedule.clear();
+    Schedule.reserve(transfers.size());
+    for (const SCHEDULED_TRANSFER &scheduled : transfers)
     {
-        // Nothing to clean for the moment.
+        Schedule.push_back(scheduled.RelativePath);
     }
 
-    return status;
-} // PreprocessEventFileInfosBeforeSending()
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: ScheduleFileInfoTransfers(): [%zu] operations scheduled, [%zu] of them with contents to send. \n",
+            Schedule.size(), numberOfContents);
+} // ScheduleFileInfoTransfers()
+
 
 
 
@@ -1248,7 +5191,9 @@ SendAllFileInfoEventsToServer(
     __in __int32                                            CltSock
     )
 /*++
-Description: The routine sends all the events recorded in the FILE_INFO structures to a server address.
+Description: The routine sends all the events recorded in the FILE_INFO structures to a server address. The directories go first,
+from the lowest depth to the highest; the other files then go in the order of the transfer schedule (see ScheduleFileInfoTransfers()):
+the operations without content, then the contents, by path priority and shortest (and oldest) first.
 
 - MainDirFullPath: Pointer to the string containg the full (absolute) path towards the main directory monitored by SyncDir client application.
 - FileInfoHMap: Reference to the hash map containing the file information related to system events.
@@ -1262,12 +5207,17 @@ was achieved, but related issues were encountered (information is logged, thereb
     FILE_INFO           *fileInfo;
     FILE_INFO           copyOfFileInfo;
     PACKET_OP           opToSend;
-    DWORD               crtFileSize;
+    QWORD               crtFileSize;
     char                crtFileFullPath[SD_MAX_PATH_LENGTH];
     struct stat         crtFileStat;
+    BOOL                isModifyOnly;
+    MODIFY_PIPELINE     modifyPipeline;
     std::set<DWORD>     setOfDepths;
     std::set<DWORD>::iterator crtDepth;
     std::unordered_map<std::string, FILE_INFO>::iterator it;
+    std::vector<std::string> schedule;
+    size_t              nextScheduled;
+    BOOL                isScheduled;
 
     // PREINIT.
 
@@ -1275,6 +5225,12 @@ was achieved, but related issues were encountered (information is logged, thereb
     fileInfo = NULL;    
     crtFileSize = 0;
     crtFileFullPath[0] = 0;
+    isModifyOnly = FALSE;
+    nextScheduled = 0;
+    isScheduled = FALSE;
+    modifyPipeline.NextRequestId = 1;
+    modifyPipeline.ContentBytes = 0;
+    modifyPipeline.BatchEntries = 0;
 
     // Parameter validation.
 
@@ -1309,6 +5265,16 @@ was achieved, but related issues were encountered (information is logged, thereb
             throw SyncDirException();
         }  
 
+        // Ask the server which contents it holds already, for all the MODIFY's at once.
+
+        status = QueryContentsOnServer(MainDirFullPath, FileInfoHMap, CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SendAllFileInfoEventsToServer(): Failed to execute QueryContentsOnServer(). Abandoning ...\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }  
+
 
 
         //
@@ -1319,7 +5285,8 @@ was achieved, but related issues were encountered (information is logged, thereb
         // Send all the recorded events inside the FileInfo's to the server address.
         // Begin by sending the FileInfo events of directories (==> the server will firstly apply the operations related to directories):
         // - from lowest directory depth to the highest.
-        // After sending all the directory related events, the remaining non-directory file events are sent.
+        // After sending all the directory related events, the remaining non-directory file events are sent, in the order of the
+        // transfer schedule (small contents do not wait for large ones).
 
 
         for (it = FileInfoHMap.begin(), crtDepth = setOfDepths.begin();  FALSE == FileInfoHMap.empty(); )
@@ -1338,6 +5305,24 @@ was achieved, but related issues were encountered (information is logged, thereb
             }
 
 
+            if (setOfDepths.end() == crtDepth)                                      // Directories sent: follow the schedule.
+            {
+                if (FALSE == isScheduled || nextScheduled >= schedule.size())
+                {
+                    ScheduleFileInfoTransfers(MainDirFullPath, FileInfoHMap, schedule);
+                    nextScheduled = 0;
+                    isScheduled = TRUE;
+                }
+
+                it = FileInfoHMap.find(schedule[nextScheduled]);
+                nextScheduled ++;
+                if (FileInfoHMap.end() == it)
+                {
+                    continue;
+                }
+            }
+
+
             fileInfo = &(it->second);                                               // Take the reference to iterated FileInfo.
 
 
@@ -1381,7 +5366,13 @@ was achieved, but related issues were encountered (information is logged, thereb
 
             // Get size and full path of current FileInfo's file.
 
-            sprintf(crtFileFullPath, "%s/%s", MainDirFullPath, fileInfo->RelativePath + 2);                  // +2 to skip "./" 
+            if (snprintf(crtFileFullPath, sizeof(crtFileFullPath), "%s/%s", MainDirFullPath, fileInfo->RelativePath + 2) >=  // +2 to skip "./" 
+                (int) sizeof(crtFileFullPath))
+            {
+                printf("[SyncDir] Warning: SendAllFileInfoEventsToServer(): Path too long for file [%s]. Skipping ...\n", 
+                    fileInfo->RelativePath);
+                continue;
+            }
 
             if (lstat(crtFileFullPath, &crtFileStat) < 0)
             {
@@ -1457,6 +5448,24 @@ was achieved, but related issues were encountered (information is logged, thereb
             **/
 
 
+            // Only the MODIFY's are pipelined (see SendModifyToServer()), and the creations of empty files batched. The server executes 
+            // the operations in order: any other operation is sent once the MODIFY's in flight are completed.
+
+            isModifyOnly = ((TRUE == IsModifyOfFileInfo(fileInfo) && FALSE == fileInfo->WasMovedFromAndTo) || 
+                            TRUE == IsBatchedCreateOfFileInfo(fileInfo)) ? TRUE : FALSE;
+
+            if (FALSE == isModifyOnly)
+            {
+                status = CompleteModifiesOnServer(modifyPipeline, 0, CltSock);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: SendAllFileInfoEventsToServer(): Failed to execute CompleteModifiesOnServer().\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+
+
             // 1. DELETE
             // Check if file was deleted.
             // Delete makes sense only if the file existed before the events.
@@ -1536,7 +5545,8 @@ was achieved, but related issues were encountered (information is logged, thereb
                 {
                     opToSend.OperationType = opFILMOVEDTO;
                     
-                    status = SendModifyToServer(&opToSend, fileInfo->RelativePath, crtFileFullPath, crtFileSize, CltSock);
+                    status = SendModifyToServer(&opToSend, fileInfo->RelativePath, crtFileFullPath, crtFileSize, 
+                                                (TRUE == fileInfo->IsContentOnServer) ? fileInfo->HashCode : NULL, modifyPipeline, CltSock);
                     if (!(SUCCESS(status)))
                     {
                         printf("[SyncDir] Error: SendAllFileInfoEventsToServer(): Failed to execute SendModifyToServer() (at MOVED_TO).\n");
@@ -1586,9 +5596,24 @@ was achieved, but related issues were encountered (information is logged, thereb
                         throw SyncDirException();
                     }                    
 
+                    // Scheduled: the content is sent later, in its own turn (see ScheduleFileInfoTransfers()). The FileInfo is 
+                    // put back as a MODIFY.
+
+                    if (setOfDepths.end() == crtDepth)
+                    {
+                        copyOfFileInfo.WasMovedFromAndTo = FALSE;
+                        copyOfFileInfo.WasMovedToOnly = FALSE;
+                        copyOfFileInfo.OldRelativePath[0] = 0;
+                        FileInfoHMap.insert({std::string(copyOfFileInfo.RelativePath), copyOfFileInfo});
+                        it = FileInfoHMap.end();                            // May be invalidated (rehash); found by the schedule.
+
+                        continue;
+                    }
+
                     opToSend.OperationType = opMODIFY;
 
-                    status = SendModifyToServer(&opToSend, fileInfo->RelativePath, crtFileFullPath, crtFileSize, CltSock);
+                    status = SendModifyToServer(&opToSend, fileInfo->RelativePath, crtFileFullPath, crtFileSize, 
+                                                (TRUE == fileInfo->IsContentOnServer) ? fileInfo->HashCode : NULL, modifyPipeline, CltSock);
                     if (!(SUCCESS(status)))
                     {
                         printf("[SyncDir] Error: SendAllFileInfoEventsToServer(): Failed to execute SendModifyToServer() (at MOVE).\n");
@@ -1629,7 +5654,8 @@ was achieved, but related issues were encountered (information is logged, thereb
             {
                 opToSend.OperationType = opMODIFY;
 
-                status = SendModifyToServer(&opToSend, fileInfo->RelativePath, crtFileFullPath, crtFileSize, CltSock);
+                status = SendModifyToServer(&opToSend, fileInfo->RelativePath, crtFileFullPath, crtFileSize, 
+                                            (TRUE == fileInfo->IsContentOnServer) ? fileInfo->HashCode : NULL, modifyPipeline, CltSock);
                 if (!(SUCCESS(status)))
                 {
                     printf("[SyncDir] Error: SendAllFileInfoEventsToServer(): Failed to execute SendModifyToServer() (at MODIFY).\n");
@@ -1648,6 +5674,19 @@ was achieved, but related issues were encountered (information is logged, thereb
 
             if (TRUE == fileInfo->WasCreated)
             {
+                if (TRUE == IsBatchedCreateOfFileInfo(fileInfo))                    // Empty regular file: batched.
+                {
+                    status = AppendFileToModifyBatch(modifyPipeline, fileInfo->RelativePath, NULL, NULL, 0, CltSock);
+                    if (!(SUCCESS(status)))
+                    {
+                        printf("[SyncDir] Error: SendAllFileInfoEventsToServer(): Failed to execute AppendFileToModifyBatch() (at CREATE).\n");
+                        status = STATUS_FAIL;
+                        throw SyncDirException();
+                    }
+
+                    continue;
+                }
+
                 opToSend.OperationType = opCREATE;
 
                 status = SendCreateToServer(&opToSend, fileInfo->RelativePath, fileInfo->RealRelativePath, CltSock);
@@ -1667,6 +5706,17 @@ was achieved, but related issues were encountered (information is logged, thereb
         } // --> for (auto &fileInfo: FileInfoHMap)
 
 
+        // Complete the MODIFY's still in flight.
+
+        status = CompleteModifiesOnServer(modifyPipeline, 0, CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SendAllFileInfoEventsToServer(): Failed to execute CompleteModifiesOnServer() (at the end).\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
         // Events sent.
         // Clear the event records (file infos).
         FileInfoHMap.clear();
@@ -1700,11 +5750,11 @@ was achieved, but related issues were encountered (information is logged, thereb
     // UNINIT. Cleanup.
     if (SUCCESS(status))
     {
-        // Nothing to clean for the moment.
+        ReleaseModifyPipeline(modifyPipeline);                              // Empty, on success.
     }
     else
     {
-        // Nothing to clean for the moment.
+        ReleaseModifyPipeline(modifyPipeline);
     }
 
     return status;
@@ -100,6 +100,63 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
 
 
 
+//
+// PrehashFilesIntoHashCache
+//
+SDSTATUS
+PrehashFilesIntoHashCache(
+    __inout std::vector<std::string>    &FileFullPaths
+    )
+/*++
+Description: The routine hashes the files of FileFullPaths in batches of SD_HASH_BATCH_SIZE files (see HashCachePrehashFiles()) and
+empties FileFullPaths. Used by the startup scan: the small files are hashed together (multi-buffer) and their hash codes are cached,
+so that SendModifyToServer() finds them in the hash cache instead of hashing the files one by one.
+
+- FileFullPaths: Reference to the full paths of the files.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING if some of the files could not be hashed (they are
+hashed again, one by one, when synchronized).
+--*/
+{
+    SDSTATUS    status;
+    SDSTATUS    batchStatus;
+    const char  *fileFullPaths[SD_HASH_BATCH_SIZE];
+    DWORD       numberOfFiles;
+    size_t      i;
+
+    // PREINIT.
+
+    status = STATUS_SUCCESS;
+    numberOfFiles = 0;
+
+    for (i = 0; i < FileFullPaths.size(); i ++)
+    {
+        fileFullPaths[numberOfFiles] = FileFullPaths[i].c_str();
+        numberOfFiles ++;
+
+        if (SD_HASH_BATCH_SIZE == numberOfFiles || i + 1 == FileFullPaths.size())
+        {
+            batchStatus = HashCachePrehashFiles(gHashAlgorithm, numberOfFiles, fileFullPaths);
+            if (!(SUCCESS(batchStatus)))
+            {
+                printf("[SyncDir] Warning: PrehashFilesIntoHashCache(): HashCachePrehashFiles() failed. Continuing execution...\n");
+                status = STATUS_WARNING;
+            }
+            else if (STATUS_WARNING == batchStatus)
+            {
+                status = STATUS_WARNING;
+            }
+            numberOfFiles = 0;
+        }
+    }
+
+    FileFullPaths.clear();
+
+    return status;
+} // PrehashFilesIntoHashCache()
+
+
+
 //
 // BuildEventsForAllSubdirFiles
 //
@@ -115,7 +172,7 @@ BuildEventsForAllSubdirFiles(
 Description: The routine recursively builds and emits all the necessary events for the SyncDir synchronization of a directory's content.
 The directory is identified by its directory watch DirWatchIndex. 
 All the events built by the routine are passed on to ProcessOperationAndAggregate(), to ensure the correct processing and aggregation 
-of the events.
+of the events. The small regular files not found in the hash cache are hashed in batches (see PrehashFilesIntoHashCache()).
 
 Note: The routine does not build an event for the first directory (DirWatchIndex), but only for the inner files and directories.
 
@@ -135,6 +192,10 @@ was achieved, but related issues were encountered (information is logged, thereb
     struct dirent   *file;
     struct stat     fileStat;
     DWORD           indexOfNewDirWatch;
+    BOOL            isPrehashEnabled;
+    BOOL            isHashCached;
+    char            hashCode[SD_MAX_HASH_CODE_LENGTH + 1];
+    std::vector<std::string> prehashFileFullPaths;
 
     // PREINIT.
 
@@ -142,6 +203,8 @@ was achieved, but related issues were encountered (information is logged, thereb
     dirStream = NULL;
     file = NULL;
     indexOfNewDirWatch = 0;
+    isPrehashEnabled = HashCacheIsOpen();                               // Without the cache, the batched hash codes would be lost.
+    isHashCached = FALSE;
 
     // Parameter validation.
 
@@ -306,9 +369,27 @@ was achieved, but related issues were encountered (information is logged, thereb
                     status = STATUS_FAIL;
                     throw SyncDirException();
                 }                     
+
+
+                // Small regular file, not in the hash cache: hash it later, together with others.
+
+                if (TRUE == isPrehashEnabled && S_ISREG(fileStat.st_mode) && SD_HASH_BATCH_MAX_FILE_SIZE >= fileStat.st_size &&
+                    SUCCESS(HashCacheLookup(&fileStat, gHashAlgorithm, hashCode, &isHashCached)) && FALSE == isHashCached)
+                {
+                    prehashFileFullPaths.push_back(DataOfEvent.FullPath);
+                    if (SD_HASH_BATCH_SIZE == prehashFileFullPaths.size())
+                    {
+                        PrehashFilesIntoHashCache(prehashFileFullPaths);
+                    }
+                }
             }
 
         } // --> while(1)
+
+
+        // Hash the remaining small files.
+
+        PrehashFilesIntoHashCache(prehashFileFullPaths);
      
 
 
@@ -2019,6 +2100,17 @@ was achieved, but related issues were encountered (information is logged, thereb
         fprintf(g_SD_STDLOG, "[SyncDir] Info: All the events were built for the current state of the client partition. \n");
 
 
+        // Compare the directory trees (digests) with the server. Drop the events of the directories already identical on the server.
+
+        status = ReconcileDirDigestsWithServer((*Watches), fileInfoHMap, CltSock);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: WaitForEventsAndProcessChanges(): Failed to execute ReconcileDirDigestsWithServer(). \n");   
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
         // Inform the server. Synchronize the current partition state. 
 
         status = SendAllFileInfoEventsToServer(MainDirFullPath, fileInfoHMap, CltSock);
@@ -2076,7 +2168,14 @@ was achieved, but related issues were encountered (information is logged, thereb
 
             printf("[SyncDir] Info: Waiting for events ...\n\n");
 
-            existEventsToRead = select(HInotify + 1, &readableFdSet, NULL, NULL, NULL);      
+            // A signal handled (e.g. SIGHUP, see GovernorInit()) interrupts select(): wait again.
+
+            do
+            {
+                FD_ZERO(&readableFdSet);
+                FD_SET(HInotify, &readableFdSet);
+                existEventsToRead = select(HInotify + 1, &readableFdSet, NULL, NULL, NULL);
+            } while (-1 == existEventsToRead && EINTR == errno);
             if (-1 == existEventsToRead)
             {
                 perror("[SyncDir] Error: WaitForEventsAndProcessChanges(): select() failed (first events).\n");
@@ -2138,12 +2237,15 @@ was achieved, but related issues were encountered (information is logged, thereb
                 // - If no events ==> update server.
                 // - If events still exist ==> loop for processing.
 
-                FD_ZERO(&readableFdSet);                                // Init for select().
-                FD_SET(HInotify, &readableFdSet);
-                waitOnSelect.tv_sec = 0;
-                waitOnSelect.tv_usec = 0;
+                do
+                {
+                    FD_ZERO(&readableFdSet);                            // Init for select().
+                    FD_SET(HInotify, &readableFdSet);
+                    waitOnSelect.tv_sec = 0;
+                    waitOnSelect.tv_usec = 0;
 
-                existEventsToRead = select(HInotify + 1, &readableFdSet, NULL, NULL, &waitOnSelect);
+                    existEventsToRead = select(HInotify + 1, &readableFdSet, NULL, NULL, &waitOnSelect);
+                } while (-1 == existEventsToRead && EINTR == errno);    // Interrupted by a signal handled (e.g. SIGHUP).
                 if (-1 == existEventsToRead)                            // ==> Error.
                 {
                     perror("[SyncDir] Error: WaitForEventsAndProcessChanges(): Instant select() failed.\n");
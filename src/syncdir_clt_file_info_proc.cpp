@@ -124,6 +124,7 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
 --*/
 {
     SDSTATUS status;
+    struct timespec now;
 
     // PREINIT.
     status = STATUS_FAIL;
@@ -148,10 +149,14 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
 
     FileInfo->RelativePath[0] = 0;
     FileInfo->RealRelativePath[0] = 0;
-    FileInfo->MD5Hash[0] = 0;               
+    FileInfo->HashCode[0] = 0;               
+    FileInfo->IsContentOnServer = FALSE;
     FileInfo->Inode = 0;
     FileInfo->FileSize = 0;
 
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    FileInfo->FirstEventTime = (QWORD) now.tv_sec;              // Age of the events, for the transfer schedule.
+
     FileInfo->WasCreated = FALSE;
     FileInfo->WasDeleted = FALSE;
     FileInfo->WasModified = FALSE;
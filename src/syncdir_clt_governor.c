@@ -0,0 +1,405 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_clt_governor.h"
+#include <time.h>
+
+
+
+GOVERNOR gGovernor = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, "", PTHREAD_MUTEX_INITIALIZER };    // Definition. Unlimited.
+
+static volatile sig_atomic_t gIsReloadRequested = 0;                    // Set by SIGHUP: the limits file is read again.
+
+
+
+//
+// Internal helpers.
+//
+
+static inline QWORD
+GovernorTimeNs(
+    void
+    )
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (QWORD) now.tv_sec * 1000000000ULL + (QWORD) now.tv_nsec;
+}
+
+
+static void
+GovernorSighupHandler(
+    __in int Signal
+    )
+{
+    (void) Signal;
+
+    gIsReloadRequested = 1;                                             // Async-signal-safe: the reload is done by the next quota.
+}
+
+
+
+//
+// SetBucketRate
+//
+static void
+SetBucketRate(
+    __inout TOKEN_BUCKET    *Bucket,
+    __in QWORD              Rate,
+    __in QWORD              MinBurst
+    )
+/*++
+Description: The routine sets the Rate of a bucket (0: unlimited) and its burst: SD_CLT_RATE_BURST_MS of Rate, at least MinBurst. A
+bucket that was unlimited starts full; otherwise, the tokens (or the debt) are kept, within the new burst. Called with the lock held.
+--*/
+{
+    BOOL wasUnlimited;
+
+    wasUnlimited = (0 == Bucket->Rate) ? TRUE : FALSE;
+
+    Bucket->Rate = Rate;
+    Bucket->Burst = SD_MAX(Rate * SD_CLT_RATE_BURST_MS / 1000, MinBurst);
+
+    if (TRUE == wasUnlimited || Bucket->Tokens > (double) Bucket->Burst)
+    {
+        Bucket->Tokens = (double) Bucket->Burst;
+    }
+    Bucket->LastRefillNs = GovernorTimeNs();
+
+} // SetBucketRate()
+
+
+
+//
+// TakeBucketTokens
+//
+static QWORD
+TakeBucketTokens(
+    __inout TOKEN_BUCKET    *Bucket,
+    __in QWORD              Tokens,
+    __in QWORD              NowNs
+    )
+/*++
+Description: The routine refills a limited bucket for the time elapsed since its last refill (up to its burst), then takes Tokens
+from it, going into debt if they are not there. Called with the lock held.
+
+Return value: The time (nanoseconds) the caller must wait for its tokens: the time the debt takes to be refilled. 0 if no debt.
+--*/
+{
+    if (NowNs > Bucket->LastRefillNs)
+    {
+        Bucket->Tokens = Bucket->Tokens + (double) (NowNs - Bucket->LastRefillNs) * (double) Bucket->Rate / 1e9;
+        if (Bucket->Tokens > (double) Bucket->Burst)
+        {
+            Bucket->Tokens = (double) Bucket->Burst;
+        }
+        Bucket->LastRefillNs = NowNs;
+    }
+
+    Bucket->Tokens = Bucket->Tokens - (double) Tokens;
+    if (Bucket->Tokens >= 0)
+    {
+        return 0;
+    }
+
+    return (QWORD) (-Bucket->Tokens * 1e9 / (double) Bucket->Rate);
+} // TakeBucketTokens()
+
+
+
+//
+// GovernorQuota
+//
+static size_t
+GovernorQuota(
+    __inout TOKEN_BUCKET        *Bytes,
+    __inout_opt TOKEN_BUCKET    *Operations,
+    __in size_t                 Wanted
+    )
+/*++
+Description: The routine grants to the caller the Wanted bytes (at most the burst of Bytes, if limited) and one operation (if
+Operations is not NULL), then waits for the buckets to cover them. The limits file is read first, if SIGHUP asked for it.
+
+Return value: The number of bytes granted (at most Wanted; not 0, unless Wanted is 0).
+--*/
+{
+    size_t          granted;
+    QWORD           nowNs;
+    QWORD           waitNs;
+    struct timespec waitTime;
+
+    if (0 == Wanted)
+    {
+        return 0;
+    }
+
+    granted = Wanted;
+    waitNs = 0;
+
+    pthread_mutex_lock(&gGovernor.Lock);
+
+    if (0 != gIsReloadRequested)
+    {
+        gIsReloadRequested = 0;
+        GovernorLoadLimits();
+    }
+
+    nowNs = GovernorTimeNs();
+
+    if (0 != Bytes->Rate)
+    {
+        granted = (size_t) SD_MIN((QWORD) granted, Bytes->Burst);
+        waitNs = TakeBucketTokens(Bytes, granted, nowNs);
+    }
+    if (NULL != Operations && 0 != Operations->Rate)
+    {
+        waitNs = SD_MAX(waitNs, TakeBucketTokens(Operations, 1, nowNs));
+    }
+
+    pthread_mutex_unlock(&gGovernor.Lock);
+
+
+    // Wait (without the lock: the other callers take their tokens meanwhile, after this debt).
+
+    waitTime.tv_sec = (time_t) (waitNs / 1000000000ULL);
+    waitTime.tv_nsec = (long) (waitNs % 1000000000ULL);
+    while (0 != waitNs && 0 != nanosleep(&waitTime, &waitTime) && EINTR == errno)
+    {
+        // Interrupted (e.g. SIGHUP): sleep the time left.
+    }
+
+    return granted;
+} // GovernorQuota()
+
+
+
+
+//
+// GovernorInit
+//
+SDSTATUS
+GovernorInit(
+    __in_opt const char     *LimitsFilePath
+    )
+/*++
+Description: The routine sets the built-in limits, then the ones of the limits file at LimitsFilePath (if any). It installs the SIGHUP
+handler (the limits file is read again), and sets gReadQuotaRoutine, for the file reads of the hashing and chunking routines to be
+limited as well. With SD_CLT_IDLE_IO_PRIORITY, the calling thread takes the idle I/O scheduling class, inherited by the threads it
+creates afterwards.
+
+- LimitsFilePath: Optional. Pointer to the full path of the limits file. NULL or "": the built-in limits only.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING if the limits file or the I/O priority could not be used.
+--*/
+{
+    SDSTATUS            status;
+    struct sigaction    action;
+
+    // PREINIT.
+
+    status = STATUS_SUCCESS;
+
+    // Parameter validation.
+
+    if (NULL != LimitsFilePath && strlen(LimitsFilePath) >= SD_MAX_PATH_LENGTH)
+    {
+        printf("[SyncDir] Error: GovernorInit(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    pthread_mutex_lock(&gGovernor.Lock);
+
+    SetBucketRate(&gGovernor.SendBytes, SD_CLT_SEND_RATE_LIMIT, SD_GOVERNOR_MIN_BURST);
+    SetBucketRate(&gGovernor.ReadBytes, SD_CLT_READ_RATE_LIMIT, SD_GOVERNOR_MIN_BURST);
+    SetBucketRate(&gGovernor.ReadOperations, SD_CLT_READ_IOPS_LIMIT, 1);
+
+    gGovernor.LimitsFilePath[0] = 0;
+    if (NULL != LimitsFilePath)
+    {
+        strcpy(gGovernor.LimitsFilePath, LimitsFilePath);
+    }
+
+    // A missing limits file is not an error: there may be none, until the limits must be changed (then, SIGHUP).
+    if (0 != gGovernor.LimitsFilePath[0] && 0 == access(gGovernor.LimitsFilePath, F_OK) && !(SUCCESS(GovernorLoadLimits())))
+    {
+        printf("[SyncDir] Warning: GovernorInit(): GovernorLoadLimits() failed. Continuing with the built-in limits ...\n");
+        status = STATUS_WARNING;
+    }
+
+    pthread_mutex_unlock(&gGovernor.Lock);
+
+
+    // Read the limits file again on SIGHUP. SA_RESTART: the blocking calls interrupted are resumed (e.g. inotify reads).
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = GovernorSighupHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGHUP, &action, NULL) < 0)
+    {
+        perror("[SyncDir] Warning: GovernorInit(): Error at sigaction(). The limits cannot be changed at runtime.\n");
+        status = STATUS_WARNING;
+    }
+
+
+    // The file reads of the shared routines (hashing, chunking) go through the read limits too.
+
+    gReadQuotaRoutine = GovernorReadQuota;
+
+
+    // Disk time only when no other process needs it. Inherited by the threads created afterwards.
+
+    if (TRUE == SD_CLT_IDLE_IO_PRIORITY &&
+        syscall(SYS_ioprio_set, SD_IOPRIO_WHO_PROCESS, 0, SD_IOPRIO_CLASS_IDLE << SD_IOPRIO_CLASS_SHIFT) < 0)
+    {
+        perror("[SyncDir] Warning: GovernorInit(): Error at ioprio_set(). Continuing with the default I/O priority ...\n");
+        status = STATUS_WARNING;
+    }
+
+    return status;
+} // GovernorInit()
+
+
+
+
+//
+// GovernorLoadLimits
+//
+SDSTATUS
+GovernorLoadLimits(
+    void
+    )
+/*++
+Description: The routine reads the limits file (gGovernor.LimitsFilePath), if any: "send_rate <bytes>", "read_rate <bytes>" and
+"read_iops <reads>" lines (per second, 0: unlimited). The limits not named keep their built-in values. Called with the lock held.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the limits are not changed).
+--*/
+{
+    FILE                *limitsFile;
+    char                line[SD_MAX_PATH_LENGTH];
+    char                name[SD_MAX_PATH_LENGTH];
+    unsigned long long  value;
+    QWORD               sendRate;
+    QWORD               readRate;
+    QWORD               readIops;
+    DWORD               lineNumber;
+
+    if (0 == gGovernor.LimitsFilePath[0])
+    {
+        return STATUS_SUCCESS;
+    }
+
+    limitsFile = fopen(gGovernor.LimitsFilePath, "r");
+    if (NULL == limitsFile)
+    {
+        perror("[SyncDir] Error: GovernorLoadLimits(): Error at fopen() (limits file). Limits not changed.\n");
+        return STATUS_FAIL;
+    }
+
+    sendRate = SD_CLT_SEND_RATE_LIMIT;
+    readRate = SD_CLT_READ_RATE_LIMIT;
+    readIops = SD_CLT_READ_IOPS_LIMIT;
+    lineNumber = 0;
+
+    while (NULL != fgets(line, sizeof(line), limitsFile))
+    {
+        lineNumber ++;
+
+        if (1 > sscanf(line, "%s", name) || '#' == name[0])
+        {
+            continue;                                                   // Empty line, or comment.
+        }
+        if (2 != sscanf(line, "%s %llu", name, &value))
+        {
+            printf("[SyncDir] Error: GovernorLoadLimits(): Invalid line [%u] in the limits file. Limits not changed.\n", lineNumber);
+            fclose(limitsFile);
+            return STATUS_FAIL;
+        }
+
+        if (0 == strcmp(name, "send_rate"))
+        {
+            sendRate = value;
+        }
+        else if (0 == strcmp(name, "read_rate"))
+        {
+            readRate = value;
+        }
+        else if (0 == strcmp(name, "read_iops"))
+        {
+            readIops = value;
+        }
+        else
+        {
+            printf("[SyncDir] Warning: GovernorLoadLimits(): Unknown limit [%s] in the limits file. Ignored.\n", name);
+        }
+    }
+
+    fclose(limitsFile);
+
+    SetBucketRate(&gGovernor.SendBytes, sendRate, SD_GOVERNOR_MIN_BURST);
+    SetBucketRate(&gGovernor.ReadBytes, readRate, SD_GOVERNOR_MIN_BURST);
+    SetBucketRate(&gGovernor.ReadOperations, readIops, 1);
+
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: GovernorLoadLimits(): Limits: send [%llu B/s], read [%llu B/s], [%llu reads/s] (0: unlimited).\n",
+            (unsigned long long) sendRate, (unsigned long long) readRate, (unsigned long long) readIops);
+
+    return STATUS_SUCCESS;
+} // GovernorLoadLimits()
+
+
+
+
+//
+// GovernorSendQuota
+//
+size_t
+GovernorSendQuota(
+    __in size_t     Wanted
+    )
+/*++
+Description: The routine returns how many of the Wanted bytes of file data the caller may send now, waiting for the send rate limit
+to allow them (see GovernorQuota()).
+
+- Wanted: Number of bytes the caller is about to send.
+
+Return value: The number of bytes allowed (at most Wanted; not 0, unless Wanted is 0).
+--*/
+{
+    return GovernorQuota(&gGovernor.SendBytes, NULL, Wanted);
+} // GovernorSendQuota()
+
+
+
+
+//
+// GovernorReadQuota
+//
+size_t
+GovernorReadQuota(
+    __in size_t     Wanted
+    )
+/*++
+Description: The routine returns how many of the Wanted bytes the caller may read now from a file (one read), waiting for the read
+limits (bytes, and reads per second) to allow them (see GovernorQuota()).
+
+- Wanted: Number of bytes the caller is about to read.
+
+Return value: The number of bytes allowed (at most Wanted; not 0, unless Wanted is 0).
+--*/
+{
+    return GovernorQuota(&gGovernor.ReadBytes, &gGovernor.ReadOperations, Wanted);
+} // GovernorReadQuota()
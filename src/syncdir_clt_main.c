@@ -31,6 +31,171 @@ int main(int argc, char **argv)
 
 
 
+//
+// IsSocketConnectionLost
+//
+static BOOL
+IsSocketConnectionLost(
+    __in __int32 Sock
+    )
+/*++
+Description: The routine checks whether a connection was closed or reset by the peer (or failed). The session on the connection is
+over: the data not read yet is discarded. A peer gone may close its connections one after the other: the routine waits up to
+SD_CLT_CONNECTION_LOST_WAIT milliseconds for the end of this one.
+
+Return value: TRUE if the connection is lost, FALSE otherwise.
+--*/
+{
+    char            buffer[SD_MAX_PATH_LENGTH];
+    ssize_t         recvBytes;
+    struct pollfd   pollFd;
+
+    pollFd.fd = Sock;
+    pollFd.events = POLLIN;
+
+    while (1)
+    {
+        recvBytes = recv(Sock, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (0 == recvBytes)                                             // Closed by the peer.
+        {
+            return TRUE;
+        }
+        if (recvBytes < 0 && EAGAIN != errno && EWOULDBLOCK != errno)
+        {
+            return TRUE;
+        }
+        if (recvBytes < 0)
+        {
+            pollFd.revents = 0;
+            if (poll(&pollFd, 1, SD_CLT_CONNECTION_LOST_WAIT) <= 0)     // Still open, and silent.
+            {
+                return FALSE;
+            }
+        }
+    }
+} // IsSocketConnectionLost()
+
+
+
+
+//
+// CltRunSession
+//
+static SDSTATUS
+CltRunSession(
+    __in DWORD      SrvPort,
+    __in char       *SrvIP,
+    __in char       *MainDirFullPath,
+    __out BOOL      *IsNegotiated,
+    __out BOOL      *IsConnectionLost
+    )
+/*++
+Description: The routine runs one session with the server: it executes 4 routine calls, CltReturnConnectedSocket, 
+CltNegotiateSessionWithServer, CltOpenDataConnections and CltMonitorPartition. The first creates a socket connection to the SyncDir
+server, the second agrees with the server on the session parameters (e.g. content hash algorithm), the third opens the data
+connections granted (for whole files) and the last launches the client partition monitoring, which also loops the server update
+procedures. The connections are closed at the end.
+
+- IsNegotiated: Pointer to where the routine outputs whether the session was established (negotiated with the server).
+- IsConnectionLost: Pointer to where the routine outputs whether the session failed because the server could not be reached, or the
+  connection to it was lost (then, reconnecting may help).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS    status;
+    __int32     cltSock;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    cltSock = -1;
+    (*IsNegotiated) = FALSE;
+    (*IsConnectionLost) = FALSE;
+
+
+    // Obtain socket connection to the server.
+    
+    status = CltReturnConnectedSocket(&cltSock, SrvPort, SrvIP);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: CltRunSession(): Failed at CltReturnConnectedSocket.\n");
+        (*IsConnectionLost) = TRUE;
+        status = STATUS_FAIL;
+        goto cleanup_CltRunSession;
+    }    
+
+
+
+    // Agree with the server on the session parameters (e.g. content hash algorithm).
+
+    status = CltNegotiateSessionWithServer(cltSock);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: CltRunSession(): Failed at CltNegotiateSessionWithServer().\n");
+        (*IsConnectionLost) = IsSocketConnectionLost(cltSock);
+        status = STATUS_FAIL;
+        goto cleanup_CltRunSession;
+    }
+    (*IsNegotiated) = TRUE;
+
+
+
+    // Open the data connections granted by the server (whole files). Not fatal: whole files go on the control connection otherwise.
+
+    status = CltOpenDataConnections(SrvPort, SrvIP);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Warning: CltRunSession(): Failed at CltOpenDataConnections(). Continuing without data connections ...\n");
+    }
+
+
+
+    // Monitor file system partition & Update the server.
+
+    status = CltMonitorPartition(MainDirFullPath, cltSock);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: CltRunSession(): Failed to execute CltMonitorPartition().\n");
+        (*IsConnectionLost) = IsSocketConnectionLost(cltSock);
+        status = STATUS_FAIL;
+        goto cleanup_CltRunSession;
+    }
+
+
+
+    // If here, everything went well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_CltRunSession:
+
+    if (SUCCESS(status))
+    {
+        // Close connections/sockets. The data connections first: the ranges queued are sent.
+        CltCloseDataConnections();
+        if (0 < cltSock)
+        {
+            close(cltSock);
+            cltSock = -1;
+        }
+    }
+    else
+    {
+        CltCloseDataConnections();
+        if (0 < cltSock)
+        {
+            close(cltSock);
+            cltSock = -1;
+        }
+    }
+
+    return status;
+} // CltRunSession()
+
+
+
+
 //
 // MainCltRoutine
 //
@@ -40,8 +205,8 @@ SDSTATUS MainCltRoutine(
     )
 /*++
 Description: The routine verifies and validates all command-line arguments of SyncDir launch (MainArgc and MainArgv arguments), then 
-executes 2 routine calls: CltReturnConnectedSocket and CltMonitorPartition. The former creates a socket connection to the SyncDir server
-and the latter launches the client partition monitoring, which also loops the server update procedures.
+runs the sessions with the server (see CltRunSession()): if the connection to the server is lost, it reconnects, up to 
+SD_CLT_RECONNECT_ATTEMPTS times in a row.
 
 - MainArgc: Length of the MainArgv array, i.e. number of command-line arguments provided at SyncDir client startup. 
 - MainArgv: Pointer to the array of command-line arguments (strings) provided at SyncDir client launch.
@@ -52,22 +217,36 @@ was achieved, but related issues were encountered (information is logged, thereb
 {
 
     SDSTATUS    status;
-    __int32     cltSock;
     char        mainDirFullPath[SD_MAX_PATH_LENGTH];
+    char        hashCacheFullPath[SD_MAX_PATH_LENGTH];
+    char        limitsFullPath[SD_MAX_PATH_LENGTH];
     char        *srvIP;
     DWORD       srvPort;
+    DWORD       attempts;
     BOOL        isSymLink;
     BOOL        isDirValid;
+    BOOL        isNegotiated;
+    BOOL        isConnectionLost;
+    QWORD       timeLimit;
+    QWORD       elapsedTime;
+    time_t      startTime;
 
     // PREINIT.
 
     status = STATUS_FAIL;
-    cltSock = -1;
     mainDirFullPath[0] = 0;
+    hashCacheFullPath[0] = 0;
+    limitsFullPath[0] = 0;
     srvIP = NULL;
     srvPort = 0;
+    attempts = 0;
     isSymLink = TRUE;
     isDirValid = FALSE;
+    isNegotiated = FALSE;
+    isConnectionLost = FALSE;
+    timeLimit = 0;
+    elapsedTime = 0;
+    startTime = 0;
 
     // Parameter validation (start).
 
@@ -160,7 +339,37 @@ was achieved, but related issues were encountered (information is logged, thereb
         gTimeLimit = (QWORD)(-1);       // "infinity"
     }
     printf("gTimeLimit: [%lu] \n", gTimeLimit);
-    
+
+    // Persistent hash cache, next to the main directory (not inside it, so it generates no events). Optional: a client without
+    // hash cache only hashes more.
+    if (0 != SD_CLT_HASH_CACHE_SUFFIX[0] && 0 != strcmp(mainDirFullPath, "/"))
+    {
+        snprintf(hashCacheFullPath, SD_MAX_PATH_LENGTH, "%s%s", mainDirFullPath, SD_CLT_HASH_CACHE_SUFFIX);
+        if (!(SUCCESS(HashCacheOpen(hashCacheFullPath))))
+        {
+            printf("[SyncDir] Warning: MainCltRoutine(): Failed to open the hash cache. Continuing without it ...\n");
+        }
+    }
+
+
+    // Resource governor: limits of the file data sent and of the file reads (see GovernorInit()), adjustable at runtime by a limits
+    // file next to the main directory (read again on SIGHUP). Before any thread is created, for the I/O priority to be inherited.
+    if (0 != SD_CLT_LIMITS_SUFFIX[0] && 0 != strcmp(mainDirFullPath, "/"))
+    {
+        snprintf(limitsFullPath, SD_MAX_PATH_LENGTH, "%s%s", mainDirFullPath, SD_CLT_LIMITS_SUFFIX);
+    }
+    if (!(SUCCESS(GovernorInit(limitsFullPath))))
+    {
+        printf("[SyncDir] Error: MainCltRoutine(): Failed to execute GovernorInit().\n");
+        status = STATUS_FAIL;
+        goto cleanup_MainCltRoutine;
+    }
+
+
+
+    // A server lost while the client sends to it must end the session only (send() fails), not the client.
+    signal(SIGPIPE, SIG_IGN);
+
 
 
     //
@@ -169,24 +378,47 @@ was achieved, but related issues were encountered (information is logged, thereb
 
 
 
-    // Obtain socket connection to the server.
-    
-    status = CltReturnConnectedSocket(&cltSock, srvPort, srvIP);
-    if (!(SUCCESS(status)))
-    {
-        printf("[SyncDir] Error: MainCltRoutine(): Failed at CltReturnConnectedSocket.\n");
-        status = STATUS_FAIL;
-        goto cleanup_MainCltRoutine;
-    }    
+    // Run the sessions with the server. If the connection is lost, reconnect (at most SD_CLT_RECONNECT_ATTEMPTS times in a row,
+    // SD_CLT_RECONNECT_DELAY seconds apart) and start again: the startup synchronization sends only what the server misses, and the
+    // server resumes the whole files it was receiving (see PACKET_MODIFY_REPLY). The time limit covers all the sessions.
 
+    startTime = time(NULL);
+    timeLimit = gTimeLimit;
+
+    while (1)
+    {
+        status = CltRunSession(srvPort, srvIP, mainDirFullPath, &isNegotiated, &isConnectionLost);
+        if (SUCCESS(status) || FALSE == isConnectionLost)
+        {
+            break;
+        }
 
+        attempts = (TRUE == isNegotiated) ? 1 : attempts + 1;
+        if (attempts > SD_CLT_RECONNECT_ATTEMPTS)
+        {
+            printf("[SyncDir] Error: MainCltRoutine(): Connection to the server lost. No more reconnection attempts.\n");
+            break;
+        }
 
-    // Monitor file system partition & Update the server.
+        elapsedTime = (QWORD) (time(NULL) - startTime) + SD_CLT_RECONNECT_DELAY;
+        if ((QWORD)(-1) != timeLimit)
+        {
+            if (elapsedTime >= timeLimit)
+            {
+                printf("[SyncDir] Info: MainCltRoutine(): Connection to the server lost. Time limit reached: not reconnecting.\n");
+                status = STATUS_SUCCESS;
+                break;
+            }
+            gTimeLimit = timeLimit - elapsedTime;
+        }
 
-    status = CltMonitorPartition(mainDirFullPath, cltSock);
+        printf("[SyncDir] Warning: MainCltRoutine(): Connection to the server lost. Reconnecting in [%u] seconds (attempt [%u/%u]) ...\n",
+            SD_CLT_RECONNECT_DELAY, attempts, SD_CLT_RECONNECT_ATTEMPTS);
+        sleep(SD_CLT_RECONNECT_DELAY);
+    }
     if (!(SUCCESS(status)))
     {
-        printf("[SyncDir] Error: MainCltRoutine(): Failed to execute CltMonitorPartition().\n");
+        printf("[SyncDir] Error: MainCltRoutine(): Failed at CltRunSession().\n");
         status = STATUS_FAIL;
         goto cleanup_MainCltRoutine;
     }
@@ -201,20 +433,11 @@ was achieved, but related issues were encountered (information is logged, thereb
 
     if (SUCCESS(status))
     {
-        // Close connection/socket.
-        if (0 < cltSock)
-        {
-            close(cltSock);
-            cltSock = -1;
-        }
+        HashCacheClose();
     }
     else
     {
-        if (0 < cltSock)
-        {
-            close(cltSock);
-            cltSock = -1;
-        }
+        HashCacheClose();
     }
 
     return status;
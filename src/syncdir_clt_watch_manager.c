@@ -837,6 +837,7 @@ was achieved, but related issues were encountered (information is logged, thereb
     // Allocate space and initialize the watch array == the array of directory watches (DIR_WATCH structures).
     // The watch array will store the essential information for monitoring all the directories on the client partition.
 
+    gWatchesArrayCapacity = SD_INITIAL_NR_OF_WATCHES;                   // A new session (after reconnecting) starts a new array.
     watches = (DIR_WATCH*) malloc(SD_INITIAL_NR_OF_WATCHES * sizeof(DIR_WATCH));
     if (NULL == watches)
     {
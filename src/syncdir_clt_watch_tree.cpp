@@ -812,14 +812,25 @@ Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
         while (FALSE == queue.empty())
         {
             DWORD i;
+            std::string parentRelativePath;
+            std::string parentFullPath;
 
             nodeToExplore = queue.front(); 
             queue.pop();
 
-            sprintf(Watches[nodeToExplore->DirWatchIndex].DirRelativePath, "%s/%s", Watches[nodeToExplore->Parent->DirWatchIndex].DirRelativePath,
-                nodeToExplore->DirName.c_str());
-            sprintf(Watches[nodeToExplore->DirWatchIndex].DirFullPath, "%s/%s", Watches[nodeToExplore->Parent->DirWatchIndex].DirFullPath,
-                nodeToExplore->DirName.c_str());
+            // Copy the parent paths first: the parent and the node are entries of the same Watches array.
+            parentRelativePath.assign(Watches[nodeToExplore->Parent->DirWatchIndex].DirRelativePath);
+            parentFullPath.assign(Watches[nodeToExplore->Parent->DirWatchIndex].DirFullPath);
+
+            if (snprintf(Watches[nodeToExplore->DirWatchIndex].DirRelativePath, SD_MAX_PATH_LENGTH, "%s/%s", 
+                    parentRelativePath.c_str(), nodeToExplore->DirName.c_str()) >= SD_MAX_PATH_LENGTH ||
+                snprintf(Watches[nodeToExplore->DirWatchIndex].DirFullPath, SD_MAX_PATH_LENGTH, "%s/%s", 
+                    parentFullPath.c_str(), nodeToExplore->DirName.c_str()) >= SD_MAX_PATH_LENGTH)
+            {
+                printf("[SyncDir] Error: UpdatePathsForSubTreeWatches(): Path too long for directory [%s]. \n", nodeToExplore->DirName.c_str());
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
             nodeToExplore->Depth = nodeToExplore->Parent->Depth + 1;
 
             for (i=0; i<nodeToExplore->Subdirs.size(); i++)
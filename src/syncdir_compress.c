@@ -0,0 +1,458 @@
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_compress.h"
+
+
+
+COMPRESSION_CODEC gCompressionCodec = ccNONE;                           // Definition. Set at handshake.
+
+
+
+/*++
+Format of an LZ block: a sequence of "sequences". Each sequence is a token byte (high nibble: number of literals, low nibble: match
+length - SD_LZ_MIN_MATCH; 15 means "more length bytes follow": each adds 0-255, a byte below 255 ends the length), the literals, the
+match offset (2 bytes, little endian, 1 - SD_LZ_MAX_OFFSET back in the output) and the extra match length bytes. The last sequence
+has literals only: it ends at the end of the block.
+--*/
+
+
+
+//
+// LzRead32
+//
+static inline DWORD
+LzRead32(
+    __in const BYTE *Data
+    )
+{
+    DWORD   value;
+
+    memcpy(&value, Data, sizeof(value));                                // Unaligned read.
+    return value;
+} // LzRead32()
+
+
+
+//
+// LzHash
+//
+static inline DWORD
+LzHash(
+    __in DWORD Value
+    )
+{
+    return (Value * 2654435761U) >> (32 - SD_LZ_HASH_BITS);             // Multiplicative (Fibonacci) hashing.
+} // LzHash()
+
+
+
+//
+// LzWriteSequence
+//
+static BYTE*
+LzWriteSequence(
+    __in BYTE           *Output,
+    __in const BYTE     *OutputEnd,
+    __in const BYTE     *Literals,
+    __in size_t         NumberOfLiterals,
+    __in DWORD          Offset,
+    __in size_t         MatchLength
+    )
+/*++
+Description: The routine writes one sequence (see the format above). A MatchLength of 0 writes the last sequence (literals only).
+
+Return value: Pointer to the end of the written sequence, or NULL if it does not fit before OutputEnd.
+--*/
+{
+    size_t  length;
+
+    if ((size_t) (OutputEnd - Output) < 1 + NumberOfLiterals + NumberOfLiterals / 255 + 1 + 2 + MatchLength / 255 + 1)
+    {
+        return NULL;
+    }
+
+    length = (0 == MatchLength) ? 0 : MatchLength - SD_LZ_MIN_MATCH;
+    *Output++ = (BYTE) ((SD_MIN(NumberOfLiterals, (size_t) 15) << 4) | SD_MIN(length, (size_t) 15));
+
+    if (15 <= NumberOfLiterals)
+    {
+        for (length = NumberOfLiterals - 15; 255 <= length; length -= 255)
+        {
+            *Output++ = 255;
+        }
+        *Output++ = (BYTE) length;
+    }
+    memcpy(Output, Literals, NumberOfLiterals);
+    Output = Output + NumberOfLiterals;
+
+    if (0 == MatchLength)
+    {
+        return Output;
+    }
+
+    *Output++ = (BYTE) (Offset & 0xFF);
+    *Output++ = (BYTE) (Offset >> 8);
+
+    if (15 <= MatchLength - SD_LZ_MIN_MATCH)
+    {
+        for (length = MatchLength - SD_LZ_MIN_MATCH - 15; 255 <= length; length -= 255)
+        {
+            *Output++ = 255;
+        }
+        *Output++ = (BYTE) length;
+    }
+
+    return Output;
+} // LzWriteSequence()
+
+
+
+//
+// LzCompress
+//
+static size_t
+LzCompress(
+    __in const BYTE     *Source,
+    __in size_t         SourceSize,
+    __out BYTE          *Destination,
+    __in size_t         DestinationCapacity
+    )
+/*++
+Description: The routine compresses a block (greedy parsing, one candidate per hash entry). Where no match is found, the search
+steps faster and faster over the input, so incompressible data costs little time.
+
+Return value: The size of the compressed block, or 0 if it does not fit in DestinationCapacity bytes.
+--*/
+{
+    DWORD       positions[1 << SD_LZ_HASH_BITS];                        // Last position of each hashed 4-byte sequence.
+    const BYTE  *input;
+    const BYTE  *anchor;
+    const BYTE  *candidate;
+    const BYTE  *inputEnd;
+    const BYTE  *matchLimit;
+    const BYTE  *matchStartLimit;
+    BYTE        *output;
+    BYTE        *outputEnd;
+    size_t      matchLength;
+    DWORD       hash;
+
+    input = Source;
+    anchor = Source;
+    inputEnd = Source + SourceSize;
+    output = Destination;
+    outputEnd = Destination + DestinationCapacity;
+
+    if (SD_LZ_MATCH_START_LIMIT < SourceSize)
+    {
+        memset(positions, 0, sizeof(positions));
+        matchLimit = inputEnd - SD_LZ_LAST_LITERALS;
+        matchStartLimit = inputEnd - SD_LZ_MATCH_START_LIMIT;
+
+        while (input < matchStartLimit)
+        {
+            hash = LzHash(LzRead32(input));
+            candidate = Source + positions[hash];
+            positions[hash] = (DWORD) (input - Source);
+
+            if (candidate >= input || SD_LZ_MAX_OFFSET < input - candidate || LzRead32(candidate) != LzRead32(input))
+            {
+                input = input + 1 + ((input - anchor) >> 6);            // No match: step faster, the longer it lasts.
+                continue;
+            }
+
+            // Extend the match forwards, then backwards (over the pending literals).
+
+            for (matchLength = SD_LZ_MIN_MATCH; input + matchLength < matchLimit && candidate[matchLength] == input[matchLength]; matchLength ++);
+
+            while (input > anchor && candidate > Source && input[-1] == candidate[-1])
+            {
+                input --;
+                candidate --;
+                matchLength ++;
+            }
+
+            output = LzWriteSequence(output, outputEnd, anchor, input - anchor, (DWORD) (input - candidate), matchLength);
+            if (NULL == output)
+            {
+                return 0;
+            }
+
+            input = input + matchLength;
+            anchor = input;
+
+            if (input < matchStartLimit)
+            {
+                positions[LzHash(LzRead32(input - 2))] = (DWORD) (input - 2 - Source);
+            }
+        }
+    }
+
+    // Last literals.
+
+    output = LzWriteSequence(output, outputEnd, anchor, inputEnd - anchor, 0, 0);
+    if (NULL == output)
+    {
+        return 0;
+    }
+
+    return output - Destination;
+} // LzCompress()
+
+
+
+//
+// LzReadLength
+//
+static inline BOOL
+LzReadLength(
+    __inout const BYTE  **Input,
+    __in const BYTE     *InputEnd,
+    __inout size_t      *Length,
+    __in size_t         MaxLength
+    )
+/*++
+Description: The routine reads the extra length bytes of a sequence (see the format above) and adds them to Length.
+
+Return value: TRUE on success, FALSE if the input ends, or if the length exceeds MaxLength (corrupt block).
+--*/
+{
+    BYTE    value;
+
+    do
+    {
+        if ((*Input) >= InputEnd)
+        {
+            return FALSE;
+        }
+        value = *(*Input)++;
+        (*Length) = (*Length) + value;
+        if ((*Length) > MaxLength)
+        {
+            return FALSE;
+        }
+    } while (255 == value);
+
+    return TRUE;
+} // LzReadLength()
+
+
+
+//
+// LzDecompress
+//
+static SDSTATUS
+LzDecompress(
+    __in const BYTE     *Source,
+    __in size_t         SourceSize,
+    __out BYTE          *Destination,
+    __in size_t         DestinationSize
+    )
+/*++
+Description: The routine decompresses a block, checking every length and offset against the buffers.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (corrupt block).
+--*/
+{
+    const BYTE  *input;
+    const BYTE  *inputEnd;
+    BYTE        *output;
+    BYTE        *outputEnd;
+    const BYTE  *match;
+    size_t      numberOfLiterals;
+    size_t      matchLength;
+    size_t      offset;
+    BYTE        token;
+
+    input = Source;
+    inputEnd = Source + SourceSize;
+    output = Destination;
+    outputEnd = Destination + DestinationSize;
+
+    while (1)
+    {
+        if (input >= inputEnd)
+        {
+            return STATUS_FAIL;
+        }
+        token = *input++;
+
+        // Literals.
+
+        numberOfLiterals = token >> 4;
+        if (15 == numberOfLiterals && !LzReadLength(&input, inputEnd, &numberOfLiterals, DestinationSize))
+        {
+            return STATUS_FAIL;
+        }
+        if (numberOfLiterals > (size_t) (inputEnd - input) || numberOfLiterals > (size_t) (outputEnd - output))
+        {
+            return STATUS_FAIL;
+        }
+        memcpy(output, input, numberOfLiterals);
+        input = input + numberOfLiterals;
+        output = output + numberOfLiterals;
+
+        if (input == inputEnd)                                          // Last sequence.
+        {
+            break;
+        }
+
+        // Match.
+
+        if (2 > inputEnd - input)
+        {
+            return STATUS_FAIL;
+        }
+        offset = input[0] | (input[1] << 8);
+        input = input + 2;
+        if (0 == offset || offset > (size_t) (output - Destination))
+        {
+            return STATUS_FAIL;
+        }
+
+        matchLength = token & 15;
+        if (15 == matchLength && !LzReadLength(&input, inputEnd, &matchLength, DestinationSize))
+        {
+            return STATUS_FAIL;
+        }
+        matchLength = matchLength + SD_LZ_MIN_MATCH;
+        if (matchLength > (size_t) (outputEnd - output))
+        {
+            return STATUS_FAIL;
+        }
+
+        match = output - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(output, match, matchLength);
+            output = output + matchLength;
+        }
+        else
+        {
+            while (0 < matchLength --)                                  // Overlapping: repeats the last offset bytes.
+            {
+                *output++ = *match++;
+            }
+        }
+    }
+
+    return (output == outputEnd) ? STATUS_SUCCESS : STATUS_FAIL;
+} // LzDecompress()
+
+
+
+//
+// GetCompressionCodecName
+//
+const char*
+GetCompressionCodecName(
+    __in COMPRESSION_CODEC Codec
+    )
+/*++
+Description: The routine returns the name of a compression codec (for logging).
+
+- Codec: The compression codec.
+
+Return value: The name of the codec ("unknown" for an invalid value).
+--*/
+{
+    switch (Codec)
+    {
+        case ccNONE:
+            return "none";
+        case ccLZ:
+            return "LZ";
+        default:
+            return "unknown";
+    }
+} // GetCompressionCodecName()
+
+
+
+//
+// CompressBlock
+//
+size_t
+CompressBlock(
+    __in COMPRESSION_CODEC  Codec,
+    __in const BYTE         *Source,
+    __in size_t             SourceSize,
+    __out BYTE              *Destination,
+    __in size_t             DestinationCapacity
+    )
+/*++
+Description: The routine compresses SourceSize bytes into Destination, with the given codec.
+
+- Codec: The compression codec (not ccNONE).
+- Source: Pointer to the data to compress.
+- SourceSize: Size of the data to compress, in bytes.
+- Destination: Pointer to the output buffer.
+- DestinationCapacity: Size of the output buffer, in bytes.
+
+Return value: The size of the compressed data, or 0 if it does not fit in DestinationCapacity bytes (or on invalid parameters).
+--*/
+{
+    // Parameter validation.
+
+    if (NULL == Source || NULL == Destination)
+    {
+        printf("[SyncDir] Error: CompressBlock(): Invalid parameter 2 or 4.\n");
+        return 0;
+    }
+
+    switch (Codec)
+    {
+        case ccLZ:
+            return LzCompress(Source, SourceSize, Destination, DestinationCapacity);
+        default:
+            printf("[SyncDir] Error: CompressBlock(): Invalid codec [%d].\n", Codec);
+            return 0;
+    }
+} // CompressBlock()
+
+
+
+//
+// DecompressBlock
+//
+SDSTATUS
+DecompressBlock(
+    __in COMPRESSION_CODEC  Codec,
+    __in const BYTE         *Source,
+    __in size_t             SourceSize,
+    __out BYTE              *Destination,
+    __in size_t             DestinationSize
+    )
+/*++
+Description: The routine decompresses the output of CompressBlock(), with the given codec.
+
+- Codec: The compression codec (not ccNONE).
+- Source: Pointer to the compressed data.
+- SourceSize: Size of the compressed data, in bytes.
+- Destination: Pointer to the output buffer.
+- DestinationSize: Exact size of the decompressed data, in bytes.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (corrupt data, or other size than DestinationSize).
+--*/
+{
+    // Parameter validation.
+
+    if (NULL == Source || (NULL == Destination && 0 != DestinationSize))
+    {
+        printf("[SyncDir] Error: DecompressBlock(): Invalid parameter 2 or 4.\n");
+        return STATUS_FAIL;
+    }
+
+    switch (Codec)
+    {
+        case ccLZ:
+            return LzDecompress(Source, SourceSize, Destination, DestinationSize);
+        default:
+            printf("[SyncDir] Error: DecompressBlock(): Invalid codec [%d].\n", Codec);
+            return STATUS_FAIL;
+    }
+} // DecompressBlock()
@@ -0,0 +1,725 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_delta.h"
+
+
+
+//
+// DELTA_SORT_ENTRY - Entry sorted while building a DELTA_INDEX.
+//
+typedef struct _DELTA_SORT_ENTRY
+{
+    DWORD   Tag;
+    DWORD   WeakChecksum;
+    DWORD   BlockIndex;
+} DELTA_SORT_ENTRY;
+
+
+
+//
+// DeltaTagOfChecksum
+//
+static DWORD
+DeltaTagOfChecksum(
+    __in DWORD Checksum
+    )
+{
+    return ((Checksum & 0xFFFF) + (Checksum >> 16)) & 0xFFFF;
+}
+
+
+
+//
+// DeltaCompareSortEntries
+//
+static int
+DeltaCompareSortEntries(
+    __in const void *First,
+    __in const void *Second
+    )
+{
+    const DELTA_SORT_ENTRY *first = (const DELTA_SORT_ENTRY*) First;
+    const DELTA_SORT_ENTRY *second = (const DELTA_SORT_ENTRY*) Second;
+
+    if (first->Tag != second->Tag)
+    {
+        return first->Tag < second->Tag ? -1 : 1;
+    }
+    if (first->WeakChecksum != second->WeakChecksum)
+    {
+        return first->WeakChecksum < second->WeakChecksum ? -1 : 1;
+    }
+    return first->BlockIndex < second->BlockIndex ? -1 : (first->BlockIndex > second->BlockIndex ? 1 : 0);
+}
+
+
+
+//
+// DeltaBlockSize
+//
+DWORD
+DeltaBlockSize(
+    __in QWORD FileSize
+    )
+/*++
+Description: The routine returns the block size used for the signatures of a file of FileSize bytes: the integer square root of the
+size, rounded down to a multiple of 1 KB, within [SD_DELTA_MIN_BLOCK_SIZE, SD_DELTA_MAX_BLOCK_SIZE]. E.g. 1 MB per block for a 1 TB
+file would be too coarse, hence the upper bound; and 2 KB keeps the signatures of small files within a few packets.
+
+- FileSize: Size of the server copy of the file, in bytes.
+
+Return value: The block size, in bytes.
+--*/
+{
+    QWORD   low;
+    QWORD   high;
+    QWORD   middle;
+
+    // Integer square root (binary search).
+
+    low = 0;
+    high = SD_MIN(FileSize, (QWORD) 0xFFFFFFFF) + 1;
+    while (low + 1 < high)
+    {
+        middle = (low + high) / 2;
+        if (middle * middle <= FileSize)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    low = low & ~((QWORD) 1023);
+
+    return (DWORD) SD_MAX(SD_MIN(low, (QWORD) SD_DELTA_MAX_BLOCK_SIZE), (QWORD) SD_DELTA_MIN_BLOCK_SIZE);
+} // DeltaBlockSize()
+
+
+
+//
+// DeltaWeakChecksum
+//
+DWORD
+DeltaWeakChecksum(
+    __in const BYTE *Data,
+    __in DWORD      Length
+    )
+/*++
+Description: The routine returns the weak (rolling) checksum of Length bytes, as in rsync: a = sum of the bytes, b = sum of the bytes
+weighted by (Length - position), both modulo 2^16; the checksum is a + (b << 16). Sliding the window by one byte, out and in:
+a' = a - out + in, b' = b - Length * out + a'.
+
+- Data: Pointer to the data.
+- Length: Number of bytes.
+
+Return value: The checksum.
+--*/
+{
+    DWORD   a;
+    DWORD   b;
+    DWORD   i;
+
+    a = 0;
+    b = 0;
+
+    for (i = 0; i < Length; i ++)
+    {
+        a = a + Data[i];
+        b = b + (Length - i) * Data[i];
+    }
+
+    return (a & 0xFFFF) | ((b & 0xFFFF) << 16);
+} // DeltaWeakChecksum()
+
+
+
+//
+// DeltaStrongHashes
+//
+SDSTATUS
+DeltaStrongHashes(
+    __in HASH_ALGORITHM     Algorithm,
+    __in DWORD              NumberOfBlocks,
+    __in const BYTE         **Blocks,
+    __in const size_t       *BlockLengths,
+    __out BYTE              (*StrongHashes)[SD_DELTA_STRONG_HASH_SIZE]
+    )
+/*++
+Description: The routine outputs the strong digests of NumberOfBlocks blocks: the first SD_DELTA_STRONG_HASH_SIZE bytes of their
+digests (negotiated algorithm), converted from the hash codes output by HashMany(). All the algorithms have digests of at least
+SD_DELTA_STRONG_HASH_SIZE bytes.
+
+- Algorithm: The hash algorithm.
+- NumberOfBlocks: Number of blocks.
+- Blocks: Pointer to the NumberOfBlocks pointers to the blocks.
+- BlockLengths: Pointer to the NumberOfBlocks block lengths, in bytes.
+- StrongHashes: Pointer to where the NumberOfBlocks digests are output.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS    status;
+    char        (*hashCodes)[SD_MAX_HASH_CODE_LENGTH + 1];
+    char        hexByte[3];
+    DWORD       i;
+    DWORD       j;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    hashCodes = NULL;
+    hexByte[2] = 0;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm) || GetHashProvider(Algorithm)->DigestSize < SD_DELTA_STRONG_HASH_SIZE)
+    {
+        printf("[SyncDir] Error: DeltaStrongHashes(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (0 == NumberOfBlocks)
+    {
+        return STATUS_SUCCESS;
+    }
+    if (NULL == Blocks || NULL == BlockLengths || NULL == StrongHashes)
+    {
+        printf("[SyncDir] Error: DeltaStrongHashes(): Invalid parameters 3-5.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    hashCodes = (char (*)[SD_MAX_HASH_CODE_LENGTH + 1]) malloc(NumberOfBlocks * sizeof(*hashCodes));
+    if (NULL == hashCodes)
+    {
+        printf("[SyncDir] Error: DeltaStrongHashes(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_DeltaStrongHashes;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    status = HashMany(Algorithm, NumberOfBlocks, Blocks, BlockLengths, hashCodes);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: DeltaStrongHashes(): HashMany() failed.\n");
+        status = STATUS_FAIL;
+        goto cleanup_DeltaStrongHashes;
+    }
+
+    for (i = 0; i < NumberOfBlocks; i ++)
+    {
+        for (j = 0; j < SD_DELTA_STRONG_HASH_SIZE; j ++)
+        {
+            hexByte[0] = hashCodes[i][2 * j];
+            hexByte[1] = hashCodes[i][2 * j + 1];
+            StrongHashes[i][j] = (BYTE) strtoul(hexByte, NULL, 16);
+        }
+    }
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_DeltaStrongHashes:
+
+    if (SUCCESS(status))
+    {
+        free(hashCodes);
+        hashCodes = NULL;
+    }
+    else
+    {
+        free(hashCodes);
+        hashCodes = NULL;
+    }
+
+    return status;
+} // DeltaStrongHashes()
+
+
+
+//
+// DeltaSignaturesOfFile
+//
+SDSTATUS
+DeltaSignaturesOfFile(
+    __in HASH_ALGORITHM         Algorithm,
+    __in __int32                FileDescriptor,
+    __in DWORD                  BlockSize,
+    __in DWORD                  NumberOfBlocks,
+    __out PACKET_DELTA_BLOCK    *Blocks
+    )
+/*++
+Description: The routine outputs the signatures of the first NumberOfBlocks blocks of BlockSize bytes of a file (server side). The
+file is read in groups of blocks (about SD_FILE_READ_BUFFER_SIZE bytes), whose strong digests are computed together. The weak
+checksums are output in network byte order.
+
+- Algorithm: The hash algorithm of the strong digests.
+- FileDescriptor: Descriptor of the file, open for reading.
+- BlockSize: Size of the blocks, in bytes.
+- NumberOfBlocks: Number of blocks (the file has at least NumberOfBlocks * BlockSize bytes).
+- Blocks: Pointer to where the NumberOfBlocks signatures are output.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. the file was truncated meanwhile).
+--*/
+{
+    SDSTATUS    status;
+    BYTE        *buffer;
+    const BYTE  *groupBlocks[SD_HASH_BATCH_SIZE];
+    size_t      groupLengths[SD_HASH_BATCH_SIZE];
+    BYTE        (*groupHashes)[SD_DELTA_STRONG_HASH_SIZE];
+    DWORD       blocksPerGroup;
+    DWORD       blocksInGroup;
+    size_t      bufferSize;
+    size_t      readSoFar;
+    ssize_t     readBytes;
+    QWORD       fileOffset;
+    DWORD       i;
+    DWORD       j;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    buffer = NULL;
+    groupHashes = NULL;
+    blocksPerGroup = 0;
+    bufferSize = 0;
+
+    // Parameter validation.
+
+    if (FileDescriptor < 0)
+    {
+        printf("[SyncDir] Error: DeltaSignaturesOfFile(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (BlockSize < SD_DELTA_MIN_BLOCK_SIZE || BlockSize > SD_DELTA_MAX_BLOCK_SIZE)
+    {
+        printf("[SyncDir] Error: DeltaSignaturesOfFile(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+    if (0 == NumberOfBlocks)
+    {
+        return STATUS_SUCCESS;
+    }
+    if (NULL == Blocks)
+    {
+        printf("[SyncDir] Error: DeltaSignaturesOfFile(): Invalid parameter 5.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    blocksPerGroup = SD_MIN(SD_MAX(SD_FILE_READ_BUFFER_SIZE / BlockSize, (DWORD) 1), (DWORD) SD_HASH_BATCH_SIZE);
+    bufferSize = (size_t) blocksPerGroup * BlockSize;
+
+    buffer = (BYTE*) malloc(bufferSize);
+    groupHashes = (BYTE (*)[SD_DELTA_STRONG_HASH_SIZE]) malloc(blocksPerGroup * sizeof(*groupHashes));
+    if (NULL == buffer || NULL == groupHashes)
+    {
+        printf("[SyncDir] Error: DeltaSignaturesOfFile(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_DeltaSignaturesOfFile;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    for (i = 0; i < NumberOfBlocks; i += blocksInGroup)
+    {
+        blocksInGroup = SD_MIN(blocksPerGroup, NumberOfBlocks - i);
+        fileOffset = (QWORD) i * BlockSize;
+
+
+        // Read the group of blocks.
+
+        for (readSoFar = 0; readSoFar < (size_t) blocksInGroup * BlockSize; readSoFar += readBytes)
+        {
+            readBytes = pread(FileDescriptor, buffer + readSoFar, (size_t) blocksInGroup * BlockSize - readSoFar, fileOffset + readSoFar);
+            if (readBytes <= 0)
+            {
+                perror("[SyncDir] Error: DeltaSignaturesOfFile(): Error at pread() (or file truncated).\n");
+                status = STATUS_FAIL;
+                goto cleanup_DeltaSignaturesOfFile;
+            }
+        }
+
+
+        // Signatures.
+
+        for (j = 0; j < blocksInGroup; j ++)
+        {
+            groupBlocks[j] = buffer + (size_t) j * BlockSize;
+            groupLengths[j] = BlockSize;
+            Blocks[i + j].WeakChecksum = htonl(DeltaWeakChecksum(groupBlocks[j], BlockSize));
+        }
+
+        status = DeltaStrongHashes(Algorithm, blocksInGroup, groupBlocks, groupLengths, groupHashes);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: DeltaSignaturesOfFile(): DeltaStrongHashes() failed.\n");
+            status = STATUS_FAIL;
+            goto cleanup_DeltaSignaturesOfFile;
+        }
+
+        for (j = 0; j < blocksInGroup; j ++)
+        {
+            memcpy(Blocks[i + j].StrongHash, groupHashes[j], SD_DELTA_STRONG_HASH_SIZE);
+        }
+    }
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_DeltaSignaturesOfFile:
+
+    if (SUCCESS(status))
+    {
+        free(buffer);
+        buffer = NULL;
+        free(groupHashes);
+        groupHashes = NULL;
+    }
+    else
+    {
+        free(buffer);
+        buffer = NULL;
+        free(groupHashes);
+        groupHashes = NULL;
+    }
+
+    return status;
+} // DeltaSignaturesOfFile()
+
+
+
+//
+// DeltaBuildIndex
+//
+SDSTATUS
+DeltaBuildIndex(
+    __in HASH_ALGORITHM         Algorithm,
+    __in DWORD                  BlockSize,
+    __in DWORD                  NumberOfBlocks,
+    __in PACKET_DELTA_BLOCK     *Blocks,
+    __out DELTA_INDEX           *Index
+    )
+/*++
+Description: The routine builds the index of the block signatures received from the server (client side). As in rsync, the blocks
+are sorted by a 16-bit tag of their weak checksum, and a table of 2^16 + 1 entries gives the range of each tag: most windows are
+rejected by one table lookup, and the few candidates are found without hashing.
+
+- Algorithm: The hash algorithm of the strong digests.
+- BlockSize: Size of the blocks, in bytes.
+- NumberOfBlocks: Number of blocks.
+- Blocks: Pointer to the NumberOfBlocks signatures (weak checksums in host byte order).
+- Index: Pointer to the index to initialize.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS            status;
+    DELTA_SORT_ENTRY    *entries;
+    DWORD               i;
+    DWORD               tag;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    entries = NULL;
+
+    // Parameter validation.
+
+    if (NULL == Index)
+    {
+        printf("[SyncDir] Error: DeltaBuildIndex(): Invalid parameter 5.\n");
+        return STATUS_FAIL;
+    }
+    memset(Index, 0, sizeof(DELTA_INDEX));
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: DeltaBuildIndex(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (BlockSize < SD_DELTA_MIN_BLOCK_SIZE || BlockSize > SD_DELTA_MAX_BLOCK_SIZE)
+    {
+        printf("[SyncDir] Error: DeltaBuildIndex(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == Blocks && 0 != NumberOfBlocks)
+    {
+        printf("[SyncDir] Error: DeltaBuildIndex(): Invalid parameter 4.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    Index->Algorithm = Algorithm;
+    Index->BlockSize = BlockSize;
+    Index->NumberOfBlocks = NumberOfBlocks;
+    Index->Blocks = Blocks;
+
+    Index->TagTable = (DWORD*) calloc(0x10000 + 1, sizeof(DWORD));
+    Index->SortedBlocks = (DWORD*) malloc(SD_MAX(NumberOfBlocks, (DWORD) 1) * sizeof(DWORD));
+    entries = (DELTA_SORT_ENTRY*) malloc(SD_MAX(NumberOfBlocks, (DWORD) 1) * sizeof(DELTA_SORT_ENTRY));
+    if (NULL == Index->TagTable || NULL == Index->SortedBlocks || NULL == entries)
+    {
+        printf("[SyncDir] Error: DeltaBuildIndex(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_DeltaBuildIndex;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    for (i = 0; i < NumberOfBlocks; i ++)
+    {
+        entries[i].Tag = DeltaTagOfChecksum(Blocks[i].WeakChecksum);
+        entries[i].WeakChecksum = Blocks[i].WeakChecksum;
+        entries[i].BlockIndex = i;
+    }
+
+    if (1 < NumberOfBlocks)
+    {
+        qsort(entries, NumberOfBlocks, sizeof(DELTA_SORT_ENTRY), DeltaCompareSortEntries);
+    }
+
+
+    // Sorted block indexes, and the start of each tag range (TagTable[tag] .. TagTable[tag + 1]).
+
+    for (i = 0; i < NumberOfBlocks; i ++)
+    {
+        Index->SortedBlocks[i] = entries[i].BlockIndex;
+        Index->TagTable[entries[i].Tag + 1] ++;
+    }
+    for (tag = 0; tag < 0x10000; tag ++)
+    {
+        Index->TagTable[tag + 1] += Index->TagTable[tag];
+    }
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_DeltaBuildIndex:
+
+    if (SUCCESS(status))
+    {
+        free(entries);
+        entries = NULL;
+    }
+    else
+    {
+        free(entries);
+        entries = NULL;
+
+        DeltaFreeIndex(Index);
+    }
+
+    return status;
+} // DeltaBuildIndex()
+
+
+
+//
+// DeltaFreeIndex
+//
+void
+DeltaFreeIndex(
+    __inout DELTA_INDEX *Index
+    )
+/*++
+Description: The routine frees the memory of an index built by DeltaBuildIndex(). The signatures (Blocks) belong to the caller.
+
+- Index: Pointer to the index.
+
+Return value: None.
+--*/
+{
+    if (NULL == Index)
+    {
+        return;
+    }
+
+    free(Index->SortedBlocks);
+    Index->SortedBlocks = NULL;
+    free(Index->TagTable);
+    Index->TagTable = NULL;
+    Index->NumberOfBlocks = 0;
+} // DeltaFreeIndex()
+
+
+
+//
+// DeltaFindMatch
+//
+SDSTATUS
+DeltaFindMatch(
+    __in DELTA_INDEX    *Index,
+    __in const BYTE     *Data,
+    __in size_t         Length,
+    __inout size_t      *Offset,
+    __inout DWORD       *Checksum,
+    __inout BOOL        *IsChecksumValid,
+    __out DWORD         *BlockIndex
+    )
+/*++
+Description: The routine slides a window of BlockSize bytes over Data, from Offset, until the window matches a block of the index or
+reaches the end of Data. The weak checksum is rolled in constant time per byte, and looked up in the tag table; the strong digest of
+the window is computed only for the windows whose weak checksum matches a block (once per window, whatever the number of candidates).
+
+- Index: Pointer to the index of the block signatures.
+- Data: Pointer to the data.
+- Length: Number of bytes of Data.
+- Offset: Pointer to the offset of the first window to check. Output: offset of the matching window, or of the first window not
+checked yet (reaching past Length).
+- Checksum: Pointer to the rolling checksum of the window at Offset. Kept between calls.
+- IsChecksumValid: Pointer to the validity flag of Checksum.
+- BlockIndex: Pointer to where the index of the matching block is output, or SD_DELTA_NO_MATCH.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS    status;
+    size_t      position;
+    DWORD       blockSize;
+    DWORD       a;
+    DWORD       b;
+    DWORD       tag;
+    DWORD       candidate;
+    DWORD       i;
+    BOOL        isStrongHashComputed;
+    BYTE        strongHash[1][SD_DELTA_STRONG_HASH_SIZE];
+    const BYTE  *window[1];
+    size_t      windowLength[1];
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+
+    // Parameter validation.
+
+    if (NULL == Index || NULL == Index->TagTable || NULL == Data || NULL == Offset || NULL == Checksum || NULL == IsChecksumValid ||
+        NULL == BlockIndex)
+    {
+        printf("[SyncDir] Error: DeltaFindMatch(): Invalid parameters.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    (*BlockIndex) = SD_DELTA_NO_MATCH;
+    blockSize = Index->BlockSize;
+    position = (*Offset);
+    windowLength[0] = blockSize;
+
+    if (0 == Index->NumberOfBlocks || position + blockSize > Length)
+    {
+        // No block to match, or no whole window: the caller provides more data, or ends.
+        (*Offset) = SD_MAX(position, (Length >= blockSize ? Length - blockSize + 1 : 0));
+        (*IsChecksumValid) = FALSE;
+        return STATUS_SUCCESS;
+    }
+
+    if (FALSE == (*IsChecksumValid))
+    {
+        (*Checksum) = DeltaWeakChecksum(Data + position, blockSize);
+        (*IsChecksumValid) = TRUE;
+    }
+    a = (*Checksum) & 0xFFFF;
+    b = (*Checksum) >> 16;
+
+
+
+    //
+    // Main processing.
+    //
+
+    while (1)
+    {
+        tag = DeltaTagOfChecksum(a | (b << 16));
+        isStrongHashComputed = FALSE;
+
+        for (i = Index->TagTable[tag]; i < Index->TagTable[tag + 1]; i ++)
+        {
+            candidate = Index->SortedBlocks[i];
+            if (Index->Blocks[candidate].WeakChecksum != (a | (b << 16)))
+            {
+                continue;
+            }
+
+            if (FALSE == isStrongHashComputed)
+            {
+                window[0] = Data + position;
+                status = DeltaStrongHashes(Index->Algorithm, 1, window, windowLength, strongHash);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: DeltaFindMatch(): DeltaStrongHashes() failed.\n");
+                    return STATUS_FAIL;
+                }
+                isStrongHashComputed = TRUE;
+            }
+
+            if (0 == memcmp(strongHash[0], Index->Blocks[candidate].StrongHash, SD_DELTA_STRONG_HASH_SIZE))
+            {
+                (*BlockIndex) = candidate;
+                (*Offset) = position;
+                (*Checksum) = a | (b << 16);
+                return STATUS_SUCCESS;
+            }
+        }
+
+
+        // Slide the window by one byte, if the next window is within Data.
+
+        if (position + blockSize >= Length)
+        {
+            (*Offset) = position + 1;
+            (*IsChecksumValid) = FALSE;
+            return STATUS_SUCCESS;
+        }
+
+        a = (a - Data[position] + Data[position + blockSize]) & 0xFFFF;
+        b = (b - blockSize * Data[position] + a) & 0xFFFF;
+        position ++;
+    }
+} // DeltaFindMatch()
@@ -0,0 +1,185 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_dir_digest.h"
+
+
+
+//
+// DirDigestCompareEntries
+//
+static int
+DirDigestCompareEntries(
+    __in const void *First,
+    __in const void *Second
+    )
+{
+    return strcmp(((const DIR_DIGEST_ENTRY*) First)->Name, ((const DIR_DIGEST_ENTRY*) Second)->Name);
+}
+
+
+
+//
+// DirDigestEntryType
+//
+char
+DirDigestEntryType(
+    __in mode_t FileMode
+    )
+/*++
+Description: The routine returns the type of directory entry (SD_DIR_DIGEST_ENTRY_*) of a file, given its mode (as returned by lstat()).
+
+- FileMode: The mode of the file.
+
+Return value: The entry type.
+--*/
+{
+    if (S_ISDIR(FileMode))
+    {
+        return SD_DIR_DIGEST_ENTRY_DIRECTORY;
+    }
+    if (S_ISREG(FileMode))
+    {
+        return SD_DIR_DIGEST_ENTRY_FILE;
+    }
+    if (S_ISLNK(FileMode))
+    {
+        return SD_DIR_DIGEST_ENTRY_SYMLINK;
+    }
+
+    return SD_DIR_DIGEST_ENTRY_OTHER;
+} // DirDigestEntryType()
+
+
+
+//
+// DirDigestOfEntries
+//
+SDSTATUS
+DirDigestOfEntries(
+    __in HASH_ALGORITHM         Algorithm,
+    __inout DIR_DIGEST_ENTRY    *Entries,
+    __in DWORD                  NumberOfEntries,
+    __out char                  *DirDigest
+    )
+/*++
+Description: The routine outputs the digest of a directory, given its NumberOfEntries entries. The entries are sorted by name (strcmp()
+order, same on the client and the server), then each one is hashed as: type, name, '\0', hash code, '\0'. The separators make the
+encoding unambiguous (a name cannot contain '\0'). If the hash code of a file or the digest of a subdirectory is unknown (""), the
+routine outputs "" (unknown digest, which never matches).
+
+- Algorithm: The hash algorithm.
+- Entries: Pointer to the entries of the directory. Sorted by the routine.
+- NumberOfEntries: Number of entries.
+- DirDigest: Pointer to where the digest is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS        status;
+    HASH_CONTEXT    *hashContext;
+    DWORD           i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    hashContext = NULL;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: DirDigestOfEntries(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == Entries && 0 != NumberOfEntries)
+    {
+        printf("[SyncDir] Error: DirDigestOfEntries(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == DirDigest)
+    {
+        printf("[SyncDir] Error: DirDigestOfEntries(): Invalid parameter 4.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    DirDigest[0] = 0;
+
+    hashContext = (HASH_CONTEXT*) malloc(sizeof(HASH_CONTEXT));
+    if (NULL == hashContext)
+    {
+        printf("[SyncDir] Error: DirDigestOfEntries(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_DirDigestOfEntries;
+    }
+
+    status = HashInit(hashContext, Algorithm);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: DirDigestOfEntries(): HashInit() failed.\n");
+        status = STATUS_FAIL;
+        goto cleanup_DirDigestOfEntries;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    if (1 < NumberOfEntries)
+    {
+        qsort(Entries, NumberOfEntries, sizeof(DIR_DIGEST_ENTRY), DirDigestCompareEntries);
+    }
+
+    for (i = 0; i < NumberOfEntries; i ++)
+    {
+        if ((SD_DIR_DIGEST_ENTRY_FILE == Entries[i].Type || SD_DIR_DIGEST_ENTRY_DIRECTORY == Entries[i].Type) &&
+            0 == Entries[i].HashCode[0])
+        {
+            // Unknown: so is the directory digest.
+            status = STATUS_SUCCESS;
+            goto cleanup_DirDigestOfEntries;
+        }
+
+        HashUpdate(hashContext, &Entries[i].Type, 1);
+        HashUpdate(hashContext, Entries[i].Name, strlen(Entries[i].Name) + 1);
+        HashUpdate(hashContext, Entries[i].HashCode, strlen(Entries[i].HashCode) + 1);
+    }
+
+    HashFinal(hashContext, DirDigest);
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_DirDigestOfEntries:
+
+    if (SUCCESS(status))
+    {
+        free(hashContext);
+        hashContext = NULL;
+    }
+    else
+    {
+        free(hashContext);
+        hashContext = NULL;
+
+        // Output NULL, on fail.
+        DirDigest[0] = 0;
+    }
+
+    return status;
+} // DirDigestOfEntries()
@@ -0,0 +1,1137 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_hash.h"
+#include "syncdir_utile.h"
+
+
+
+HASH_ALGORITHM gHashAlgorithm = haMD5;                                  // Definition. Set at startup (server) or at handshake (client).
+
+
+
+//
+// Table of the supported hash algorithms. Indexed by HASH_ALGORITHM.
+//
+static const HASH_PROVIDER gHashProviders[haUNKNOWN] =
+{
+    { haMD5,        "MD5",                  SD_MD5_DIGEST_SIZE },
+    { haMURMUR3,    "MurmurHash3_x64_128",  SD_MURMUR3_DIGEST_SIZE },
+    { haBLAKE3,     "BLAKE3",               SD_BLAKE3_DIGEST_SIZE },
+};
+
+
+
+//
+// GetHashProvider
+//
+const HASH_PROVIDER*
+GetHashProvider(
+    __in HASH_ALGORITHM Algorithm
+    )
+/*++
+Description: The routine returns the description of the hash algorithm Algorithm.
+
+- Algorithm: The hash algorithm.
+
+Return value: Pointer to the (static) provider description, or NULL if the algorithm is not supported.
+--*/
+{
+    if ((DWORD) Algorithm >= (DWORD) haUNKNOWN)
+    {
+        return NULL;
+    }
+
+    return &gHashProviders[Algorithm];
+} // GetHashProvider()
+
+
+
+//
+// HashCodeLength
+//
+DWORD
+HashCodeLength(
+    __in HASH_ALGORITHM Algorithm
+    )
+/*++
+Description: The routine returns the length of the hash codes produced by Algorithm (number of hex chars, excluding '\0').
+
+- Algorithm: The hash algorithm.
+
+Return value: The hash code length, or 0 if the algorithm is not supported.
+--*/
+{
+    const HASH_PROVIDER *provider;
+
+    provider = GetHashProvider(Algorithm);
+    if (NULL == provider)
+    {
+        return 0;
+    }
+
+    return 2 * provider->DigestSize;
+} // HashCodeLength()
+
+
+
+//
+// HashInit
+//
+SDSTATUS
+HashInit(
+    __out HASH_CONTEXT      *Context,
+    __in HASH_ALGORITHM     Algorithm
+    )
+/*++
+Description: The routine initializes a hash computation with the algorithm Algorithm.
+
+- Context: Pointer to the context to be initialized. The caller provides the storage space.
+- Algorithm: The hash algorithm.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. unsupported algorithm).
+--*/
+{
+    if (NULL == Context)
+    {
+        printf("[SyncDir] Error: HashInit(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+
+    Context->Algorithm = Algorithm;
+
+    switch (Algorithm)
+    {
+        case (haMD5):
+            Md5Init(&Context->Engine.Md5);
+            break;
+
+        case (haMURMUR3):
+            Murmur3Init(&Context->Engine.Murmur3);
+            break;
+
+        case (haBLAKE3):
+            Blake3Init(&Context->Engine.Blake3);
+            break;
+
+        default:
+            printf("[SyncDir] Error: HashInit(): Invalid parameter 2 (unsupported hash algorithm %d).\n", (int) Algorithm);
+            Context->Algorithm = haUNKNOWN;
+            return STATUS_FAIL;
+    }
+
+    return STATUS_SUCCESS;
+} // HashInit()
+
+
+
+//
+// HashUpdate
+//
+void
+HashUpdate(
+    __inout HASH_CONTEXT    *Context,
+    __in const void         *Data,
+    __in size_t             DataLength
+    )
+/*++
+Description: The routine adds DataLength bytes from Data to the hash computation represented by Context.
+
+- Context: Pointer to a context initialized with HashInit().
+- Data: Pointer to the bytes to be hashed.
+- DataLength: Number of bytes at Data.
+
+Return value: None.
+--*/
+{
+    switch (Context->Algorithm)
+    {
+        case (haMD5):
+            Md5Update(&Context->Engine.Md5, Data, DataLength);
+            break;
+
+        case (haMURMUR3):
+            Murmur3Update(&Context->Engine.Murmur3, Data, DataLength);
+            break;
+
+        case (haBLAKE3):
+            Blake3Update(&Context->Engine.Blake3, Data, DataLength);
+            break;
+
+        default:
+            break;
+    }
+} // HashUpdate()
+
+
+
+//
+// HashFinal
+//
+void
+HashFinal(
+    __inout HASH_CONTEXT    *Context,
+    __out char              *HashCode
+    )
+/*++
+Description: The routine completes the hash computation and outputs the hash code (lowercase hex, '\0' terminated).
+
+- Context: Pointer to the context.
+- HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+
+Return value: None.
+--*/
+{
+    BYTE digest[SD_MAX_HASH_CODE_LENGTH / 2];
+
+    switch (Context->Algorithm)
+    {
+        case (haMD5):
+            Md5Final(&Context->Engine.Md5, digest);
+            break;
+
+        case (haMURMUR3):
+            Murmur3Final(&Context->Engine.Murmur3, digest);
+            break;
+
+        case (haBLAKE3):
+            Blake3Final(&Context->Engine.Blake3, digest);
+            break;
+
+        default:
+            HashCode[0] = 0;
+            return;
+    }
+
+    BytesToHexString(digest, gHashProviders[Context->Algorithm].DigestSize, HashCode);
+} // HashFinal()
+
+
+
+//
+// HashOfFileDescriptor
+//
+SDSTATUS
+HashOfFileDescriptor(
+    __in HASH_ALGORITHM     Algorithm,
+    __in __int32            FileDescriptor,
+    __out char              *HashCode
+    )
+/*++
+Description: The routine outputs the hash code of the content of the file identified by FileDescriptor, which must be positioned at
+the start of the file. The content is streamed through a large page-aligned buffer, so the memory usage does not depend on the file
+size. Regular files of at least SD_HASH_PARALLEL_MIN_SIZE bytes are hashed by several threads, if the algorithm allows it (BLAKE3).
+
+- Algorithm: The hash algorithm.
+- FileDescriptor: Descriptor of the file, open for reading.
+- HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS        status;
+    HASH_CONTEXT    *hashContext;
+    BYTE            *readBuffer;
+    ssize_t         readBytes;
+    struct stat     fileStat;
+    long            numberOfThreads;
+    BYTE            digest[SD_BLAKE3_DIGEST_SIZE];
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    hashContext = NULL;
+    readBuffer = NULL;
+    readBytes = -1;
+    numberOfThreads = SD_HASH_MAX_THREADS;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: HashOfFileDescriptor(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (FileDescriptor < 0)
+    {
+        printf("[SyncDir] Error: HashOfFileDescriptor(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCode)
+    {
+        printf("[SyncDir] Error: HashOfFileDescriptor(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    if (0 == numberOfThreads)
+    {
+        numberOfThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+
+    // Large regular file and tree hash: hash segments of the file in parallel.
+
+    if (haBLAKE3 == Algorithm && 1 < numberOfThreads && 0 == fstat(FileDescriptor, &fileStat) && S_ISREG(fileStat.st_mode) &&
+        SD_HASH_PARALLEL_MIN_SIZE <= fileStat.st_size)
+    {
+        status = Blake3HashOfFileDescriptorParallel(FileDescriptor, fileStat.st_size, numberOfThreads, digest);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: HashOfFileDescriptor(): Blake3HashOfFileDescriptorParallel() failed.\n");
+            status = STATUS_FAIL;
+            goto cleanup_HashOfFileDescriptor;
+        }
+
+        BytesToHexString(digest, SD_BLAKE3_DIGEST_SIZE, HashCode);
+        status = STATUS_SUCCESS;
+        goto cleanup_HashOfFileDescriptor;
+    }
+
+
+    // Otherwise, stream the content once, from start to end.
+
+    hashContext = (HASH_CONTEXT*) malloc(sizeof(HASH_CONTEXT));
+    if (NULL == hashContext)
+    {
+        printf("[SyncDir] Error: HashOfFileDescriptor(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashOfFileDescriptor;
+    }
+
+    if (0 != posix_memalign((void**) &readBuffer, SD_FILE_READ_BUFFER_ALIGNMENT, SD_FILE_READ_BUFFER_SIZE))
+    {
+        printf("[SyncDir] Error: HashOfFileDescriptor(): Error at posix_memalign().\n");
+        readBuffer = NULL;
+        status = STATUS_FAIL;
+        goto cleanup_HashOfFileDescriptor;
+    }
+
+    // Let the kernel read ahead aggressively (advice only, errors are ignored).
+    posix_fadvise(FileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    status = HashInit(hashContext, Algorithm);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: HashOfFileDescriptor(): HashInit() failed.\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashOfFileDescriptor;
+    }
+
+    while (1)
+    {
+        readBytes = read(FileDescriptor, readBuffer, FileReadQuota(SD_FILE_READ_BUFFER_SIZE));
+        if (readBytes < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            perror("[SyncDir] Error: HashOfFileDescriptor(): Error at read().\n");
+            status = STATUS_FAIL;
+            goto cleanup_HashOfFileDescriptor;
+        }
+        if (0 == readBytes)
+        {
+            break;                                                      // EOF.
+        }
+
+        HashUpdate(hashContext, readBuffer, (size_t) readBytes);
+    }
+
+    HashFinal(hashContext, HashCode);
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_HashOfFileDescriptor:
+
+    if (SUCCESS(status))
+    {
+        free(readBuffer);
+        readBuffer = NULL;
+        free(hashContext);
+        hashContext = NULL;
+    }
+    else
+    {
+        free(readBuffer);
+        readBuffer = NULL;
+        free(hashContext);
+        hashContext = NULL;
+
+        // Output NULL, on fail.
+        HashCode[0] = 0;
+    }
+
+    return status;
+} // HashOfFileDescriptor()
+
+
+
+//
+// HashAndReadFileDescriptor
+//
+SDSTATUS
+HashAndReadFileDescriptor(
+    __in HASH_ALGORITHM     Algorithm,
+    __in __int32            FileDescriptor,
+    __in size_t             ContentLimit,
+    __out BYTE              **Content,
+    __out QWORD             *ContentLength,
+    __out char              *HashCode
+    )
+/*++
+Description: The routine reads the file identified by FileDescriptor (positioned at the start of the file) once, keeps its content in
+memory and outputs its hash code, computed while reading: every piece is hashed right after it was read, while it is still in the CPU
+caches. If the content exceeds ContentLimit bytes (already at fstat(), or because the file grew meanwhile), it is hashed but not kept,
+and NULL is output at Content: the caller may read it again from the same descriptor, only if needed. Files known to be too large from
+the start are hashed by HashOfFileDescriptor() (in parallel, if possible).
+
+- Algorithm: The hash algorithm.
+- FileDescriptor: Descriptor of the file, open for reading.
+- ContentLimit: Maximum number of bytes kept in memory.
+- Content: Pointer to where the routine outputs the address of the content (allocated by the routine, released by the caller with
+free()), or NULL if the content was not kept.
+- ContentLength: Pointer to where the routine outputs the number of bytes hashed (the file size, as read).
+- HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS        status;
+    HASH_CONTEXT    *hashContext;
+    struct stat     fileStat;
+    BYTE            *buffer;
+    BYTE            *newBuffer;
+    size_t          bufferCapacity;
+    size_t          bufferLength;
+    size_t          toRead;
+    ssize_t         readBytes;
+    QWORD           totalLength;
+    BOOL            isContentKept;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    hashContext = NULL;
+    buffer = NULL;
+    newBuffer = NULL;
+    bufferCapacity = 0;
+    bufferLength = 0;
+    readBytes = -1;
+    totalLength = 0;
+    isContentKept = TRUE;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: HashAndReadFileDescriptor(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (FileDescriptor < 0)
+    {
+        printf("[SyncDir] Error: HashAndReadFileDescriptor(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == Content)
+    {
+        printf("[SyncDir] Error: HashAndReadFileDescriptor(): Invalid parameter 4.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == ContentLength)
+    {
+        printf("[SyncDir] Error: HashAndReadFileDescriptor(): Invalid parameter 5.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCode)
+    {
+        printf("[SyncDir] Error: HashAndReadFileDescriptor(): Invalid parameter 6.\n");
+        return STATUS_FAIL;
+    }
+
+    (*Content) = NULL;
+    (*ContentLength) = 0;
+
+
+    //
+    // INIT.
+    //
+
+    if (fstat(FileDescriptor, &fileStat) < 0)
+    {
+        perror("[SyncDir] Error: HashAndReadFileDescriptor(): Error at fstat().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashAndReadFileDescriptor;
+    }
+
+
+    // Too large to be kept: only hash it (the caller reads it again, if needed).
+
+    if ((QWORD) fileStat.st_size > (QWORD) ContentLimit)
+    {
+        status = HashOfFileDescriptor(Algorithm, FileDescriptor, HashCode);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: HashAndReadFileDescriptor(): HashOfFileDescriptor() failed.\n");
+            status = STATUS_FAIL;
+            goto cleanup_HashAndReadFileDescriptor;
+        }
+
+        (*ContentLength) = fileStat.st_size;
+        status = STATUS_SUCCESS;
+        goto cleanup_HashAndReadFileDescriptor;
+    }
+
+
+    // Buffer for the whole content (plus one byte, to detect growth without an extra reallocation).
+
+    bufferCapacity = (size_t) fileStat.st_size + 1;
+    buffer = (BYTE*) malloc(SD_MAX(bufferCapacity, (size_t) SD_FILE_READ_BUFFER_ALIGNMENT));
+    if (NULL == buffer)
+    {
+        printf("[SyncDir] Error: HashAndReadFileDescriptor(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashAndReadFileDescriptor;
+    }
+    bufferCapacity = SD_MAX(bufferCapacity, (size_t) SD_FILE_READ_BUFFER_ALIGNMENT);
+
+    hashContext = (HASH_CONTEXT*) malloc(sizeof(HASH_CONTEXT));
+    if (NULL == hashContext)
+    {
+        printf("[SyncDir] Error: HashAndReadFileDescriptor(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashAndReadFileDescriptor;
+    }
+
+    status = HashInit(hashContext, Algorithm);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: HashAndReadFileDescriptor(): HashInit() failed.\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashAndReadFileDescriptor;
+    }
+
+    // Let the kernel read ahead aggressively (advice only, errors are ignored).
+    posix_fadvise(FileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+
+
+    //
+    // Main processing.
+    //
+
+
+    // Read and hash, piece by piece, until EOF.
+
+    while (1)
+    {
+        // Buffer full: the file grew. Grow the buffer while under the limit, otherwise keep hashing through the buffer
+        // start (the content is dropped).
+
+        if (bufferLength == bufferCapacity)
+        {
+            if (TRUE == isContentKept && bufferCapacity < ContentLimit)
+            {
+                newBuffer = (BYTE*) realloc(buffer, SD_MIN(2 * bufferCapacity, ContentLimit));
+                if (NULL == newBuffer)
+                {
+                    printf("[SyncDir] Error: HashAndReadFileDescriptor(): Error at realloc().\n");
+                    status = STATUS_FAIL;
+                    goto cleanup_HashAndReadFileDescriptor;
+                }
+                buffer = newBuffer;
+                bufferCapacity = SD_MIN(2 * bufferCapacity, ContentLimit);
+            }
+            else
+            {
+                isContentKept = FALSE;
+                bufferLength = 0;
+            }
+        }
+
+        toRead = SD_MIN(bufferCapacity - bufferLength, (size_t) SD_FILE_READ_BUFFER_SIZE);
+
+        readBytes = read(FileDescriptor, buffer + bufferLength, FileReadQuota(toRead));
+        if (readBytes < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            perror("[SyncDir] Error: HashAndReadFileDescriptor(): Error at read().\n");
+            status = STATUS_FAIL;
+            goto cleanup_HashAndReadFileDescriptor;
+        }
+        if (0 == readBytes)
+        {
+            break;                                                      // EOF.
+        }
+
+        HashUpdate(hashContext, buffer + bufferLength, (size_t) readBytes);
+        bufferLength = bufferLength + readBytes;
+        totalLength = totalLength + readBytes;
+    }
+
+    HashFinal(hashContext, HashCode);
+
+    (*ContentLength) = totalLength;
+    if (TRUE == isContentKept)
+    {
+        (*Content) = buffer;
+        buffer = NULL;                                                  // Ownership passed to the caller.
+    }
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_HashAndReadFileDescriptor:
+
+    if (SUCCESS(status))
+    {
+        free(buffer);
+        buffer = NULL;
+        free(hashContext);
+        hashContext = NULL;
+    }
+    else
+    {
+        free(buffer);
+        buffer = NULL;
+        free(hashContext);
+        hashContext = NULL;
+
+        // Output NULL, on fail.
+        HashCode[0] = 0;
+        (*ContentLength) = 0;
+    }
+
+    return status;
+} // HashAndReadFileDescriptor()
+
+
+
+//
+// HashOfFile
+//
+SDSTATUS
+HashOfFile(
+    __in HASH_ALGORITHM     Algorithm,
+    __in const char         *FileFullPath,
+    __out char              *HashCode
+    )
+/*++
+Description: The routine outputs the hash code of the content of the file at FileFullPath (symbolic links are followed).
+
+- Algorithm: The hash algorithm.
+- FileFullPath: Pointer to the full path of the file.
+- HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS    status;
+    __int32     fileDescriptor;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    fileDescriptor = -1;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: HashOfFile(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileFullPath)
+    {
+        printf("[SyncDir] Error: HashOfFile(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCode)
+    {
+        printf("[SyncDir] Error: HashOfFile(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    fileDescriptor = open(FileFullPath, O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0)
+    {
+        perror("[SyncDir] Error: HashOfFile(): Error at open(). (File may not exist anymore.)\n");
+        printf("open() error was for file [%s].\n", FileFullPath);
+        status = STATUS_FAIL;
+        goto cleanup_HashOfFile;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    status = HashOfFileDescriptor(Algorithm, fileDescriptor, HashCode);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: HashOfFile(): HashOfFileDescriptor() failed for file [%s].\n", FileFullPath);
+        status = STATUS_FAIL;
+        goto cleanup_HashOfFile;
+    }
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_HashOfFile:
+
+    if (SUCCESS(status))
+    {
+        if (0 <= fileDescriptor)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+    }
+    else
+    {
+        if (0 <= fileDescriptor)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+
+        // Output NULL, on fail.
+        HashCode[0] = 0;
+    }
+
+    return status;
+} // HashOfFile()
+
+
+
+//
+// HashMany
+//
+SDSTATUS
+HashMany(
+    __in HASH_ALGORITHM     Algorithm,
+    __in DWORD              NumberOfInputs,
+    __in const BYTE         **Inputs,
+    __in const size_t       *InputLengths,
+    __out char              (*HashCodes)[SD_MAX_HASH_CODE_LENGTH + 1]
+    )
+/*++
+Description: The routine outputs the hash codes of NumberOfInputs independent inputs. MD5 and BLAKE3 hash several inputs at once, one
+per vector lane (see Md5HashMany() and Blake3HashMany()). MurmurHash3 is based on 64-bit multiplications, which the vector units
+lack (before AVX-512), and is already faster than the reads: its inputs are hashed one by one.
+
+- Algorithm: The hash algorithm.
+- NumberOfInputs: Number of inputs.
+- Inputs: Pointer to the NumberOfInputs pointers to the inputs.
+- InputLengths: Pointer to the NumberOfInputs input lengths, in bytes.
+- HashCodes: Pointer to where the NumberOfInputs hash codes are output.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS        status;
+    BYTE            (*digests)[SD_MAX_HASH_CODE_LENGTH / 2];
+    HASH_CONTEXT    *hashContext;
+    DWORD           digestSize;
+    DWORD           i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    digests = NULL;
+    hashContext = NULL;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: HashMany(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (0 == NumberOfInputs)
+    {
+        return STATUS_SUCCESS;
+    }
+    if (NULL == Inputs)
+    {
+        printf("[SyncDir] Error: HashMany(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == InputLengths)
+    {
+        printf("[SyncDir] Error: HashMany(): Invalid parameter 4.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCodes)
+    {
+        printf("[SyncDir] Error: HashMany(): Invalid parameter 5.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    digestSize = gHashProviders[Algorithm].DigestSize;
+
+    digests = malloc(NumberOfInputs * sizeof(*digests));
+    if (NULL == digests)
+    {
+        printf("[SyncDir] Error: HashMany(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashMany;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    switch (Algorithm)
+    {
+        case (haMD5):
+            Md5HashMany(NumberOfInputs, Inputs, InputLengths, (BYTE (*)[SD_MD5_DIGEST_SIZE]) digests);
+            break;
+
+        case (haBLAKE3):
+            Blake3HashMany(NumberOfInputs, Inputs, InputLengths, (BYTE (*)[SD_BLAKE3_DIGEST_SIZE]) digests);
+            break;
+
+        default:
+            // One by one.
+            hashContext = (HASH_CONTEXT*) malloc(sizeof(HASH_CONTEXT));
+            if (NULL == hashContext)
+            {
+                printf("[SyncDir] Error: HashMany(): Error at malloc().\n");
+                status = STATUS_FAIL;
+                goto cleanup_HashMany;
+            }
+            for (i = 0; i < NumberOfInputs; i ++)
+            {
+                HashInit(hashContext, Algorithm);
+                HashUpdate(hashContext, Inputs[i], InputLengths[i]);
+                HashFinal(hashContext, HashCodes[i]);
+            }
+            status = STATUS_SUCCESS;
+            goto cleanup_HashMany;
+    }
+
+    // The digests of the multi-buffer algorithms are packed (digestSize bytes each).
+
+    for (i = 0; i < NumberOfInputs; i ++)
+    {
+        BytesToHexString((BYTE*) digests + (size_t) i * digestSize, digestSize, HashCodes[i]);
+    }
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_HashMany:
+
+    if (SUCCESS(status))
+    {
+        free(digests);
+        digests = NULL;
+        free(hashContext);
+        hashContext = NULL;
+    }
+    else
+    {
+        free(digests);
+        digests = NULL;
+        free(hashContext);
+        hashContext = NULL;
+    }
+
+    return status;
+} // HashMany()
+
+
+
+//
+// HashOfFileBatch
+//
+SDSTATUS
+HashOfFileBatch(
+    __in HASH_ALGORITHM     Algorithm,
+    __in DWORD              NumberOfFiles,
+    __in const char         **FileFullPaths,
+    __out char              (*HashCodes)[SD_MAX_HASH_CODE_LENGTH + 1],
+    __out_opt struct stat   *FileStats,
+    __out SDSTATUS          *Statuses
+    )
+/*++
+Description: The routine outputs the hash codes of the contents of NumberOfFiles files (symbolic links are followed). The regular files
+of at most SD_HASH_BATCH_MAX_FILE_SIZE bytes are read into one arena, then hashed together by HashMany(), so that the (many) small
+files found by the startup scans keep all the vector lanes busy. The other files (larger, not regular, or grown while read) are hashed
+one by one, by HashOfFileDescriptor(). The failure of one file is reported in Statuses and does not stop the others.
+
+- Algorithm: The hash algorithm.
+- NumberOfFiles: Number of files. At most SD_HASH_BATCH_SIZE.
+- FileFullPaths: Pointer to the NumberOfFiles full paths of the files.
+- HashCodes: Pointer to where the NumberOfFiles hash codes are output.
+- FileStats: Optional pointer to where the routine outputs the NumberOfFiles file statuses (fstat(), before the content was read).
+- Statuses: Pointer to where the routine outputs the NumberOfFiles results (STATUS_SUCCESS or STATUS_FAIL, for each file).
+
+Return value: STATUS_SUCCESS if all the files were hashed, STATUS_WARNING if some of them failed, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS        status;
+    BYTE            *arena;
+    const BYTE      *inputs[SD_HASH_BATCH_SIZE];
+    size_t          inputLengths[SD_HASH_BATCH_SIZE];
+    DWORD           inputFiles[SD_HASH_BATCH_SIZE];                     // Index of the file of each batched input.
+    char            (*inputHashCodes)[SD_MAX_HASH_CODE_LENGTH + 1];
+    DWORD           numberOfInputs;
+    __int32         fileDescriptor;
+    struct stat     fileStat;
+    BYTE            *slot;
+    size_t          slotLength;
+    ssize_t         readBytes;
+    DWORD           numberOfFailed;
+    DWORD           i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    arena = NULL;
+    inputHashCodes = NULL;
+    numberOfInputs = 0;
+    memset(inputLengths, 0, sizeof(inputLengths));
+    fileDescriptor = -1;
+    numberOfFailed = 0;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: HashOfFileBatch(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NumberOfFiles > SD_HASH_BATCH_SIZE)
+    {
+        printf("[SyncDir] Error: HashOfFileBatch(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileFullPaths)
+    {
+        printf("[SyncDir] Error: HashOfFileBatch(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCodes)
+    {
+        printf("[SyncDir] Error: HashOfFileBatch(): Invalid parameter 4.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == Statuses)
+    {
+        printf("[SyncDir] Error: HashOfFileBatch(): Invalid parameter 6.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    // One slot per file, one byte larger than the limit (to detect files which grew).
+    arena = (BYTE*) malloc(SD_MAX(NumberOfFiles, 1) * (size_t) (SD_HASH_BATCH_MAX_FILE_SIZE + 1));
+    inputHashCodes = malloc(SD_MAX(NumberOfFiles, 1) * sizeof(*inputHashCodes));
+    if (NULL == arena || NULL == inputHashCodes)
+    {
+        printf("[SyncDir] Error: HashOfFileBatch(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashOfFileBatch;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+
+    // Read the small files into the arena. Hash the others right away.
+
+    for (i = 0; i < NumberOfFiles; i ++)
+    {
+        Statuses[i] = STATUS_FAIL;
+        HashCodes[i][0] = 0;
+
+        fileDescriptor = open(FileFullPaths[i], O_RDONLY | O_CLOEXEC);
+        if (fileDescriptor < 0)
+        {
+            perror("[SyncDir] Error: HashOfFileBatch(): Error at open(). (File may not exist anymore.)\n");
+            printf("open() error was for file [%s].\n", FileFullPaths[i]);
+            numberOfFailed ++;
+            continue;
+        }
+
+        if (fstat(fileDescriptor, &fileStat) < 0)
+        {
+            perror("[SyncDir] Error: HashOfFileBatch(): Error at fstat().\n");
+            close(fileDescriptor);
+            fileDescriptor = -1;
+            numberOfFailed ++;
+            continue;
+        }
+        if (NULL != FileStats)
+        {
+            FileStats[i] = fileStat;
+        }
+
+        slot = arena + (size_t) i * (SD_HASH_BATCH_MAX_FILE_SIZE + 1);
+        slotLength = 0;
+        readBytes = -1;
+
+        if (S_ISREG(fileStat.st_mode) && fileStat.st_size <= SD_HASH_BATCH_MAX_FILE_SIZE)
+        {
+            while (slotLength < SD_HASH_BATCH_MAX_FILE_SIZE + 1)
+            {
+                readBytes = read(fileDescriptor, slot + slotLength, FileReadQuota(SD_HASH_BATCH_MAX_FILE_SIZE + 1 - slotLength));
+                if (readBytes < 0 && EINTR == errno)
+                {
+                    continue;
+                }
+                if (readBytes <= 0)
+                {
+                    break;                                              // EOF or error.
+                }
+                slotLength = slotLength + readBytes;
+            }
+
+            if (readBytes < 0)
+            {
+                perror("[SyncDir] Error: HashOfFileBatch(): Error at read().\n");
+                printf("read() error was for file [%s].\n", FileFullPaths[i]);
+                close(fileDescriptor);
+                fileDescriptor = -1;
+                numberOfFailed ++;
+                continue;
+            }
+
+            if (slotLength <= SD_HASH_BATCH_MAX_FILE_SIZE)
+            {
+                inputs[numberOfInputs] = slot;
+                inputLengths[numberOfInputs] = slotLength;
+                inputFiles[numberOfInputs] = i;
+                numberOfInputs ++;
+
+                close(fileDescriptor);
+                fileDescriptor = -1;
+                continue;
+            }
+
+            // Grew while read: hash it alone, from the start.
+            if (lseek(fileDescriptor, 0, SEEK_SET) < 0)
+            {
+                perror("[SyncDir] Error: HashOfFileBatch(): Error at lseek().\n");
+                close(fileDescriptor);
+                fileDescriptor = -1;
+                numberOfFailed ++;
+                continue;
+            }
+        }
+
+        if (SUCCESS(HashOfFileDescriptor(Algorithm, fileDescriptor, HashCodes[i])))
+        {
+            Statuses[i] = STATUS_SUCCESS;
+        }
+        else
+        {
+            printf("[SyncDir] Error: HashOfFileBatch(): HashOfFileDescriptor() failed for file [%s].\n", FileFullPaths[i]);
+            numberOfFailed ++;
+        }
+
+        close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+
+
+    // Hash the small files together.
+
+    status = HashMany(Algorithm, numberOfInputs, inputs, inputLengths, inputHashCodes);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: HashOfFileBatch(): HashMany() failed.\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashOfFileBatch;
+    }
+
+    for (i = 0; i < numberOfInputs; i ++)
+    {
+        memcpy(HashCodes[inputFiles[i]], inputHashCodes[i], sizeof(inputHashCodes[i]));
+        Statuses[inputFiles[i]] = STATUS_SUCCESS;
+    }
+
+
+
+    // If here, everything worked well (maybe except for some files).
+    status = (0 == numberOfFailed) ? STATUS_SUCCESS : STATUS_WARNING;
+
+    // UNINIT. Cleanup.
+    cleanup_HashOfFileBatch:
+
+    if (SUCCESS(status))
+    {
+        free(arena);
+        arena = NULL;
+        free(inputHashCodes);
+        inputHashCodes = NULL;
+    }
+    else
+    {
+        free(arena);
+        arena = NULL;
+        free(inputHashCodes);
+        inputHashCodes = NULL;
+
+        // Output fail, for all the files.
+        for (i = 0; i < NumberOfFiles; i ++)
+        {
+            Statuses[i] = STATUS_FAIL;
+        }
+    }
+
+    return status;
+} // HashOfFileBatch()
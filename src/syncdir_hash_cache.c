@@ -0,0 +1,889 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_hash_cache.h"
+#include <sys/file.h>
+#include <time.h>
+
+
+
+extern FILE *g_SD_STDLOG;                                               // From the client (or server) main source file.
+
+HASH_CACHE gHashCache = { -1, 0, NULL, NULL, PTHREAD_MUTEX_INITIALIZER };   // Definition. Closed, until HashCacheOpen().
+
+
+
+//
+// Internal helpers.
+//
+
+static inline QWORD
+HashCacheTimeNs(
+    __in const struct timespec *Time
+    )
+{
+    return (QWORD) Time->tv_sec * 1000000000ULL + (QWORD) Time->tv_nsec;
+}
+
+
+static inline QWORD
+HashCacheSlot(
+    __in QWORD Device,
+    __in QWORD Inode,
+    __in QWORD Capacity
+    )
+{
+    QWORD mix;
+
+    mix = Inode ^ (Device * 0xFF51AFD7ED558CCDULL);
+    mix = mix * 0x9E3779B97F4A7C15ULL;
+
+    return (mix ^ (mix >> 32)) & (Capacity - 1);
+}
+
+
+static inline size_t
+HashCacheFileSize(
+    __in QWORD Capacity
+    )
+{
+    return sizeof(HASH_CACHE_HEADER) + (size_t) Capacity * sizeof(HASH_CACHE_ENTRY);
+}
+
+
+
+//
+// HashCacheMap
+//
+static SDSTATUS
+HashCacheMap(
+    __in QWORD  Capacity,
+    __in BOOL   IsReset
+    )
+/*++
+Description: The routine maps the cache file (gHashCache.FileDescriptor) in memory, for Capacity entries. If IsReset is TRUE, the
+file is first emptied and a new header is written. Any previous mapping must have been removed by the caller.
+
+- Capacity: Number of entries (power of 2).
+- IsReset: TRUE to reinitialize the file content, FALSE to map the existing content.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    void    *map;
+    size_t  mapSize;
+
+    mapSize = HashCacheFileSize(Capacity);
+
+    if (TRUE == IsReset)
+    {
+        if (ftruncate(gHashCache.FileDescriptor, 0) < 0 || ftruncate(gHashCache.FileDescriptor, mapSize) < 0)   // Zero filled.
+        {
+            perror("[SyncDir] Error: HashCacheMap(): Error at ftruncate().\n");
+            return STATUS_FAIL;
+        }
+    }
+
+    map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, gHashCache.FileDescriptor, 0);
+    if (MAP_FAILED == map)
+    {
+        perror("[SyncDir] Error: HashCacheMap(): Error at mmap().\n");
+        return STATUS_FAIL;
+    }
+
+    gHashCache.MapSize = mapSize;
+    gHashCache.Header = (HASH_CACHE_HEADER*) map;
+    gHashCache.Entries = (HASH_CACHE_ENTRY*) ((BYTE*) map + sizeof(HASH_CACHE_HEADER));
+
+    if (TRUE == IsReset)
+    {
+        gHashCache.Header->Magic = SD_HASH_CACHE_MAGIC;
+        gHashCache.Header->Version = SD_HASH_CACHE_VERSION;
+        gHashCache.Header->Capacity = Capacity;
+        gHashCache.Header->Count = 0;
+    }
+
+    return STATUS_SUCCESS;
+} // HashCacheMap()
+
+
+
+//
+// HashCacheUnmap
+//
+static void
+HashCacheUnmap(
+    void
+    )
+{
+    if (NULL != gHashCache.Header)
+    {
+        munmap(gHashCache.Header, gHashCache.MapSize);
+        gHashCache.Header = NULL;
+        gHashCache.Entries = NULL;
+        gHashCache.MapSize = 0;
+    }
+}
+
+
+
+//
+// HashCacheFindEntry
+//
+static HASH_CACHE_ENTRY*
+HashCacheFindEntry(
+    __in QWORD Device,
+    __in QWORD Inode
+    )
+/*++
+Description: The routine returns the entry of the file identified by (Device, Inode) or, if there is none, the free entry where it
+should be stored (linear probing). The table is never full (see HashCacheGrow()).
+
+- Device: Device of the file.
+- Inode: Inode of the file.
+
+Return value: Pointer to the entry.
+--*/
+{
+    QWORD               capacity;
+    QWORD               slot;
+    HASH_CACHE_ENTRY    *entry;
+
+    capacity = gHashCache.Header->Capacity;
+    slot = HashCacheSlot(Device, Inode, capacity);
+
+    while (1)
+    {
+        entry = &gHashCache.Entries[slot];
+        if (FALSE == entry->IsUsed || (Device == entry->Device && Inode == entry->Inode))
+        {
+            return entry;
+        }
+        slot = (slot + 1) & (capacity - 1);
+    }
+} // HashCacheFindEntry()
+
+
+
+//
+// HashCacheGrow
+//
+static SDSTATUS
+HashCacheGrow(
+    void
+    )
+/*++
+Description: The routine doubles the number of entries of the cache, keeping the stored hash codes.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the cache is closed).
+--*/
+{
+    SDSTATUS            status;
+    HASH_CACHE_ENTRY    *oldEntries;
+    HASH_CACHE_ENTRY    *newEntry;
+    QWORD               oldCapacity;
+    QWORD               index;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    oldEntries = NULL;
+    oldCapacity = gHashCache.Header->Capacity;
+
+    // INIT.
+
+    oldEntries = (HASH_CACHE_ENTRY*) malloc(oldCapacity * sizeof(HASH_CACHE_ENTRY));
+    if (NULL == oldEntries)
+    {
+        printf("[SyncDir] Error: HashCacheGrow(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheGrow;
+    }
+    memcpy(oldEntries, gHashCache.Entries, oldCapacity * sizeof(HASH_CACHE_ENTRY));
+
+
+    // Main processing: new (empty) table, then re-insert.
+
+    HashCacheUnmap();
+
+    status = HashCacheMap(2 * oldCapacity, TRUE);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: HashCacheGrow(): HashCacheMap() failed.\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheGrow;
+    }
+
+    for (index = 0; index < oldCapacity; index++)
+    {
+        if (FALSE == oldEntries[index].IsUsed)
+        {
+            continue;
+        }
+        newEntry = HashCacheFindEntry(oldEntries[index].Device, oldEntries[index].Inode);
+        (*newEntry) = oldEntries[index];
+        gHashCache.Header->Count++;
+    }
+
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: HashCacheGrow(): Hash cache grown to [%llu] entries. \n",
+            (unsigned long long) gHashCache.Header->Capacity);
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_HashCacheGrow:
+
+    if (SUCCESS(status))
+    {
+        free(oldEntries);
+        oldEntries = NULL;
+    }
+    else
+    {
+        free(oldEntries);
+        oldEntries = NULL;
+
+        HashCacheClose();                                               // Continue without cache.
+    }
+
+    return status;
+} // HashCacheGrow()
+
+
+
+//
+// HashCacheOpen
+//
+SDSTATUS
+HashCacheOpen(
+    __in char   *CacheFilePath
+    )
+/*++
+Description: The routine opens (creating it, if needed) the cache file at CacheFilePath and maps it in memory (gHashCache). An invalid
+cache file (e.g. other version, truncated) is reset. The file is locked, so that only one SyncDir client uses it.
+
+- CacheFilePath: Pointer to the full path of the cache file.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the cache stays closed, lookups miss).
+--*/
+{
+    SDSTATUS            status;
+    struct stat         cacheStat;
+    HASH_CACHE_HEADER   header;
+    BOOL                isValid;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    isValid = FALSE;
+
+    // Parameter validation.
+
+    if (NULL == CacheFilePath || 0 == CacheFilePath[0])
+    {
+        printf("[SyncDir] Error: HashCacheOpen(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (0 <= gHashCache.FileDescriptor)
+    {
+        printf("[SyncDir] Error: HashCacheOpen(): The hash cache is already open.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    gHashCache.FileDescriptor = open(CacheFilePath, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (gHashCache.FileDescriptor < 0)
+    {
+        perror("[SyncDir] Error: HashCacheOpen(): Error at opening the cache file.\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheOpen;
+    }
+
+    if (flock(gHashCache.FileDescriptor, LOCK_EX | LOCK_NB) < 0)
+    {
+        perror("[SyncDir] Error: HashCacheOpen(): The cache file is used by another process.\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheOpen;
+    }
+
+    if (fstat(gHashCache.FileDescriptor, &cacheStat) < 0)
+    {
+        perror("[SyncDir] Error: HashCacheOpen(): Error at fstat().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheOpen;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+
+    // Validate the existing content (header and size).
+
+    if ((size_t) cacheStat.st_size >= sizeof(HASH_CACHE_HEADER) &&
+        sizeof(HASH_CACHE_HEADER) == pread(gHashCache.FileDescriptor, &header, sizeof(HASH_CACHE_HEADER), 0))
+    {
+        isValid = SD_HASH_CACHE_MAGIC == header.Magic && SD_HASH_CACHE_VERSION == header.Version && 0 != header.Capacity &&
+                  0 == (header.Capacity & (header.Capacity - 1)) && header.Count < header.Capacity &&
+                  (size_t) cacheStat.st_size == HashCacheFileSize(header.Capacity);
+    }
+
+    if (TRUE == isValid)
+    {
+        status = HashCacheMap(header.Capacity, FALSE);
+    }
+    else
+    {
+        if (0 != cacheStat.st_size)
+        {
+            printf("[SyncDir] Warning: HashCacheOpen(): Invalid cache file. Resetting it ...\n");
+        }
+        status = HashCacheMap(SD_HASH_CACHE_INITIAL_CAPACITY, TRUE);
+    }
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: HashCacheOpen(): HashCacheMap() failed.\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheOpen;
+    }
+
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: Hash cache [%s] open: [%llu/%llu] entries used. \n", CacheFilePath,
+            (unsigned long long) gHashCache.Header->Count, (unsigned long long) gHashCache.Header->Capacity);
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_HashCacheOpen:
+
+    if (SUCCESS(status))
+    {
+        // Nothing to clean. The cache stays open.
+    }
+    else
+    {
+        HashCacheClose();
+    }
+
+    return status;
+} // HashCacheOpen()
+
+
+
+//
+// HashCacheClose
+//
+void
+HashCacheClose(
+    void
+    )
+/*++
+Description: The routine unmaps and closes the cache file, if open. The content is persisted by the kernel (shared mapping).
+
+Return value: None.
+--*/
+{
+    HashCacheUnmap();
+
+    if (0 <= gHashCache.FileDescriptor)
+    {
+        close(gHashCache.FileDescriptor);                               // Also releases the lock.
+        gHashCache.FileDescriptor = -1;
+    }
+} // HashCacheClose()
+
+
+
+//
+// HashCacheLookup
+//
+SDSTATUS
+HashCacheLookup(
+    __in const struct stat  *FileStat,
+    __in HASH_ALGORITHM     Algorithm,
+    __out char              *HashCode,
+    __out BOOL              *IsFound
+    )
+/*++
+Description: The routine searches the cache for the hash code (computed with Algorithm) of the file described by FileStat. The hash
+code is found only if the file identity (device, inode, size, modification and status change times) is unchanged since it was stored.
+
+- FileStat: Pointer to the status of the file (as returned by fstat()).
+- Algorithm: The hash algorithm of the wanted hash code.
+- HashCode: Pointer to where the hash code is output, if found. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided
+by the caller.
+- IsFound: Pointer to where the routine outputs TRUE if the hash code was found, FALSE otherwise.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    HASH_CACHE_ENTRY    *entry;
+
+    // Parameter validation.
+
+    if (NULL == FileStat)
+    {
+        printf("[SyncDir] Error: HashCacheLookup(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCode)
+    {
+        printf("[SyncDir] Error: HashCacheLookup(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == IsFound)
+    {
+        printf("[SyncDir] Error: HashCacheLookup(): Invalid parameter 4.\n");
+        return STATUS_FAIL;
+    }
+
+    (*IsFound) = FALSE;
+
+    pthread_mutex_lock(&gHashCache.Lock);
+
+    if (NULL != gHashCache.Header)
+    {
+        entry = HashCacheFindEntry(FileStat->st_dev, FileStat->st_ino);
+
+        if (TRUE == entry->IsUsed && (QWORD) FileStat->st_size == entry->FileSize &&
+            HashCacheTimeNs(&FileStat->st_mtim) == entry->ModifyTimeNs && HashCacheTimeNs(&FileStat->st_ctim) == entry->ChangeTimeNs &&
+            (DWORD) Algorithm == entry->HashAlgorithm)
+        {
+            memcpy(HashCode, entry->HashCode, SD_MAX_HASH_CODE_LENGTH + 1);
+            HashCode[SD_MAX_HASH_CODE_LENGTH] = 0;
+            (*IsFound) = TRUE;
+        }
+    }
+
+    pthread_mutex_unlock(&gHashCache.Lock);
+
+    return STATUS_SUCCESS;
+} // HashCacheLookup()
+
+
+
+//
+// HashCacheStore
+//
+SDSTATUS
+HashCacheStore(
+    __in const struct stat  *FileStat,
+    __in HASH_ALGORITHM     Algorithm,
+    __in const char         *HashCode
+    )
+/*++
+Description: The routine stores in the cache the hash code (computed with Algorithm) of the file described by FileStat, which must be
+the status of the file taken before its content was read. Files modified within the last SD_HASH_CACHE_RACY_WINDOW_NS are not stored,
+since a following modification could keep the same times (timestamp granularity). The entry is invalidated before it is rewritten,
+so that an interrupted update never validates a wrong hash code.
+
+- FileStat: Pointer to the status of the file (as returned by fstat(), before hashing).
+- Algorithm: The hash algorithm of HashCode.
+- HashCode: Pointer to the hash code.
+
+Return value: STATUS_SUCCESS on success (including when not stored, e.g. closed cache), STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS            status;
+    HASH_CACHE_ENTRY    *entry;
+    struct timespec     now;
+
+    // PREINIT.
+
+    status = STATUS_SUCCESS;
+
+    // Parameter validation.
+
+    if (NULL == FileStat)
+    {
+        printf("[SyncDir] Error: HashCacheStore(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCode || strlen(HashCode) != HashCodeLength(Algorithm))
+    {
+        printf("[SyncDir] Error: HashCacheStore(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+
+    // Racy file: modified too recently to be trusted later.
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (HashCacheTimeNs(&now) < HashCacheTimeNs(&FileStat->st_mtim) + SD_HASH_CACHE_RACY_WINDOW_NS)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    pthread_mutex_lock(&gHashCache.Lock);
+
+    if (NULL != gHashCache.Header)
+    {
+        entry = HashCacheFindEntry(FileStat->st_dev, FileStat->st_ino);
+
+        if (FALSE == entry->IsUsed)
+        {
+            // Keep the load factor under 1/2 (short probes, and always a free entry).
+
+            if (2 * (gHashCache.Header->Count + 1) > gHashCache.Header->Capacity)
+            {
+                status = HashCacheGrow();
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Warning: HashCacheStore(): HashCacheGrow() failed. Continuing without hash cache ...\n");
+                    pthread_mutex_unlock(&gHashCache.Lock);
+                    return STATUS_WARNING;
+                }
+                entry = HashCacheFindEntry(FileStat->st_dev, FileStat->st_ino);
+            }
+            gHashCache.Header->Count++;
+        }
+
+        entry->IsUsed = FALSE;
+        __sync_synchronize();
+
+        entry->Device = FileStat->st_dev;
+        entry->Inode = FileStat->st_ino;
+        entry->FileSize = FileStat->st_size;
+        entry->ModifyTimeNs = HashCacheTimeNs(&FileStat->st_mtim);
+        entry->ChangeTimeNs = HashCacheTimeNs(&FileStat->st_ctim);
+        entry->HashAlgorithm = (DWORD) Algorithm;
+        strncpy(entry->HashCode, HashCode, SD_MAX_HASH_CODE_LENGTH);
+        entry->HashCode[SD_MAX_HASH_CODE_LENGTH] = 0;
+
+        __sync_synchronize();
+        entry->IsUsed = TRUE;
+    }
+
+    pthread_mutex_unlock(&gHashCache.Lock);
+
+    return status;
+} // HashCacheStore()
+
+
+
+//
+// HashCacheIsOpen
+//
+BOOL
+HashCacheIsOpen(
+    void
+    )
+/*++
+Description: The routine tells if the cache is open (i.e. if lookups can hit and stores are kept).
+
+Return value: TRUE if the cache is open, FALSE otherwise.
+--*/
+{
+    BOOL isOpen;
+
+    pthread_mutex_lock(&gHashCache.Lock);
+    isOpen = (NULL != gHashCache.Header) ? TRUE : FALSE;
+    pthread_mutex_unlock(&gHashCache.Lock);
+
+    return isOpen;
+} // HashCacheIsOpen()
+
+
+
+//
+// HashCachePrehashFiles
+//
+SDSTATUS
+HashCachePrehashFiles(
+    __in HASH_ALGORITHM     Algorithm,
+    __in DWORD              NumberOfFiles,
+    __in const char         **FileFullPaths
+    )
+/*++
+Description: The routine hashes NumberOfFiles files together (see HashOfFileBatch()) and stores their hash codes in the cache, so that
+the following synchronization of each of them hits the cache instead of reading and hashing it alone. A hash code is stored only if
+the file identity is unchanged after the content was read.
+
+- Algorithm: The hash algorithm.
+- NumberOfFiles: Number of files. At most SD_HASH_BATCH_SIZE.
+- FileFullPaths: Pointer to the NumberOfFiles full paths of the files.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING is returned if some of the files could not be hashed
+(they are simply not cached).
+--*/
+{
+    SDSTATUS        status;
+    char            (*hashCodes)[SD_MAX_HASH_CODE_LENGTH + 1];
+    struct stat     *fileStats;
+    SDSTATUS        *statuses;
+    struct stat     fileStat;
+    DWORD           i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    hashCodes = NULL;
+    fileStats = NULL;
+    statuses = NULL;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: HashCachePrehashFiles(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NumberOfFiles > SD_HASH_BATCH_SIZE)
+    {
+        printf("[SyncDir] Error: HashCachePrehashFiles(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileFullPaths)
+    {
+        printf("[SyncDir] Error: HashCachePrehashFiles(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+    if (0 == NumberOfFiles || FALSE == HashCacheIsOpen())
+    {
+        return STATUS_SUCCESS;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    hashCodes = malloc(NumberOfFiles * sizeof(*hashCodes));
+    fileStats = (struct stat*) malloc(NumberOfFiles * sizeof(struct stat));
+    statuses = (SDSTATUS*) malloc(NumberOfFiles * sizeof(SDSTATUS));
+    if (NULL == hashCodes || NULL == fileStats || NULL == statuses)
+    {
+        printf("[SyncDir] Error: HashCachePrehashFiles(): Error at malloc().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCachePrehashFiles;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    status = HashOfFileBatch(Algorithm, NumberOfFiles, FileFullPaths, hashCodes, fileStats, statuses);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: HashCachePrehashFiles(): HashOfFileBatch() failed.\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCachePrehashFiles;
+    }
+
+    for (i = 0; i < NumberOfFiles; i ++)
+    {
+        if (!(SUCCESS(statuses[i])))
+        {
+            continue;
+        }
+
+        // Changed while read: the hash code may be of neither version.
+        if (stat(FileFullPaths[i], &fileStat) < 0 || FALSE == IsSameFileIdentity(&fileStats[i], &fileStat))
+        {
+            continue;
+        }
+
+        HashCacheStore(&fileStats[i], Algorithm, hashCodes[i]);
+    }
+
+
+
+    // If here, everything worked well (maybe except for some files).
+    status = SUCCESS_KEEP_WARNING(status);
+
+    // UNINIT. Cleanup.
+    cleanup_HashCachePrehashFiles:
+
+    if (SUCCESS(status))
+    {
+        free(hashCodes);
+        hashCodes = NULL;
+        free(fileStats);
+        fileStats = NULL;
+        free(statuses);
+        statuses = NULL;
+    }
+    else
+    {
+        free(hashCodes);
+        hashCodes = NULL;
+        free(fileStats);
+        fileStats = NULL;
+        free(statuses);
+        statuses = NULL;
+    }
+
+    return status;
+} // HashCachePrehashFiles()
+
+
+
+//
+// HashCacheHashOfFile
+//
+SDSTATUS
+HashCacheHashOfFile(
+    __in HASH_ALGORITHM     Algorithm,
+    __in const char         *FileFullPath,
+    __out char              *HashCode
+    )
+/*++
+Description: The routine outputs the hash code of the content of the file at FileFullPath (symbolic links are followed), taken from
+the cache if the file identity is unchanged since it was stored. Otherwise, the file is hashed (see HashOfFileDescriptor()) and the
+hash code is stored, if the file did not change while being read.
+
+- Algorithm: The hash algorithm.
+- FileFullPath: Pointer to the full path of the file.
+- HashCode: Pointer to where the hash code is output. Storage of at least SD_MAX_HASH_CODE_LENGTH + 1 chars is provided by the caller.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS        status;
+    __int32         fileDescriptor;
+    struct stat     fileStat;
+    struct stat     fileStatAfterRead;
+    BOOL            isFound;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    fileDescriptor = -1;
+    isFound = FALSE;
+
+    // Parameter validation.
+
+    if (NULL == GetHashProvider(Algorithm))
+    {
+        printf("[SyncDir] Error: HashCacheHashOfFile(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileFullPath)
+    {
+        printf("[SyncDir] Error: HashCacheHashOfFile(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCode)
+    {
+        printf("[SyncDir] Error: HashCacheHashOfFile(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+
+
+    //
+    // INIT.
+    //
+
+    fileDescriptor = open(FileFullPath, O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor < 0)
+    {
+        perror("[SyncDir] Error: HashCacheHashOfFile(): Error at open(). (File may not exist anymore.)\n");
+        printf("open() error was for file [%s].\n", FileFullPath);
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheHashOfFile;
+    }
+
+    if (fstat(fileDescriptor, &fileStat) < 0)
+    {
+        perror("[SyncDir] Error: HashCacheHashOfFile(): Error at fstat().\n");
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheHashOfFile;
+    }
+
+
+
+    //
+    // Main processing.
+    //
+
+    if (SUCCESS(HashCacheLookup(&fileStat, Algorithm, HashCode, &isFound)) && TRUE == isFound)
+    {
+        status = STATUS_SUCCESS;
+        goto cleanup_HashCacheHashOfFile;
+    }
+
+    status = HashOfFileDescriptor(Algorithm, fileDescriptor, HashCode);
+    if (!(SUCCESS(status)))
+    {
+        printf("[SyncDir] Error: HashCacheHashOfFile(): HashOfFileDescriptor() failed for file [%s].\n", FileFullPath);
+        status = STATUS_FAIL;
+        goto cleanup_HashCacheHashOfFile;
+    }
+
+    if (S_ISREG(fileStat.st_mode) && 0 == fstat(fileDescriptor, &fileStatAfterRead) &&
+        TRUE == IsSameFileIdentity(&fileStat, &fileStatAfterRead))
+    {
+        HashCacheStore(&fileStat, Algorithm, HashCode);
+    }
+
+
+
+    // If here, everything worked well.
+    status = STATUS_SUCCESS;
+
+    // UNINIT. Cleanup.
+    cleanup_HashCacheHashOfFile:
+
+    if (SUCCESS(status))
+    {
+        if (0 <= fileDescriptor)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+    }
+    else
+    {
+        if (0 <= fileDescriptor)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+
+        // Output NULL, on fail.
+        HashCode[0] = 0;
+    }
+
+    return status;
+} // HashCacheHashOfFile()
+
+
+
+//
+// IsSameFileIdentity
+//
+BOOL
+IsSameFileIdentity(
+    __in const struct stat  *FirstStat,
+    __in const struct stat  *SecondStat
+    )
+/*++
+Description: The routine compares the identities (device, inode, size, modification and status change times) of two file status records.
+
+- FirstStat: Pointer to the first file status.
+- SecondStat: Pointer to the second file status.
+
+Return value: TRUE if the identities are equal, FALSE otherwise.
+--*/
+{
+    return FirstStat->st_dev == SecondStat->st_dev && FirstStat->st_ino == SecondStat->st_ino &&
+           FirstStat->st_size == SecondStat->st_size &&
+           HashCacheTimeNs(&FirstStat->st_mtim) == HashCacheTimeNs(&SecondStat->st_mtim) &&
+           HashCacheTimeNs(&FirstStat->st_ctim) == HashCacheTimeNs(&SecondStat->st_ctim);
+} // IsSameFileIdentity()
@@ -0,0 +1,541 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_md5.h"
+
+
+
+//
+// MD5 auxiliary functions and round step (RFC 1321, section 3.4).
+//
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+#define MD5_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define MD5_STEP(f, a, b, c, d, x, t, s)                                \
+    (a) += f((b), (c), (d)) + (x) + (DWORD)(t);                         \
+    (a) = MD5_ROTL((a), (s));                                           \
+    (a) += (b);
+
+
+//
+// The 64 steps of the compression function (4 rounds). The operands may be DWORDs, or vectors of DWORDs (one lane per message).
+//
+#define MD5_ALL_STEPS(a, b, c, d, x)                                    \
+    /* Round 1. */                                                      \
+    MD5_STEP(MD5_F, a, b, c, d, x[ 0], 0xd76aa478,  7)                  \
+    MD5_STEP(MD5_F, d, a, b, c, x[ 1], 0xe8c7b756, 12)                  \
+    MD5_STEP(MD5_F, c, d, a, b, x[ 2], 0x242070db, 17)                  \
+    MD5_STEP(MD5_F, b, c, d, a, x[ 3], 0xc1bdceee, 22)                  \
+    MD5_STEP(MD5_F, a, b, c, d, x[ 4], 0xf57c0faf,  7)                  \
+    MD5_STEP(MD5_F, d, a, b, c, x[ 5], 0x4787c62a, 12)                  \
+    MD5_STEP(MD5_F, c, d, a, b, x[ 6], 0xa8304613, 17)                  \
+    MD5_STEP(MD5_F, b, c, d, a, x[ 7], 0xfd469501, 22)                  \
+    MD5_STEP(MD5_F, a, b, c, d, x[ 8], 0x698098d8,  7)                  \
+    MD5_STEP(MD5_F, d, a, b, c, x[ 9], 0x8b44f7af, 12)                  \
+    MD5_STEP(MD5_F, c, d, a, b, x[10], 0xffff5bb1, 17)                  \
+    MD5_STEP(MD5_F, b, c, d, a, x[11], 0x895cd7be, 22)                  \
+    MD5_STEP(MD5_F, a, b, c, d, x[12], 0x6b901122,  7)                  \
+    MD5_STEP(MD5_F, d, a, b, c, x[13], 0xfd987193, 12)                  \
+    MD5_STEP(MD5_F, c, d, a, b, x[14], 0xa679438e, 17)                  \
+    MD5_STEP(MD5_F, b, c, d, a, x[15], 0x49b40821, 22)                  \
+    /* Round 2. */                                                      \
+    MD5_STEP(MD5_G, a, b, c, d, x[ 1], 0xf61e2562,  5)                  \
+    MD5_STEP(MD5_G, d, a, b, c, x[ 6], 0xc040b340,  9)                  \
+    MD5_STEP(MD5_G, c, d, a, b, x[11], 0x265e5a51, 14)                  \
+    MD5_STEP(MD5_G, b, c, d, a, x[ 0], 0xe9b6c7aa, 20)                  \
+    MD5_STEP(MD5_G, a, b, c, d, x[ 5], 0xd62f105d,  5)                  \
+    MD5_STEP(MD5_G, d, a, b, c, x[10], 0x02441453,  9)                  \
+    MD5_STEP(MD5_G, c, d, a, b, x[15], 0xd8a1e681, 14)                  \
+    MD5_STEP(MD5_G, b, c, d, a, x[ 4], 0xe7d3fbc8, 20)                  \
+    MD5_STEP(MD5_G, a, b, c, d, x[ 9], 0x21e1cde6,  5)                  \
+    MD5_STEP(MD5_G, d, a, b, c, x[14], 0xc33707d6,  9)                  \
+    MD5_STEP(MD5_G, c, d, a, b, x[ 3], 0xf4d50d87, 14)                  \
+    MD5_STEP(MD5_G, b, c, d, a, x[ 8], 0x455a14ed, 20)                  \
+    MD5_STEP(MD5_G, a, b, c, d, x[13], 0xa9e3e905,  5)                  \
+    MD5_STEP(MD5_G, d, a, b, c, x[ 2], 0xfcefa3f8,  9)                  \
+    MD5_STEP(MD5_G, c, d, a, b, x[ 7], 0x676f02d9, 14)                  \
+    MD5_STEP(MD5_G, b, c, d, a, x[12], 0x8d2a4c8a, 20)                  \
+    /* Round 3. */                                                      \
+    MD5_STEP(MD5_H, a, b, c, d, x[ 5], 0xfffa3942,  4)                  \
+    MD5_STEP(MD5_H, d, a, b, c, x[ 8], 0x8771f681, 11)                  \
+    MD5_STEP(MD5_H, c, d, a, b, x[11], 0x6d9d6122, 16)                  \
+    MD5_STEP(MD5_H, b, c, d, a, x[14], 0xfde5380c, 23)                  \
+    MD5_STEP(MD5_H, a, b, c, d, x[ 1], 0xa4beea44,  4)                  \
+    MD5_STEP(MD5_H, d, a, b, c, x[ 4], 0x4bdecfa9, 11)                  \
+    MD5_STEP(MD5_H, c, d, a, b, x[ 7], 0xf6bb4b60, 16)                  \
+    MD5_STEP(MD5_H, b, c, d, a, x[10], 0xbebfbc70, 23)                  \
+    MD5_STEP(MD5_H, a, b, c, d, x[13], 0x289b7ec6,  4)                  \
+    MD5_STEP(MD5_H, d, a, b, c, x[ 0], 0xeaa127fa, 11)                  \
+    MD5_STEP(MD5_H, c, d, a, b, x[ 3], 0xd4ef3085, 16)                  \
+    MD5_STEP(MD5_H, b, c, d, a, x[ 6], 0x04881d05, 23)                  \
+    MD5_STEP(MD5_H, a, b, c, d, x[ 9], 0xd9d4d039,  4)                  \
+    MD5_STEP(MD5_H, d, a, b, c, x[12], 0xe6db99e5, 11)                  \
+    MD5_STEP(MD5_H, c, d, a, b, x[15], 0x1fa27cf8, 16)                  \
+    MD5_STEP(MD5_H, b, c, d, a, x[ 2], 0xc4ac5665, 23)                  \
+    /* Round 4. */                                                      \
+    MD5_STEP(MD5_I, a, b, c, d, x[ 0], 0xf4292244,  6)                  \
+    MD5_STEP(MD5_I, d, a, b, c, x[ 7], 0x432aff97, 10)                  \
+    MD5_STEP(MD5_I, c, d, a, b, x[14], 0xab9423a7, 15)                  \
+    MD5_STEP(MD5_I, b, c, d, a, x[ 5], 0xfc93a039, 21)                  \
+    MD5_STEP(MD5_I, a, b, c, d, x[12], 0x655b59c3,  6)                  \
+    MD5_STEP(MD5_I, d, a, b, c, x[ 3], 0x8f0ccc92, 10)                  \
+    MD5_STEP(MD5_I, c, d, a, b, x[10], 0xffeff47d, 15)                  \
+    MD5_STEP(MD5_I, b, c, d, a, x[ 1], 0x85845dd1, 21)                  \
+    MD5_STEP(MD5_I, a, b, c, d, x[ 8], 0x6fa87e4f,  6)                  \
+    MD5_STEP(MD5_I, d, a, b, c, x[15], 0xfe2ce6e0, 10)                  \
+    MD5_STEP(MD5_I, c, d, a, b, x[ 6], 0xa3014314, 15)                  \
+    MD5_STEP(MD5_I, b, c, d, a, x[13], 0x4e0811a1, 21)                  \
+    MD5_STEP(MD5_I, a, b, c, d, x[ 4], 0xf7537e82,  6)                  \
+    MD5_STEP(MD5_I, d, a, b, c, x[11], 0xbd3af235, 10)                  \
+    MD5_STEP(MD5_I, c, d, a, b, x[ 2], 0x2ad7d2bb, 15)                  \
+    MD5_STEP(MD5_I, b, c, d, a, x[ 9], 0xeb86d391, 21)
+
+
+
+//
+// MD5_DWORD_VECTOR - One 32-bit word of SD_MD5_LANES independent messages (GCC vector extension). The compiler maps it on the
+// widest available vector registers (e.g. 2 x SSE2, or 1 x AVX2 for the AVX2 clone of Md5TransformLanes()).
+//
+typedef DWORD MD5_DWORD_VECTOR __attribute__ ((vector_size (4 * SD_MD5_LANES)));
+
+
+
+//
+// MD5_LANE - One message hashed by Md5HashMany(), in one vector lane.
+//
+typedef struct _MD5_LANE
+{
+    DWORD       Index;                                                  // Index of the message (-1: lane not used).
+    const BYTE  *Input;
+    size_t      FullBlocksLength;                                       // Bytes hashed directly from Input (whole blocks).
+    QWORD       NumberOfBlocks;                                         // Including the padding blocks.
+    QWORD       Block;                                                  // Next block.
+    BYTE        Tail[2 * SD_MD5_BLOCK_SIZE];                            // Last bytes of the message, padding and length.
+} MD5_LANE, *PMD5_LANE;
+
+
+
+//
+// Md5LoadWord
+//
+static inline DWORD
+Md5LoadWord(
+    __in const BYTE *Bytes
+    )
+/*++
+Description: The routine reads a 32-bit little-endian word, independently of the host byte order and alignment.
+--*/
+{
+    return (DWORD) Bytes[0] | ((DWORD) Bytes[1] << 8) | ((DWORD) Bytes[2] << 16) | ((DWORD) Bytes[3] << 24);
+} // Md5LoadWord()
+
+
+
+//
+// Md5TransformBlocks
+//
+static void
+Md5TransformBlocks(
+    __inout DWORD       *State,
+    __in const BYTE     *Blocks,
+    __in size_t         NumberOfBlocks
+    )
+/*++
+Description: The routine applies the MD5 compression function on NumberOfBlocks consecutive 64 bytes blocks, updating the 4 chaining
+variables at State.
+
+- State: Pointer to the 4 chaining variables (A, B, C, D).
+- Blocks: Pointer to the blocks to be processed.
+- NumberOfBlocks: Number of 64 bytes blocks at Blocks.
+
+Return value: None.
+--*/
+{
+    DWORD a, b, c, d;
+    DWORD x[16];
+    DWORD i;
+
+    while (0 != NumberOfBlocks)
+    {
+        for (i = 0; i < 16; i ++)
+        {
+            x[i] = Md5LoadWord(Blocks + 4 * i);
+        }
+
+        a = State[0];
+        b = State[1];
+        c = State[2];
+        d = State[3];
+
+        MD5_ALL_STEPS(a, b, c, d, x)
+
+        State[0] += a;
+        State[1] += b;
+        State[2] += c;
+        State[3] += d;
+
+        Blocks = Blocks + SD_MD5_BLOCK_SIZE;
+        NumberOfBlocks --;
+    }
+} // Md5TransformBlocks()
+
+
+
+//
+// Md5TransformLanes
+//
+__attribute__ ((target_clones ("avx2", "default")))
+static void
+Md5TransformLanes(
+    __inout MD5_DWORD_VECTOR    *State,
+    __in const BYTE             **Blocks
+    )
+/*++
+Description: The routine applies the MD5 compression function on SD_MD5_LANES blocks of independent messages at once, one message
+per vector lane, so every step processes all the messages with one vector instruction. The function is compiled twice (AVX2 and
+default) and the loader picks the variant matching the CPU.
+
+- State: Pointer to the 4 chaining variables (A, B, C, D) of all the lanes.
+- Blocks: Pointer to the SD_MD5_LANES pointers to the 64 bytes blocks (one per lane).
+
+Return value: None.
+--*/
+{
+    MD5_DWORD_VECTOR    a, b, c, d;
+    MD5_DWORD_VECTOR    x[16];
+    DWORD               lane, i;
+
+    // Transpose: message word i of every lane.
+
+    for (i = 0; i < 16; i ++)
+    {
+        for (lane = 0; lane < SD_MD5_LANES; lane ++)
+        {
+            x[i][lane] = Md5LoadWord(Blocks[lane] + 4 * i);
+        }
+    }
+
+    a = State[0];
+    b = State[1];
+    c = State[2];
+    d = State[3];
+
+    MD5_ALL_STEPS(a, b, c, d, x)
+
+    State[0] += a;
+    State[1] += b;
+    State[2] += c;
+    State[3] += d;
+} // Md5TransformLanes()
+
+
+
+//
+// Md5LaneStart
+//
+static void
+Md5LaneStart(
+    __out MD5_LANE          *Lane,
+    __inout MD5_DWORD_VECTOR *State,
+    __in DWORD              LaneIndex,
+    __in DWORD              Index,
+    __in const BYTE         *Input,
+    __in size_t             InputLength
+    )
+/*++
+Description: The routine assigns the message Index (Input, InputLength) to the vector lane LaneIndex: it prepares the padded tail
+of the message (1 or 2 blocks) and resets the chaining variables of the lane.
+--*/
+{
+    size_t  tailLength;
+    QWORD   bitLength;
+    DWORD   i;
+
+    Lane->Index = Index;
+    Lane->Input = Input;
+    Lane->FullBlocksLength = InputLength - InputLength % SD_MD5_BLOCK_SIZE;
+    Lane->NumberOfBlocks = (InputLength + 8) / SD_MD5_BLOCK_SIZE + 1;
+    Lane->Block = 0;
+
+    tailLength = (Lane->NumberOfBlocks - Lane->FullBlocksLength / SD_MD5_BLOCK_SIZE) * SD_MD5_BLOCK_SIZE;
+    bitLength = (QWORD) InputLength * 8;
+
+    memcpy(Lane->Tail, Input + Lane->FullBlocksLength, InputLength % SD_MD5_BLOCK_SIZE);
+    Lane->Tail[InputLength % SD_MD5_BLOCK_SIZE] = 0x80;
+    memset(Lane->Tail + InputLength % SD_MD5_BLOCK_SIZE + 1, 0, tailLength - InputLength % SD_MD5_BLOCK_SIZE - 1);
+    for (i = 0; i < 8; i ++)
+    {
+        Lane->Tail[tailLength - 8 + i] = (BYTE) (bitLength >> (8 * i));
+    }
+
+    State[0][LaneIndex] = 0x67452301;
+    State[1][LaneIndex] = 0xefcdab89;
+    State[2][LaneIndex] = 0x98badcfe;
+    State[3][LaneIndex] = 0x10325476;
+} // Md5LaneStart()
+
+
+
+//
+// Md5Init
+//
+void
+Md5Init(
+    __out MD5_CONTEXT   *Context
+    )
+/*++
+Description: The routine initializes an MD5 context, before any data is hashed with Md5Update().
+
+- Context: Pointer to the context to be initialized. The caller provides the storage space.
+
+Return value: None.
+--*/
+{
+    Context->State[0] = 0x67452301;
+    Context->State[1] = 0xefcdab89;
+    Context->State[2] = 0x98badcfe;
+    Context->State[3] = 0x10325476;
+    Context->TotalLength = 0;
+    Context->BufferLength = 0;
+} // Md5Init()
+
+
+
+//
+// Md5Update
+//
+void
+Md5Update(
+    __inout MD5_CONTEXT *Context,
+    __in const void     *Data,
+    __in size_t         DataLength
+    )
+/*++
+Description: The routine adds DataLength bytes from Data to the MD5 computation represented by Context.
+Whole blocks are compressed directly from the caller's memory; only the incomplete tail is copied in the context buffer.
+
+- Context: Pointer to an initialized MD5 context.
+- Data: Pointer to the bytes to be hashed.
+- DataLength: Number of bytes at Data.
+
+Return value: None.
+--*/
+{
+    const BYTE  *input;
+    size_t      toCopy;
+
+    input = (const BYTE*) Data;
+    Context->TotalLength = Context->TotalLength + DataLength;
+
+    // Complete a pending block first.
+
+    if (0 != Context->BufferLength)
+    {
+        toCopy = SD_MIN((size_t) (SD_MD5_BLOCK_SIZE - Context->BufferLength), DataLength);
+        memcpy(Context->Buffer + Context->BufferLength, input, toCopy);
+
+        Context->BufferLength = Context->BufferLength + toCopy;
+        input = input + toCopy;
+        DataLength = DataLength - toCopy;
+
+        if (SD_MD5_BLOCK_SIZE != Context->BufferLength)
+        {
+            return;
+        }
+
+        Md5TransformBlocks(Context->State, Context->Buffer, 1);
+        Context->BufferLength = 0;
+    }
+
+    // Compress all whole blocks in place.
+
+    if (SD_MD5_BLOCK_SIZE <= DataLength)
+    {
+        Md5TransformBlocks(Context->State, input, DataLength / SD_MD5_BLOCK_SIZE);
+        input = input + (DataLength - DataLength % SD_MD5_BLOCK_SIZE);
+        DataLength = DataLength % SD_MD5_BLOCK_SIZE;
+    }
+
+    // Keep the tail for later.
+
+    if (0 != DataLength)
+    {
+        memcpy(Context->Buffer, input, DataLength);
+        Context->BufferLength = DataLength;
+    }
+} // Md5Update()
+
+
+
+//
+// Md5Final
+//
+void
+Md5Final(
+    __inout MD5_CONTEXT *Context,
+    __out BYTE          *Digest
+    )
+/*++
+Description: The routine completes the MD5 computation (padding and length) and outputs the 16 bytes digest.
+
+- Context: Pointer to the MD5 context.
+- Digest: Pointer to where the routine outputs the digest. Storage of at least SD_MD5_DIGEST_SIZE bytes is provided by the caller.
+
+Return value: None.
+--*/
+{
+    QWORD   bitLength;
+    DWORD   i;
+
+    bitLength = Context->TotalLength * 8;
+
+    // Padding: one 0x80 byte, then zeros until 56 bytes (mod 64), then the message length in bits (64-bit little-endian).
+
+    Context->Buffer[Context->BufferLength] = 0x80;
+    Context->BufferLength ++;
+
+    if (SD_MD5_BLOCK_SIZE - 8 < Context->BufferLength)
+    {
+        memset(Context->Buffer + Context->BufferLength, 0, SD_MD5_BLOCK_SIZE - Context->BufferLength);
+        Md5TransformBlocks(Context->State, Context->Buffer, 1);
+        Context->BufferLength = 0;
+    }
+
+    memset(Context->Buffer + Context->BufferLength, 0, SD_MD5_BLOCK_SIZE - 8 - Context->BufferLength);
+
+    for (i = 0; i < 8; i ++)
+    {
+        Context->Buffer[SD_MD5_BLOCK_SIZE - 8 + i] = (BYTE) (bitLength >> (8 * i));
+    }
+
+    Md5TransformBlocks(Context->State, Context->Buffer, 1);
+
+    // Output the chaining variables, little-endian.
+
+    for (i = 0; i < 4; i ++)
+    {
+        Digest[4 * i + 0] = (BYTE) (Context->State[i]);
+        Digest[4 * i + 1] = (BYTE) (Context->State[i] >> 8);
+        Digest[4 * i + 2] = (BYTE) (Context->State[i] >> 16);
+        Digest[4 * i + 3] = (BYTE) (Context->State[i] >> 24);
+    }
+
+    Context->BufferLength = 0;
+} // Md5Final()
+
+
+
+//
+// Md5HashMany
+//
+void
+Md5HashMany(
+    __in DWORD          NumberOfInputs,
+    __in const BYTE     **Inputs,
+    __in const size_t   *InputLengths,
+    __out BYTE          (*Digests)[SD_MD5_DIGEST_SIZE]
+    )
+/*++
+Description: The routine outputs the MD5 digests of NumberOfInputs independent messages, hashing SD_MD5_LANES messages at once
+(multi-buffer: one message per vector lane, see Md5TransformLanes()). A lane which completes its message takes the next one, so
+messages of different lengths keep all the lanes busy. Meant for many small messages (e.g. small files), whose hashing cost is
+dominated by the latency of the compression function.
+
+- NumberOfInputs: Number of messages.
+- Inputs: Pointer to the NumberOfInputs pointers to the messages.
+- InputLengths: Pointer to the NumberOfInputs message lengths, in bytes.
+- Digests: Pointer to where the routine outputs the NumberOfInputs digests.
+
+Return value: None.
+--*/
+{
+    MD5_LANE            lanes[SD_MD5_LANES];
+    MD5_DWORD_VECTOR    state[4];
+    const BYTE          *blocks[SD_MD5_LANES];
+    BYTE                unusedBlock[SD_MD5_BLOCK_SIZE];
+    DWORD               nextInput;
+    DWORD               activeLanes;
+    DWORD               lane, i;
+
+    memset(unusedBlock, 0, sizeof(unusedBlock));
+    memset(state, 0, sizeof(state));
+    nextInput = 0;
+    activeLanes = 0;
+
+    for (lane = 0; lane < SD_MD5_LANES; lane ++)
+    {
+        lanes[lane].Index = (DWORD) -1;
+        if (nextInput < NumberOfInputs)
+        {
+            Md5LaneStart(&lanes[lane], state, lane, nextInput, Inputs[nextInput], InputLengths[nextInput]);
+            nextInput ++;
+            activeLanes ++;
+        }
+    }
+
+    while (0 != activeLanes)
+    {
+        // Next block of every lane (from the message, or from its padded tail).
+
+        for (lane = 0; lane < SD_MD5_LANES; lane ++)
+        {
+            if ((DWORD) -1 == lanes[lane].Index)
+            {
+                blocks[lane] = unusedBlock;
+            }
+            else if (lanes[lane].Block * SD_MD5_BLOCK_SIZE < lanes[lane].FullBlocksLength)
+            {
+                blocks[lane] = lanes[lane].Input + lanes[lane].Block * SD_MD5_BLOCK_SIZE;
+            }
+            else
+            {
+                blocks[lane] = lanes[lane].Tail + (lanes[lane].Block * SD_MD5_BLOCK_SIZE - lanes[lane].FullBlocksLength);
+            }
+        }
+
+        Md5TransformLanes(state, blocks);
+
+        // Output the completed messages (chaining variables, little-endian) and refill their lanes.
+
+        for (lane = 0; lane < SD_MD5_LANES; lane ++)
+        {
+            if ((DWORD) -1 == lanes[lane].Index)
+            {
+                continue;
+            }
+
+            lanes[lane].Block ++;
+            if (lanes[lane].Block < lanes[lane].NumberOfBlocks)
+            {
+                continue;
+            }
+
+            for (i = 0; i < 4; i ++)
+            {
+                Digests[lanes[lane].Index][4 * i + 0] = (BYTE) (state[i][lane]);
+                Digests[lanes[lane].Index][4 * i + 1] = (BYTE) (state[i][lane] >> 8);
+                Digests[lanes[lane].Index][4 * i + 2] = (BYTE) (state[i][lane] >> 16);
+                Digests[lanes[lane].Index][4 * i + 3] = (BYTE) (state[i][lane] >> 24);
+            }
+
+            lanes[lane].Index = (DWORD) -1;
+            activeLanes --;
+
+            if (nextInput < NumberOfInputs)
+            {
+                Md5LaneStart(&lanes[lane], state, lane, nextInput, Inputs[nextInput], InputLengths[nextInput]);
+                nextInput ++;
+                activeLanes ++;
+            }
+        }
+    }
+} // Md5HashMany()
@@ -0,0 +1,269 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_murmur3.h"
+
+
+
+#define MURMUR3_C1 0x87c37b91114253d5ULL
+#define MURMUR3_C2 0x4cf5ad432745937fULL
+
+#define MURMUR3_ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+
+
+//
+// Murmur3LoadQword
+//
+static inline QWORD
+Murmur3LoadQword(
+    __in const BYTE *Bytes
+    )
+/*++
+Description: The routine reads a 64-bit little-endian word, independently of the host byte order and alignment.
+--*/
+{
+    QWORD value;
+
+    memcpy(&value, Bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+} // Murmur3LoadQword()
+
+
+
+//
+// Murmur3FinalMix
+//
+static inline QWORD
+Murmur3FinalMix(
+    __in QWORD  Key
+    )
+/*++
+Description: The routine applies the MurmurHash3 64-bit avalanche (fmix64).
+--*/
+{
+    Key ^= Key >> 33;
+    Key *= 0xff51afd7ed558ccdULL;
+    Key ^= Key >> 33;
+    Key *= 0xc4ceb9fe1a85ec53ULL;
+    Key ^= Key >> 33;
+
+    return Key;
+} // Murmur3FinalMix()
+
+
+
+//
+// Murmur3TransformBlocks
+//
+static void
+Murmur3TransformBlocks(
+    __inout MURMUR3_CONTEXT *Context,
+    __in const BYTE         *Blocks,
+    __in size_t             NumberOfBlocks
+    )
+/*++
+Description: The routine mixes NumberOfBlocks consecutive 16 bytes blocks into the hash state. The two lanes are kept in registers
+for the whole run.
+
+- Context: Pointer to the context.
+- Blocks: Pointer to the blocks to be processed.
+- NumberOfBlocks: Number of 16 bytes blocks at Blocks.
+
+Return value: None.
+--*/
+{
+    QWORD h1, h2, k1, k2;
+
+    h1 = Context->H1;
+    h2 = Context->H2;
+
+    while (0 != NumberOfBlocks)
+    {
+        k1 = Murmur3LoadQword(Blocks);
+        k2 = Murmur3LoadQword(Blocks + 8);
+
+        k1 *= MURMUR3_C1; k1 = MURMUR3_ROTL64(k1, 31); k1 *= MURMUR3_C2; h1 ^= k1;
+        h1 = MURMUR3_ROTL64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= MURMUR3_C2; k2 = MURMUR3_ROTL64(k2, 33); k2 *= MURMUR3_C1; h2 ^= k2;
+        h2 = MURMUR3_ROTL64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+
+        Blocks = Blocks + SD_MURMUR3_BLOCK_SIZE;
+        NumberOfBlocks --;
+    }
+
+    Context->H1 = h1;
+    Context->H2 = h2;
+} // Murmur3TransformBlocks()
+
+
+
+//
+// Murmur3Init
+//
+void
+Murmur3Init(
+    __out MURMUR3_CONTEXT   *Context
+    )
+/*++
+Description: The routine initializes a MurmurHash3_x64_128 context (seed SD_MURMUR3_SEED), before any data is hashed with Murmur3Update().
+
+- Context: Pointer to the context to be initialized. The caller provides the storage space.
+
+Return value: None.
+--*/
+{
+    Context->H1 = SD_MURMUR3_SEED;
+    Context->H2 = SD_MURMUR3_SEED;
+    Context->TotalLength = 0;
+    Context->BufferLength = 0;
+} // Murmur3Init()
+
+
+
+//
+// Murmur3Update
+//
+void
+Murmur3Update(
+    __inout MURMUR3_CONTEXT *Context,
+    __in const void         *Data,
+    __in size_t             DataLength
+    )
+/*++
+Description: The routine adds DataLength bytes from Data to the hash computation represented by Context.
+Whole blocks are mixed directly from the caller's memory; only the incomplete tail is copied in the context buffer.
+
+- Context: Pointer to an initialized context.
+- Data: Pointer to the bytes to be hashed.
+- DataLength: Number of bytes at Data.
+
+Return value: None.
+--*/
+{
+    const BYTE  *input;
+    size_t      toCopy;
+
+    input = (const BYTE*) Data;
+    Context->TotalLength = Context->TotalLength + DataLength;
+
+    // Complete a pending block first.
+
+    if (0 != Context->BufferLength)
+    {
+        toCopy = SD_MIN((size_t) (SD_MURMUR3_BLOCK_SIZE - Context->BufferLength), DataLength);
+        memcpy(Context->Buffer + Context->BufferLength, input, toCopy);
+
+        Context->BufferLength = Context->BufferLength + toCopy;
+        input = input + toCopy;
+        DataLength = DataLength - toCopy;
+
+        if (SD_MURMUR3_BLOCK_SIZE != Context->BufferLength)
+        {
+            return;
+        }
+
+        Murmur3TransformBlocks(Context, Context->Buffer, 1);
+        Context->BufferLength = 0;
+    }
+
+    // Mix all whole blocks in place.
+
+    if (SD_MURMUR3_BLOCK_SIZE <= DataLength)
+    {
+        Murmur3TransformBlocks(Context, input, DataLength / SD_MURMUR3_BLOCK_SIZE);
+        input = input + (DataLength - DataLength % SD_MURMUR3_BLOCK_SIZE);
+        DataLength = DataLength % SD_MURMUR3_BLOCK_SIZE;
+    }
+
+    // Keep the tail for later.
+
+    if (0 != DataLength)
+    {
+        memcpy(Context->Buffer, input, DataLength);
+        Context->BufferLength = DataLength;
+    }
+} // Murmur3Update()
+
+
+
+//
+// Murmur3Final
+//
+void
+Murmur3Final(
+    __inout MURMUR3_CONTEXT *Context,
+    __out BYTE              *Digest
+    )
+/*++
+Description: The routine completes the hash computation (tail and finalization mix) and outputs the 16 bytes digest.
+
+- Context: Pointer to the context.
+- Digest: Pointer to where the routine outputs the digest. Storage of at least SD_MURMUR3_DIGEST_SIZE bytes is provided by the caller.
+
+Return value: None.
+--*/
+{
+    const BYTE  *tail;
+    QWORD       h1, h2, k1, k2;
+    DWORD       i;
+
+    tail = Context->Buffer;
+    h1 = Context->H1;
+    h2 = Context->H2;
+    k1 = 0;
+    k2 = 0;
+
+    // Tail (0 to 15 bytes): bytes 8..14 go to the second lane, bytes 0..7 to the first one.
+
+    for (i = Context->BufferLength; 8 < i; i --)
+    {
+        k2 ^= (QWORD) tail[i - 1] << (8 * (i - 9));
+    }
+    if (8 < Context->BufferLength)
+    {
+        k2 *= MURMUR3_C2; k2 = MURMUR3_ROTL64(k2, 33); k2 *= MURMUR3_C1; h2 ^= k2;
+    }
+
+    for (i = SD_MIN(Context->BufferLength, 8); 0 < i; i --)
+    {
+        k1 ^= (QWORD) tail[i - 1] << (8 * (i - 1));
+    }
+    if (0 < Context->BufferLength)
+    {
+        k1 *= MURMUR3_C1; k1 = MURMUR3_ROTL64(k1, 31); k1 *= MURMUR3_C2; h1 ^= k1;
+    }
+
+    // Finalization.
+
+    h1 ^= Context->TotalLength;
+    h2 ^= Context->TotalLength;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = Murmur3FinalMix(h1);
+    h2 = Murmur3FinalMix(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    // Output the lanes, little-endian.
+
+    for (i = 0; i < 8; i ++)
+    {
+        Digest[i] = (BYTE) (h1 >> (8 * i));
+        Digest[8 + i] = (BYTE) (h2 >> (8 * i));
+    }
+
+    Context->BufferLength = 0;
+} // Murmur3Final()
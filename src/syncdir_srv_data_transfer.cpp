@@ -10,6 +10,10 @@
 
 
 
+static GROUP_COMMIT gGroupCommit = { 0, 0 };                            // Files not yet synced to disk (see CommitReceivedFiles()).
+
+
+
 //
 // SrvReturnListeningSocket
 //
@@ -167,6 +171,369 @@ SrvReturnListeningSocket(
 
 
 
+//
+// SrvNegotiateSessionWithClient
+//
+SDSTATUS
+SrvNegotiateSessionWithClient(
+    __in DWORD              SockConnID,
+    __inout STRIPE_RECEIVER &StripeReceiver
+    )
+/*++
+Description: The routine performs the handshake with a newly connected SyncDir client (see PACKET_HELLO). The server chooses the 
+content hash algorithm of its hash index (gHashAlgorithm), provided that the client supports it. Otherwise, the client is told that no
+common algorithm exists (haUNKNOWN). The compression codec requested by the client is granted if the server supports it (gCompressionCodec),
+otherwise the data frames are not compressed (ccNONE). The data connections requested by the client are granted up to 
+SD_SRV_DATA_CONNECTIONS, with a random key for the session (see SrvAcceptDataConnections()); none without a key.
+
+- SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+- StripeReceiver: Data connections of the session. Receives the number of data connections granted and the key of the session.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (e.g. not a SyncDir client, or no common hash algorithm).
+--*/
+{
+    SDSTATUS        status;
+    PACKET_HELLO    helloPacket;
+    __int32         sentBytes;
+    __int32         recvBytes;
+    DWORD           cltSupportedAlgorithms;
+    DWORD           cltPreferredAlgorithm;
+    HASH_ALGORITHM  chosenAlgorithm;
+    DWORD           cltCodec;
+    DWORD           grantedConnections;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    sentBytes = -1;
+    recvBytes = -1;
+    cltSupportedAlgorithms = 0;
+    cltPreferredAlgorithm = haUNKNOWN;
+    chosenAlgorithm = haUNKNOWN;
+    cltCodec = ccNONE;
+    grantedConnections = 0;
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+
+
+        //
+        // Main processing:
+        //
+
+
+        // Receive the client hello.
+
+        recvBytes = recv(SockConnID, &helloPacket, sizeof(PACKET_HELLO), MSG_WAITALL);
+        if (sizeof(PACKET_HELLO) != recvBytes)
+        {
+            perror("[SyncDir] Error: SrvNegotiateSessionWithClient(): Error at receiving the hello packet from client.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        if (SD_PROTOCOL_MAGIC != ntohl(helloPacket.Magic))
+        {
+            printf("[SyncDir] Error: SrvNegotiateSessionWithClient(): The peer is not a SyncDir client (or has an older version).\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        cltSupportedAlgorithms = ntohl(helloPacket.SupportedHashAlgorithms);
+        cltPreferredAlgorithm = ntohl(helloPacket.HashAlgorithm);
+        cltCodec = ntohl(helloPacket.CompressionCodec);
+
+
+        // Choose: the hash index of the server is built with gHashAlgorithm, so only that one can be used.
+        // Other protocol versions exchange other messages after the handshake: no algorithm is chosen (the client is refused).
+
+        if (SD_PROTOCOL_VERSION == ntohl(helloPacket.ProtocolVersion) && 0 != (cltSupportedAlgorithms & SD_HASH_ALGORITHM_BIT(gHashAlgorithm)))
+        {
+            chosenAlgorithm = gHashAlgorithm;
+        }
+        gCompressionCodec = (ccLZ == cltCodec) ? ccLZ : ccNONE;             // Codecs supported by the server.
+
+        grantedConnections = SD_MIN(ntohl(helloPacket.DataConnections), (DWORD) SD_MIN(SD_SRV_DATA_CONNECTIONS, SD_MAX_DATA_CONNECTIONS));
+        if (0 != grantedConnections && 
+            SD_SESSION_KEY_SIZE != getrandom(StripeReceiver.SessionKey, SD_SESSION_KEY_SIZE, 0))
+        {
+            perror("[SyncDir] Warning: SrvNegotiateSessionWithClient(): Error at getrandom(). No data connections granted.\n");
+            grantedConnections = 0;
+        }
+        StripeReceiver.GrantedConnections = grantedConnections;
+
+        if (cltPreferredAlgorithm != (DWORD) gHashAlgorithm)
+        {
+            printf("[SyncDir] Warning: SrvNegotiateSessionWithClient(): Client prefers hash algorithm %u, the server index uses %s.\n",
+                cltPreferredAlgorithm, GetHashProvider(gHashAlgorithm)->Name);
+        }
+
+
+        // Send the server decision.
+
+        helloPacket.Magic = htonl(SD_PROTOCOL_MAGIC);
+        helloPacket.ProtocolVersion = htonl(SD_PROTOCOL_VERSION);
+        helloPacket.SupportedHashAlgorithms = htonl(SD_HASH_ALGORITHM_BIT(gHashAlgorithm));
+        helloPacket.HashAlgorithm = htonl(chosenAlgorithm);
+        helloPacket.CompressionCodec = htonl(gCompressionCodec);
+        helloPacket.DataConnections = htonl(grantedConnections);
+        memcpy(helloPacket.SessionKey, StripeReceiver.SessionKey, SD_SESSION_KEY_SIZE);
+
+        sentBytes = send(SockConnID, &helloPacket, sizeof(PACKET_HELLO), 0);
+        if (sizeof(PACKET_HELLO) != sentBytes)
+        {
+            perror("[SyncDir] Error: SrvNegotiateSessionWithClient(): Error at sending the hello packet to client.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        if (haUNKNOWN == chosenAlgorithm)
+        {
+            printf("[SyncDir] Error: SrvNegotiateSessionWithClient(): The client uses another protocol version, or does not support the hash algorithm %s (client mask "
+                "0x%x).\n", GetHashProvider(gHashAlgorithm)->Name, cltSupportedAlgorithms);
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        printf("[SyncDir] Info: Session negotiated with the client (protocol version %u). Content hash algorithm: %s. Compression: %s. "
+            "Data connections: %u.\n", ntohl(helloPacket.ProtocolVersion), GetHashProvider(chosenAlgorithm)->Name, 
+            GetCompressionCodecName(gCompressionCodec), grantedConnections);
+
+
+
+        // If here, everything worked fine.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SrvNegotiateSessionWithClient(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SrvNegotiateSessionWithClient(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        // Nothing to clean for the moment.
+    }
+
+    return status;
+} // SrvNegotiateSessionWithClient()
+
+
+
+
+//
+// SrvReconcileDirDigestsWithClient
+//
+SDSTATUS
+SrvReconcileDirDigestsWithClient(
+    __in char                                                   *MainDirFullPath,
+    __in const std::unordered_map<std::string, HASH_INFO>       & HashInfoHMap,
+    __in DWORD                                                  SockConnID
+    )
+/*++
+Description: The routine answers the startup reconciliation of a newly connected SyncDir client (see PACKET_DIR_DIGEST). It computes
+the digests of all the server directories (see BuildDirDigestsOfServerTree()), then, round after round, receives the digests of the
+client directories and replies with one byte per directory: 1 if the server digest is equal (and known), 0 otherwise. An empty round
+ends the reconciliation.
+
+- MainDirFullPath: Pointer to the full path of the server main directory.
+- HashInfoHMap: Reference to the structure containing the file hash information.
+- SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS                                        status;
+    std::unordered_map<std::string, std::string>    dirDigestHMap;
+    std::unordered_map<std::string, std::string>::const_iterator iteratorDD;
+    std::string                                     rootDigest;
+    std::vector<BYTE>                               replies;
+    PACKET_DIR_DIGEST                               digestPacket;
+    char                                            dirRelativePath[SD_MAX_PATH_LENGTH];
+    DWORD                                           numberOfDirs;
+    DWORD                                           numberOfEqualDirs;
+    WORD                                            pathLength;
+    __int32                                         recvBytes;
+    __int32                                         sentBytes;
+    DWORD                                           i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    dirRelativePath[0] = 0;
+    numberOfDirs = 0;
+    numberOfEqualDirs = 0;
+    pathLength = 0;
+    recvBytes = -1;
+    sentBytes = -1;
+
+    // Parameter validation.
+
+    if (NULL == MainDirFullPath || 0 == MainDirFullPath[0])
+    {
+        printf("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+
+        // Digests of the server directories (no file is read: hash codes are taken from HashInfoHMap).
+
+        status = BuildDirDigestsOfServerTree(MainDirFullPath, ".", HashInfoHMap, dirDigestHMap, rootDigest);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Failed to execute BuildDirDigestsOfServerTree(). \n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+
+        //
+        // Main processing:
+        //
+
+        while (1)
+        {
+            // Number of directories of this round. 0 ends the reconciliation.
+
+            recvBytes = recv(SockConnID, &numberOfDirs, sizeof(DWORD), MSG_WAITALL);
+            if (sizeof(DWORD) != recvBytes)
+            {
+                perror("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Error at receiving the number of directories.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            numberOfDirs = ntohl(numberOfDirs);
+            if (0 == numberOfDirs)
+            {
+                break;
+            }
+            if (numberOfDirs > SD_DIR_DIGEST_MAX_DIRS)
+            {
+                printf("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Invalid number of directories [%u].\n", numberOfDirs);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+
+            // Compare each directory digest.
+
+            replies.assign(numberOfDirs, 0);
+
+            for (i = 0; i < numberOfDirs; i++)
+            {
+                recvBytes = recv(SockConnID, &digestPacket, sizeof(PACKET_DIR_DIGEST), MSG_WAITALL);
+                if (sizeof(PACKET_DIR_DIGEST) != recvBytes)
+                {
+                    perror("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Error at receiving a directory digest.\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+
+                pathLength = ntohs(digestPacket.DirRelativePathLength);
+                if (SD_MAX_PATH_LENGTH <= pathLength)
+                {
+                    printf("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Invalid directory path length [%u].\n", pathLength);
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+
+                recvBytes = recv(SockConnID, dirRelativePath, pathLength + 1, MSG_WAITALL);
+                if (pathLength + 1 != recvBytes)
+                {
+                    perror("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Error at receiving a directory path.\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                dirRelativePath[pathLength] = 0;                                        // Never trust the peer's terminator.
+                digestPacket.DirDigest[SD_MAX_HASH_CODE_LENGTH] = 0;
+
+                iteratorDD = dirDigestHMap.find(dirRelativePath);
+                if (0 != digestPacket.DirDigest[0] && dirDigestHMap.end() != iteratorDD && 
+                    0 == strcmp(iteratorDD->second.c_str(), digestPacket.DirDigest))
+                {
+                    replies[i] = 1;
+                    numberOfEqualDirs ++;
+                }
+            }
+
+            sentBytes = send(SockConnID, replies.data(), replies.size(), 0);
+            if ((__int32) replies.size() != sentBytes)
+            {
+                perror("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Error at sending the digest comparisons.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+
+        printf("[SyncDir] Info: Startup reconciliation done: [%u] identical subtrees (server has [%zu] directories). \n", 
+            numberOfEqualDirs, dirDigestHMap.size());
+
+
+
+        // If here, everything worked fine.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SrvReconcileDirDigestsWithClient(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment.
+    }
+    else
+    {
+        // Nothing to clean for the moment.
+    }
+
+    return status;
+} // SrvReconcileDirDigestsWithClient()
+
+
+
+
+
 //
 // RecvPacketOpAndFilePathFromClient
 //
@@ -302,211 +669,3313 @@ was achieved, but related issues were encountered (information is logged, thereb
 
 
 //
-// RecvFileFromClient
+// SpliceFrameToFile
 //
+static
 SDSTATUS
-RecvFileFromClient(
-    __in char       *FileFullPath,
-    __out DWORD     *FileSize,
-    __in DWORD      SockConnID
+SpliceFrameToFile(
+    __in __int32        SockConnID,
+    __in const __int32  *Pipe,
+    __in __int32        FileDescriptor,
+    __in DWORD          DataSize,
+    __in BYTE           *Buffer,
+    __inout DWORD       *FrameRecvBytes,
+    __inout BOOL        *UseSplice
     )
 /*++
-Description: The routine receives a whole file from a SyncDir client application. The file content is stored at 
-the location pointed by FileFullPath and the size of the file is output at the FileSize address.
-
-- FileFullPath: Pointer to the full path where the routine stores the received file.
-- FileSize: Pointer to where the routine outputs the size of the received file. The caller must provide the storage space. 
-- SockConnID: Descriptor representing the socket connection with the SyncDir client application.
-
-Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
-was achieved, but related issues were encountered (information is logged, thereby).
+Description: The routine moves the content of a data frame from the socket to the file with splice(), through Pipe: the pages move
+from the socket to the file without copies through user space buffers. The routine resumes from FrameRecvBytes (bytes of the frame
+already written) and updates it. If the file system does not support splice(), UseSplice is set to FALSE and the routine returns 
+with the rest of the frame still in the socket (the bytes already in the pipe are read out through Buffer, of SD_FILE_READ_BUFFER_SIZE
+bytes, and written).
 --*/
 {
-    SDSTATUS    status;
-    FILE        *fileStream;
-    __int32     recvBytes;
-    DWORD       totalRecvBytes;
-    DWORD       writtenBytes;
-    PACKET_FILE packet;
-
-    // PREINIT.
-
-    status = STATUS_FAIL;
-    fileStream = NULL;
-    recvBytes = -1;
-    totalRecvBytes = 0;
-    writtenBytes = 0;
-    packet.ChunkSize = 0;
-    packet.FileChunk[0] = 0;
-
-    // Parameter validation.
+    ssize_t     inPipe;
+    ssize_t     outPipe;
+    ssize_t     readBytes;
+    ssize_t     writtenBytes;
+    ssize_t     returnValue;
 
-    if (NULL == FileFullPath || 0 == FileFullPath[0])
+    while ((*FrameRecvBytes) < DataSize)
     {
-        printf("[SyncDir] Error: RecvFileFromClient(): Invalid parameter 1.\n");
-        return STATUS_FAIL;
+        inPipe = splice(SockConnID, NULL, Pipe[1], NULL, SD_MIN(DataSize - (*FrameRecvBytes), (DWORD) SD_SRV_SPLICE_PIPE_SIZE), 
+            SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (inPipe < 0 && (EINVAL == errno || ENOSYS == errno))
+        {
+            (*UseSplice) = FALSE;
+            return STATUS_SUCCESS;
+        }
+        if (inPipe <= 0)
+        {
+            if (inPipe < 0)
+            {
+                perror("[SyncDir] Error: SpliceFrameToFile(): Error at receiving from client (splice).\n");
+            }
+            else
+            {
+                printf("[SyncDir] Error: SpliceFrameToFile(): Connection closed by the client (file data).\n");
+            }
+            return STATUS_FAIL;
+        }
+
+        while (0 < inPipe)
+        {
+            outPipe = splice(Pipe[0], NULL, FileDescriptor, NULL, inPipe, SPLICE_F_MOVE);
+            if (outPipe < 0 && (EINVAL == errno || ENOSYS == errno))
+            {
+                // The file system does not support splice(). Empty the pipe, by copies.
+
+                (*UseSplice) = FALSE;
+                while (0 < inPipe)
+                {
+                    readBytes = read(Pipe[0], Buffer, SD_MIN((size_t) inPipe, (size_t) SD_FILE_READ_BUFFER_SIZE));
+                    if (readBytes <= 0)
+                    {
+                        perror("[SyncDir] Error: SpliceFrameToFile(): Error at reading from pipe.\n");
+                        return STATUS_FAIL;
+                    }
+                    for (writtenBytes = 0; writtenBytes < readBytes; writtenBytes += returnValue)
+                    {
+                        returnValue = write(FileDescriptor, Buffer + writtenBytes, readBytes - writtenBytes);
+                        if (returnValue <= 0)
+                        {
+                            perror("[SyncDir] Error: SpliceFrameToFile(): Error at file writing.\n");
+                            return STATUS_FAIL;
+                        }
+                    }
+                    inPipe = inPipe - readBytes;
+                    (*FrameRecvBytes) = (*FrameRecvBytes) + readBytes;
+                }
+                return STATUS_SUCCESS;
+            }
+            if (outPipe <= 0)
+            {
+                perror("[SyncDir] Error: SpliceFrameToFile(): Error at file writing (splice).\n");
+                return STATUS_FAIL;
+            }
+            inPipe = inPipe - outPipe;
+            (*FrameRecvBytes) = (*FrameRecvBytes) + outPipe;
+        }
+    }
+
+    return STATUS_SUCCESS;
+} // SpliceFrameToFile()
+
+
+
+
+//
+// WriteBufferToFile
+//
+static
+SDSTATUS
+WriteBufferToFile(
+    __in __int32        FileDescriptor,
+    __in const BYTE     *Buffer,
+    __in DWORD          BufferSize
+    )
+/*++
+Description: The routine writes BufferSize bytes to the file. A write() may write fewer bytes than requested: the routine resumes 
+until all the bytes are written.
+--*/
+{
+    DWORD       offset;
+    ssize_t     writtenBytes;
+
+    for (offset = 0; offset < BufferSize; offset += writtenBytes)
+    {
+        writtenBytes = write(FileDescriptor, Buffer + offset, BufferSize - offset);
+        if (writtenBytes <= 0)
+        {
+            perror("[SyncDir] Error: WriteBufferToFile(): Error at file writing. \n");
+            printf("[SyncDir] Error: WriteBufferToFile(): Only %u/%u bytes written to file.\n", offset, BufferSize);
+            return STATUS_FAIL;
+        }
+    }
+
+    return STATUS_SUCCESS;
+} // WriteBufferToFile()
+
+
+
+
+//
+// CompleteFileWrites
+//
+static
+SDSTATUS
+CompleteFileWrites(
+    __inout URING       *Ring,
+    __inout DWORD       *Lengths,
+    __in DWORD          First,
+    __in DWORD          Count
+    )
+/*++
+Description: The routine waits for the io_uring writes in flight on Count buffers of the ring, from First on (in turns), and checks 
+that each one wrote its whole piece (Lengths: bytes of the write on each buffer, 0 if none; reset). See RecvDataFramesToFile().
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (a write failed or was short, e.g. disk full).
+--*/
+{
+    SDSTATUS    status;
+    __int32     result;
+    DWORD       slot;
+    DWORD       i;
+
+    status = STATUS_SUCCESS;
+
+    for (i = 0; i < Count; i ++)
+    {
+        slot = (First + i) % Ring->QueueDepth;
+        if (0 == Lengths[slot])
+        {
+            continue;
+        }
+        if (!(SUCCESS(UringWaitBuffer(Ring, slot, &result))) || result != (__int32) Lengths[slot])
+        {
+            printf("[SyncDir] Error: CompleteFileWrites(): Error at file writing (%s): [%d/%u B] written.\n", 
+                (result < 0) ? strerror(-result) : "short write", SD_MAX(result, 0), Lengths[slot]);
+            status = STATUS_FAIL;
+        }
+        Lengths[slot] = 0;
+    }
+
+    return status;
+} // CompleteFileWrites()
+
+
+
+
+//
+// IsZeroBuffer
+//
+static inline
+BOOL
+IsZeroBuffer(
+    __in const BYTE     *Buffer,
+    __in DWORD          BufferSize
+    )
+/*++
+Description: The routine checks whether a buffer holds only zeros. Such content, copied to a file being assembled, is skipped: it
+stays a hole, as in the sparse file it comes from.
+--*/
+{
+    return (0 == BufferSize || (0 == Buffer[0] && 0 == memcmp(Buffer, Buffer + 1, BufferSize - 1))) ? TRUE : FALSE;
+} // IsZeroBuffer()
+
+
+
+
+//
+// RecvCompressedFrameToFile
+//
+static
+SDSTATUS
+RecvCompressedFrameToFile(
+    __in DWORD          SockConnID,
+    __in __int32        FileDescriptor,
+    __in DWORD          DataSize,
+    __in DWORD          MaxOriginalSize,
+    __inout BYTE        **Buffers,
+    __inout DWORD       *BufferSizes,
+    __out DWORD         *OriginalSize
+    )
+/*++
+Description: The routine receives the content of a compressed data frame (see SD_DATA_FLAG_COMPRESSED), of DataSize bytes, then
+decompresses it and writes it to the file. Buffers holds the two buffers of the routine (compressed, decompressed content), kept by
+the caller from one frame to the next; they grow as needed (BufferSizes). The original size must not exceed MaxOriginalSize.
+--*/
+{
+    BYTE        *newBuffer;
+    DWORD       neededSizes[2];
+    __int32     recvBytes;
+    DWORD       i;
+
+    if (ccNONE == gCompressionCodec || DataSize <= sizeof(DWORD))
+    {
+        printf("[SyncDir] Error: RecvCompressedFrameToFile(): Unexpected compressed frame (codec: %s, size: %u).\n", 
+            GetCompressionCodecName(gCompressionCodec), DataSize);
+        return STATUS_FAIL;
+    }
+
+    recvBytes = recv(SockConnID, OriginalSize, sizeof(DWORD), MSG_WAITALL);
+    if (sizeof(DWORD) != recvBytes)
+    {
+        perror("[SyncDir] Error: RecvCompressedFrameToFile(): Error at receiving from client (original size).\n");
+        return STATUS_FAIL;
+    }
+    (*OriginalSize) = ntohl((*OriginalSize));
+    if ((*OriginalSize) > MaxOriginalSize || (*OriginalSize) > SD_DATA_FRAME_MAX_SIZE)
+    {
+        printf("[SyncDir] Error: RecvCompressedFrameToFile(): Invalid original size [%u] (at most [%u B] left).\n", (*OriginalSize), 
+            MaxOriginalSize);
+        return STATUS_FAIL;
+    }
+
+    // Grow the buffers, if needed.
+
+    neededSizes[0] = DataSize - sizeof(DWORD);
+    neededSizes[1] = (*OriginalSize);
+    for (i = 0; i < 2; i ++)
+    {
+        if (BufferSizes[i] < neededSizes[i])
+        {
+            newBuffer = (BYTE*) realloc(Buffers[i], neededSizes[i]);
+            if (NULL == newBuffer)
+            {
+                printf("[SyncDir] Error: RecvCompressedFrameToFile(): Error at realloc().\n");
+                return STATUS_FAIL;
+            }
+            Buffers[i] = newBuffer;
+            BufferSizes[i] = neededSizes[i];
+        }
+    }
+
+    recvBytes = recv(SockConnID, Buffers[0], neededSizes[0], MSG_WAITALL);
+    if (neededSizes[0] != (DWORD) recvBytes)
+    {
+        perror("[SyncDir] Error: RecvCompressedFrameToFile(): Error at receiving from client (compressed data).\n");
+        return STATUS_FAIL;
+    }
+
+    if (!(SUCCESS(DecompressBlock(gCompressionCodec, Buffers[0], neededSizes[0], Buffers[1], (*OriginalSize)))))
+    {
+        printf("[SyncDir] Error: RecvCompressedFrameToFile(): Corrupt compressed frame ([%u B], original [%u B]).\n", neededSizes[0], 
+            (*OriginalSize));
+        return STATUS_FAIL;
+    }
+
+    return WriteBufferToFile(FileDescriptor, Buffers[1], (*OriginalSize));
+} // RecvCompressedFrameToFile()
+
+
+
+
+//
+// PreallocateFile
+//
+static
+void
+PreallocateFile(
+    __in __int32    FileDescriptor,
+    __in QWORD      FileSize
+    )
+/*++
+Description: The routine reserves the disk space of a file to be received (FileSize bytes, announced by the client), so that it is
+written in few extents, and a full disk is met before receiving, not in the middle of the file. The file takes the announced size
+at once (a hole skipped is punched back, see RecvDataFramesToFile(); ext4 punches nothing beyond the size); the receiving routine
+sets the final size, at the end. Best effort: nothing is reserved if SD_SRV_PREALLOCATE is FALSE, if the file system does not
+support it, or if the free space is short.
+--*/
+{
+    struct statvfs  fsStat;
+
+    if (FALSE == SD_SRV_PREALLOCATE || 0 == FileSize)
+    {
+        return;
+    }
+    if (fstatvfs(FileDescriptor, &fsStat) < 0 || (QWORD) fsStat.f_bavail * fsStat.f_frsize <= FileSize)
+    {
+        return;
+    }
+
+    fallocate(FileDescriptor, 0, 0, (off_t) FileSize);
+} // PreallocateFile()
+
+
+
+
+//
+// CreateTempFile
+//
+static
+__int32
+CreateTempFile(
+    __in const char     *FileFullPath,
+    __out char          *TempFullPath
+    )
+/*++
+Description: The routine creates the temporary file where a whole file is received, before it takes the place of FileFullPath (see
+PublishTempFile()). Readers of the directory never see a half-written file, and a failed transfer leaves the server copy untouched.
+The file is unnamed (O_TMPFILE, in the directory of FileFullPath): nothing is left behind by a crash. If the file system does not
+support it, the file is named <file>SD_SRV_TEMP_SUFFIX (not indexed, see IsPartialFileName()).
+
+- FileFullPath: Pointer to the full path of the file to be received.
+- TempFullPath: Pointer to where the routine outputs the path of the temporary file (SD_MAX_PATH_LENGTH bytes), or an empty string
+if the file is unnamed.
+
+Return value: The descriptor of the temporary file (open for writing), or -1 on failure.
+--*/
+{
+    char        dirFullPath[SD_MAX_PATH_LENGTH];
+    char        *lastSlash;
+    __int32     fileDescriptor;
+
+    TempFullPath[0] = 0;
+
+    snprintf(dirFullPath, SD_MAX_PATH_LENGTH, "%s", FileFullPath);
+    lastSlash = strrchr(dirFullPath, '/');
+    if (NULL != lastSlash && lastSlash != dirFullPath)
+    {
+        (*lastSlash) = 0;
+
+        fileDescriptor = open(dirFullPath, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666);
+        if (fileDescriptor >= 0)
+        {
+            return fileDescriptor;
+        }
+    }
+
+    if (SD_MAX_PATH_LENGTH <= snprintf(TempFullPath, SD_MAX_PATH_LENGTH, "%s%s", FileFullPath, SD_SRV_TEMP_SUFFIX))
+    {
+        TempFullPath[0] = 0;
+        return -1;
+    }
+
+    return open(TempFullPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+} // CreateTempFile()
+
+
+
+
+//
+// PublishTempFile
+//
+static
+SDSTATUS
+PublishTempFile(
+    __in __int32        FileDescriptor,
+    __in const char     *TempFullPath,
+    __in const char     *FileFullPath,
+    __in QWORD          FileSize
+    )
+/*++
+Description: The routine makes a temporary file, fully received, take the place of FileFullPath, in one step (rename()): the readers
+see either the previous file or the new one. An unnamed file (see CreateTempFile()) is linked into the directory first. The file
+keeps the permissions of the file it replaces. The file is not synced to disk here: it is counted for the next group commit (see
+CommitReceivedFiles()), so that one sync covers a whole batch of files.
+
+- FileDescriptor: Descriptor of the temporary file. Required if the file is unnamed, -1 otherwise allowed.
+- TempFullPath: Pointer to the path of the temporary file, or an empty string if the file is unnamed.
+- FileFullPath: Pointer to the full path the file takes.
+- FileSize: Size of the file, in bytes (group commit accounting).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (a named temporary file is removed; FileFullPath is untouched).
+--*/
+{
+    char            procFdPath[32];
+    char            linkFullPath[SD_MAX_PATH_LENGTH];
+    struct stat     oldFileStat;
+
+    if (0 == stat(FileFullPath, &oldFileStat) && S_ISREG(oldFileStat.st_mode))
+    {
+        if (FileDescriptor >= 0)
+        {
+            fchmod(FileDescriptor, oldFileStat.st_mode & 07777);
+        }
+        else
+        {
+            chmod(TempFullPath, oldFileStat.st_mode & 07777);
+        }
+    }
+
+    if (0 == TempFullPath[0])
+    {
+        // Unnamed: linked at its final path if free, otherwise at a temporary name, then renamed over the file.
+
+        snprintf(procFdPath, sizeof(procFdPath), "/proc/self/fd/%d", FileDescriptor);
+        if (0 == linkat(AT_FDCWD, procFdPath, AT_FDCWD, FileFullPath, AT_SYMLINK_FOLLOW))
+        {
+            linkFullPath[0] = 0;
+        }
+        else
+        {
+            snprintf(linkFullPath, SD_MAX_PATH_LENGTH, "%s%s", FileFullPath, SD_SRV_TEMP_SUFFIX);
+            unlink(linkFullPath);
+            if (linkat(AT_FDCWD, procFdPath, AT_FDCWD, linkFullPath, AT_SYMLINK_FOLLOW) < 0)
+            {
+                perror("[SyncDir] Error: PublishTempFile(): Error at linking the received file. \n");
+                return STATUS_FAIL;
+            }
+        }
+    }
+    else
+    {
+        snprintf(linkFullPath, SD_MAX_PATH_LENGTH, "%s", TempFullPath);
+    }
+
+    if (0 != linkFullPath[0] && rename(linkFullPath, FileFullPath) < 0)
+    {
+        perror("[SyncDir] Error: PublishTempFile(): Error at renaming the received file. \n");
+        unlink(linkFullPath);
+        return STATUS_FAIL;
+    }
+
+    gGroupCommit.Files ++;
+    gGroupCommit.Bytes = gGroupCommit.Bytes + FileSize;
+
+    return STATUS_SUCCESS;
+} // PublishTempFile()
+
+
+
+
+//
+// CopyLocalFile
+//
+static
+SDSTATUS
+CopyLocalFile(
+    __in const char     *SourceFullPath,
+    __in const char     *FileFullPath,
+    __out QWORD         *FileSize
+    )
+/*++
+Description: The routine copies a server file holding the content needed (dedupe hit) to FileFullPath, in the process, in the
+cheapest way available: a reflink (FICLONE, the copy shares the blocks of the source: instant, no space used; btrfs, XFS), else
+copy_file_range() (the kernel copies, without user space buffers; server-side copy on network file systems), else read() and
+write(). The copy is made in a temporary file which takes the place of FileFullPath (see PublishTempFile()).
+
+- SourceFullPath: Pointer to the full path of the server file to copy.
+- FileFullPath: Pointer to the full path of the copy.
+- FileSize: Pointer to where the routine outputs the size of the copy.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (FileFullPath is untouched).
+--*/
+{
+    SDSTATUS        status;
+    __int32         sourceDescriptor;
+    __int32         fileDescriptor;
+    char            tempFullPath[SD_MAX_PATH_LENGTH];
+    struct stat     sourceStat;
+    const char      *copyMethod;
+    BYTE            *buffer;
+    ssize_t         copiedBytes;
+    QWORD           totalCopiedBytes;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    sourceDescriptor = -1;
+    fileDescriptor = -1;
+    tempFullPath[0] = 0;
+    copyMethod = "reflink";
+    buffer = NULL;
+    copiedBytes = 0;
+    totalCopiedBytes = 0;
+
+    // Parameter validation.
+
+    if (NULL == SourceFullPath || NULL == FileFullPath || NULL == FileSize)
+    {
+        printf("[SyncDir] Error: CopyLocalFile(): Invalid parameters.\n");
+        return STATUS_FAIL;
+    }
+    (*FileSize) = 0;
+
+    __try
+    {
+        sourceDescriptor = open(SourceFullPath, O_RDONLY | O_CLOEXEC);
+        if (sourceDescriptor < 0 || fstat(sourceDescriptor, &sourceStat) < 0 || !S_ISREG(sourceStat.st_mode))
+        {
+            perror("[SyncDir] Warning: CopyLocalFile(): Error at opening the source file.\n");
+            throw SyncDirException();
+        }
+        fileDescriptor = CreateTempFile(FileFullPath, tempFullPath);
+        if (fileDescriptor < 0)
+        {
+            perror("[SyncDir] Warning: CopyLocalFile(): Error at creating the copy.\n");
+            throw SyncDirException();
+        }
+
+
+        // 1. Reflink. 2. copy_file_range(), up to the end of the source (which may change meanwhile). 3. Buffered copy.
+
+        if (FALSE == SD_SRV_REFLINK_COPY || ioctl(fileDescriptor, FICLONE, sourceDescriptor) < 0)
+        {
+            copyMethod = "copy_file_range";
+            while (0 < (copiedBytes = copy_file_range(sourceDescriptor, NULL, fileDescriptor, NULL, SD_SRV_COPY_CHUNK_SIZE, 0)))
+            {
+                totalCopiedBytes = totalCopiedBytes + (QWORD) copiedBytes;
+            }
+            if (copiedBytes < 0 && 0 == totalCopiedBytes && 
+                (EXDEV == errno || ENOSYS == errno || EOPNOTSUPP == errno || EINVAL == errno))
+            {
+                copyMethod = "buffered";
+                buffer = (BYTE*) malloc(SD_FILE_READ_BUFFER_SIZE);
+                if (NULL == buffer)
+                {
+                    printf("[SyncDir] Warning: CopyLocalFile(): Error at malloc().\n");
+                    throw SyncDirException();
+                }
+                while (0 < (copiedBytes = read(sourceDescriptor, buffer, SD_FILE_READ_BUFFER_SIZE)))
+                {
+                    if (!(SUCCESS(WriteBufferToFile(fileDescriptor, buffer, (DWORD) copiedBytes))))
+                    {
+                        throw SyncDirException();
+                    }
+                    totalCopiedBytes = totalCopiedBytes + (QWORD) copiedBytes;
+                }
+            }
+            if (copiedBytes < 0)
+            {
+                perror("[SyncDir] Warning: CopyLocalFile(): Error at copying the file.\n");
+                throw SyncDirException();
+            }
+        }
+        else
+        {
+            totalCopiedBytes = (QWORD) sourceStat.st_size;
+        }
+
+
+        // The copy takes its place.
+
+        if (!(SUCCESS(PublishTempFile(fileDescriptor, tempFullPath, FileFullPath, totalCopiedBytes))))
+        {
+            tempFullPath[0] = 0;                                        // Already removed.
+            throw SyncDirException();
+        }
+        tempFullPath[0] = 0;
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Local copy of [%s]: [%llu B] (%s). \n", SourceFullPath, 
+            (unsigned long long) totalCopiedBytes, copyMethod);
+        (*FileSize) = totalCopiedBytes;
+
+        status = STATUS_SUCCESS;
+    }
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";
+        status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: CopyLocalFile(): Standard Exception caught: " << e.what() << "\n";
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: CopyLocalFile(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (0 != tempFullPath[0])
+    {
+        unlink(tempFullPath);
+    }
+    if (fileDescriptor >= 0)
+    {
+        close(fileDescriptor);
+    }
+    if (sourceDescriptor >= 0)
+    {
+        close(sourceDescriptor);
+    }
+    free(buffer);
+
+    return status;
+} // CopyLocalFile()
+
+
+
+
+//
+// CheckpointPartialFile
+//
+static
+SDSTATUS
+CheckpointPartialFile(
+    __in __int32    FileDescriptor,
+    __in QWORD      Offset
+    )
+/*++
+Description: The routine records that the first Offset bytes of a resumable partial file were received (see STRIPE_TRANSFER): the
+content is synced to disk first (fdatasync()), then the offset is stored (SD_SRV_PARTIAL_XATTR_OFFSET). So the recorded offset never
+covers bytes lost by a crash of the server.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the previous checkpoint stays).
+--*/
+{
+    char    offsetText[24];
+
+    snprintf(offsetText, sizeof(offsetText), "%llu", (unsigned long long) Offset);
+
+    if (fdatasync(FileDescriptor) < 0 || fsetxattr(FileDescriptor, SD_SRV_PARTIAL_XATTR_OFFSET, offsetText, strlen(offsetText), 0) < 0)
+    {
+        perror("[SyncDir] Warning: CheckpointPartialFile(): Error at recording the checkpoint.\n");
+        return STATUS_FAIL;
+    }
+
+    return STATUS_SUCCESS;
+} // CheckpointPartialFile()
+
+
+
+
+//
+// CreatePartialFile
+//
+static
+SDSTATUS
+CreatePartialFile(
+    __in const char     *PartialFullPath,
+    __in const char     *HashCode,
+    __in QWORD          FileSize,
+    __out BOOL          *IsResumable
+    )
+/*++
+Description: The routine creates (or empties) the partial file of a whole file to be received, reserves its size (see
+PreallocateFile()), and identifies its content in extended attributes (SD_SRV_PARTIAL_XATTR_CONTENT, and an offset of 0). If the
+file system does not support them, the file is created all the same, but the transfer cannot be resumed (IsResumable is FALSE).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the file could not be created).
+--*/
+{
+    __int32     fileDescriptor;
+    char        contentText[SD_MAX_HASH_CODE_LENGTH + 24];
+
+    (*IsResumable) = FALSE;
+
+    fileDescriptor = open(PartialFullPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fileDescriptor < 0)
+    {
+        return STATUS_FAIL;
+    }
+
+    PreallocateFile(fileDescriptor, FileSize);
+
+    snprintf(contentText, sizeof(contentText), "%s %llu", HashCode, (unsigned long long) FileSize);
+    if (0 == fsetxattr(fileDescriptor, SD_SRV_PARTIAL_XATTR_CONTENT, contentText, strlen(contentText), 0) && 
+        0 == fsetxattr(fileDescriptor, SD_SRV_PARTIAL_XATTR_OFFSET, "0", 1, 0))
+    {
+        (*IsResumable) = TRUE;
+    }
+
+    close(fileDescriptor);
+
+    return STATUS_SUCCESS;
+} // CreatePartialFile()
+
+
+
+
+//
+// ResumeOffsetOfPartialFile
+//
+static
+QWORD
+ResumeOffsetOfPartialFile(
+    __in const char     *PartialFullPath,
+    __in const char     *HashCode,
+    __in QWORD          FileSize
+    )
+/*++
+Description: The routine checks whether a partial file left by an interrupted transfer holds the start of the given content (same
+hash code and size, see CreatePartialFile()), and how much of it was checkpointed (see CheckpointPartialFile()).
+
+Return value: The offset to resume from (the bytes beyond it are not trusted), or 0 if the transfer cannot be resumed.
+--*/
+{
+    char            contentText[SD_MAX_HASH_CODE_LENGTH + 24];
+    char            expectedText[SD_MAX_HASH_CODE_LENGTH + 24];
+    char            offsetText[24];
+    ssize_t         length;
+    struct stat     partialStat;
+    unsigned long long offset;
+
+    if (lstat(PartialFullPath, &partialStat) < 0 || !S_ISREG(partialStat.st_mode))
+    {
+        return 0;
+    }
+
+    length = getxattr(PartialFullPath, SD_SRV_PARTIAL_XATTR_CONTENT, contentText, sizeof(contentText) - 1);
+    if (length <= 0)
+    {
+        return 0;
+    }
+    contentText[length] = 0;
+    snprintf(expectedText, sizeof(expectedText), "%s %llu", HashCode, (unsigned long long) FileSize);
+    if (0 != strcmp(contentText, expectedText))
+    {
+        return 0;
+    }
+
+    length = getxattr(PartialFullPath, SD_SRV_PARTIAL_XATTR_OFFSET, offsetText, sizeof(offsetText) - 1);
+    if (length <= 0)
+    {
+        return 0;
+    }
+    offsetText[length] = 0;
+    offset = strtoull(offsetText, NULL, 10);
+
+    return (offset < FileSize) ? (QWORD) offset : 0;                   // Beyond the size of the partial file: holes (sparse file).
+} // ResumeOffsetOfPartialFile()
+
+
+
+
+//
+// SuspendPartialFile
+//
+static
+void
+SuspendPartialFile(
+    __in const STRIPE_TRANSFER  &Transfer
+    )
+/*++
+Description: The routine handles the partial file of an interrupted transfer: if resumable, it is checkpointed at the end of the bytes
+received in order (ContiguousEnd) and kept, for a later "File Resume"; otherwise, it is removed.
+--*/
+{
+    __int32     fileDescriptor;
+
+    if (TRUE == Transfer.IsResumable && Transfer.ContiguousEnd > Transfer.DurableOffset)
+    {
+        fileDescriptor = open(Transfer.TempFullPath.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fileDescriptor >= 0)
+        {
+            CheckpointPartialFile(fileDescriptor, Transfer.ContiguousEnd);
+            close(fileDescriptor);
+        }
+    }
+
+    if (TRUE == Transfer.IsResumable)
+    {
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Partial file [%s] kept for resuming: [%llu/%llu B] received in order. \n", 
+            Transfer.TempFullPath.c_str(), (unsigned long long) SD_MAX(Transfer.ContiguousEnd, Transfer.DurableOffset), 
+            (unsigned long long) Transfer.FileSize);
+    }
+    else
+    {
+        unlink(Transfer.TempFullPath.c_str());
+    }
+} // SuspendPartialFile()
+
+
+
+
+//
+// RemovePartialFile
+//
+static
+void
+RemovePartialFile(
+    __in const char     *FileFullPath
+    )
+/*++
+Description: The routine removes the partial file kept for resuming the transfer of a file (see SuspendPartialFile()), if any: the
+file was deleted or moved by the client, so the content of the partial file is stale.
+--*/
+{
+    std::string     partialFullPath;
+
+    partialFullPath.assign(FileFullPath).append(SD_SRV_PARTIAL_SUFFIX);
+    if (0 == unlink(partialFullPath.c_str()))
+    {
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Stale partial file [%s] removed. \n", partialFullPath.c_str());
+    }
+} // RemovePartialFile()
+
+
+
+
+//
+// RecvDataFramesToFile
+//
+static
+SDSTATUS
+RecvDataFramesToFile(
+    __in DWORD      SockConnID,
+    __in __int32    FileDescriptor,
+    __in QWORD      MaxSize,
+    __in BOOL       IsCheckpointed,
+    __out QWORD     *ReceivedSize
+    )
+/*++
+Description: The routine receives data frames (see PACKET_DATA_HEADER), up to the last one (SD_DATA_FLAG_EOF), and writes their content
+to the file, from its current offset: a whole file (see RecvFileFromClient()), or one range of it (see PACKET_STRIPE_HEADER). Exactly
+the framed length is received, whatever the frame size chosen by the client; the content must not exceed MaxSize bytes.
+With SD_SRV_SPLICE_RECV, the content is moved from the socket to the file with splice() (see SpliceFrameToFile()); otherwise, or if
+the file system does not support it, it is received by pieces of at most SD_FILE_READ_BUFFER_SIZE bytes and written. With 
+SD_SRV_IO_URING (if the kernel provides io_uring), the pieces are written asynchronously, in turns from SD_SRV_WRITE_QUEUE_DEPTH
+buffers, at the offset of the file (moved past them at once): the next pieces are received while the previous ones are written. All
+the writes are complete before a checkpoint and before the routine returns. Compressed
+frames (see SD_DATA_FLAG_COMPRESSED) are received whole, decompressed and written. A hole (see SD_DATA_FLAG_HOLE) moves the offset
+of the file forward, without writing: the file stays sparse. The holes at the end of a file are not written at all: the caller sets
+the size of the complete file.
+With IsCheckpointed (resumable partial file, see STRIPE_TRANSFER), the file is checkpointed every SD_SRV_PARTIAL_CHECKPOINT_SIZE
+bytes and on failure, at its current offset: only whole pieces of content are written, so all the bytes before it were received.
+
+Return value: STATUS_SUCCESS on success (ReceivedSize: bytes of content written), STATUS_FAIL otherwise (the connection is out of 
+sync).
+--*/
+{
+    SDSTATUS            status;
+    __int32             recvBytes;
+    QWORD               totalRecvBytes;
+    QWORD               checkpointedBytes;
+    DWORD               frameRecvBytes;
+    DWORD               frameContentSize;
+    DWORD               pieceSize;
+    __int32             pipeFds[2];
+    BOOL                bUseSplice;
+    PACKET_DATA_HEADER  header;
+    BYTE                *buffer;
+    BYTE                *pieceBuffer;
+    BYTE                *compressionBuffers[2];
+    DWORD               compressionBufferSizes[2];
+    URING               ring;                                           // Asynchronous writes of the pieces (see CompleteFileWrites()).
+    BYTE                *ringBuffers[SD_SRV_WRITE_QUEUE_DEPTH];
+    DWORD               ringLengths[SD_SRV_WRITE_QUEUE_DEPTH];          // Bytes of the write in flight on each buffer, 0 if none.
+    DWORD               ringSlot;
+    BOOL                bUseRing;
+    BOOL                bRingTried;
+    BOOL                bRingFailed;                                    // A write failed: the file offset is not trusted.
+    off_t               fileOffset;
+    DWORD               i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    recvBytes = -1;
+    totalRecvBytes = 0;
+    checkpointedBytes = 0;
+    frameRecvBytes = 0;
+    frameContentSize = 0;
+    pieceSize = 0;
+    pipeFds[0] = -1;
+    pipeFds[1] = -1;
+    bUseSplice = FALSE;
+    header.Flags = 0;
+    header.DataSize = 0;
+    buffer = NULL;
+    pieceBuffer = NULL;
+    compressionBuffers[0] = NULL;
+    compressionBuffers[1] = NULL;
+    compressionBufferSizes[0] = 0;
+    compressionBufferSizes[1] = 0;
+    ring.RingFd = -1;
+    ring.QueueDepth = 0;
+    for (i = 0; i < SD_SRV_WRITE_QUEUE_DEPTH; i ++)
+    {
+        ringBuffers[i] = NULL;
+        ringLengths[i] = 0;
+    }
+    ringSlot = 0;
+    bUseRing = FALSE;
+    bRingTried = FALSE;
+    bRingFailed = FALSE;
+    fileOffset = 0;
+    (*ReceivedSize) = 0;
+
+
+    __try
+    {
+        // INIT (start).
+
+        buffer = (BYTE*) malloc(SD_FILE_READ_BUFFER_SIZE);
+        if (NULL == buffer)
+        {
+            printf("[SyncDir] Error: RecvDataFramesToFile(): Error at malloc().\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        // Pipe for splice(). Not fatal: without it, the content is received through the buffer.
+
+        if (SD_SRV_SPLICE_RECV)
+        {
+            if (0 == pipe2(pipeFds, O_CLOEXEC))
+            {
+                fcntl(pipeFds[1], F_SETPIPE_SZ, SD_SRV_SPLICE_PIPE_SIZE);        // Best effort (limited by /proc/sys/fs/pipe-max-size).
+                bUseSplice = TRUE;
+            }
+            else
+            {
+                perror("[SyncDir] Warning: RecvDataFramesToFile(): Error at pipe creation. Receiving through buffer.\n");
+                pipeFds[0] = -1;
+                pipeFds[1] = -1;
+            }
+        }
+
+        // --> INIT (end)
+
+
+
+        //
+        // Main procecssing:
+        //
+
+        // Receive the content, frame by frame.
+        // Write to the open file.
+
+        while (1)
+        {
+
+            recvBytes = recv(SockConnID, &header, sizeof(header), MSG_WAITALL);
+            if (sizeof(header) != (DWORD) recvBytes)
+            { 
+                if (recvBytes < 0)
+                {
+                    perror("[SyncDir] Error: RecvDataFramesToFile(): Error at receiving from client (frame header). Abandoning file receiving.\n");
+                }
+                else
+                {
+                    printf("[SyncDir] Error: RecvDataFramesToFile(): %d/%lu bytes received (frame header).\n", recvBytes, sizeof(header));
+                }      
+                status = STATUS_FAIL;
+                throw SyncDirException();  
+            }
+            header.Flags = ntohl(header.Flags);
+            header.DataSize = ntohl(header.DataSize);
+
+            if ((!(SD_DATA_FLAG_HOLE & header.Flags) && header.DataSize > SD_DATA_FRAME_MAX_SIZE) || 
+                (!(SD_DATA_FLAG_COMPRESSED & header.Flags) && header.DataSize > MaxSize - totalRecvBytes))
+            {
+                printf("[SyncDir] Error: RecvDataFramesToFile(): Invalid frame size [%u] (at [%llu/%llu B]).\n", header.DataSize, 
+                    (unsigned long long) totalRecvBytes, (unsigned long long) MaxSize);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+
+            // Hole: no content, skipped. Compressed frame: received whole, then decompressed.
+
+            if (SD_DATA_FLAG_HOLE & header.Flags)
+            {
+                fileOffset = lseek(FileDescriptor, header.DataSize, SEEK_CUR);
+                if ((off_t) -1 == fileOffset)
+                {
+                    perror("[SyncDir] Error: RecvDataFramesToFile(): Error at skipping a hole. Abandoning file receiving.\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                if (TRUE == SD_SRV_PREALLOCATE && 0 != header.DataSize)       // Space reserved for the hole (see PreallocateFile()).
+                {
+                    fallocate(FileDescriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, fileOffset - (off_t) header.DataSize, 
+                        (off_t) header.DataSize);
+                }
+                frameContentSize = header.DataSize;
+            }
+            else if (SD_DATA_FLAG_COMPRESSED & header.Flags)
+            {
+                status = RecvCompressedFrameToFile(SockConnID, FileDescriptor, header.DataSize, 
+                    (DWORD) SD_MIN(MaxSize - totalRecvBytes, (QWORD) SD_DATA_FRAME_MAX_SIZE), compressionBuffers, compressionBufferSizes, &frameContentSize);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: RecvDataFramesToFile(): RecvCompressedFrameToFile() failed. Abandoning file receiving.\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+            else
+            {
+                frameContentSize = header.DataSize;
+            }
+
+
+            // Receive exactly the framed length: spliced, then (if splice() is not supported) by pieces.
+
+            frameRecvBytes = ((SD_DATA_FLAG_COMPRESSED | SD_DATA_FLAG_HOLE) & header.Flags) ? header.DataSize : 0;
+
+            if (bUseSplice && frameRecvBytes < header.DataSize)
+            {
+                status = SpliceFrameToFile(SockConnID, pipeFds, FileDescriptor, header.DataSize, buffer, &frameRecvBytes, &bUseSplice);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: RecvDataFramesToFile(): SpliceFrameToFile() failed. Abandoning file receiving.\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                if (!bUseSplice)
+                {
+                    fprintf(g_SD_STDLOG, "[SyncDir] Info: RecvDataFramesToFile(): splice() not supported. Receiving through buffer. \n");
+                }
+            }
+
+            // Ring for the pieces: set up once, if more than one piece is left to receive.
+
+            if (SD_SRV_IO_URING && FALSE == bRingTried && frameRecvBytes < header.DataSize && 
+                MaxSize - totalRecvBytes > SD_FILE_READ_BUFFER_SIZE)
+            {
+                bRingTried = TRUE;
+                for (i = 0; i < SD_SRV_WRITE_QUEUE_DEPTH; i ++)
+                {
+                    if (0 != posix_memalign((void**) &ringBuffers[i], SD_FILE_READ_BUFFER_ALIGNMENT, SD_FILE_READ_BUFFER_SIZE))
+                    {
+                        ringBuffers[i] = NULL;
+                        break;
+                    }
+                }
+                if (SD_SRV_WRITE_QUEUE_DEPTH == i && SUCCESS(UringSetup(&ring, SD_SRV_WRITE_QUEUE_DEPTH, ringBuffers, SD_FILE_READ_BUFFER_SIZE)))
+                {
+                    bUseRing = TRUE;
+                }
+            }
+
+            for (; frameRecvBytes < header.DataSize; frameRecvBytes += pieceSize)
+            {
+                pieceSize = SD_MIN(header.DataSize - frameRecvBytes, (DWORD) SD_FILE_READ_BUFFER_SIZE);
+
+                pieceBuffer = buffer;
+                if (bUseRing)
+                {
+                    status = CompleteFileWrites(&ring, ringLengths, ringSlot, 1);   // The buffer is free again.
+                    if (!(SUCCESS(status)))
+                    {
+                        bRingFailed = TRUE;
+                        status = STATUS_FAIL;
+                        throw SyncDirException();
+                    }
+                    pieceBuffer = ringBuffers[ringSlot];
+                }
+
+                recvBytes = recv(SockConnID, pieceBuffer, pieceSize, MSG_WAITALL);
+                if (pieceSize != (DWORD) recvBytes)
+                {
+                    if (recvBytes < 0)
+                    {
+                        perror("[SyncDir] Error: RecvDataFramesToFile(): Error at receiving from client (file data). Abandoning file receiving.\n");
+                    }
+                    else
+                    {
+                        printf("[SyncDir] Error: RecvDataFramesToFile(): %d/%u bytes received (file data).\n", recvBytes, pieceSize);
+                    }
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+
+                // Written asynchronously (the offset of the file is moved past the piece at once), or synchronously.
+
+                fileOffset = (bUseRing) ? lseek(FileDescriptor, 0, SEEK_CUR) : (off_t) -1;
+                if (0 <= fileOffset && SUCCESS(UringSubmitWrite(&ring, ringSlot, FileDescriptor, pieceSize, (QWORD) fileOffset)))
+                {
+                    ringLengths[ringSlot] = pieceSize;
+                    ringSlot = (ringSlot + 1) % SD_SRV_WRITE_QUEUE_DEPTH;
+                    status = ((off_t) -1 != lseek(FileDescriptor, pieceSize, SEEK_CUR)) ? STATUS_SUCCESS : STATUS_FAIL;
+                }
+                else
+                {
+                    status = WriteBufferToFile(FileDescriptor, pieceBuffer, pieceSize);
+                }
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: RecvDataFramesToFile(): Writing the file data failed.\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+
+            totalRecvBytes = totalRecvBytes + frameContentSize;
+
+
+            // Writes in flight completed before a checkpoint or the end.
+
+            if (bUseRing && ((SD_DATA_FLAG_EOF & header.Flags) || 
+                (TRUE == IsCheckpointed && totalRecvBytes - checkpointedBytes >= SD_SRV_PARTIAL_CHECKPOINT_SIZE)))
+            {
+                status = CompleteFileWrites(&ring, ringLengths, 0, SD_SRV_WRITE_QUEUE_DEPTH);
+                if (!(SUCCESS(status)))
+                {
+                    bRingFailed = TRUE;
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+
+
+            // Checkpoint (resumable partial file).
+
+            if (TRUE == IsCheckpointed && totalRecvBytes - checkpointedBytes >= SD_SRV_PARTIAL_CHECKPOINT_SIZE)
+            {
+                CheckpointPartialFile(FileDescriptor, (QWORD) lseek(FileDescriptor, 0, SEEK_CUR));
+                checkpointedBytes = totalRecvBytes;
+            }
+
+
+            // Exit condition. If the content was completely received (EOF was met).
+
+            if (SD_DATA_FLAG_EOF & header.Flags)
+            {
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: RecvDataFramesToFile(): EOF was met. End transfer. \n");
+
+                fileOffset = lseek(FileDescriptor, 0, SEEK_CUR);
+                if (TRUE == SD_SRV_PREALLOCATE && totalRecvBytes < MaxSize && (off_t) -1 != fileOffset)     // Last hole, not sent.
+                {
+                    fallocate(FileDescriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, fileOffset, (off_t) (MaxSize - totalRecvBytes));
+                }
+                (*ReceivedSize) = totalRecvBytes;
+                break;                
+            }
+
+        }//--> while (1)
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: RecvDataFramesToFile(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: RecvDataFramesToFile(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        UringTeardown(&ring);                                           // No write in flight (completed at EOF).
+        for (i = 0; i < SD_SRV_WRITE_QUEUE_DEPTH; i ++)
+        {
+            free(ringBuffers[i]);
+            ringBuffers[i] = NULL;
+        }
+        free(buffer);
+        buffer = NULL;
+        free(compressionBuffers[0]);
+        free(compressionBuffers[1]);
+        compressionBuffers[0] = NULL;
+        compressionBuffers[1] = NULL;
+        if (0 <= pipeFds[0])
+        {
+            close(pipeFds[0]);
+            close(pipeFds[1]);
+            pipeFds[0] = -1;
+            pipeFds[1] = -1;
+        }
+    }
+    else
+    {
+        if (bUseRing && !(SUCCESS(CompleteFileWrites(&ring, ringLengths, 0, SD_SRV_WRITE_QUEUE_DEPTH))))
+        {
+            bRingFailed = TRUE;
+        }
+        UringTeardown(&ring);
+        for (i = 0; i < SD_SRV_WRITE_QUEUE_DEPTH; i ++)
+        {
+            free(ringBuffers[i]);
+            ringBuffers[i] = NULL;
+        }
+        free(buffer);
+        buffer = NULL;
+        free(compressionBuffers[0]);
+        free(compressionBuffers[1]);
+        compressionBuffers[0] = NULL;
+        compressionBuffers[1] = NULL;
+        if (0 <= pipeFds[0])
+        {
+            close(pipeFds[0]);
+            close(pipeFds[1]);
+            pipeFds[0] = -1;
+            pipeFds[1] = -1;
+        }
+        if (TRUE == IsCheckpointed && FALSE == bRingFailed)             // Keep what was received (see SuspendPartialFile()).
+        {
+            CheckpointPartialFile(FileDescriptor, (QWORD) lseek(FileDescriptor, 0, SEEK_CUR));
+        }
+    }
+
+    return status;
+} // RecvDataFramesToFile()
+
+
+
+
+//
+// RecvFileFromClient
+//
+SDSTATUS
+RecvFileFromClient(
+    __in char       *FileFullPath,
+    __out QWORD     *FileSize,
+    __in DWORD      SockConnID
+    )
+/*++
+Description: The routine receives a whole file from a SyncDir client application. The file content is stored at 
+the location pointed by FileFullPath and the size of the file is output at the FileSize address.
+The size of the file comes first (QWORD, big-endian), then the content, in data frames (see RecvDataFramesToFile()). The content is
+received into a temporary file (see CreateTempFile()), with its size reserved, which takes the place of the file once complete.
+
+- FileFullPath: Pointer to the full path where the routine stores the received file.
+- FileSize: Pointer to where the routine outputs the size of the received file. The caller must provide the storage space. 
+- SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the server copy is left as it was). STATUS_WARNING if the file was
+put in place, but does not hold the content announced (shorter, or its size could not be set).
+--*/
+{
+    SDSTATUS            status;
+    __int32             fileDescriptor;
+    __int32             recvBytes;
+    char                tempFullPath[SD_MAX_PATH_LENGTH];
+    QWORD               announcedSize;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    fileDescriptor = -1;
+    recvBytes = -1;
+    tempFullPath[0] = 0;
+    announcedSize = 0;
+
+    // Parameter validation.
+
+    if (NULL == FileFullPath || 0 == FileFullPath[0])
+    {
+        printf("[SyncDir] Error: RecvFileFromClient(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileSize)
+    {
+        printf("[SyncDir] Error: RecvFileFromClient(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }    
+
+    __try
+    {
+        // INIT (start).
+
+        // Log.
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Receiving file from client. Writing at full path [%s]. \n", FileFullPath);
+
+        // Create the temporary file.
+
+        fileDescriptor = CreateTempFile(FileFullPath, tempFullPath);
+        if (fileDescriptor < 0)
+        {
+            perror("[SyncDir] Error: RecvFileFromClient(): Error at file opening / creation. \n");
+            status = STATUS_FAIL;
+            throw SyncDirException();              
+        }
+
+        // --> INIT (end)
+
+
+
+        //
+        // Main procecssing:
+        //
+
+        // Receive file size.
+
+        recvBytes = recv(SockConnID, FileSize, sizeof(QWORD), MSG_WAITALL);
+        if (sizeof(QWORD) != recvBytes)
+        {
+            if (recvBytes < 0)
+            {
+                perror("[SyncDir] Error: RecvFileFromClient(): Error at receiving from client (file size). Abandoning file reception.\n");
+            }
+            else
+            {
+                printf("[SyncDir] Error: RecvFileFromClient(): Numbers of received/to-receive bytes do not match.\n");
+            }
+            status = STATUS_FAIL;
+            throw SyncDirException();                  
+        }
+
+        // Network to host. Byte order.
+
+        (*FileSize) = be64toh((*FileSize));
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Receiving file of size [%llu]. \n", (unsigned long long) (*FileSize));
+
+        PreallocateFile(fileDescriptor, (*FileSize));
+        announcedSize = (*FileSize);
+
+
+        // Receive whole file content, frame by frame.
+
+        status = RecvDataFramesToFile(SockConnID, fileDescriptor, (*FileSize), FALSE, FileSize);          // Save new file size, at EOF.
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: RecvFileFromClient(): RecvDataFramesToFile() failed. Abandoning file receiving.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        if (ftruncate(fileDescriptor, (off_t) (*FileSize)) < 0)                // Sparse file: its last hole was skipped, not written.
+        {
+            perror("[SyncDir] Warning: RecvFileFromClient(): Error at setting the file size. \n");
+            status = STATUS_WARNING;
+        }
+        if ((*FileSize) < announcedSize)                                // Truncated on the client meanwhile.
+        {
+            printf("[SyncDir] Warning: RecvFileFromClient(): [%llu/%llu B] received: the file was truncated meanwhile. \n", 
+                (unsigned long long) (*FileSize), (unsigned long long) announcedSize);
+            status = STATUS_WARNING;
+        }
+
+        // The file takes its place.
+
+        if (!(SUCCESS(PublishTempFile(fileDescriptor, tempFullPath, FileFullPath, (*FileSize)))))
+        {
+            printf("[SyncDir] Error: RecvFileFromClient(): PublishTempFile() failed for [%s].\n", FileFullPath);
+            tempFullPath[0] = 0;                                        // Already removed.
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+        tempFullPath[0] = 0;
+
+
+        // Log.
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: File received. \n");
+
+
+        // If here, everything is ok.
+        status = SUCCESS_KEEP_WARNING(status);
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: RecvFileFromClient(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: RecvFileFromClient(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        if (0 <= fileDescriptor)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+    }
+    else
+    {
+        if (0 <= fileDescriptor)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+        if (0 != tempFullPath[0])                                       // The server copy is left as it was.
+        {
+            unlink(tempFullPath);
+        }
+    }
+
+    return status;
+} // RecvFileFromClient()
+
+
+
+//
+// StripeReceiverWorker
+//
+static void
+StripeReceiverWorker(
+    __inout STRIPE_RECEIVER *StripeReceiver,
+    __in __int32            DataSock
+    )
+/*++
+Description: Routine of the receiving thread of a data connection. It receives the ranges of the whole files, one after the other
+(see PACKET_STRIPE_HEADER), and writes each one at its offset in the partial file of its transfer, registered at MODIFY time. The
+range is written through its own file descriptor, positioned at the offset: the ranges of a file are written in parallel, each
+thread in its own region. Once the data connection fails (or is closed), the thread ends; the transfers waiting for its ranges fail.
+--*/
+{
+    SDSTATUS                status;
+    PACKET_STRIPE_HEADER    header;
+    std::string             tempFullPath;
+    __int32                 recvBytes;
+    __int32                 fileDescriptor;
+    QWORD                   receivedSize;
+    BOOL                    isValid;
+    BOOL                    isClosing;
+
+    while (1)
+    {
+        // Receive the header of the next range.
+
+        recvBytes = recv(DataSock, &header, sizeof(header), MSG_WAITALL);
+        if (sizeof(header) != (DWORD) recvBytes)
+        {
+            {
+                std::lock_guard<std::mutex> lock(StripeReceiver->Lock);
+                isClosing = StripeReceiver->IsClosing;                      // Closed by the server: nothing to log.
+            }
+            if (FALSE == isClosing)
+            {
+                if (recvBytes < 0)
+                {
+                    perror("[SyncDir] Error: StripeReceiverWorker(): Error at receiving from client (range header).\n");
+                }
+                else
+                {
+                    printf("[SyncDir] Info: StripeReceiverWorker(): Data connection closed by the client.\n");
+                }
+            }
+            break;
+        }
+        header.RequestId = ntohl(header.RequestId);
+        header.Length = ntohl(header.Length);
+        header.Offset = be64toh(header.Offset);
+
+
+        // Find its transfer.
+
+        {
+            std::lock_guard<std::mutex> lock(StripeReceiver->Lock);
+
+            auto iteratorST = StripeReceiver->Transfers.find(header.RequestId);
+            isValid = (StripeReceiver->Transfers.end() != iteratorST && 
+                       header.Offset <= iteratorST->second.FileSize && 
+                       header.Length <= iteratorST->second.FileSize - header.Offset) ? TRUE : FALSE;
+            if (TRUE == isValid)
+            {
+                tempFullPath = iteratorST->second.TempFullPath;
+            }
+        }
+        if (FALSE == isValid)
+        {
+            printf("[SyncDir] Error: StripeReceiverWorker(): Unexpected range [%u B at %llu] of request [%u].\n", header.Length, 
+                (unsigned long long) header.Offset, header.RequestId);
+            break;
+        }
+
+
+        // Receive the range, at its offset.
+
+        fileDescriptor = open(tempFullPath.c_str(), O_WRONLY | O_CLOEXEC);
+        if (fileDescriptor < 0 || (off_t) header.Offset != lseek(fileDescriptor, (off_t) header.Offset, SEEK_SET))
+        {
+            perror("[SyncDir] Error: StripeReceiverWorker(): Error at opening the file of the range.\n");
+            if (fileDescriptor >= 0)
+            {
+                close(fileDescriptor);
+            }
+            break;
+        }
+
+        status = RecvDataFramesToFile(DataSock, fileDescriptor, header.Length, FALSE, &receivedSize);
+        if (!(SUCCESS(status)))
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+            printf("[SyncDir] Error: StripeReceiverWorker(): RecvDataFramesToFile() failed for request [%u].\n", header.RequestId);
+            break;
+        }
+
+
+        // Count the range. Advance the bytes received in order, and checkpoint them (resumable partial file).
+
+        {
+            std::lock_guard<std::mutex> lock(StripeReceiver->Lock);
+
+            auto iteratorST = StripeReceiver->Transfers.find(header.RequestId);
+            if (StripeReceiver->Transfers.end() != iteratorST)
+            {
+                STRIPE_TRANSFER &transfer = iteratorST->second;
+
+                transfer.ReceivedRanges ++;
+                transfer.ReceivedBytes = transfer.ReceivedBytes + receivedSize;
+                transfer.RangeEnds[header.Offset] = header.Offset + receivedSize;
+
+                for (auto iteratorRE = transfer.RangeEnds.begin(); transfer.RangeEnds.end() != iteratorRE && 
+                     iteratorRE->first <= transfer.ContiguousEnd; iteratorRE = transfer.RangeEnds.erase(iteratorRE))
+                {
+                    transfer.ContiguousEnd = SD_MAX(transfer.ContiguousEnd, iteratorRE->second);
+                }
+
+                if (TRUE == transfer.IsResumable && transfer.ContiguousEnd - transfer.DurableOffset >= SD_SRV_PARTIAL_CHECKPOINT_SIZE &&
+                    SUCCESS(CheckpointPartialFile(fileDescriptor, transfer.ContiguousEnd)))
+                {
+                    transfer.DurableOffset = transfer.ContiguousEnd;
+                }
+            }
+        }
+        close(fileDescriptor);
+        fileDescriptor = -1;
+        StripeReceiver->RangeDone.notify_all();
+    }
+
+    // The ranges left on this connection will not come.
+
+    {
+        std::lock_guard<std::mutex> lock(StripeReceiver->Lock);
+
+        StripeReceiver->IsFailed = TRUE;
+    }
+    StripeReceiver->RangeDone.notify_all();
+} // StripeReceiverWorker()
+
+
+
+
+//
+// SrvAcceptDataConnections
+//
+SDSTATUS
+SrvAcceptDataConnections(
+    __in __int32            SrvSock,
+    __inout STRIPE_RECEIVER &StripeReceiver
+    )
+/*++
+Description: The routine accepts the data connections granted to the client at handshake (see PACKET_DATA_CONNECTION), on the 
+listening socket, during at most SD_DATA_CONNECTION_TIMEOUT seconds. Each one must present the key of the session and its index, in
+order (the client opens them one after the other); it is then echoed. Other connections are closed. Then the receiving threads are
+started (see StripeReceiverWorker()).
+
+- SrvSock: Listening socket of the server.
+- StripeReceiver: Data connections of the session (see SrvNegotiateSessionWithClient()).
+
+Return value: STATUS_SUCCESS on success, STATUS_WARNING if fewer data connections were accepted (the session goes on with these),
+STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS                status;
+    PACKET_DATA_CONNECTION  identity;
+    struct pollfd           pollFd;
+    struct timeval          timeout;
+    __int32                 dataSock;
+    __int32                 recvBytes;
+    __int32                 sentBytes;
+    long                    remainingTime;
+    std::chrono::steady_clock::time_point   deadline;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    dataSock = -1;
+    recvBytes = -1;
+    sentBytes = -1;
+    remainingTime = 0;
+
+
+    __try
+    {
+        // INIT.
+
+        timeout.tv_sec = SD_DATA_CONNECTION_TIMEOUT;
+        timeout.tv_usec = 0;
+        pollFd.fd = SrvSock;
+        pollFd.events = POLLIN;
+        deadline = std::chrono::steady_clock::now() + std::chrono::seconds(SD_DATA_CONNECTION_TIMEOUT);
+        StripeReceiver.IsClosing = FALSE;
+        StripeReceiver.IsFailed = FALSE;
+
+
+
+        //
+        // Main processing:
+        //
+
+
+        // Accept the data connections, until all were accepted or the time is up.
+
+        while (StripeReceiver.Socks.size() < StripeReceiver.GrantedConnections)
+        {
+            remainingTime = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (remainingTime <= 0 || 1 != poll(&pollFd, 1, (int) remainingTime))
+            {
+                printf("[SyncDir] Warning: SrvAcceptDataConnections(): No more data connections within [%u] seconds.\n", 
+                    SD_DATA_CONNECTION_TIMEOUT);
+                break;
+            }
+
+            dataSock = accept(SrvSock, NULL, NULL);
+            if (dataSock < 0)
+            {
+                perror("[SyncDir] Warning: SrvAcceptDataConnections(): accept() failed. Continue accepting ...\n");
+                continue;
+            }
+
+            setsockopt(dataSock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+            recvBytes = recv(dataSock, &identity, sizeof(identity), MSG_WAITALL);
+            if (sizeof(identity) != (DWORD) recvBytes || SD_PROTOCOL_MAGIC != ntohl(identity.Magic) || 
+                StripeReceiver.Socks.size() != ntohl(identity.Index) || 
+                0 != memcmp(identity.SessionKey, StripeReceiver.SessionKey, SD_SESSION_KEY_SIZE))
+            {
+                printf("[SyncDir] Warning: SrvAcceptDataConnections(): Not a data connection of the session. Closing it ...\n");
+                close(dataSock);
+                dataSock = -1;
+                continue;
+            }
+
+            sentBytes = send(dataSock, &identity, sizeof(identity), 0);
+            if (sizeof(identity) != (DWORD) sentBytes)
+            {
+                perror("[SyncDir] Warning: SrvAcceptDataConnections(): Error at sending the echo. Closing the data connection ...\n");
+                close(dataSock);
+                dataSock = -1;
+                continue;
+            }
+
+            timeout.tv_sec = 0;                                                 // No timeout for the transfers.
+            setsockopt(dataSock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            timeout.tv_sec = SD_DATA_CONNECTION_TIMEOUT;
+
+            StripeReceiver.Socks.push_back(dataSock);
+            dataSock = -1;
+        }
+
+
+        // Start the receiving threads.
+
+        for (__int32 sock : StripeReceiver.Socks)
+        {
+            StripeReceiver.Receivers.emplace_back(StripeReceiverWorker, &StripeReceiver, sock);
+        }
+
+        printf("[SyncDir] Info: [%u/%u] data connections accepted. \n", (DWORD) StripeReceiver.Socks.size(), 
+            StripeReceiver.GrantedConnections);
+
+
+
+        // If here, everything worked fine.
+        status = (StripeReceiver.Socks.size() < StripeReceiver.GrantedConnections) ? STATUS_WARNING : STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: SrvAcceptDataConnections(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: SrvAcceptDataConnections(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean for the moment. The data connections are closed by SrvCloseDataConnections().
+    }
+    else
+    {
+        SrvCloseDataConnections(StripeReceiver);
+    }
+
+    return status;
+} // SrvAcceptDataConnections()
+
+
+
+
+//
+// SrvCloseDataConnections
+//
+void
+SrvCloseDataConnections(
+    __inout STRIPE_RECEIVER &StripeReceiver
+    )
+/*++
+Description: The routine closes the data connections of the session: the receiving threads are woken up (shutdown()) and waited for.
+The partial files of the transfers not completed are kept for resuming, or removed (see SuspendPartialFile()).
+
+- StripeReceiver: Data connections of the session.
+
+Return value: None.
+--*/
+{
+    {
+        std::lock_guard<std::mutex> lock(StripeReceiver.Lock);
+
+        StripeReceiver.IsClosing = TRUE;
+    }
+
+    for (__int32 sock : StripeReceiver.Socks)
+    {
+        shutdown(sock, SHUT_RDWR);
+    }
+    for (std::thread &receiver : StripeReceiver.Receivers)
+    {
+        if (receiver.joinable())
+        {
+            receiver.join();
+        }
+    }
+    for (__int32 sock : StripeReceiver.Socks)
+    {
+        close(sock);
+    }
+
+    if (!StripeReceiver.Transfers.empty())
+    {
+        printf("[SyncDir] Warning: SrvCloseDataConnections(): [%zu] whole files were not completed. \n", 
+            StripeReceiver.Transfers.size());
+    }
+    for (auto &transfer : StripeReceiver.Transfers)
+    {
+        SuspendPartialFile(transfer.second);
+    }
+
+    StripeReceiver.Socks.clear();
+    StripeReceiver.Receivers.clear();
+    StripeReceiver.Transfers.clear();
+    StripeReceiver.GrantedConnections = 0;
+    StripeReceiver.IsClosing = FALSE;
+    StripeReceiver.IsFailed = FALSE;
+} // SrvCloseDataConnections()
+
+
+
+//
+// WaitStripeTransferFromClient
+//
+static SDSTATUS
+WaitStripeTransferFromClient(
+    __in char               *FileFullPath,
+    __in DWORD              RequestId,
+    __inout STRIPE_RECEIVER &StripeReceiver,
+    __out QWORD             *FileSize,
+    __in DWORD              SockConnID
+    )
+/*++
+Description: The routine completes a whole file received into its partial file (see STRIPE_TRANSFER): it receives the number of ranges
+on the control connection, waits for the data connections to receive all of them (see PACKET_STRIPE_HEADER), then renames the partial
+file to FileFullPath, with its size (its last hole, if sparse, was skipped). With 0 ranges (the client has no data connections), the content follows on the control connection: its size,
+then data frames, written from the start offset of the transfer (checkpointed, if resumable). If the transfer is interrupted, the
+partial file is kept for resuming (see SuspendPartialFile()). If less content than announced was received (file truncated on the
+client meanwhile), the partial file is removed and the file is left as it was: the rest of the preallocated size would be zeros.
+
+Return value: STATUS_SUCCESS on success, STATUS_WARNING if the file could not be completed or put in place but the connections are
+still in sync (e.g. file truncated on the client meanwhile: the file does not hold the content announced), STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS            status;
+    __int32             recvBytes;
+    __int32             fileDescriptor;
+    DWORD               numberOfRanges;
+    QWORD               contentSize;
+    QWORD               receivedSize;
+    BOOL                isComplete;
+    STRIPE_TRANSFER     transfer;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    recvBytes = -1;
+    fileDescriptor = -1;
+    numberOfRanges = 0;
+    contentSize = 0;
+    receivedSize = 0;
+    isComplete = FALSE;
+    (*FileSize) = 0;
+
+
+    __try
+    {
+        // INIT.
+        // --
+
+
+
+        //
+        // Main processing:
+        //
+
+
+        // Receive the number of ranges.
+
+        recvBytes = recv(SockConnID, &numberOfRanges, sizeof(DWORD), MSG_WAITALL);
+        if (sizeof(DWORD) != recvBytes)
+        {
+            perror("[SyncDir] Error: WaitStripeTransferFromClient(): Error at receiving the number of ranges. \n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+        numberOfRanges = ntohl(numberOfRanges);
+
+
+        // Wait for the ranges. Take the transfer over.
+
+        {
+            std::unique_lock<std::mutex> lock(StripeReceiver.Lock);
+
+            auto iteratorST = StripeReceiver.Transfers.find(RequestId);
+            if (StripeReceiver.Transfers.end() == iteratorST || numberOfRanges > SD_MAX(iteratorST->second.FileSize, 1ULL))
+            {
+                printf("[SyncDir] Error: WaitStripeTransferFromClient(): Invalid transfer of request [%u] ([%u] ranges). \n", RequestId, 
+                    numberOfRanges);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            StripeReceiver.RangeDone.wait(lock, [&iteratorST, numberOfRanges, &StripeReceiver] { 
+                return iteratorST->second.ReceivedRanges >= numberOfRanges || TRUE == StripeReceiver.IsFailed; });
+
+            isComplete = (iteratorST->second.ReceivedRanges >= numberOfRanges) ? TRUE : FALSE;
+            transfer = iteratorST->second;
+            StripeReceiver.Transfers.erase(iteratorST);
+        }
+
+
+        // No ranges: the content comes on the control connection, after its size.
+
+        if (0 == numberOfRanges)
+        {
+            recvBytes = recv(SockConnID, &contentSize, sizeof(QWORD), MSG_WAITALL);
+            contentSize = be64toh(contentSize);
+            if (sizeof(QWORD) != recvBytes || contentSize > transfer.FileSize - transfer.StartOffset)
+            {
+                perror("[SyncDir] Error: WaitStripeTransferFromClient(): Error at receiving the size of the content. \n");
+                SuspendPartialFile(transfer);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            fileDescriptor = open(transfer.TempFullPath.c_str(), O_WRONLY | O_CLOEXEC);
+            if (fileDescriptor < 0 || (off_t) transfer.StartOffset != lseek(fileDescriptor, (off_t) transfer.StartOffset, SEEK_SET))
+            {
+                perror("[SyncDir] Error: WaitStripeTransferFromClient(): Error at opening the partial file. \n");
+                SuspendPartialFile(transfer);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+                // The content cannot be received: the connection is out of sync.
+            }
+
+            status = RecvDataFramesToFile(SockConnID, fileDescriptor, contentSize, transfer.IsResumable, &receivedSize);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: WaitStripeTransferFromClient(): RecvDataFramesToFile() failed. \n");
+                if (FALSE == transfer.IsResumable)                      // Otherwise, checkpointed (kept for resuming).
+                {
+                    unlink(transfer.TempFullPath.c_str());
+                }
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            transfer.ReceivedBytes = transfer.StartOffset + receivedSize;
+        }
+        else if (FALSE == isComplete)
+        {
+            SuspendPartialFile(transfer);
+            printf("[SyncDir] Error: WaitStripeTransferFromClient(): A data connection failed: [%u/%u] ranges received. \n", 
+                transfer.ReceivedRanges, numberOfRanges);
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // Less content than announced (truncated on the client meanwhile): the old file stays. The new content follows with the
+        // next modification of the file; a partial file of the old content cannot be resumed.
+
+        (*FileSize) = transfer.ReceivedBytes;
+        if (transfer.ReceivedBytes < transfer.FileSize)
+        {
+            printf("[SyncDir] Warning: WaitStripeTransferFromClient(): Content received short: [%llu/%llu B]. Partial file removed. \n", 
+                (unsigned long long) transfer.ReceivedBytes, (unsigned long long) transfer.FileSize);
+            unlink(transfer.TempFullPath.c_str());
+            status = STATUS_WARNING;
+            throw SyncDirException();
+        }
+
+
+        // All the content was received: the file takes its place.
+
+        status = STATUS_SUCCESS;
+
+        if (truncate(transfer.TempFullPath.c_str(), (off_t) transfer.FileSize) < 0)
+        {
+            perror("[SyncDir] Warning: WaitStripeTransferFromClient(): Error at setting the file size (sparse file). \n");
+            status = STATUS_WARNING;
+        }
+        if (TRUE == transfer.IsResumable)
+        {
+            removexattr(transfer.TempFullPath.c_str(), SD_SRV_PARTIAL_XATTR_CONTENT);
+            removexattr(transfer.TempFullPath.c_str(), SD_SRV_PARTIAL_XATTR_OFFSET);
+        }
+        if (!(SUCCESS(PublishTempFile(-1, transfer.TempFullPath.c_str(), FileFullPath, transfer.ReceivedBytes))))
+        {
+            printf("[SyncDir] Error: WaitStripeTransferFromClient(): PublishTempFile() failed for the partial file. \n");
+            status = STATUS_WARNING;
+        }
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: File received in [%u] ranges: [%llu/%llu B] ([%llu B] resumed). \n", 
+            numberOfRanges, (unsigned long long) (*FileSize), (unsigned long long) transfer.FileSize, 
+            (unsigned long long) transfer.StartOffset);
+
+
+
+        // If here, everything is ok.
+        status = SUCCESS_KEEP_WARNING(status);
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: WaitStripeTransferFromClient(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: WaitStripeTransferFromClient(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        if (0 <= fileDescriptor)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+    }
+    else
+    {
+        if (0 <= fileDescriptor)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+    }
+
+    return status;
+} // WaitStripeTransferFromClient()
+
+
+
+
+//
+// RecvDeltaFromClient
+//
+SDSTATUS
+RecvDeltaFromClient(
+    __in char       *FileFullPath,
+    __in __int32    OldFileDescriptor,
+    __in const char *HashCode,
+    __out QWORD     *FileSize,
+    __in DWORD      SockConnID
+    )
+/*++
+Description: The routine receives a modified file as a delta against the server copy (rsync algorithm, see PACKET_DELTA_HEADER). It
+sends the signatures of the blocks of the server copy (see DeltaSignaturesOfFile()), then rebuilds the file from the instructions of
+the client: literal data, or blocks read from the server copy. The file is rebuilt into a temporary file (see CreateTempFile())
+and hashed while written; it replaces the server copy only if its hash code is the expected one. Otherwise (e.g. the client file
+changed meanwhile, or the server copy could not be read), the client is told so, and sends the whole file.
+
+- FileFullPath: Pointer to the full path of the file (server copy, replaced by the received file).
+- OldFileDescriptor: Descriptor of the server copy, open for reading.
+- HashCode: Pointer to the hash code of the new content, as sent by the client (negotiated algorithm).
+- FileSize: Pointer to where the routine outputs the size of the received file. The caller must provide the storage space. 
+- SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+{
+    SDSTATUS            status;
+    struct stat         oldFileStat;
+    PACKET_DELTA_HEADER header;
+    PACKET_DELTA_BLOCK  *blocks;
+    PACKET_DELTA_OP     op;
+    HASH_CONTEXT        *hashContext;
+    BYTE                *buffer;
+    char                tempFullPath[SD_MAX_PATH_LENGTH];
+    char                newHashCode[SD_MAX_HASH_CODE_LENGTH + 1];
+    char                bufferOut[SD_SHORT_MSG_SIZE];
+    __int32             tempFileDescriptor;
+    DWORD               blockSize;
+    DWORD               numberOfBlocks;
+    QWORD               newFileSize;
+    QWORD               copiedBytes;
+    BOOL                isRebuildFailed;
+    size_t              writtenSoFar;
+    size_t              dataSize;
+    ssize_t             recvBytes;
+    ssize_t             readBytes;
+    ssize_t             writtenBytes;
+    DWORD               i;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    blocks = NULL;
+    hashContext = NULL;
+    buffer = NULL;
+    tempFullPath[0] = 0;
+    newHashCode[0] = 0;
+    memset(bufferOut, 0, sizeof(bufferOut));
+    tempFileDescriptor = -1;
+    blockSize = 0;
+    numberOfBlocks = 0;
+    newFileSize = 0;
+    copiedBytes = 0;
+    isRebuildFailed = FALSE;
+    dataSize = 0;
+    recvBytes = -1;
+
+    // Parameter validation.
+
+    if (NULL == FileFullPath || 0 == FileFullPath[0])
+    {
+        printf("[SyncDir] Error: RecvDeltaFromClient(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (OldFileDescriptor < 0 || fstat(OldFileDescriptor, &oldFileStat) < 0)
+    {
+        printf("[SyncDir] Error: RecvDeltaFromClient(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCode || NULL == FileSize)
+    {
+        printf("[SyncDir] Error: RecvDeltaFromClient(): Invalid parameters 3-4.\n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+
+        // Signatures of the server copy (whole blocks only).
+
+        blockSize = DeltaBlockSize(oldFileStat.st_size);
+        numberOfBlocks = (DWORD) SD_MIN((QWORD) oldFileStat.st_size / blockSize, (QWORD) (0xFFFFFFFF / SD_DELTA_MIN_BLOCK_SIZE));
+
+        blocks = (PACKET_DELTA_BLOCK*) malloc(SD_MAX(numberOfBlocks, (DWORD) 1) * sizeof(PACKET_DELTA_BLOCK));
+        hashContext = (HASH_CONTEXT*) malloc(sizeof(HASH_CONTEXT));
+        buffer = (BYTE*) malloc(SD_MAX(blockSize, (DWORD) SD_DELTA_MAX_LITERAL_SIZE));
+        if (NULL == blocks || NULL == hashContext || NULL == buffer)
+        {
+            printf("[SyncDir] Error: RecvDeltaFromClient(): Error at malloc().\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        status = DeltaSignaturesOfFile(gHashAlgorithm, OldFileDescriptor, blockSize, numberOfBlocks, blocks);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Warning: RecvDeltaFromClient(): DeltaSignaturesOfFile() failed. No block offered.\n");
+            numberOfBlocks = 0;
+            // Fault tolerance: the client sends all the content as literals.
+        }
+
+        header.BlockSize = htonl(blockSize);
+        header.NumberOfBlocks = htonl(numberOfBlocks);
+
+        status = SendBufferToClient(&header, sizeof(PACKET_DELTA_HEADER), SockConnID);
+        if (SUCCESS(status))
+        {
+            status = SendBufferToClient(blocks, numberOfBlocks * sizeof(PACKET_DELTA_BLOCK), SockConnID);
+        }
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: RecvDeltaFromClient(): SendBufferToClient() failed (block signatures).\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Receiving delta against [%u] blocks of [%u B]. \n", numberOfBlocks, blockSize);
+
+
+        // The file is rebuilt aside, and hashed while written.
+
+        tempFileDescriptor = CreateTempFile(FileFullPath, tempFullPath);
+        if (tempFileDescriptor < 0 || fchmod(tempFileDescriptor, oldFileStat.st_mode & 07777) < 0)
+        {
+            perror("[SyncDir] Warning: RecvDeltaFromClient(): Error at creating the rebuilt file.\n");
+            isRebuildFailed = TRUE;
+            // Keep receiving the delta (the connection stays in sync), then ask for the whole file.
+        }
+
+        status = HashInit(hashContext, gHashAlgorithm);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: RecvDeltaFromClient(): HashInit() failed.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+
+        //
+        // Main processing:
+        //
+
+        while (1)
+        {
+            recvBytes = recv(SockConnID, &op, sizeof(PACKET_DELTA_OP), MSG_WAITALL);
+            if (sizeof(PACKET_DELTA_OP) != recvBytes)
+            {
+                perror("[SyncDir] Error: RecvDeltaFromClient(): Error at receiving a delta instruction.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            op.Type = ntohl(op.Type);
+            op.Value = ntohl(op.Value);
+            op.Count = ntohl(op.Count);
+
+            if (SD_DELTA_OP_END == op.Type)
+            {
+                break;
+            }
+
+
+            // Instructions: literal data, or a run of blocks of the server copy.
+
+            if (SD_DELTA_OP_LITERAL == op.Type)
+            {
+                if (op.Value > SD_DELTA_MAX_LITERAL_SIZE)
+                {
+                    printf("[SyncDir] Error: RecvDeltaFromClient(): Invalid literal size [%u].\n", op.Value);
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+
+                recvBytes = recv(SockConnID, buffer, op.Value, MSG_WAITALL);
+                if ((ssize_t) op.Value != recvBytes)
+                {
+                    perror("[SyncDir] Error: RecvDeltaFromClient(): Error at receiving literal data.\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                op.Count = 1;
+                dataSize = op.Value;
+            }
+            else if (SD_DELTA_OP_COPY == op.Type)
+            {
+                if (op.Value >= numberOfBlocks || op.Count > numberOfBlocks - op.Value)
+                {
+                    printf("[SyncDir] Error: RecvDeltaFromClient(): Invalid block run [%u, +%u].\n", op.Value, op.Count);
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                dataSize = blockSize;
+            }
+            else
+            {
+                printf("[SyncDir] Error: RecvDeltaFromClient(): Invalid delta instruction [%u].\n", op.Type);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            for (i = 0; i < op.Count; i++)
+            {
+                if (SD_DELTA_OP_COPY == op.Type)
+                {
+                    readBytes = pread(OldFileDescriptor, buffer, blockSize, (QWORD) (op.Value + i) * blockSize);
+                    if ((ssize_t) blockSize != readBytes)
+                    {
+                        isRebuildFailed = TRUE;                             // The server copy changed meanwhile.
+                    }
+                    copiedBytes = copiedBytes + blockSize;
+                }
+
+                HashUpdate(hashContext, buffer, dataSize);
+                newFileSize = newFileSize + dataSize;
+
+                if (FALSE == isRebuildFailed && TRUE == IsZeroBuffer(buffer, dataSize))       // Zeros: left as a hole (sparse file).
+                {
+                    if ((off_t) -1 == lseek(tempFileDescriptor, dataSize, SEEK_CUR))
+                    {
+                        perror("[SyncDir] Warning: RecvDeltaFromClient(): Error at skipping zeros in the rebuilt file.\n");
+                        isRebuildFailed = TRUE;
+                    }
+                    continue;
+                }
+
+                for (writtenSoFar = 0; FALSE == isRebuildFailed && writtenSoFar < dataSize; writtenSoFar += writtenBytes)
+                {
+                    writtenBytes = write(tempFileDescriptor, buffer + writtenSoFar, dataSize - writtenSoFar);
+                    if (writtenBytes <= 0)
+                    {
+                        perror("[SyncDir] Warning: RecvDeltaFromClient(): Error at writing the rebuilt file.\n");
+                        isRebuildFailed = TRUE;
+                        break;
+                    }
+                }
+            }
+        } //--> while (1)
+
+
+        // Check the rebuilt file, then replace the server copy.
+
+        HashFinal(hashContext, newHashCode);
+
+        if (FALSE == isRebuildFailed && 0 != strcmp(newHashCode, HashCode))
+        {
+            printf("[SyncDir] Warning: RecvDeltaFromClient(): The rebuilt file does not have the expected hash code.\n");
+            isRebuildFailed = TRUE;
+        }
+        if (FALSE == isRebuildFailed && ftruncate(tempFileDescriptor, (off_t) newFileSize) < 0)       // The last blocks may be holes.
+        {
+            perror("[SyncDir] Warning: RecvDeltaFromClient(): Error at setting the size of the rebuilt file.\n");
+            isRebuildFailed = TRUE;
+        }
+        if (FALSE == isRebuildFailed)
+        {
+            if (!(SUCCESS(PublishTempFile(tempFileDescriptor, tempFullPath, FileFullPath, newFileSize))))
+            {
+                printf("[SyncDir] Warning: RecvDeltaFromClient(): PublishTempFile() failed.\n");
+                isRebuildFailed = TRUE;
+            }
+            close(tempFileDescriptor);
+            tempFileDescriptor = -1;
+        }
+
+        if (FALSE == isRebuildFailed)
+        {
+            snprintf(bufferOut, SD_SHORT_MSG_SIZE, "Delta OK");
+            (*FileSize) = newFileSize;
+        }
+        else
+        {
+            if (0 != tempFullPath[0])
+            {
+                unlink(tempFullPath);
+            }
+            snprintf(bufferOut, SD_SHORT_MSG_SIZE, "Delta Failed");
+        }
+
+        status = SendBufferToClient(bufferOut, SD_SHORT_MSG_SIZE, SockConnID);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: RecvDeltaFromClient(): SendBufferToClient() failed (delta result).\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // Fall back to the whole file, if the rebuild failed.
+
+        if (TRUE == isRebuildFailed)
+        {
+            status = RecvFileFromClient(FileFullPath, FileSize, SockConnID);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: RecvDeltaFromClient(): RecvFileFromClient() failed.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+        else
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: File rebuilt from delta: [%llu/%llu B] copied from the server copy. \n", 
+                (unsigned long long) copiedBytes, (unsigned long long) newFileSize);
+        }
+
+
+        // If here, everything is ok (the warning of the whole file fallback, if any, is kept).
+        status = SUCCESS_KEEP_WARNING(status);
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: RecvDeltaFromClient(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: RecvDeltaFromClient(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        free(blocks);
+        blocks = NULL;
+        free(hashContext);
+        hashContext = NULL;
+        free(buffer);
+        buffer = NULL;
+        if (tempFileDescriptor >= 0)
+        {
+            close(tempFileDescriptor);
+            tempFileDescriptor = -1;
+        }
+    }
+    else
+    {
+        free(blocks);
+        blocks = NULL;
+        free(hashContext);
+        hashContext = NULL;
+        free(buffer);
+        buffer = NULL;
+        if (tempFileDescriptor >= 0)
+        {
+            close(tempFileDescriptor);
+            tempFileDescriptor = -1;
+            if (0 != tempFullPath[0])
+            {
+                unlink(tempFullPath);
+            }
+        }
+    }
+
+    return status;
+} // RecvDeltaFromClient()
+
+
+
+
+
+//
+// RecvChunksFromClient
+//
+SDSTATUS
+RecvChunksFromClient(
+    __in char                                           *MainDirFullPath,
+    __in char                                           *FileFullPath,
+    __in const char                                     *FileRelativePath,
+    __in const char                                     *HashCode,
+    __inout std::unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap,
+    __inout STRIPE_RECEIVER                             & StripeReceiver,
+    __in DWORD                                          RequestId,
+    __out QWORD                                         *FileSize,
+    __in DWORD                                          SockConnID
+    )
+/*++
+Description: The routine receives a file as a list of content-defined chunks (see PACKET_CHUNK). Each chunk found in the chunk index
+ChunkInfoHMap (in any file of the server) is read from its location and its hash code is checked: if it matches, the chunk is copied
+into the file, otherwise the location is stale and it is dropped from the index. A chunk repeated in the file is asked for once, and
+copied from its first occurrence. The client is told which chunks the server has, and sends only the other ones: each run of
+consecutive missing chunks as a range of the file, in data frames (compressed, sparse, as for a whole file). The file is assembled
+into its partial file (see CreatePartialFile()), in order: every SD_SRV_PARTIAL_CHECKPOINT_SIZE bytes, and if the connection is lost,
+the assembled start of the file is checkpointed, so that a later transfer of the same content resumes from there ("File Resume", see
+STRIPE_TRANSFER). The file replaces the server file only if its hash code is the expected one. Otherwise (e.g. the client file
+changed meanwhile), the partial file is removed, the client is told so, and sends the whole file. If less than
+SD_SRV_CHUNKS_MIN_SAVING percent of the file is found on the server (copied, repeated or holes) and the session has data connections,
+the chunks are not worth their round trip: the whole file is asked for in ranges ("File Stripes", see WaitStripeTransferFromClient()).
+The chunks of the received file are then indexed.
+
+- MainDirFullPath: Pointer to the full path of the server main directory (the chunk locations are relative to it).
+- FileFullPath: Pointer to the full path of the file (replaced by the received file).
+- FileRelativePath: Pointer to the relative path of the file (relative to the main directory).
+- HashCode: Pointer to the hash code of the new content, as sent by the client (negotiated algorithm).
+- ChunkInfoHMap: Reference to the chunk index (key: hash code of the chunk).
+- StripeReceiver: Reference to the state of the data connections of the session (see STRIPE_RECEIVER).
+- RequestId: Request ID of the MODIFY answered (the ranges are sent for it).
+- FileSize: Pointer to where the routine outputs the size of the received file. The caller must provide the storage space. 
+- SockConnID: Descriptor representing the socket connection with the SyncDir client application.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+{
+    SDSTATUS                    status;
+    DWORD                       numberOfChunks;
+    std::vector<PACKET_CHUNK>   packetChunks;
+    std::vector<CDC_CHUNK>      chunks;
+    std::vector<BYTE>           isChunkOnServer;
+    std::vector<DWORD>          firstChunkIndexes;              // Earlier chunk of the same content, numberOfChunks if none.
+    std::unordered_map<std::string, DWORD>  firstChunkOfHash;
+    std::string                 sourceRelativePath;
+    STRIPE_TRANSFER             stripeTransfer;
+    BYTE                        *buffer;
+    const BYTE                  *inputs[1];
+    size_t                      inputLengths[1];
+    char                        chunkHashCode[1][SD_MAX_HASH_CODE_LENGTH + 1];
+    char                        sourceFullPath[SD_MAX_PATH_LENGTH];
+    char                        tempFullPath[SD_MAX_PATH_LENGTH];
+    char                        newHashCode[SD_MAX_HASH_CODE_LENGTH + 1];
+    char                        bufferOut[SD_SHORT_MSG_SIZE];
+    struct stat                 oldFileStat;
+    __int32                     sourceFileDescriptor;
+    __int32                     tempFileDescriptor;
+    QWORD                       newFileSize;
+    QWORD                       copiedBytes;
+    QWORD                       repeatedBytes;
+    QWORD                       holeBytes;
+    QWORD                       runLength;
+    QWORD                       receivedSize;
+    QWORD                       checkpointedOffset;
+    BOOL                        isResumable;
+    BOOL                        isAssemblyFailed;
+    BOOL                        isWholeFileAsked;
+    BOOL                        isStripeAsked;
+    ssize_t                     recvBytes;
+    ssize_t                     readBytes;
+    DWORD                       i;
+    DWORD                       j;
+    std::unordered_map<std::string, CHUNK_INFO>::iterator iteratorCI;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    numberOfChunks = 0;
+    buffer = NULL;
+    sourceFullPath[0] = 0;
+    tempFullPath[0] = 0;
+    newHashCode[0] = 0;
+    memset(bufferOut, 0, sizeof(bufferOut));
+    sourceFileDescriptor = -1;
+    tempFileDescriptor = -1;
+    newFileSize = 0;
+    copiedBytes = 0;
+    repeatedBytes = 0;
+    holeBytes = 0;
+    runLength = 0;
+    receivedSize = 0;
+    checkpointedOffset = 0;
+    isResumable = FALSE;
+    isAssemblyFailed = FALSE;
+    isWholeFileAsked = FALSE;
+    isStripeAsked = FALSE;
+    recvBytes = -1;
+    j = 0;
+
+    // Parameter validation.
+
+    if (NULL == MainDirFullPath || 0 == MainDirFullPath[0])
+    {
+        printf("[SyncDir] Error: RecvChunksFromClient(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileFullPath || 0 == FileFullPath[0])
+    {
+        printf("[SyncDir] Error: RecvChunksFromClient(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == FileRelativePath || 0 == FileRelativePath[0])
+    {
+        printf("[SyncDir] Error: RecvChunksFromClient(): Invalid parameter 3.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == HashCode)
+    {
+        printf("[SyncDir] Error: RecvChunksFromClient(): Invalid parameter 4.\n");
+        return STATUS_FAIL;
     }
     if (NULL == FileSize)
     {
-        printf("[SyncDir] Error: RecvFileFromClient(): Invalid parameter 2.\n");
+        printf("[SyncDir] Error: RecvChunksFromClient(): Invalid parameter 8.\n");
         return STATUS_FAIL;
-    }    
+    }
+
+
+    __try
+    {
+        // INIT.
+
+        // Receive the chunk list.
+
+        recvBytes = recv(SockConnID, &numberOfChunks, sizeof(DWORD), MSG_WAITALL);
+        if (sizeof(DWORD) != recvBytes)
+        {
+            perror("[SyncDir] Error: RecvChunksFromClient(): Error at receiving the number of chunks.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+        numberOfChunks = ntohl(numberOfChunks);
+        if (numberOfChunks > SD_CDC_MAX_CHUNKS)
+        {
+            printf("[SyncDir] Error: RecvChunksFromClient(): Invalid number of chunks [%u].\n", numberOfChunks);
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        packetChunks.resize(numberOfChunks);
+        if (0 != numberOfChunks)
+        {
+            recvBytes = recv(SockConnID, packetChunks.data(), packetChunks.size() * sizeof(PACKET_CHUNK), MSG_WAITALL);
+            if ((ssize_t) (packetChunks.size() * sizeof(PACKET_CHUNK)) != recvBytes)
+            {
+                perror("[SyncDir] Error: RecvChunksFromClient(): Error at receiving the chunk list.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+        }
+
+        chunks.resize(numberOfChunks);
+        for (i = 0; i < numberOfChunks; i++)
+        {
+            chunks[i].Offset = newFileSize;
+            chunks[i].Size = ntohl(packetChunks[i].ChunkSize);
+            memcpy(chunks[i].HashCode, packetChunks[i].HashCode, SD_MAX_HASH_CODE_LENGTH);
+            chunks[i].HashCode[SD_MAX_HASH_CODE_LENGTH] = 0;                // Never trust the peer's terminator.
+
+            if (0 == chunks[i].Size || chunks[i].Size > ((0 == chunks[i].HashCode[0]) ? SD_CDC_MAX_HOLE_SIZE : SD_CDC_MAX_CHUNK_SIZE))
+            {
+                printf("[SyncDir] Error: RecvChunksFromClient(): Invalid chunk size [%u].\n", chunks[i].Size);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            newFileSize = newFileSize + chunks[i].Size;
+        }
+        if (newFileSize > SD_CDC_MAX_FILE_SIZE)
+        {
+            printf("[SyncDir] Error: RecvChunksFromClient(): File too large for a chunk transfer.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        buffer = (BYTE*) malloc(SD_CDC_MAX_CHUNK_SIZE);
+        if (NULL == buffer)
+        {
+            printf("[SyncDir] Error: RecvChunksFromClient(): Error at malloc().\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // The file is assembled into its partial file (same mode as the server file, if any).
+
+        snprintf(tempFullPath, SD_MAX_PATH_LENGTH, "%s%s", FileFullPath, SD_SRV_PARTIAL_SUFFIX);
+
+        if (SUCCESS(CreatePartialFile(tempFullPath, HashCode, newFileSize, &isResumable)))
+        {
+            tempFileDescriptor = open(tempFullPath, O_RDWR | O_CLOEXEC);
+        }
+        if (tempFileDescriptor < 0 || (0 == lstat(FileFullPath, &oldFileStat) && S_ISREG(oldFileStat.st_mode) && 
+            fchmod(tempFileDescriptor, oldFileStat.st_mode & 07777) < 0))
+        {
+            perror("[SyncDir] Warning: RecvChunksFromClient(): Error at creating the assembled file.\n");
+            isAssemblyFailed = TRUE;
+            // Ask for the whole file instead of the chunks.
+        }
+
+
+
+        //
+        // Main processing:
+        //
+
+        // Copy the chunks the server has (checked), and drop the stale locations. A chunk repeated in the file is received (or 
+        // copied) once: the later ones are copied from the first one, once it is in the file. The holes (empty hash code) are left 
+        // as holes of the assembled file.
+
+        isChunkOnServer.assign(numberOfChunks, 0);
+        firstChunkIndexes.assign(numberOfChunks, numberOfChunks);
+
+        for (i = 0; FALSE == isAssemblyFailed && i < numberOfChunks; i++)
+        {
+            if (0 == chunks[i].HashCode[0])
+            {
+                if (TRUE == SD_SRV_PREALLOCATE)                             // Space reserved for the hole (see PreallocateFile()).
+                {
+                    fallocate(tempFileDescriptor, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) chunks[i].Offset, 
+                        (off_t) chunks[i].Size);
+                }
+                isChunkOnServer[i] = 1;
+                holeBytes = holeBytes + chunks[i].Size;
+                continue;
+            }
+
+            auto iteratorFC = firstChunkOfHash.insert({chunks[i].HashCode, i});
+            if (FALSE == iteratorFC.second)
+            {
+                firstChunkIndexes[i] = iteratorFC.first->second;
+                isChunkOnServer[i] = 1;
+                repeatedBytes = repeatedBytes + chunks[i].Size;
+                continue;
+            }
+
+            iteratorCI = ChunkInfoHMap.find(chunks[i].HashCode);
+            if (ChunkInfoHMap.end() == iteratorCI)
+            {
+                continue;
+            }
+
+            if (iteratorCI->second.FileRelativePath != sourceRelativePath)
+            {
+                if (sourceFileDescriptor >= 0)
+                {
+                    close(sourceFileDescriptor);
+                }
+                sourceRelativePath = iteratorCI->second.FileRelativePath;
+                snprintf(sourceFullPath, SD_MAX_PATH_LENGTH, "%s/%s", MainDirFullPath, sourceRelativePath.c_str() + 2);
+                sourceFileDescriptor = open(sourceFullPath, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+            }
+
+            readBytes = -1;
+            if (sourceFileDescriptor >= 0 && iteratorCI->second.Size == chunks[i].Size)
+            {
+                readBytes = pread(sourceFileDescriptor, buffer, chunks[i].Size, iteratorCI->second.Offset);
+            }
+
+            inputs[0] = buffer;
+            inputLengths[0] = chunks[i].Size;
+            if ((ssize_t) chunks[i].Size != readBytes || !(SUCCESS(HashMany(gHashAlgorithm, 1, inputs, inputLengths, chunkHashCode))) || 
+                0 != strcmp(chunkHashCode[0], chunks[i].HashCode))
+            {
+                ChunkInfoHMap.erase(iteratorCI);                            // Stale: the file was moved, deleted or changed.
+                continue;
+            }
+
+            if (FALSE == IsZeroBuffer(buffer, chunks[i].Size) &&                   // Zeros: left as a hole (sparse file).
+                (ssize_t) chunks[i].Size != pwrite(tempFileDescriptor, buffer, chunks[i].Size, chunks[i].Offset))
+            {
+                perror("[SyncDir] Warning: RecvChunksFromClient(): Error at writing the assembled file.\n");
+                isAssemblyFailed = TRUE;
+                break;
+            }
+            isChunkOnServer[i] = 1;
+            copiedBytes = copiedBytes + chunks[i].Size;
+        }
+
+        // Few chunks found, with data connections open: the whole file is asked for in ranges instead, into a new partial file. The
+        // transfer is registered before the answer: the ranges may come on the data connections before it is awaited.
+
+        if (FALSE == isAssemblyFailed && FALSE == StripeReceiver.Socks.empty() && 
+            (copiedBytes + repeatedBytes + holeBytes) * 100 < newFileSize * SD_SRV_CHUNKS_MIN_SAVING)
+        {
+            close(tempFileDescriptor);
+            tempFileDescriptor = -1;
+
+            if (SUCCESS(CreatePartialFile(tempFullPath, HashCode, newFileSize, &stripeTransfer.IsResumable)))
+            {
+                stripeTransfer.TempFullPath.assign(tempFullPath);
+                stripeTransfer.FileSize = newFileSize;
+                stripeTransfer.StartOffset = 0;
+                stripeTransfer.ReceivedRanges = 0;
+                stripeTransfer.ReceivedBytes = 0;
+                stripeTransfer.ContiguousEnd = 0;
+                stripeTransfer.DurableOffset = 0;
+                stripeTransfer.RangeEnds.clear();
+
+                std::lock_guard<std::mutex> lock(StripeReceiver.Lock);
+
+                StripeReceiver.Transfers.erase(RequestId);
+                StripeReceiver.Transfers.insert({RequestId, stripeTransfer});
+                isStripeAsked = TRUE;
+            }
+            else
+            {
+                perror("[SyncDir] Warning: RecvChunksFromClient(): Error at creating the partial file. Asking for the whole file ...\n");
+                isAssemblyFailed = TRUE;
+            }
+        }
+
+        // Tell the client which chunks to send. If the file cannot be assembled, the whole file is asked for at once.
+
+        snprintf(bufferOut, SD_SHORT_MSG_SIZE, (TRUE == isStripeAsked) ? "File Stripes" : ((FALSE == isAssemblyFailed) ? 
+            "Chunks Missing" : "Chunks Failed"));
+        isWholeFileAsked = (TRUE == isAssemblyFailed || TRUE == isStripeAsked) ? TRUE : FALSE;
+
+        status = SendBufferToClient(bufferOut, SD_SHORT_MSG_SIZE, SockConnID);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: RecvChunksFromClient(): SendBufferToClient() failed (chunks answer).\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+        if (FALSE == isWholeFileAsked)
+        {
+            status = SendBufferToClient(isChunkOnServer.data(), numberOfChunks, SockConnID);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: RecvChunksFromClient(): SendBufferToClient() failed (chunks on server).\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Receiving [%llu/%llu B] of [%u] chunks ([%llu B] found on the server, [%llu B] "
+                "repeated in the file, [%llu B] of holes). \n", (unsigned long long) (newFileSize - copiedBytes - repeatedBytes - holeBytes),
+                (unsigned long long) newFileSize, numberOfChunks, (unsigned long long) copiedBytes, (unsigned long long) repeatedBytes, 
+                (unsigned long long) holeBytes);
+        }
+
+
+        // Receive the other chunks: each run of consecutive missing chunks comes as one range of the file, in data frames (see
+        // RecvDataFramesToFile()), written at its offset. The repeated chunks are copied on the way: their first occurrence, before
+        // them, is in the file by then. So the file is complete up to the current chunk: it is checkpointed there (if resumable).
+
+        for (i = 0; FALSE == isWholeFileAsked && i < numberOfChunks; i = j)
+        {
+            j = i + 1;
+            if (TRUE == isResumable && FALSE == isAssemblyFailed && chunks[i].Offset - checkpointedOffset >= SD_SRV_PARTIAL_CHECKPOINT_SIZE)
+            {
+                CheckpointPartialFile(tempFileDescriptor, chunks[i].Offset);
+                checkpointedOffset = chunks[i].Offset;
+            }
+            if (numberOfChunks != firstChunkIndexes[i])
+            {
+                readBytes = (FALSE == isAssemblyFailed) ? pread(tempFileDescriptor, buffer, chunks[i].Size, 
+                                                                 chunks[firstChunkIndexes[i]].Offset) : -1;
+                if (FALSE == isAssemblyFailed && ((ssize_t) chunks[i].Size != readBytes || (FALSE == IsZeroBuffer(buffer, chunks[i].Size) &&
+                    (ssize_t) chunks[i].Size != pwrite(tempFileDescriptor, buffer, chunks[i].Size, chunks[i].Offset))))
+                {
+                    perror("[SyncDir] Warning: RecvChunksFromClient(): Error at copying a repeated chunk.\n");
+                    isAssemblyFailed = TRUE;
+                    // Keep receiving the chunks (the connection stays in sync), then ask for the whole file.
+                }
+                continue;
+            }
+            if (1 == isChunkOnServer[i])
+            {
+                continue;
+            }
+            for (; j < numberOfChunks && 0 == isChunkOnServer[j]; j++)
+            {
+                // Up to the next chunk on the server.
+            }
+            runLength = chunks[j - 1].Offset + chunks[j - 1].Size - chunks[i].Offset;
+
+            if ((off_t) chunks[i].Offset != lseek(tempFileDescriptor, (off_t) chunks[i].Offset, SEEK_SET))
+            {
+                perror("[SyncDir] Error: RecvChunksFromClient(): Error at seeking in the assembled file.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+                // The frames of the run cannot be received: the connection is out of sync.
+            }
+
+            status = RecvDataFramesToFile(SockConnID, tempFileDescriptor, runLength, (TRUE == isResumable && FALSE == isAssemblyFailed) ? 
+                                          TRUE : FALSE, &receivedSize);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: RecvChunksFromClient(): RecvDataFramesToFile() failed (chunks).\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            if (receivedSize < runLength)                                   // Truncated on the client meanwhile.
+            {
+                isAssemblyFailed = TRUE;
+            }
+        }
+
+
+        // Unless asked for in ranges: check the assembled file (from its start), then replace the server file.
+
+        if (FALSE == isStripeAsked)
+        {
+            // Its size first: the last chunks may be holes.
 
-    __try
-    {
-        // INIT (start).
+            if (FALSE == isAssemblyFailed && ((off_t) -1 == lseek(tempFileDescriptor, 0, SEEK_SET) || 
+                ftruncate(tempFileDescriptor, (off_t) newFileSize) < 0))
+            {
+                perror("[SyncDir] Warning: RecvChunksFromClient(): Error at setting the size of the assembled file.\n");
+                isAssemblyFailed = TRUE;
+            }
+            if (FALSE == isAssemblyFailed && (!(SUCCESS(HashOfFileDescriptor(gHashAlgorithm, tempFileDescriptor, newHashCode))) || 
+                0 != strcmp(newHashCode, HashCode)))
+            {
+                printf("[SyncDir] Warning: RecvChunksFromClient(): The assembled file does not have the expected hash code.\n");
+                isAssemblyFailed = TRUE;
+            }
+            if (FALSE == isAssemblyFailed)
+            {
+                if (TRUE == isResumable)
+                {
+                    fremovexattr(tempFileDescriptor, SD_SRV_PARTIAL_XATTR_CONTENT);
+                    fremovexattr(tempFileDescriptor, SD_SRV_PARTIAL_XATTR_OFFSET);
+                }
+                if (!(SUCCESS(PublishTempFile(tempFileDescriptor, tempFullPath, FileFullPath, newFileSize))))
+                {
+                    printf("[SyncDir] Warning: RecvChunksFromClient(): PublishTempFile() failed.\n");
+                    isAssemblyFailed = TRUE;
+                }
+                close(tempFileDescriptor);
+                tempFileDescriptor = -1;
+            }
 
-        // Log.
+            if (FALSE == isAssemblyFailed)
+            {
+                snprintf(bufferOut, SD_SHORT_MSG_SIZE, "Chunks OK");
+                (*FileSize) = newFileSize;
+            }
+            else
+            {
+                unlink(tempFullPath);
+                snprintf(bufferOut, SD_SHORT_MSG_SIZE, "Chunks Failed");
+            }
 
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: Receiving file from client. Writing at full path [%s]. \n", FileFullPath);
+            if (FALSE == isWholeFileAsked)
+            {
+                status = SendBufferToClient(bufferOut, SD_SHORT_MSG_SIZE, SockConnID);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: RecvChunksFromClient(): SendBufferToClient() failed (chunks result).\n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+            }
+        }
 
-        // Initialize file stream.
-        // Open file / create.
 
-        fileStream = fopen(FileFullPath, "w+b");
-        if (NULL == fileStream)
+        // Receive the file in ranges, if asked for. Or fall back to the whole file, if the assembly failed. Then index the chunks of
+        // the new file.
+
+        if (TRUE == isStripeAsked)
         {
-            perror("[SyncDir] Error: RecvFileFromClient(): Error at file opening / creation. \n");
-            status = STATUS_FAIL;
-            throw SyncDirException();              
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Few chunks on the server ([%llu/%llu B] found). Receiving the file in ranges ... \n", 
+                (unsigned long long) (copiedBytes + repeatedBytes + holeBytes), (unsigned long long) newFileSize);
+
+            status = WaitStripeTransferFromClient(FileFullPath, RequestId, StripeReceiver, FileSize, SockConnID);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: RecvChunksFromClient(): WaitStripeTransferFromClient() failed.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            if (!(SUCCESS(ChunksOfServerFile(FileFullPath, chunks))))
+            {
+                chunks.clear();
+            }
         }
-        
-        // Init total bytes.
-        
-        totalRecvBytes = 0;
+        else if (TRUE == isAssemblyFailed)
+        {
+            status = RecvFileFromClient(FileFullPath, FileSize, SockConnID);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: RecvChunksFromClient(): RecvFileFromClient() failed.\n");
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
 
-        // --> INIT (end)
+            if (!(SUCCESS(ChunksOfServerFile(FileFullPath, chunks))))
+            {
+                chunks.clear();
+            }
+        }
+        else
+        {
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: File assembled from chunks: [%llu/%llu B] copied from the server, [%llu B] "
+                "repeated, [%llu B] of holes. \n", (unsigned long long) copiedBytes, (unsigned long long) newFileSize, 
+                (unsigned long long) repeatedBytes, (unsigned long long) holeBytes);
+        }
 
+        InsertChunkInfosOfFile(FileRelativePath, chunks, ChunkInfoHMap);
 
 
-        //
-        // Main procecssing:
-        //
+        // If here, everything is ok (the warning of the whole file fallback, if any, is kept).
+        status = SUCCESS_KEEP_WARNING(status);
 
-        // Receive file size.
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: RecvChunksFromClient(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: RecvChunksFromClient(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
 
-        recvBytes = recv(SockConnID, FileSize, sizeof(DWORD), 0);
-        if (sizeof(DWORD) != recvBytes)
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        free(buffer);
+        buffer = NULL;
+        if (sourceFileDescriptor >= 0)
         {
-            if (recvBytes < 0)
+            close(sourceFileDescriptor);
+            sourceFileDescriptor = -1;
+        }
+        if (tempFileDescriptor >= 0)
+        {
+            close(tempFileDescriptor);
+            tempFileDescriptor = -1;
+        }
+    }
+    else
+    {
+        free(buffer);
+        buffer = NULL;
+        if (sourceFileDescriptor >= 0)
+        {
+            close(sourceFileDescriptor);
+            sourceFileDescriptor = -1;
+        }
+        if (tempFileDescriptor >= 0)
+        {
+            close(tempFileDescriptor);
+            tempFileDescriptor = -1;
+            if (TRUE == isResumable && FALSE == isAssemblyFailed)     // Connection lost: checkpointed (see RecvDataFramesToFile()).
             {
-                perror("[SyncDir] Error: RecvFileFromClient(): Error at receiving from client (file size). Abandoning file reception.\n");
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Partial file [%s] kept for resuming. \n", tempFullPath);
             }
             else
             {
-                printf("[SyncDir] Error: RecvFileFromClient(): Numbers of received/to-receive bytes do not match.\n");
+                unlink(tempFullPath);
             }
-            status = STATUS_FAIL;
-            throw SyncDirException();                  
         }
+    }
 
-        // Network to host. Byte order.
+    return status;
+} // RecvChunksFromClient()
 
-        (*FileSize) = ntohl((*FileSize));
 
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: Receiving file of size [%u]. \n", (*FileSize));
 
 
-        // Receive whole file content.
-        // Write to the open file stream.
-        // Note: in case of error recv() returns -1, so if number of bytes received > 0, then the loop continues to receive.
-        //      In case of zero bytes received, maybe EOF was met or the socket was shutdown. Hence, loop finishes.
+//
+// SendBufferToClient
+//
+SDSTATUS
+SendBufferToClient(
+    __in const void     *Buffer,
+    __in size_t         BufferSize,
+    __in DWORD          SockConnID
+    )
+/*++
+Description: The routine sends BufferSize bytes to the client. A send() may transfer fewer bytes than requested (e.g. full socket
+buffer): the routine resumes until all the bytes are sent.
 
-        while (1)
-        {
+- Buffer: Pointer to the data.
+- BufferSize: Number of bytes to send.
+- SockConnID: Descriptor representing the socket connection with the SyncDir client application.
 
-            recvBytes = recv(SockConnID, &packet, sizeof(packet), 0);
-            if (sizeof(packet) != (DWORD) recvBytes)
-            { 
-                if (recvBytes < 0)
-                {
-                    perror("[SyncDir] Error: RecvFileFromClient(): Error at receiving from client (file chunk). Abandoning file receiving.\n");
-                }
-                else
-                {
-                    printf("[SyncDir] Error: RecvFileFromClient(): %d/%lu(MAX) bytes received.\n", recvBytes, sizeof(packet));
-                }      
-                status = STATUS_FAIL;
-                throw SyncDirException();  
-            }
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    size_t      offset;
+    ssize_t     sentBytes;
 
+    // Parameter validation.
 
-            // In case #bytes do not match, fwrite returned error or EOF was met ==> print with perror() in this case.
-            // (error can be detected also with "if 0 != ferror(fileStream), then print(error)")
+    if (NULL == Buffer && 0 != BufferSize)
+    {
+        printf("[SyncDir] Error: SendBufferToClient(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
 
-            writtenBytes = fwrite(packet.FileChunk, 1, packet.ChunkSize, fileStream);
-            if (packet.ChunkSize != writtenBytes)
-            {
-                perror("[SyncDir] Error: RecvFileFromClient(): Possible error at fwrite(). \n");
-                printf("[SyncDir] Error: RecvFileFromClient(): Only %d/%d bytes written to file.\n", writtenBytes, packet.ChunkSize);
-                status = STATUS_FAIL;
-                throw SyncDirException();
-            }
+    for (offset = 0; offset < BufferSize; offset += sentBytes)
+    {
+        sentBytes = send(SockConnID, (const BYTE*) Buffer + offset, BufferSize - offset, 0);
+        if (sentBytes <= 0)
+        {
+            perror("[SyncDir] Error: SendBufferToClient(): Error at sending to client.\n");
+            return STATUS_FAIL;
+        }
+    }
 
+    return STATUS_SUCCESS;
+} // SendBufferToClient()
 
-            // Exit condition. If file completely received (EOF was met).
 
-            if (TRUE == packet.IsEOF)
-            {
-                fprintf(g_SD_STDLOG, "[SyncDir] Info: RecvFileFromClient(): EOF was met. End transfer. \n");
 
-                (*FileSize) = totalRecvBytes + packet.ChunkSize;                            // Save new file size, before exit.
-                break;                
-            }
 
+//
+// AnswerHashQueryOfClient
+//
+static SDSTATUS
+AnswerHashQueryOfClient(
+    __in const std::unordered_map<std::string, HASH_INFO>   & HashInfoHMap,
+    __in DWORD                                              SockConnID
+    )
+/*++
+Description: The routine receives a batched hash query (see PACKET_HASH_QUERY_HEADER) and replies with the bitmap of the contents 
+held by the server: same hash code and same size in HashInfoHMap.
 
-            totalRecvBytes = totalRecvBytes + packet.ChunkSize;
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS                    status;
+    PACKET_HASH_QUERY_HEADER    queryHeader;
+    DWORD                       numberOfHashes;
+    DWORD                       hashCodeLength;
+    DWORD                       itemSize;
+    QWORD                       fileSize;
+    DWORD                       numberOfHits;
+    BYTE                        *items;
+    BYTE                        *bitmap;
+    char                        *hashCode;
+    ssize_t                     recvBytes;
+    DWORD                       i;
+    std::string                 auxString;
+    std::unordered_map<std::string, HASH_INFO>::const_iterator iteratorHI;
 
-        }//--> while (1)
+    status = STATUS_FAIL;
+    numberOfHashes = 0;
+    hashCodeLength = HashCodeLength(gHashAlgorithm);
+    itemSize = hashCodeLength + 1 + sizeof(QWORD);
+    numberOfHits = 0;
+    items = NULL;
+    bitmap = NULL;
 
+    __try
+    {
+        recvBytes = recv(SockConnID, &queryHeader, sizeof(queryHeader), MSG_WAITALL);
+        if (sizeof(queryHeader) != recvBytes)
+        {
+            perror("[SyncDir] Error: AnswerHashQueryOfClient(): Error at receiving the query header. \n");
+            throw SyncDirException();
+        }
+        numberOfHashes = ntohl(queryHeader.NumberOfHashes);
+        if (numberOfHashes > SD_HASH_QUERY_MAX_HASHES)
+        {
+            printf("[SyncDir] Error: AnswerHashQueryOfClient(): Too many hash codes [%u]. \n", numberOfHashes);
+            throw SyncDirException();
+        }
 
+        items = (BYTE*) malloc((size_t) numberOfHashes * itemSize + 1);
+        bitmap = (BYTE*) calloc((numberOfHashes + 7) / 8 + 1, 1);
+        if (NULL == items || NULL == bitmap)
+        {
+            printf("[SyncDir] Error: AnswerHashQueryOfClient(): Memory allocation failed. \n");
+            throw SyncDirException();
+        }
 
-        // Log.
+        recvBytes = recv(SockConnID, items, (size_t) numberOfHashes * itemSize, MSG_WAITALL);
+        if ((ssize_t) numberOfHashes * itemSize != recvBytes)
+        {
+            perror("[SyncDir] Error: AnswerHashQueryOfClient(): Error at receiving the hash codes. \n");
+            throw SyncDirException();
+        }
 
-        fprintf(g_SD_STDLOG, "[SyncDir] Info: File received. \n");
 
+        // One bit per item: same hash code and same size in the hash index.
 
-        // If here, everything is ok.
-        status = SUCCESS_KEEP_WARNING(status);
+        for (i = 0; i < numberOfHashes; i ++)
+        {
+            hashCode = (char*) items + (size_t) i * itemSize;
+            memcpy(&fileSize, hashCode + hashCodeLength + 1, sizeof(QWORD));
+            hashCode[hashCodeLength] = 0;                               // Never trust the peer's terminator.
+            auxString.assign(hashCode);
 
-    } // --> __try
+            iteratorHI = HashInfoHMap.find(auxString);
+            if (HashInfoHMap.end() != iteratorHI && iteratorHI->second.FileSize == be64toh(fileSize))
+            {
+                bitmap[i / 8] = bitmap[i / 8] | (BYTE) (1 << (i % 8));
+                numberOfHits ++;
+            }
+        }
+
+        if (!(SUCCESS(SendBufferToClient(bitmap, (numberOfHashes + 7) / 8, SockConnID))))
+        {
+            printf("[SyncDir] Error: AnswerHashQueryOfClient(): Error at sending the bitmap. \n");
+            throw SyncDirException();
+        }
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Hash query: [%u/%u] contents held by the server. \n", numberOfHits, numberOfHashes);
+        status = STATUS_SUCCESS;
+    }
     __catch (const SyncDirException &e)
     {
-        cout << e.what() << "\n";        
-        //status = STATUS_FAIL;
+        cout << e.what() << "\n";
+        status = STATUS_FAIL;
     }
     __catch (const std::exception &e)
     {
-        cout << "[SyncDir] Error: RecvFileFromClient(): Standard Exception caught: " << e.what() << "\n";        
+        cout << "[SyncDir] Error: AnswerHashQueryOfClient(): Standard Exception caught: " << e.what() << "\n";
+        status = STATUS_FAIL;
+    }
+
+    free(items);
+    free(bitmap);
+
+    return status;
+} // AnswerHashQueryOfClient()
+
+
+
+
+//
+// RecvModifyBatchFromClient
+//
+static SDSTATUS
+RecvModifyBatchFromClient(
+    __in char                                               *MainDirFullPath,
+    __inout std::unordered_map<std::string, HASH_INFO>      & HashInfoHMap,
+    __in DWORD                                              SockConnID
+    )
+/*++
+Description: The routine receives a batch of small files (see PACKET_BATCH_HEADER) and writes them in order, in one pass: each 
+file is written at once into a temporary file, which takes its place (see PublishTempFile()), and its hash code is inserted in 
+HashInfoHMap. Nothing is answered.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (corrupt batch, the connection is out of sync). STATUS_WARNING if
+some files could not be written (e.g. directory removed meanwhile).
+--*/
+{
+    SDSTATUS            status;
+    PACKET_BATCH_HEADER batchHeader;
+    PACKET_BATCH_ENTRY  batchEntry;
+    DWORD               numberOfEntries;
+    DWORD               batchSize;
+    DWORD               hashCodeLength;
+    DWORD               pathLength;
+    DWORD               fileSize;
+    DWORD               numberOfWritten;
+    QWORD               writtenBytes;
+    size_t              offset;
+    BYTE                *batch;
+    ssize_t             recvBytes;
+    __int32             fileDescriptor;
+    DWORD               i;
+    char                fileRelativePath[SD_MAX_PATH_LENGTH];
+    char                fileFullPath[SD_MAX_PATH_LENGTH];
+    char                fileHashCode[SD_MAX_HASH_CODE_LENGTH + 1];
+    char                tempFullPath[SD_MAX_PATH_LENGTH];
+
+    status = STATUS_FAIL;
+    numberOfEntries = 0;
+    hashCodeLength = HashCodeLength(gHashAlgorithm);
+    numberOfWritten = 0;
+    writtenBytes = 0;
+    offset = 0;
+    batch = NULL;
+    fileDescriptor = -1;
+    tempFullPath[0] = 0;
+
+    __try
+    {
+        recvBytes = recv(SockConnID, &batchHeader, sizeof(batchHeader), MSG_WAITALL);
+        if (sizeof(batchHeader) != recvBytes)
+        {
+            perror("[SyncDir] Error: RecvModifyBatchFromClient(): Error at receiving the batch header. \n");
+            throw SyncDirException();
+        }
+        numberOfEntries = ntohl(batchHeader.NumberOfEntries);
+        batchSize = ntohl(batchHeader.BatchSize);
+        if (batchSize > SD_BATCH_MAX_SIZE)
+        {
+            printf("[SyncDir] Error: RecvModifyBatchFromClient(): Batch too large [%u B]. \n", batchSize);
+            throw SyncDirException();
+        }
+
+        batch = (BYTE*) malloc((size_t) batchSize + 1);
+        if (NULL == batch)
+        {
+            printf("[SyncDir] Error: RecvModifyBatchFromClient(): Memory allocation failed. \n");
+            throw SyncDirException();
+        }
+
+        recvBytes = recv(SockConnID, batch, batchSize, MSG_WAITALL);
+        if ((ssize_t) batchSize != recvBytes)
+        {
+            perror("[SyncDir] Error: RecvModifyBatchFromClient(): Error at receiving the batch. \n");
+            throw SyncDirException();
+        }
+
+
+        // Write the files, in order. Every length is checked against the batch.
+
+        status = STATUS_SUCCESS;
+
+        for (i = 0; i < numberOfEntries; i ++)
+        {
+            if (sizeof(batchEntry) > batchSize - offset)
+            {
+                printf("[SyncDir] Error: RecvModifyBatchFromClient(): Corrupt batch (entry [%u/%u]). \n", i, numberOfEntries);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            memcpy(&batchEntry, batch + offset, sizeof(batchEntry));
+            offset = offset + sizeof(batchEntry);
+            pathLength = ntohs(batchEntry.RelativePathLength);
+            fileSize = ntohl(batchEntry.FileSize);
+
+            if (pathLength < 3 || pathLength >= SD_MAX_PATH_LENGTH || 
+                (QWORD) pathLength + hashCodeLength + 1 + fileSize > (QWORD) (batchSize - offset))
+            {
+                printf("[SyncDir] Error: RecvModifyBatchFromClient(): Corrupt batch (entry [%u/%u]). \n", i, numberOfEntries);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+            memcpy(fileRelativePath, batch + offset, pathLength);
+            fileRelativePath[pathLength] = 0;
+            offset = offset + pathLength;
+            memcpy(fileHashCode, batch + offset, hashCodeLength);
+            fileHashCode[hashCodeLength] = 0;                               // Never trust the peer's terminator.
+            offset = offset + hashCodeLength + 1;
+
+            if (strlen(fileRelativePath) != pathLength || 0 != strncmp(fileRelativePath, "./", 2))
+            {
+                printf("[SyncDir] Error: RecvModifyBatchFromClient(): Invalid path in the batch (entry [%u/%u]). \n", i, numberOfEntries);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+
+            // Form the full path (+2 to avoid "./"). A file created replaces whatever file was there (as "rm; touch" does).
+
+            snprintf(fileFullPath, sizeof(fileFullPath), "%s/%s", MainDirFullPath, fileRelativePath + 2);
+
+            fileDescriptor = CreateTempFile(fileFullPath, tempFullPath);
+            if (fileDescriptor < 0 || !(SUCCESS(WriteBufferToFile(fileDescriptor, batch + offset, fileSize))) || 
+                !(SUCCESS(PublishTempFile(fileDescriptor, tempFullPath, fileFullPath, fileSize))))
+            {
+                if (fileDescriptor >= 0 && 0 != tempFullPath[0])
+                {
+                    unlink(tempFullPath);
+                }
+                perror("[SyncDir] Warning: RecvModifyBatchFromClient(): Error at file opening / writing. Skipping the file ...\n");
+                printf("File was [%s]. \n", fileFullPath);
+                status = STATUS_WARNING;
+            }
+            else
+            {
+                numberOfWritten ++;
+                writtenBytes = writtenBytes + fileSize;
+
+                if (0 == (ntohs(batchEntry.Flags) & SD_BATCH_FLAG_CREATE) && 
+                    !(SUCCESS(InsertHashInfoOfFile(fileRelativePath, fileHashCode, fileSize, HashInfoHMap))))
+                {
+                    printf("[SyncDir] Warning: RecvModifyBatchFromClient(): Failed to execute InsertHashInfoOfFile() for file [%s]. \n", 
+                        fileRelativePath);
+                    status = STATUS_WARNING;
+                }
+            }
+            if (fileDescriptor >= 0)
+            {
+                close(fileDescriptor);
+                fileDescriptor = -1;
+            }
+            offset = offset + fileSize;
+        }
+
+        fprintf(g_SD_STDLOG, "[SyncDir] Info: Batch received: [%u/%u] small files written ([%llu B]). \n", numberOfWritten, 
+                numberOfEntries, (unsigned long long) writtenBytes);
+    }
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";
         status = STATUS_FAIL;
     }
-    __catch (...)
+    __catch (const std::exception &e)
     {
-        printf("[SyncDir] Error: RecvFileFromClient(): Unkown exception.\n");
+        cout << "[SyncDir] Error: RecvModifyBatchFromClient(): Standard Exception caught: " << e.what() << "\n";
         status = STATUS_FAIL;
     }
 
-
-    // UNINIT. Cleanup.
-    if (SUCCESS(status))
+    if (fileDescriptor >= 0)
     {
-        if (NULL != fileStream)
-        {
-            fclose(fileStream);
-            fileStream = NULL;
-        }
-    }
-    else
-    {
-        if (NULL != fileStream)
-        {
-            fclose(fileStream);
-            fileStream = NULL;
-        }
+        close(fileDescriptor);
     }
+    free(batch);
 
     return status;
-} // RecvFileFromClient()
+} // RecvModifyBatchFromClient()
 
 
 
@@ -518,15 +3987,26 @@ SDSTATUS
 RecvAndExecuteOperationFromClient(
     __in char                                               *MainDirFullPath,
     __inout std::unordered_map<std::string, HASH_INFO>      & HashInfoHMap,
+    __inout std::unordered_map<std::string, CHUNK_INFO>     & ChunkInfoHMap,
+    __inout std::unordered_map<DWORD, PENDING_TRANSFER>     & PendingTransferHMap,
+    __inout STRIPE_RECEIVER                                 & StripeReceiver,
     __in DWORD                                              SockConnID
     )
 /*++
 Description: The routine receives, stores and executes the operation sent by a SyncDir client application, inside the MainDirFullPath 
 directory. Information related to file modifications (such as hash codes, file sizes) are stored in the HashInfoHMap structure.
+The contents of modified files are received in the cheapest available way: a local copy of identical content, a delta against the
+server copy, the chunks missing on the server, or the whole file. The chunks of the received large files are indexed in ChunkInfoHMap.
+A MODIFY is answered at once (see PACKET_MODIFY_REPLY); if the content is needed, the way to receive it is kept in PendingTransferHMap
+until the client sends it (opMODIFYDATA). With data connections, the whole files are received in ranges (see PACKET_STRIPE_HEADER),
+into a temporary file renamed once all the ranges arrived. Small files come in batches, with their contents (opMODIFYBATCH).
 
 - MainDirFullPath: Pointer to the full path of the server main directory, where the file operations are executed (the server 
 application sees this directory as its own "root" path).
 - HashInfoHMap: Reference to the structure containing the file hash information, including file paths, hash codes and file sizes.
+- ChunkInfoHMap: Reference to the chunk index (locations of the chunks stored on the server, by hash code).
+- PendingTransferHMap: Reference to the MODIFY's answered whose content is still to be received (by request ID).
+- StripeReceiver: Reference to the data connections of the session (whole files received in ranges).
 - SockConnID: Descriptor representing the socket connection with the SyncDir client application.
 
 Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
@@ -535,21 +4015,33 @@ was achieved, but related issues were encountered (information is logged, thereb
 {
     SDSTATUS            status;
     PACKET_OP           opReceived;
+    PACKET_MODIFY_REPLY modifyReply;
+    PENDING_TRANSFER    pendingTransfer;
     char                fileRelativePath[SD_MAX_PATH_LENGTH];
     char                fileOldRelativePath[SD_MAX_PATH_LENGTH];
     char                fileRealRelativePath[SD_MAX_PATH_LENGTH];
     char                fileFullPath[SD_MAX_PATH_LENGTH];
     char                fileOldFullPath[SD_MAX_PATH_LENGTH];
     char                fileRealFullPath[SD_MAX_PATH_LENGTH];
-    char                fileHashCode[SD_HASH_CODE_LENGTH + 1];    
-    char                bufferOut[SD_SHORT_MSG_SIZE];
+    char                fileHashCode[SD_MAX_HASH_CODE_LENGTH + 1];
+    DWORD               hashCodeLength;
     char                shellCommand[4 * SD_MAX_PATH_LENGTH];
     char                fileToCopyFullPath[SD_MAX_PATH_LENGTH];
     __int32             recvBytes;
     __int32             sentBytes;
-    DWORD               fileSize;
+    QWORD               fileSize;
+    QWORD               clientFileSize;
+    DWORD               requestId;
+    BOOL                isChunkTransfer;
+    BOOL                isStripeTransfer;
+    __int32             oldFileDescriptor;
+    STRIPE_TRANSFER     stripeTransfer;
+    struct stat         oldFileStat;
+    struct pollfd       controlPoll;
     std::string         auxString;
+    std::vector<CDC_CHUNK> chunks;
     std::unordered_map<std::string, HASH_INFO>::const_iterator iteratorHI;
+    std::unordered_map<DWORD, PENDING_TRANSFER>::iterator iteratorPT;
 
     // PREINIT.
 
@@ -561,12 +4053,18 @@ was achieved, but related issues were encountered (information is logged, thereb
     fileOldFullPath[0] = 0;
     fileRealFullPath[0] = 0;
     fileHashCode[0] = 0;
-    bufferOut[0] = 0;
+    hashCodeLength = HashCodeLength(gHashAlgorithm);
     shellCommand[0] = 0;
     fileToCopyFullPath[0] = 0;
     recvBytes = -1;
     sentBytes = -1;
     fileSize = 0;
+    clientFileSize = 0;
+    requestId = 0;
+    isChunkTransfer = FALSE;
+    isStripeTransfer = FALSE;
+    oldFileDescriptor = -1;
+    memset(&modifyReply, 0, sizeof(modifyReply));
 
     // Parameter validation.
 
@@ -595,6 +4093,20 @@ was achieved, but related issues were encountered (information is logged, thereb
 
 
         // I.
+        // Group commit: the files received are synced to disk once the client pauses (its batch is over), or once too many wait.
+
+        if (0 != gGroupCommit.Files)
+        {
+            controlPoll.fd = SockConnID;
+            controlPoll.events = POLLIN;
+            controlPoll.revents = 0;
+            if (gGroupCommit.Files >= SD_SRV_GROUP_COMMIT_FILES || gGroupCommit.Bytes >= (QWORD) SD_SRV_GROUP_COMMIT_SIZE || 
+                0 == poll(&controlPoll, 1, SD_SRV_GROUP_COMMIT_IDLE_MS))
+            {
+                CommitReceivedFiles(MainDirFullPath);
+            }
+        }
+
         // Receive operation info and file path.
 
         status = RecvPacketOpAndFilePathFromClient(fileRelativePath, &opReceived, SockConnID);
@@ -654,6 +4166,7 @@ was achieved, but related issues were encountered (information is logged, thereb
                 if (ftDIRECTORY != opReceived.FileType)
                 {
                     sprintf(shellCommand, "rm \"%s\" ", fileFullPath);
+                    RemovePartialFile(fileFullPath);
 
 
                     status = DeleteHashInfoOfFile(fileRelativePath, HashInfoHMap);
@@ -682,8 +4195,8 @@ was achieved, but related issues were encountered (information is logged, thereb
 
                 // Receive the file hash code.
 
-                recvBytes = recv(SockConnID, fileHashCode, SD_HASH_CODE_LENGTH + 1, 0);
-                if (SD_HASH_CODE_LENGTH + 1 != recvBytes)
+                recvBytes = recv(SockConnID, fileHashCode, hashCodeLength + 1, MSG_WAITALL);
+                if ((__int32) hashCodeLength + 1 != recvBytes)
                 {
                     if (recvBytes < 0)
                     {
@@ -692,18 +4205,45 @@ was achieved, but related issues were encountered (information is logged, thereb
                     else
                     {
                         printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Error at reception of file hash code. Only %d/%d bytes "
-                            "received.\n", recvBytes, SD_HASH_CODE_LENGTH + 1);                      
+                            "received.\n", recvBytes, hashCodeLength + 1);                      
                     }
                     status = STATUS_FAIL;
                     throw SyncDirException();                      
                 }
 
 
+                // Receive the size of the client file (QWORD, big-endian).
+
+                recvBytes = recv(SockConnID, &clientFileSize, sizeof(QWORD), MSG_WAITALL);
+                if (sizeof(QWORD) != recvBytes)
+                {
+                    perror("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Error at receiving the file size. \n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                clientFileSize = be64toh(clientFileSize);
+
+
+                // Receive the request ID of the MODIFY (network byte order). The answer carries it (see PACKET_MODIFY_REPLY).
+
+                recvBytes = recv(SockConnID, &requestId, sizeof(DWORD), MSG_WAITALL);
+                if (sizeof(DWORD) != recvBytes)
+                {
+                    perror("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Error at receiving the request ID. \n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                modifyReply.RequestId = requestId;                              // Echoed as received (network byte order).
+                modifyReply.Offset = 0;
+                requestId = ntohl(requestId);
+
+
 
                 // Check if there is file with same hash code on the server.
-                // If so, no need to receive the file from client (the server performs a local file copy).
-                // If not, receive the file from client.
+                // If so, no need to receive the file from client (the server performs a local file copy, then answers).
+                // If not, or if the copy fails, tell the client how to send the content. It is received later, with opMODIFYDATA.
 
+                fileHashCode[hashCodeLength] = 0;                               // Never trust the peer's terminator.
                 auxString.assign(fileHashCode);                                 // Transform to string. Equivalent to operator=(const char *).
 
                 iteratorHI = HashInfoHMap.find(auxString);
@@ -714,13 +4254,27 @@ was achieved, but related issues were encountered (information is logged, thereb
                     fprintf(g_SD_STDLOG, "[SyncDir] Info: File content is on the server. Preparing a local copy ... \n");
 
 
-                    // Send info message to client.
+                    // Copy the file locally (+2 to avoid "./"). If the copy fails (e.g. source removed meanwhile, disk full), the 
+                    // content is requested from the client, as if not on the server.
+
+                    sprintf(fileToCopyFullPath, "%s/%s", MainDirFullPath, iteratorHI->second.FileRelativePath.c_str() + 2);
+                    status = CopyLocalFile(fileToCopyFullPath, fileFullPath, &fileSize);
+                    if (!(SUCCESS(status)))
+                    {
+                        printf("[SyncDir] Warning: RecvAndExecuteOperationFromClient(): Failed to execute CopyLocalFile() for file [%s]. "
+                            "Requesting the content. \n", fileRelativePath);
+                        iteratorHI = HashInfoHMap.end();
+                    }
+                }
+                if (HashInfoHMap.end() != iteratorHI)
+                {
+                    // Send info message to client (the copy is in place).
                     // No need for file transfer.
 
-                    sprintf(bufferOut, "File On Server");
+                    sprintf(modifyReply.Message, "File On Server");
 
-                    sentBytes = send(SockConnID, bufferOut , SD_SHORT_MSG_SIZE, 0);
-                    if (SD_SHORT_MSG_SIZE != (DWORD)sentBytes)
+                    sentBytes = send(SockConnID, &modifyReply, sizeof(modifyReply), 0);
+                    if (sizeof(modifyReply) != (DWORD)sentBytes)
                     {
                         if (sentBytes < 0)
                         {
@@ -729,29 +4283,23 @@ was achieved, but related issues were encountered (information is logged, thereb
                         else
                         {
                             printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Error at sending to server (File On Server). "
-                                "Only %d/%d bytes sent.\n", sentBytes, SD_SHORT_MSG_SIZE);
+                                "Only %d/%d bytes sent.\n", sentBytes, (__int32) sizeof(modifyReply));
                         }
                         status = STATUS_FAIL;
                         throw SyncDirException();
                     }
 
 
-                    // Form the copy command for later. (+2 to avoid "./")
-
-                    sprintf(fileToCopyFullPath, "%s/%s", MainDirFullPath, iteratorHI->second.FileRelativePath.c_str() + 2);
-                    sprintf(shellCommand, "yes | /bin/cp \"%s\" \"%s\" ", fileToCopyFullPath, fileFullPath);
-
-
                     // Insert new HashInfo for the new file copy.
 
-                    status = InsertHashInfoOfFile(fileRelativePath, fileHashCode, fileSize, HashInfoHMap);
+                    status = InsertHashInfoOfFile(fileRelativePath, fileHashCode, clientFileSize, HashInfoHMap);
                     if (!(SUCCESS(status)))
                     {
                         printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Failed to execute InsertHashInfoOfFile() for "
                             "file [%s]. \n", fileRelativePath);
                         status = STATUS_FAIL;
                         throw SyncDirException();
-                    }                    
+                    }
 
 
                 }
@@ -761,16 +4309,131 @@ was achieved, but related issues were encountered (information is logged, thereb
                 {
 
 
-                    fprintf(g_SD_STDLOG, "[SyncDir] Info: File not on the server. Preparing to receive content ... \n");
+                    fprintf(g_SD_STDLOG, "[SyncDir] Info: File not on the server. Content requested (request [%u]) ... \n", requestId);
+
+
+                    // If the transfer of this content was interrupted (connection lost), receive only the rest of it. Otherwise, a
+                    // partial file left is stale.
+
+                    stripeTransfer.TempFullPath.assign(fileFullPath).append(SD_SRV_PARTIAL_SUFFIX);
+                    stripeTransfer.FileSize = clientFileSize;
+                    stripeTransfer.StartOffset = ResumeOffsetOfPartialFile(stripeTransfer.TempFullPath.c_str(), fileHashCode, clientFileSize);
+                    stripeTransfer.IsResumable = FALSE;
+
+                    if (0 != stripeTransfer.StartOffset && truncate(stripeTransfer.TempFullPath.c_str(), (off_t) stripeTransfer.StartOffset) < 0)
+                    {
+                        perror("[SyncDir] Warning: RecvAndExecuteOperationFromClient(): Error at truncating the partial file. \n");
+                        stripeTransfer.StartOffset = 0;
+                    }
+                    if (0 == stripeTransfer.StartOffset)
+                    {
+                        unlink(stripeTransfer.TempFullPath.c_str());
+                    }
+                    else
+                    {
+                        fprintf(g_SD_STDLOG, "[SyncDir] Info: Resuming an interrupted transfer at [%llu/%llu B] (request [%u]) ... \n", 
+                            (unsigned long long) stripeTransfer.StartOffset, (unsigned long long) clientFileSize, requestId);
+                    }
+
+
+                    // Otherwise, if the server has an older copy of the file (large enough), receive only the differences (delta).
+
+                    oldFileDescriptor = (0 == stripeTransfer.StartOffset) ? open(fileFullPath, O_RDONLY | O_NOFOLLOW | O_CLOEXEC) : -1;
+                    if (oldFileDescriptor >= 0 && (fstat(oldFileDescriptor, &oldFileStat) < 0 || !S_ISREG(oldFileStat.st_mode) || 
+                        oldFileStat.st_size < SD_DELTA_MIN_FILE_SIZE))
+                    {
+                        close(oldFileDescriptor);
+                        oldFileDescriptor = -1;
+                    }
+
+
+                    // Otherwise, if the file is large (not huge) and the server has chunks, receive only the chunks missing on the server.
+
+                    isChunkTransfer = (0 == stripeTransfer.StartOffset && oldFileDescriptor < 0 && clientFileSize >= SD_CDC_MIN_FILE_SIZE && 
+                                       clientFileSize <= SD_CDC_MAX_FILE_SIZE && !ChunkInfoHMap.empty()) ? TRUE : FALSE;
+
+
+                    // Otherwise, receive the whole file (in ranges, with data connections) into its partial file: created now (the
+                    // ranges may come before the opMODIFYDATA), or resumed.
+
+                    isStripeTransfer = FALSE;
+                    if (0 != stripeTransfer.StartOffset)
+                    {
+                        stripeTransfer.IsResumable = TRUE;
+                        isStripeTransfer = TRUE;
+                    }
+                    else if (oldFileDescriptor < 0 && FALSE == isChunkTransfer)
+                    {
+                        if (SUCCESS(CreatePartialFile(stripeTransfer.TempFullPath.c_str(), fileHashCode, clientFileSize, 
+                                                      &stripeTransfer.IsResumable)))
+                        {
+                            isStripeTransfer = TRUE;
+                        }
+                        else
+                        {
+                            perror("[SyncDir] Warning: RecvAndExecuteOperationFromClient(): Error at creating the partial file. "
+                                "Requesting the whole file ...\n");
+                        }
+                    }
+                    stripeTransfer.ReceivedRanges = 0;
+                    stripeTransfer.ReceivedBytes = stripeTransfer.StartOffset;
+                    stripeTransfer.ContiguousEnd = stripeTransfer.StartOffset;
+                    stripeTransfer.DurableOffset = stripeTransfer.StartOffset;
+                    stripeTransfer.RangeEnds.clear();
+
+
+                    // Remember how to receive the content (the file stays open, for a delta).
+
+                    pendingTransfer.FileRelativePath.assign(fileRelativePath);
+                    pendingTransfer.HashCode.assign(fileHashCode);
+                    pendingTransfer.ClientFileSize = clientFileSize;
+                    pendingTransfer.OldFileDescriptor = oldFileDescriptor;
+                    pendingTransfer.IsChunkTransfer = isChunkTransfer;
+                    pendingTransfer.IsStripeTransfer = isStripeTransfer;
+
+                    iteratorPT = PendingTransferHMap.find(requestId);
+                    if (PendingTransferHMap.end() != iteratorPT)
+                    {
+                        printf("[SyncDir] Warning: RecvAndExecuteOperationFromClient(): Request [%u] already pending. Replacing it ...\n", 
+                            requestId);
+                        if (iteratorPT->second.OldFileDescriptor >= 0)
+                        {
+                            close(iteratorPT->second.OldFileDescriptor);
+                        }
+                        PendingTransferHMap.erase(iteratorPT);
+                    }
+                    PendingTransferHMap.insert({requestId, pendingTransfer});
+                    oldFileDescriptor = -1;                                     // Owned by PendingTransferHMap.
+
+                    {
+                        std::lock_guard<std::mutex> lock(StripeReceiver.Lock);
+
+                        auto iteratorST = StripeReceiver.Transfers.find(requestId);
+                        if (StripeReceiver.Transfers.end() != iteratorST)       // Replaced request.
+                        {
+                            if (iteratorST->second.TempFullPath != stripeTransfer.TempFullPath || FALSE == isStripeTransfer)
+                            {
+                                unlink(iteratorST->second.TempFullPath.c_str());
+                            }
+                            StripeReceiver.Transfers.erase(iteratorST);
+                        }
+                        if (TRUE == isStripeTransfer)
+                        {
+                            StripeReceiver.Transfers.insert({requestId, stripeTransfer});
+                        }
+                    }
 
 
                     // Send info message to client.
-                    // Need to receive the file.
+                    // Need to receive the file (or its delta, or its chunks).
 
-                    sprintf(bufferOut, "File Not On Server");
+                    sprintf(modifyReply.Message, (pendingTransfer.OldFileDescriptor >= 0) ? "File Delta" : ((TRUE == isChunkTransfer) ? 
+                        "File Chunks" : ((0 != stripeTransfer.StartOffset) ? "File Resume" : 
+                        ((TRUE == isStripeTransfer) ? "File Stripes" : "File Not On Server"))));
+                    modifyReply.Offset = htobe64(stripeTransfer.StartOffset);
 
-                    sentBytes = send(SockConnID, bufferOut, SD_SHORT_MSG_SIZE, 0);
-                    if (SD_SHORT_MSG_SIZE != (DWORD)sentBytes)
+                    sentBytes = send(SockConnID, &modifyReply, sizeof(modifyReply), 0);
+                    if (sizeof(modifyReply) != (DWORD)sentBytes)
                     {
                         if (sentBytes < 0)
                         {
@@ -779,23 +4442,134 @@ was achieved, but related issues were encountered (information is logged, thereb
                         else
                         {
                             printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Error at sending to server (File Not On Server). "
-                                "Only %d/%d bytes sent.\n", sentBytes, SD_SHORT_MSG_SIZE);
+                                "Only %d/%d bytes sent.\n", sentBytes, (__int32) sizeof(modifyReply));
                         }
                         status = STATUS_FAIL;
                         throw SyncDirException();
                     }
 
+                
+                }//--> if (HashInfoHMap.end() == iteratorHI)
+
+                break;
+
+
+
+            //
+            // opMODIFYDATA
+            //
+
+            case (opMODIFYDATA):
+
+
 
-                    // Receive the file from client.
+                // Receive the request ID of the MODIFY answered (network byte order).
 
+                recvBytes = recv(SockConnID, &requestId, sizeof(DWORD), MSG_WAITALL);
+                if (sizeof(DWORD) != recvBytes)
+                {
+                    perror("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Error at receiving the request ID. \n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                requestId = ntohl(requestId);
+
+                iteratorPT = PendingTransferHMap.find(requestId);
+                if (PendingTransferHMap.end() == iteratorPT || iteratorPT->second.FileRelativePath != fileRelativePath)
+                {
+                    printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): No pending request [%u] for file [%s]. \n", requestId, 
+                        fileRelativePath);
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                    // The content that follows cannot be parsed: the connection is out of sync.
+                }
+                pendingTransfer = iteratorPT->second;
+                PendingTransferHMap.erase(iteratorPT);
+
+                oldFileDescriptor = pendingTransfer.OldFileDescriptor;
+                isChunkTransfer = pendingTransfer.IsChunkTransfer;
+                isStripeTransfer = pendingTransfer.IsStripeTransfer;
+                snprintf(fileHashCode, sizeof(fileHashCode), "%s", pendingTransfer.HashCode.c_str());
+
+                fprintf(g_SD_STDLOG, "[SyncDir] Info: Receiving the content requested (request [%u]) ... \n", requestId);
+
+
+                // Receive the file (or its delta) from client.
+
+                if (oldFileDescriptor >= 0)
+                {
+                    status = RecvDeltaFromClient(fileFullPath, oldFileDescriptor, fileHashCode, &fileSize, SockConnID);
+                    close(oldFileDescriptor);
+                    oldFileDescriptor = -1;
+                    if (!(SUCCESS(status)))
+                    {
+                        printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Failed to execute RecvDeltaFromClient() for "
+                            "file [%s]. \n", fileRelativePath);
+                        status = STATUS_FAIL;
+                        throw SyncDirException();
+                        // The delta stream could not be followed: the connection is out of sync.
+                    }
+                }
+                else if (TRUE == isChunkTransfer)
+                {
+                    status = RecvChunksFromClient(MainDirFullPath, fileFullPath, fileRelativePath, fileHashCode, ChunkInfoHMap, 
+                                                  StripeReceiver, requestId, &fileSize, SockConnID);
+                    if (!(SUCCESS(status)))
+                    {
+                        printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Failed to execute RecvChunksFromClient() for "
+                            "file [%s]. \n", fileRelativePath);
+                        status = STATUS_FAIL;
+                        throw SyncDirException();
+                        // The chunk stream could not be followed: the connection is out of sync.
+                    }
+                }
+                else if (TRUE == isStripeTransfer)
+                {
+                    status = WaitStripeTransferFromClient(fileFullPath, requestId, StripeReceiver, &fileSize, SockConnID);
+                    if (!(SUCCESS(status)))
+                    {
+                        printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Failed to execute WaitStripeTransferFromClient() for "
+                            "file [%s]. \n", fileRelativePath);
+                        status = STATUS_FAIL;
+                        throw SyncDirException();
+                        // The ranges could not be received: the data connections are out of sync.
+                    }
+                }
+                else
+                {
                     status = RecvFileFromClient(fileFullPath, &fileSize, SockConnID);
                     if (!(SUCCESS(status)))
                     {
                         printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Failed to execute RecvFileFromClient() for "
                             "file [%s]. \n", fileRelativePath);
                         status = STATUS_WARNING;
-                        // Just warning, because maybe the transfer was interrupted (e.g. in case of volatile files).
-                    }                       
+                        // Just warning, because maybe the transfer was interrupted (e.g. in case of volatile files). The server
+                        // copy is left as it was (see CreateTempFile()).
+                    }
+                }
+
+
+                // A file not received completely, or not put in place, does not hold the content of the hash code: it is not
+                // indexed, and the previous HashInfo of the path is dropped (the index never names a content not on the server).
+
+                if (STATUS_SUCCESS != status)
+                {
+                    printf("[SyncDir] Warning: RecvAndExecuteOperationFromClient(): File [%s] not received completely. Not indexed. \n", 
+                        fileRelativePath);
+                    if (HashInfoHMap.end() != HashInfoHMap.find(auxString.assign(fileRelativePath)))
+                    {
+                        DeleteHashInfoOfFile(fileRelativePath, HashInfoHMap);
+                    }
+                    status = STATUS_WARNING;
+                }
+                else
+                {
+                    // Index the chunks of the new file, if large (RecvChunksFromClient() did it already).
+
+                    if (FALSE == isChunkTransfer && fileSize >= SD_CDC_MIN_FILE_SIZE && SUCCESS(ChunksOfServerFile(fileFullPath, chunks)))
+                    {
+                        InsertChunkInfosOfFile(fileRelativePath, chunks, ChunkInfoHMap);
+                    }
 
                     // Insert new HashInfo for the new received file.
 
@@ -806,10 +4580,51 @@ was achieved, but related issues were encountered (information is logged, thereb
                             "file [%s]. \n", fileRelativePath);
                         status = STATUS_FAIL;
                         throw SyncDirException();
-                    }                    
+                    }
+                }
 
-                
-                }//--> if (HashInfoHMap.end() == iteratorHI)
+                break;
+
+
+
+            //
+            // opHASHQUERY
+            //
+
+            case (opHASHQUERY):
+
+
+                // Batched query: which contents the server holds (no file operation).
+
+                status = AnswerHashQueryOfClient(HashInfoHMap, SockConnID);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Failed to execute AnswerHashQueryOfClient(). \n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+
+                break;
+
+
+
+            //
+            // opMODIFYBATCH
+            //
+
+            case (opMODIFYBATCH):
+
+
+                // Small files, with their contents (no answer).
+
+                status = RecvModifyBatchFromClient(MainDirFullPath, HashInfoHMap, SockConnID);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: RecvAndExecuteOperationFromClient(): Failed to execute RecvModifyBatchFromClient(). \n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                    // The batch could not be followed: the connection is out of sync.
+                }
 
                 break;
 
@@ -906,6 +4721,15 @@ was achieved, but related issues were encountered (information is logged, thereb
                 sprintf(shellCommand, "mv -T \"%s\" \"%s\" ", fileOldFullPath, fileFullPath);
 
 
+                // A partial file of the old path or of the replaced file is stale. (Those inside a directory move with it.)
+
+                if (ftDIRECTORY != opReceived.FileType)
+                {
+                    RemovePartialFile(fileOldFullPath);
+                    RemovePartialFile(fileFullPath);
+                }
+
+
                 // Check if the old path is valid. If not, maybe the old path didn't exist before the events. In this case,
                 // the operation resolves to a CREATE, not a MOVE. (possibly followed by other operations, e.g. MODIFY.)
 
@@ -929,8 +4753,19 @@ was achieved, but related issues were encountered (information is logged, thereb
                 // Note: usage of "-T" option is motivated by operations of directory replacements, where if "-T" is not used,
                 //      then the directory is moved INSIDE of the destination one, instead of REPLACING it. Also, the "-T" option 
                 //      does not affect the move operation for regular files.
+                // A file without HashInfo (not indexed: e.g. empty, or not received completely) only moves; the HashInfo of the 
+                // file it replaces, if any, is dropped.
 
-                if (ftDIRECTORY != opReceived.FileType)
+                auxString.assign(fileOldRelativePath);
+                if (ftDIRECTORY != opReceived.FileType && HashInfoHMap.end() == HashInfoHMap.find(auxString))
+                {
+                    auxString.assign(fileRelativePath);
+                    if (HashInfoHMap.end() != HashInfoHMap.find(auxString))
+                    {
+                        DeleteHashInfoOfFile(fileRelativePath, HashInfoHMap);
+                    }
+                }
+                else if (ftDIRECTORY != opReceived.FileType)
                 {            
                     status = UpdateHashInfoOfNondirFile(fileOldRelativePath, fileRelativePath, HashInfoHMap);
                     if (!(SUCCESS(status)))
@@ -1021,11 +4856,19 @@ was achieved, but related issues were encountered (information is logged, thereb
     // UNINIT. Cleanup.
     if (SUCCESS(status))
     {
-        // Nothing to clean for the moment.
+        if (oldFileDescriptor >= 0)
+        {
+            close(oldFileDescriptor);
+            oldFileDescriptor = -1;
+        }
     }
     else
     {
-        // Nothing to clean for the moment.
+        if (oldFileDescriptor >= 0)
+        {
+            close(oldFileDescriptor);
+            oldFileDescriptor = -1;
+        }
     }
 
     return status;
@@ -1034,3 +4877,89 @@ was achieved, but related issues were encountered (information is logged, thereb
 
 
 
+//
+// ReleasePendingTransfers
+//
+void
+ReleasePendingTransfers(
+    __inout std::unordered_map<DWORD, PENDING_TRANSFER> & PendingTransferHMap
+    )
+/*++
+Description: The routine drops the MODIFY's answered whose content was not received (e.g. when the connection is closed), closing 
+the server copies kept open for delta transfers.
+
+- PendingTransferHMap: Reference to the MODIFY's answered whose content is still to be received (by request ID).
+
+Return value: None.
+--*/
+{
+    if (!PendingTransferHMap.empty())
+    {
+        printf("[SyncDir] Warning: ReleasePendingTransfers(): [%zu] contents requested were not received. \n", PendingTransferHMap.size());
+    }
+
+    for (auto &pendingTransfer : PendingTransferHMap)
+    {
+        if (pendingTransfer.second.OldFileDescriptor >= 0)
+        {
+            close(pendingTransfer.second.OldFileDescriptor);
+            pendingTransfer.second.OldFileDescriptor = -1;
+        }
+    }
+    PendingTransferHMap.clear();
+} // ReleasePendingTransfers()
+
+
+
+
+//
+// CommitReceivedFiles
+//
+SDSTATUS
+CommitReceivedFiles(
+    __in char       *MainDirFullPath
+    )
+/*++
+Description: The routine syncs to disk the files published since its last call (see PublishTempFile()), in one syncfs() of the file
+system of the main directory: a crash of the server loses none of them afterwards. Before, a crash may leave the last files
+published with a content not on disk; the startup indexer then hashes what is on disk, and the reconciliation with the client sends
+them again.
+
+- MainDirFullPath: Pointer to the full path of the server main directory.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the files stay counted, for the next call).
+--*/
+{
+    __int32     dirDescriptor;
+    __int32     returnValue;
+
+    if (FALSE == SD_SRV_GROUP_COMMIT || 0 == gGroupCommit.Files)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    dirDescriptor = open(MainDirFullPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirDescriptor < 0)
+    {
+        perror("[SyncDir] Warning: CommitReceivedFiles(): Error at opening the main directory.\n");
+        return STATUS_FAIL;
+    }
+    returnValue = syncfs(dirDescriptor);
+    close(dirDescriptor);
+    if (returnValue < 0)
+    {
+        perror("[SyncDir] Warning: CommitReceivedFiles(): Error at syncing the received files.\n");
+        return STATUS_FAIL;
+    }
+
+    fprintf(g_SD_STDLOG, "[SyncDir] Info: Group commit: [%u] files received ([%llu B]) synced to disk. \n", gGroupCommit.Files, 
+        (unsigned long long) gGroupCommit.Bytes);
+    gGroupCommit.Files = 0;
+    gGroupCommit.Bytes = 0;
+
+    return STATUS_SUCCESS;
+} // CommitReceivedFiles()
+
+
+
+
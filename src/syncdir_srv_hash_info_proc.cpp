@@ -9,6 +9,33 @@
 #include "syncdir_srv_hash_info_proc.h"
 
 
+
+//
+// IsPartialFileName
+//
+static BOOL
+IsPartialFileName(
+    __in const char *FileName
+    )
+/*++
+Description: The routine tells whether a file is the partial file of a whole file being received (SD_SRV_PARTIAL_SUFFIX), or its
+temporary file (SD_SRV_TEMP_SUFFIX, left by a crash). These files are not part of the synchronized tree: they are neither indexed nor
+counted in the directory digests.
+--*/
+{
+    size_t  nameLength;
+    size_t  suffixLength;
+    size_t  tempSuffixLength;
+
+    nameLength = strlen(FileName);
+    suffixLength = strlen(SD_SRV_PARTIAL_SUFFIX);
+    tempSuffixLength = strlen(SD_SRV_TEMP_SUFFIX);
+
+    return ((nameLength > suffixLength && 0 == strcmp(FileName + nameLength - suffixLength, SD_SRV_PARTIAL_SUFFIX)) || 
+            (nameLength > tempSuffixLength && 0 == strcmp(FileName + nameLength - tempSuffixLength, SD_SRV_TEMP_SUFFIX))) ? TRUE : FALSE;
+} // IsPartialFileName()
+
+
 //
 // UpdateOrDeleteHashInfosForDirPath
 //
@@ -636,7 +663,7 @@ SDSTATUS
 InsertHashInfoOfFile(
     __in const char     *FileRelativePath,
     __in const char     *HashCode,
-    __in DWORD          FileSize,
+    __in QWORD          FileSize,
     __inout std::unordered_map<std::string, HASH_INFO> & HashInfoHMap
     )
 /*++
@@ -790,23 +817,329 @@ equal hash codes, this becomes a simple greedy approach, where the value at Hash
 
 
 
+
 //
-// BuildHashInfoForEachFile
+// ChunksOfServerFile
 //
 SDSTATUS
-BuildHashInfoForEachFile(
-    __in const char     *DirFullPath,
-    __in const char     *DirRelativePath,
-    __out std::unordered_map<std::string, HASH_INFO> & HashInfoHMap    
+ChunksOfServerFile(
+    __in const char                 *FileFullPath,
+    __out std::vector<CDC_CHUNK>    & Chunks
     )
 /*++
-Description: The routine builds the map containing all the HASH_INFO structures of every file inside the DirFullPath directory and its
-subdirectories. These structures are made accessible through the hash code of the file (e.g. using MD5 algorithm) and thorugh the file 
-relative path.
+Description: The routine splits a server file into content-defined chunks (see CdcChunksOfFile()), for the chunk index. Only the
+regular files of SD_CDC_MIN_FILE_SIZE to SD_CDC_MAX_FILE_SIZE bytes are chunked (symbolic links are not followed); for the other 
+files, no chunk is output.
+
+- FileFullPath: Pointer to the full path of the file.
+- Chunks: Reference to where the routine outputs the chunks of the file (offsets, sizes, hash codes).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS    status;
+    __int32     fileDescriptor;
+    struct stat fileStat;
+    CDC_CHUNK   *chunks;
+    DWORD       numberOfChunks;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    fileDescriptor = -1;
+    chunks = NULL;
+    numberOfChunks = 0;
+
+    // Parameter validation.
+
+    if (NULL == FileFullPath || 0 == FileFullPath[0])
+    {
+        printf("[SyncDir] Error: ChunksOfServerFile(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+
+        Chunks.clear();
+
+        fileDescriptor = open(FileFullPath, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStat) < 0)
+        {
+            perror("[SyncDir] Error: ChunksOfServerFile(): Error at opening the file.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+
+        // Main processing:
+
+        if (S_ISREG(fileStat.st_mode) && fileStat.st_size >= SD_CDC_MIN_FILE_SIZE && (QWORD) fileStat.st_size <= SD_CDC_MAX_FILE_SIZE)
+        {
+            status = CdcChunksOfFile(gHashAlgorithm, fileDescriptor, NULL, fileStat.st_size, &chunks, &numberOfChunks);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: ChunksOfServerFile(): CdcChunksOfFile() failed for file [%s].\n", FileFullPath);
+                status = STATUS_FAIL;
+                throw SyncDirException();
+            }
+
+            Chunks.assign(chunks, chunks + numberOfChunks);
+        }
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: ChunksOfServerFile(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: ChunksOfServerFile(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        free(chunks);
+        chunks = NULL;
+        close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+    else
+    {
+        free(chunks);
+        chunks = NULL;
+        if (fileDescriptor >= 0)
+        {
+            close(fileDescriptor);
+            fileDescriptor = -1;
+        }
+        Chunks.clear();
+    }
+
+    return status;
+} // ChunksOfServerFile()
+
+
+
+
+
+//
+// InsertChunkInfosOfFile
+//
+void
+InsertChunkInfosOfFile(
+    __in const char                                     *FileRelativePath,
+    __in const std::vector<CDC_CHUNK>                   & Chunks,
+    __inout std::unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap
+    )
+/*++
+Description: The routine inserts in the chunk index ChunkInfoHMap the locations of the chunks of the file at path FileRelativePath.
+As for HashInfo's (see InsertHashInfoOfFile()), the newest location of a chunk replaces the existing one: it is the most likely to
+be still valid. The holes (chunks with an empty hash code) are not indexed: they are never copied.
+
+- FileRelativePath: Pointer to the file relative path.
+- Chunks: Reference to the chunks of the file.
+- ChunkInfoHMap: Reference to the chunk index (key: hash code of the chunk).
+
+Return value: None.
+--*/
+{
+    CHUNK_INFO  chunkInfo;
+
+    chunkInfo.FileRelativePath = FileRelativePath;
+
+    for (const CDC_CHUNK &chunk : Chunks)
+    {
+        if (0 == chunk.HashCode[0])
+        {
+            continue;
+        }
+        chunkInfo.Offset = chunk.Offset;
+        chunkInfo.Size = chunk.Size;
+        ChunkInfoHMap[chunk.HashCode] = chunkInfo;
+    }
+} // InsertChunkInfosOfFile()
+
+
+
 
-- DirFullPath: Reference to the string containing the full path of the directory.
-- DirRelativePath: Reference to the string containing the relative path of the directory.
-- HahsInfoHMap: Reference to the map where the routine stores all the HASH_INFO structures.
+
+//
+// ReportHashIndexerProgress
+//
+void
+ReportHashIndexerProgress(
+    __inout HASH_INDEXER    &Indexer,
+    __in BOOL               IsForced
+    )
+/*++
+Description: The routine logs the progress and the throughput of the startup indexer, if at least SD_SRV_INDEXER_PROGRESS_INTERVAL 
+seconds passed since the previous report, or if IsForced is TRUE. The caller holds Indexer.Lock.
+
+- Indexer: Reference to the indexer state.
+- IsForced: TRUE to report regardless of the time passed since the previous report.
+
+Return value: None.
+--*/
+{
+    std::chrono::steady_clock::time_point   now;
+    double                                  elapsedSeconds;
+
+    now = std::chrono::steady_clock::now();
+
+    if (FALSE == IsForced && now - Indexer.LastReportTime < std::chrono::seconds(SD_SRV_INDEXER_PROGRESS_INTERVAL))
+    {
+        return;
+    }
+    Indexer.LastReportTime = now;
+
+    elapsedSeconds = std::chrono::duration<double>(now - Indexer.StartTime).count();
+    if (elapsedSeconds <= 0)
+    {
+        elapsedSeconds = 1e-9;
+    }
+
+    printf("[SyncDir] Info: Indexing: [%llu/%llu%s] files hashed ([%llu] failed), [%.1f/%.1f MB] in [%.1f s]: [%.1f MB/s], [%.0f files/s].\n",
+        (unsigned long long) Indexer.HashedFiles, (unsigned long long) Indexer.SubmittedFiles, 
+        (TRUE == Indexer.IsWalkDone) ? "" : "+", (unsigned long long) Indexer.FailedFiles,
+        Indexer.HashedBytes / 1e6, Indexer.SubmittedBytes / 1e6, elapsedSeconds, Indexer.HashedBytes / 1e6 / elapsedSeconds,
+        (Indexer.HashedFiles + Indexer.FailedFiles) / elapsedSeconds);
+} // ReportHashIndexerProgress()
+
+
+
+//
+// HashIndexerWorker
+//
+void
+HashIndexerWorker(
+    __inout HASH_INDEXER    *Indexer
+    )
+/*++
+Description: Routine of the hashing threads of the startup indexer. It takes files from the indexer queue and hashes them (algorithm:
+gHashAlgorithm), until the queue is empty and the directory walk is done. Consecutive small files (at most SD_HASH_BATCH_MAX_FILE_SIZE
+bytes) are taken together, up to SD_HASH_BATCH_SIZE files, and hashed as one batch (see HashOfFileBatch()). The files of at least
+SD_CDC_MIN_FILE_SIZE bytes are also split into chunks, for the chunk index (see ChunksOfServerFile()). The hashed files are appended
+to Indexer->Results.
+
+- Indexer: Pointer to the indexer state.
+
+Return value: None.
+--*/
+{
+    std::vector<HASH_INDEX_ITEM>    items;
+    const char                      *fileFullPaths[SD_HASH_BATCH_SIZE];
+    char                            hashCodes[SD_HASH_BATCH_SIZE][SD_MAX_HASH_CODE_LENGTH + 1];
+    SDSTATUS                        statuses[SD_HASH_BATCH_SIZE];
+    DWORD                           i;
+
+    items.reserve(SD_HASH_BATCH_SIZE);
+
+    while (1)
+    {
+        // Get next file, and the small files right after it (if it is small).
+
+        items.clear();
+        {
+            std::unique_lock<std::mutex> lock(Indexer->Lock);
+
+            Indexer->QueueNotEmpty.wait(lock, [Indexer] { return !Indexer->Queue.empty() || TRUE == Indexer->IsWalkDone; });
+            if (Indexer->Queue.empty())
+            {
+                break;                                                      // Walk done, nothing left.
+            }
+
+            do
+            {
+                items.push_back(std::move(Indexer->Queue.front()));
+                Indexer->Queue.pop_front();
+            } while (items.size() < SD_HASH_BATCH_SIZE && !Indexer->Queue.empty() &&
+                     SD_HASH_BATCH_MAX_FILE_SIZE >= items.front().HashInfo.FileSize &&
+                     SD_HASH_BATCH_MAX_FILE_SIZE >= Indexer->Queue.front().HashInfo.FileSize);
+        }
+        Indexer->QueueNotFull.notify_all();
+
+
+        // Hash them (outside the lock).
+
+        for (i = 0; i < items.size(); i ++)
+        {
+            fileFullPaths[i] = items[i].FileFullPath.c_str();
+        }
+        HashOfFileBatch(gHashAlgorithm, (DWORD) items.size(), fileFullPaths, hashCodes, NULL, statuses);
+
+        for (i = 0; i < items.size(); i ++)
+        {
+            if (SUCCESS(statuses[i]) && SD_CDC_MIN_FILE_SIZE <= items[i].HashInfo.FileSize && 
+                !(SUCCESS(ChunksOfServerFile(items[i].FileFullPath.c_str(), items[i].Chunks))))
+            {
+                printf("[SyncDir] Warning: HashIndexerWorker(): No chunk indexed for file [%s].\n", items[i].FileFullPath.c_str());
+                                                                            // Not fatal: the file is still deduplicated as a whole.
+            }
+        }
+
+
+        // Publish the results.
+
+        {
+            std::lock_guard<std::mutex> lock(Indexer->Lock);
+
+            for (i = 0; i < items.size(); i ++)
+            {
+                if (!(SUCCESS(statuses[i])))
+                {
+                    printf("[SyncDir] Warning: HashIndexerWorker(): Hash code function failed for file [%s].\n", items[i].FileFullPath.c_str());
+                                                                            // Maybe file was altered (deleted) meanwhile.
+                    Indexer->FailedFiles++;
+                }
+                else
+                {
+                    items[i].HashInfo.HashCode.assign(hashCodes[i]);
+                    Indexer->HashedFiles++;
+                    Indexer->HashedBytes += items[i].HashInfo.FileSize;
+                    Indexer->Results.push_back(std::move(items[i]));
+                }
+            }
+        }
+        Indexer->ItemDone.notify_one();
+    }
+} // HashIndexerWorker()
+
+
+
+//
+// WalkDirForHashIndexer
+//
+SDSTATUS
+WalkDirForHashIndexer(
+    __in const char         *DirFullPath,
+    __in const char         *DirRelativePath,
+    __inout HASH_INDEXER    &Indexer
+    )
+/*++
+Description: The routine walks (recursively) the DirFullPath directory and its subdirectories, and submits every non-directory file
+to the hashing workers of the startup indexer. The routine waits while the indexer queue is full (SD_SRV_INDEXER_QUEUE_SIZE files), 
+so the memory usage does not depend on the tree size.
+
+- DirFullPath: Pointer to the string containing the full path of the directory.
+- DirRelativePath: Pointer to the string containing the relative path of the directory.
+- Indexer: Reference to the indexer state.
 
 Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
 was achieved, but related issues were encountered (information is logged, thereby).
@@ -816,7 +1149,6 @@ was achieved, but related issues were encountered (information is logged, thereb
     DIR             *dirStream;
     struct dirent   *file;
     struct stat     fileStat;
-    char            hashCode[SD_HASH_CODE_LENGTH+1];
     char            fileFullPath[SD_MAX_PATH_LENGTH];
 
 
@@ -825,18 +1157,17 @@ was achieved, but related issues were encountered (information is logged, thereb
     status = STATUS_FAIL;
     dirStream = NULL;
     file = NULL;
-    hashCode[0] = 0;
 
     // Parameter validation.
 
     if (NULL == DirFullPath || 0 == DirFullPath[0])
     {
-        printf("[SyncDir] Error: BuildHashInfoForEachFile(): Invalid parameter 1.\n");
+        printf("[SyncDir] Error: WalkDirForHashIndexer(): Invalid parameter 1.\n");
         return STATUS_FAIL;
     }
     if (NULL == DirRelativePath || 0 == DirRelativePath[0])
     {
-        printf("[SyncDir] Error: BuildHashInfoForEachFile(): Invalid parameter 2.\n");
+        printf("[SyncDir] Error: WalkDirForHashIndexer(): Invalid parameter 2.\n");
         return STATUS_FAIL;
     }
 
@@ -850,7 +1181,7 @@ was achieved, but related issues were encountered (information is logged, thereb
         dirStream = opendir(DirFullPath);
         if (NULL == dirStream)
         {
-            perror("[SyncDir] Error: BuildHashInfoForEachFile(): could not execute opendir().\n");
+            perror("[SyncDir] Error: WalkDirForHashIndexer(): could not execute opendir().\n");
             status = STATUS_WARNING;
             throw SyncDirException();
             // File may not exist anymore, or the user renamed/moved the file meanwhile.
@@ -861,9 +1192,6 @@ was achieved, but related issues were encountered (information is logged, thereb
 
         while (1)
         {
-            hashCode[0] = 0;                                                     // Init.
-
-
             // >Get next directory entry.
 
             file = readdir(dirStream);
@@ -881,7 +1209,7 @@ was achieved, but related issues were encountered (information is logged, thereb
 
             if (fstatat(dirfd(dirStream), file->d_name, &fileStat, AT_SYMLINK_NOFOLLOW) < 0)
             {
-                perror("[SyncDir] Warning: BuildHashInfoForEachFile(): could not execute fstatat(). \n");
+                perror("[SyncDir] Warning: WalkDirForHashIndexer(): could not execute fstatat(). \n");
                 printf("fstatat() warning was for the file [%s].\n", file->d_name);
                                                                                 // Possibly the file was (re)moved meanwhile. (Or altered.)
                 continue;
@@ -893,37 +1221,37 @@ was achieved, but related issues were encountered (information is logged, thereb
             sprintf(fileFullPath, "%s/%s", DirFullPath, file->d_name);
 
 
-            // If file is non-directory.
-            // Build new HashInfo.
-            // Store the new HashInfo.
+            // If file is non-directory (and not a partial file, see IsPartialFileName()).
+            // Submit it to the hashing workers (wait while the queue is full).
 
+            if (!(S_ISDIR(fileStat.st_mode)) && TRUE == IsPartialFileName(file->d_name))
+            {
+                continue;
+            }
             if (!(S_ISDIR(fileStat.st_mode)))
             {
-                HASH_INFO   hashInfo;
-                char        formatPath[SD_MAX_PATH_LENGTH];
+                HASH_INDEX_ITEM item;
+                char            formatPath[SD_MAX_PATH_LENGTH];
 
 
                 snprintf(formatPath, SD_MAX_PATH_LENGTH, "%s/%s", DirRelativePath, file->d_name);
-                hashInfo.FileRelativePath.assign(formatPath);                       // equivalent to operator=(const char*)
-                hashInfo.FileSize = fileStat.st_size;
+                item.FileFullPath.assign(fileFullPath);
+                item.HashInfo.FileRelativePath.assign(formatPath);                  // equivalent to operator=(const char*)
+                item.HashInfo.FileSize = fileStat.st_size;
 
-                status = MD5HashOfFile(fileFullPath, hashCode);                      // Note: For now, use MD5 hash algorithm for each file.
-                if (!(SUCCESS(status)))
                 {
-                    printf("[SyncDir] Warning: BuildHashInfoForEachFile(): Hash code function failed for file [%s].\n", fileFullPath);
-                                                                                    // Maybe file was altered (deleted) meanwhile.
-                    status = STATUS_WARNING;     
-                    continue;             
-                }
+                    std::unique_lock<std::mutex> lock(Indexer.Lock);
 
-                hashInfo.HashCode.assign(hashCode);                                 // equivalent to operator=(const char*)
+                    Indexer.QueueNotFull.wait(lock, [&Indexer] { return Indexer.Queue.size() < SD_SRV_INDEXER_QUEUE_SIZE; });
 
-                HashInfoHMap[hashInfo.HashCode] = hashInfo;
-                HashInfoHMap[hashInfo.FileRelativePath] = hashInfo;                 // For quick access by file path.
-                                                                                    // Average access time: O(1). Excluding O(hash).
+                    item.Sequence = Indexer.SubmittedFiles;
+                    Indexer.SubmittedFiles++;
+                    Indexer.SubmittedBytes += item.HashInfo.FileSize;
+                    Indexer.Queue.push_back(std::move(item));
 
-                fprintf(g_SD_STDLOG, "[SyncDir] Info: Added HashInfo: \n - hash code [%s], \n - relative path [%s], \n - file size [%u]. \n",
-                    hashInfo.HashCode.c_str(), hashInfo.FileRelativePath.c_str(), hashInfo.FileSize);
+                    ReportHashIndexerProgress(Indexer, FALSE);
+                }
+                Indexer.QueueNotEmpty.notify_one();
 
                 continue;
             }
@@ -943,10 +1271,10 @@ was achieved, but related issues were encountered (information is logged, thereb
                 fprintf(g_SD_STDLOG, "[SyncDir] Info: Recursive call: Create HashInfo's for files inside: \n - directory full path [%s] \n"
                     " - directory relative path [%s] \n", tempFullPath, tempRelativePath);
 
-                status = BuildHashInfoForEachFile(tempFullPath, tempRelativePath, HashInfoHMap);
+                status = WalkDirForHashIndexer(tempFullPath, tempRelativePath, Indexer);
                 if (!(SUCCESS(status)))
                 {
-                    perror("[SyncDir] Error: BuildHashInfoForEachFile(): Error at function recursive call.\n");
+                    perror("[SyncDir] Error: WalkDirForHashIndexer(): Error at function recursive call.\n");
                     status = STATUS_FAIL;
                     throw SyncDirException();                    
                 }                
@@ -966,12 +1294,12 @@ was achieved, but related issues were encountered (information is logged, thereb
     }
     __catch (const std::exception &e)
     {
-        cout << "[SyncDir] Error: BuildHashInfoForEachFile(): Standard Exception caught: " << e.what() << "\n";        
+        cout << "[SyncDir] Error: WalkDirForHashIndexer(): Standard Exception caught: " << e.what() << "\n";        
         status = STATUS_FAIL;
     }
     __catch (...)
     {
-        printf("[SyncDir] Error: BuildHashInfoForEachFile(): Unkown exception.\n");
+        printf("[SyncDir] Error: WalkDirForHashIndexer(): Unkown exception.\n");
         status = STATUS_FAIL;
     }
 
@@ -994,8 +1322,380 @@ was achieved, but related issues were encountered (information is logged, thereb
         }
     }
 
+    return status;
+} // WalkDirForHashIndexer()
+
+
+
+//
+// BuildHashInfoForEachFile
+//
+SDSTATUS
+BuildHashInfoForEachFile(
+    __in const char     *DirFullPath,
+    __in const char     *DirRelativePath,
+    __out std::unordered_map<std::string, HASH_INFO> & HashInfoHMap,
+    __out std::unordered_map<std::string, CHUNK_INFO> & ChunkInfoHMap
+    )
+/*++
+Description: The routine builds the map containing all the HASH_INFO structures of every file inside the DirFullPath directory and its
+subdirectories. These structures are made accessible through the hash code of the file (algorithm: gHashAlgorithm) and thorugh the file 
+relative path. The chunks of the large files (see ChunksOfServerFile()) are indexed in ChunkInfoHMap.
+The files are hashed in parallel: the calling thread walks the directory tree (WalkDirForHashIndexer) and feeds a bounded queue, from
+which SD_SRV_INDEXER_THREADS workers (HashIndexerWorker) hash the files. The results are merged into HashInfoHMap by the calling thread
+only, in the order of the walk (so that, for equal hash codes, the same path is kept as with a sequential walk). The progress and
+throughput are logged every SD_SRV_INDEXER_PROGRESS_INTERVAL seconds.
+
+- DirFullPath: Reference to the string containing the full path of the directory.
+- DirRelativePath: Reference to the string containing the relative path of the directory.
+- HahsInfoHMap: Reference to the map where the routine stores all the HASH_INFO structures.
+- ChunkInfoHMap: Reference to the map where the routine stores the CHUNK_INFO structures (key: hash code of the chunk).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise. STATUS_WARNING may be returned if the main purpose of the routine
+was achieved, but related issues were encountered (information is logged, thereby).
+--*/
+{
+    SDSTATUS                    status;
+    HASH_INDEXER                indexer;
+    std::vector<std::thread>    workers;
+    DWORD                       numberOfWorkers;
+
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    numberOfWorkers = SD_SRV_INDEXER_THREADS;
+    indexer.IsWalkDone = FALSE;
+    indexer.SubmittedFiles = 0;
+    indexer.SubmittedBytes = 0;
+    indexer.HashedFiles = 0;
+    indexer.HashedBytes = 0;
+    indexer.FailedFiles = 0;
+    indexer.StartTime = std::chrono::steady_clock::now();
+    indexer.LastReportTime = indexer.StartTime;
+
+    // Parameter validation.
+
+    if (NULL == DirFullPath || 0 == DirFullPath[0])
+    {
+        printf("[SyncDir] Error: BuildHashInfoForEachFile(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == DirRelativePath || 0 == DirRelativePath[0])
+    {
+        printf("[SyncDir] Error: BuildHashInfoForEachFile(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+
+    __try
+    {
+        // INIT.
+
+        if (0 == numberOfWorkers)
+        {
+            numberOfWorkers = std::thread::hardware_concurrency();
+        }
+        if (0 == numberOfWorkers)
+        {
+            numberOfWorkers = 1;                                            // Unknown number of CPUs.
+        }
+
+        printf("[SyncDir] Info: BuildHashInfoForEachFile(): Indexing [%s] with [%u] hashing threads ... \n", DirFullPath, numberOfWorkers);
+
+        for (DWORD index = 0; index < numberOfWorkers; index++)
+        {
+            workers.emplace_back(HashIndexerWorker, &indexer);
+        }
+
+
+
+        //
+        // Main processing:
+        //
+
+
+        // Walk the tree, feeding the workers.
+
+        status = WalkDirForHashIndexer(DirFullPath, DirRelativePath, indexer);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: BuildHashInfoForEachFile(): WalkDirForHashIndexer() failed.\n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // Wait for the workers to finish. Report progress meanwhile.
+
+        {
+            std::unique_lock<std::mutex> lock(indexer.Lock);
+
+            indexer.IsWalkDone = TRUE;
+            indexer.QueueNotEmpty.notify_all();
+
+            while (indexer.HashedFiles + indexer.FailedFiles < indexer.SubmittedFiles)
+            {
+                indexer.ItemDone.wait_for(lock, std::chrono::seconds(1));
+                ReportHashIndexerProgress(indexer, FALSE);
+            }
+            ReportHashIndexerProgress(indexer, TRUE);
+        }
+
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        workers.clear();
+
+        if (0 != indexer.FailedFiles)
+        {
+            status = STATUS_WARNING;
+        }
+
+
+        // Merge step (single thread): insert the HashInfo's, in the order of the walk.
+
+        std::sort(indexer.Results.begin(), indexer.Results.end(), 
+            [] (const HASH_INDEX_ITEM &First, const HASH_INDEX_ITEM &Second) { return First.Sequence < Second.Sequence; });
+
+        HashInfoHMap.reserve(HashInfoHMap.size() + 2 * indexer.Results.size());
+
+        for (HASH_INDEX_ITEM &item : indexer.Results)
+        {
+            HashInfoHMap[item.HashInfo.HashCode] = item.HashInfo;
+            HashInfoHMap[item.HashInfo.FileRelativePath] = item.HashInfo;       // For quick access by file path.
+                                                                                // Average access time: O(1). Excluding O(hash).
+
+            fprintf(g_SD_STDLOG, "[SyncDir] Info: Added HashInfo: \n - hash code [%s], \n - relative path [%s], \n - file size [%llu]. \n",
+                item.HashInfo.HashCode.c_str(), item.HashInfo.FileRelativePath.c_str(), (unsigned long long) item.HashInfo.FileSize);
+
+            InsertChunkInfosOfFile(item.HashInfo.FileRelativePath.c_str(), item.Chunks, ChunkInfoHMap);
+        }
+
+        printf("[SyncDir] Info: BuildHashInfoForEachFile(): [%zu] distinct chunks indexed. \n", ChunkInfoHMap.size());
+
+
+        // If here, everything is ok.
+        status = SUCCESS_KEEP_WARNING(status);
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: BuildHashInfoForEachFile(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: BuildHashInfoForEachFile(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        // Nothing to clean. The workers were joined.
+    }
+    else
+    {
+        // Stop the workers (the remaining queued files are dropped).
+        {
+            std::lock_guard<std::mutex> lock(indexer.Lock);
+
+            indexer.Queue.clear();
+            indexer.IsWalkDone = TRUE;
+        }
+        indexer.QueueNotEmpty.notify_all();
+
+        for (std::thread &worker : workers)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+    }
+
     return status;
 } // BuildHashInfoForEachFile()
 
 
 
+
+
+//
+// BuildDirDigestsOfServerTree
+//
+SDSTATUS
+BuildDirDigestsOfServerTree(
+    __in const char                                         *DirFullPath,
+    __in const char                                         *DirRelativePath,
+    __in const std::unordered_map<std::string, HASH_INFO>   & HashInfoHMap,
+    __inout std::unordered_map<std::string, std::string>    & DirDigestHMap,
+    __out std::string                                       & DirDigest
+    )
+/*++
+Description: The routine computes (post-order) the digests of the DirFullPath directory and of all its subdirectories, and stores them
+in DirDigestHMap, by the relative paths of the directories. Only the directory entries are listed: the content hash codes of the files
+are taken from HashInfoHMap (path keys), so no file is read. A file without HashInfo makes the digest unknown (""), so that the client
+synchronizes that directory as before.
+
+- DirFullPath: Pointer to the string containing the full path of the directory.
+- DirRelativePath: Pointer to the string containing the relative path of the directory.
+- HashInfoHMap: Reference to the map of the HASH_INFO structures of the server files.
+- DirDigestHMap: Reference to the hash map where the routine stores the digests (key: relative path of the directory).
+- DirDigest: Reference to where the routine outputs the digest of the DirFullPath directory ("" if unknown).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+--*/
+{
+    SDSTATUS                        status;
+    DIR                             *dirStream;
+    struct dirent                   *file;
+    struct stat                     fileStat;
+    std::vector<DIR_DIGEST_ENTRY>   entries;
+    DIR_DIGEST_ENTRY                entry;
+    char                            fileFullPath[SD_MAX_PATH_LENGTH];
+    char                            fileRelativePath[SD_MAX_PATH_LENGTH];
+    char                            dirDigest[SD_MAX_HASH_CODE_LENGTH + 1];
+    std::string                     childDigest;
+    std::unordered_map<std::string, HASH_INFO>::const_iterator iteratorHI;
+
+    // PREINIT.
+
+    status = STATUS_FAIL;
+    dirStream = NULL;
+    file = NULL;
+    dirDigest[0] = 0;
+    DirDigest.clear();
+
+    // Parameter validation.
+
+    if (NULL == DirFullPath || 0 == DirFullPath[0])
+    {
+        printf("[SyncDir] Error: BuildDirDigestsOfServerTree(): Invalid parameter 1.\n");
+        return STATUS_FAIL;
+    }
+    if (NULL == DirRelativePath || 0 == DirRelativePath[0])
+    {
+        printf("[SyncDir] Error: BuildDirDigestsOfServerTree(): Invalid parameter 2.\n");
+        return STATUS_FAIL;
+    }
+
+
+    __try
+    {
+        // INIT.
+
+        dirStream = opendir(DirFullPath);
+        if (NULL == dirStream)
+        {
+            perror("[SyncDir] Warning: BuildDirDigestsOfServerTree(): Could not execute opendir(). Digest unknown.\n");
+            printf("The error was for path [%s] \n", DirFullPath);
+            status = STATUS_SUCCESS;
+            throw SyncDirException();
+        }
+
+
+        // Main processing:
+
+        while (NULL != (file = readdir(dirStream)))
+        {
+            if (0 == strcmp(".", file->d_name) || 0 == strcmp("..", file->d_name))
+            {
+                continue;
+            }
+
+            snprintf(fileFullPath, SD_MAX_PATH_LENGTH, "%s/%s", DirFullPath, file->d_name);
+            snprintf(fileRelativePath, SD_MAX_PATH_LENGTH, "%s/%s", DirRelativePath, file->d_name);
+
+            if (lstat(fileFullPath, &fileStat) < 0 || (S_ISREG(fileStat.st_mode) && TRUE == IsPartialFileName(file->d_name)))
+            {
+                continue;
+            }
+
+            memset(&entry, 0, sizeof(entry));
+            entry.Type = DirDigestEntryType(fileStat.st_mode);
+            snprintf(entry.Name, sizeof(entry.Name), "%s", file->d_name);
+
+            if (SD_DIR_DIGEST_ENTRY_DIRECTORY == entry.Type)
+            {
+                status = BuildDirDigestsOfServerTree(fileFullPath, fileRelativePath, HashInfoHMap, DirDigestHMap, childDigest);
+                if (!(SUCCESS(status)))
+                {
+                    printf("[SyncDir] Error: BuildDirDigestsOfServerTree(): Recursive call failed. \n");
+                    status = STATUS_FAIL;
+                    throw SyncDirException();
+                }
+                snprintf(entry.HashCode, sizeof(entry.HashCode), "%s", childDigest.c_str());
+            }
+            if (SD_DIR_DIGEST_ENTRY_FILE == entry.Type)
+            {
+                iteratorHI = HashInfoHMap.find(fileRelativePath);
+                if (HashInfoHMap.end() != iteratorHI)
+                {
+                    snprintf(entry.HashCode, sizeof(entry.HashCode), "%s", iteratorHI->second.HashCode.c_str());
+                }
+            }
+
+            entries.push_back(entry);
+        }
+
+        status = DirDigestOfEntries(gHashAlgorithm, entries.data(), (DWORD) entries.size(), dirDigest);
+        if (!(SUCCESS(status)))
+        {
+            printf("[SyncDir] Error: BuildDirDigestsOfServerTree(): DirDigestOfEntries() failed. \n");
+            status = STATUS_FAIL;
+            throw SyncDirException();
+        }
+
+
+        // If here, everything is ok.
+        status = STATUS_SUCCESS;
+
+    } // --> __try
+    __catch (const SyncDirException &e)
+    {
+        cout << e.what() << "\n";        
+        //status = STATUS_FAIL;
+    }
+    __catch (const std::exception &e)
+    {
+        cout << "[SyncDir] Error: BuildDirDigestsOfServerTree(): Standard Exception caught: " << e.what() << "\n";        
+        status = STATUS_FAIL;
+    }
+    __catch (...)
+    {
+        printf("[SyncDir] Error: BuildDirDigestsOfServerTree(): Unkown exception.\n");
+        status = STATUS_FAIL;
+    }
+
+
+    // UNINIT. Cleanup.
+    if (SUCCESS(status))
+    {
+        if (NULL != dirStream)
+        {
+            closedir(dirStream);
+            dirStream = NULL;
+        }
+
+        DirDigest.assign(dirDigest);
+        DirDigestHMap[DirRelativePath] = DirDigest;
+    }
+    else
+    {
+        if (NULL != dirStream)
+        {
+            closedir(dirStream);
+            dirStream = NULL;
+        }
+    }
+
+    return status;
+} // BuildDirDigestsOfServerTree()
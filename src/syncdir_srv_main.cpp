@@ -54,8 +54,12 @@ was achieved, but related issues were encountered (information is logged, thereb
     BOOL                isSymLink;
     BOOL                isDirValid;
     socklen_t           lenCltAddr;
+    int                 keepAliveOption;
     struct sockaddr_in  cltAddr;                                                // Client address info.    
     std::unordered_map<std::string, HASH_INFO> hashInfoHMap;
+    std::unordered_map<std::string, CHUNK_INFO> chunkInfoHMap;                 // Chunk index (key: chunk hash code).
+    std::unordered_map<DWORD, PENDING_TRANSFER> pendingTransferHMap;           // MODIFY's answered, content to come (key: request ID).
+    STRIPE_RECEIVER                             stripeReceiver;                // Data connections of the session.
 
     // PREINIT.
     
@@ -68,6 +72,7 @@ was achieved, but related issues were encountered (information is logged, thereb
     isSymLink = TRUE;
     isDirValid = FALSE;
     lenCltAddr = 0;
+    keepAliveOption = 0;
     
     // Validate parameters (start).
     
@@ -134,6 +139,12 @@ was achieved, but related issues were encountered (information is logged, thereb
         // Global log file stream. Init.
         g_SD_STDLOG = stdout;
 
+        // Content hash algorithm of the server hash index (offered to every client at handshake).
+        gHashAlgorithm = SD_SRV_HASH_ALGORITHM;
+
+        // A client lost while the server sends to it must end its session only (send() fails), not the server.
+        signal(SIGPIPE, SIG_IGN);
+
         // Initialize server port and client address length for connection acceptance.
         srvPort = atoi(MainArgv[1]);
         lenCltAddr = sizeof(cltAddr);
@@ -155,15 +166,17 @@ was achieved, but related issues were encountered (information is logged, thereb
 
 
         // Build the HashInfo's of all files on the server and store them in a hash map (hashInfoHMap).
+        // Index the chunks of the large files as well (chunkInfoHMap).
 
-        status = BuildHashInfoForEachFile(mainDirFullPath, ".", hashInfoHMap);
+        status = BuildHashInfoForEachFile(mainDirFullPath, ".", hashInfoHMap, chunkInfoHMap);
         if (!(SUCCESS(status)))
         {
             printf("[SyncDir] Error: MainSrvRoutine(): Failed at BuildHashInfoForEachFile(). \n");
             status = STATUS_FAIL;
             throw SyncDirException();
         }
-        printf("[SyncDir] Info: HashInfo's were built for all files on the SyncDir server. \n");
+        printf("[SyncDir] Info: HashInfo's were built for all files on the SyncDir server (hash algorithm: %s). \n", 
+            GetHashProvider(gHashAlgorithm)->Name);
 
 
 
@@ -203,6 +216,41 @@ was achieved, but related issues were encountered (information is logged, thereb
             }
             printf("[SyncDir] Info: SyncDir client connected successfully!\n");
 
+            // Detect a client lost without closing the connection (e.g. network down): its session ends, so that it can reconnect.
+            keepAliveOption = 1;
+            setsockopt(sockConnID, SOL_SOCKET, SO_KEEPALIVE, &keepAliveOption, sizeof(keepAliveOption));
+            keepAliveOption = SD_SRV_KEEPALIVE_IDLE;
+            setsockopt(sockConnID, IPPROTO_TCP, TCP_KEEPIDLE, &keepAliveOption, sizeof(keepAliveOption));
+            keepAliveOption = SD_SRV_KEEPALIVE_INTERVAL;
+            setsockopt(sockConnID, IPPROTO_TCP, TCP_KEEPINTVL, &keepAliveOption, sizeof(keepAliveOption));
+            keepAliveOption = SD_SRV_KEEPALIVE_PROBES;
+            setsockopt(sockConnID, IPPROTO_TCP, TCP_KEEPCNT, &keepAliveOption, sizeof(keepAliveOption));
+
+            status = SrvNegotiateSessionWithClient(sockConnID, stripeReceiver);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: MainSrvRoutine(): Failed at SrvNegotiateSessionWithClient(). Closing the connection ...\n");
+                close(sockConnID);
+                sockConnID = -1;
+                continue;
+            }
+
+            status = SrvAcceptDataConnections(srvSock, stripeReceiver);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Warning: MainSrvRoutine(): Failed at SrvAcceptDataConnections(). Continuing on the control connection ...\n");
+            }
+
+            status = SrvReconcileDirDigestsWithClient(mainDirFullPath, hashInfoHMap, sockConnID);
+            if (!(SUCCESS(status)))
+            {
+                printf("[SyncDir] Error: MainSrvRoutine(): Failed at SrvReconcileDirDigestsWithClient(). Closing the connection ...\n");
+                SrvCloseDataConnections(stripeReceiver);
+                close(sockConnID);
+                sockConnID = -1;
+                continue;
+            }
+
 
 
             while (1)
@@ -211,7 +259,8 @@ was achieved, but related issues were encountered (information is logged, thereb
                 printf("[#%lu] ----------------------------------------\n", opCount);
                 opCount ++;
 
-                status = RecvAndExecuteOperationFromClient(mainDirFullPath, hashInfoHMap, sockConnID);
+                status = RecvAndExecuteOperationFromClient(mainDirFullPath, hashInfoHMap, chunkInfoHMap, pendingTransferHMap, stripeReceiver, 
+                                                           sockConnID);
                 if (!(SUCCESS(status)))
                 {
                     printf("[SyncDir] Error: MainSrvRoutine(): Failed at RecvAndExecuteOperationFromClient(). \n");
@@ -221,6 +270,11 @@ was achieved, but related issues were encountered (information is logged, thereb
                 }        
                 printf("[SyncDir] Info: Server updated. Operation received from SyncDir client and executed. \n");
             }
+
+            // The request IDs are those of the closed connection. The files received are synced to disk before the next session.
+            SrvCloseDataConnections(stripeReceiver);
+            ReleasePendingTransfers(pendingTransferHMap);
+            CommitReceivedFiles(mainDirFullPath);
         }
 
 
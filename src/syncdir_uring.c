@@ -0,0 +1,477 @@
+
+/*
+* SPDX-FileCopyrightText: Copyright © 2022 Mihai-Ioan Popescu <mihai.popescu.d12@gmail.com>
+*
+* SPDX-License-Identifier: Apache-2.0
+*/
+
+
+#include "syncdir_uring.h"
+
+
+
+/*++
+The submission and the completion rings are shared with the kernel: the routines produce the submission entries and consume the
+completions, the kernel does the opposite. The indexes written for the kernel are stored with release semantics, the ones written
+by the kernel are loaded with acquire semantics. The user_data of an operation is the index of its buffer.
+--*/
+
+
+
+#ifdef __NR_io_uring_setup
+
+
+
+#ifndef IORING_SETUP_DEFER_TASKRUN
+    #define IORING_SETUP_SINGLE_ISSUER (1U << 12)                       // Linux 6.1 (older headers).
+    #define IORING_SETUP_DEFER_TASKRUN (1U << 13)
+#endif
+
+
+
+//
+// Internal helpers.
+//
+
+static inline __int32
+UringEnter(
+    __in __int32    RingFd,
+    __in unsigned   ToSubmit,
+    __in unsigned   MinComplete,
+    __in unsigned   Flags
+    )
+{
+    long    result;
+
+    do
+    {
+        result = syscall(__NR_io_uring_enter, RingFd, ToSubmit, MinComplete, Flags, NULL, 0);
+    } while (result < 0 && EINTR == errno);
+
+    return (__int32) result;
+}
+
+
+static void
+UringReapCompletions(
+    __inout URING   *Uring
+    )
+{
+    unsigned                head;
+    unsigned                tail;
+    struct io_uring_cqe     *cqe;
+
+    head = *Uring->CqHead;
+    tail = __atomic_load_n(Uring->CqTail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head ++)
+    {
+        cqe = &((struct io_uring_cqe*) Uring->Cqes)[head & (*Uring->CqMask)];
+        if (cqe->user_data < Uring->QueueDepth)
+        {
+            Uring->Results[cqe->user_data] = cqe->res;
+            Uring->IsPending[cqe->user_data] = FALSE;
+        }
+    }
+
+    __atomic_store_n(Uring->CqHead, head, __ATOMIC_RELEASE);
+}
+
+
+static SDSTATUS
+UringSubmit(
+    __inout URING   *Uring,
+    __in BOOL       IsWrite,
+    __in DWORD      BufferIndex,
+    __in __int32    FileDescriptor,
+    __in DWORD      Length,
+    __in QWORD      Offset
+    )
+{
+    unsigned                tail;
+    unsigned                index;
+    struct io_uring_sqe     *sqe;
+
+    if (Uring->RingFd < 0 || BufferIndex >= Uring->QueueDepth || TRUE == Uring->IsPending[BufferIndex] || Length > Uring->BufferSize)
+    {
+        printf("[SyncDir] Error: UringSubmit(): Invalid parameters.\n");
+        return STATUS_FAIL;
+    }
+
+    tail = *Uring->SqTail;                                              // Written by this thread only.
+    index = tail & (*Uring->SqMask);
+    sqe = &((struct io_uring_sqe*) Uring->Sqes)[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (TRUE == Uring->IsRegistered)
+    {
+        sqe->opcode = (TRUE == IsWrite) ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = (__u16) BufferIndex;
+    }
+    else
+    {
+        sqe->opcode = (TRUE == IsWrite) ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd = FileDescriptor;
+    sqe->addr = (__u64) (uintptr_t) Uring->Buffers[BufferIndex];
+    sqe->len = Length;
+    sqe->off = Offset;
+    sqe->user_data = BufferIndex;
+    Uring->SqArray[index] = index;
+
+    __atomic_store_n(Uring->SqTail, tail + 1, __ATOMIC_RELEASE);
+    Uring->IsPending[BufferIndex] = TRUE;
+
+    if (1 != UringEnter(Uring->RingFd, 1, 0, 0))
+    {
+        perror("[SyncDir] Error: UringSubmit(): Error at io_uring_enter().\n");
+        __atomic_store_n(Uring->SqTail, tail, __ATOMIC_RELEASE);        // Not consumed by the kernel: withdrawn, not sent later.
+        Uring->IsPending[BufferIndex] = FALSE;
+        return STATUS_FAIL;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+
+
+//
+// UringSetup
+//
+SDSTATUS
+UringSetup(
+    __out URING         *Uring,
+    __in DWORD          QueueDepth,
+    __in BYTE           **Buffers,
+    __in DWORD          BufferSize
+    )
+/*++
+Description: The routine creates an io_uring instance for QueueDepth operations in flight, one on each of the given buffers, and
+registers the buffers with the kernel.
+
+- Uring: Pointer to the URING to set up. On failure, it is left not set up.
+- QueueDepth: Number of buffers (at most SD_URING_MAX_QUEUE_DEPTH).
+- Buffers: Array of QueueDepth pointers to the buffers, of BufferSize bytes each.
+- BufferSize: Size of each buffer, in bytes.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (io_uring not available).
+--*/
+{
+    struct io_uring_params  params;
+    struct iovec            iovecs[SD_URING_MAX_QUEUE_DEPTH];
+    void                    *mapping;
+    DWORD                   i;
+
+    memset(Uring, 0, sizeof(*Uring));
+    Uring->RingFd = -1;
+
+    if (0 == QueueDepth || QueueDepth > SD_URING_MAX_QUEUE_DEPTH || NULL == Buffers || 0 == BufferSize)
+    {
+        printf("[SyncDir] Error: UringSetup(): Invalid parameters.\n");
+        return STATUS_FAIL;
+    }
+
+    // Completions run only when the ring is waited for (IORING_SETUP_DEFER_TASKRUN): otherwise, they interrupt the system calls of 
+    // the thread, as a signal would (e.g. a recv() waiting for all its bytes returns fewer). Older kernels: no ring.
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    Uring->RingFd = (__int32) syscall(__NR_io_uring_setup, QueueDepth, &params);
+    if (Uring->RingFd < 0)
+    {
+        Uring->RingFd = -1;
+        return STATUS_FAIL;                                             // ENOSYS, EPERM (io_uring disabled), EINVAL: silent fallback.
+    }
+
+    // Map the rings. The completion ring may share the mapping of the submission ring (IORING_FEAT_SINGLE_MMAP).
+
+    Uring->SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    Uring->CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        Uring->SqRingSize = SD_MAX(Uring->SqRingSize, Uring->CqRingSize);
+    }
+
+    mapping = mmap(NULL, Uring->SqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Uring->RingFd, IORING_OFF_SQ_RING);
+    if (MAP_FAILED == mapping)
+    {
+        perror("[SyncDir] Warning: UringSetup(): Error at mmap() (submission ring).\n");
+        UringTeardown(Uring);
+        return STATUS_FAIL;
+    }
+    Uring->SqRing = mapping;
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        mapping = mmap(NULL, Uring->CqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Uring->RingFd, IORING_OFF_CQ_RING);
+        if (MAP_FAILED == mapping)
+        {
+            perror("[SyncDir] Warning: UringSetup(): Error at mmap() (completion ring).\n");
+            UringTeardown(Uring);
+            return STATUS_FAIL;
+        }
+        Uring->CqRing = mapping;
+    }
+
+    Uring->SqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    mapping = mmap(NULL, Uring->SqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Uring->RingFd, IORING_OFF_SQES);
+    if (MAP_FAILED == mapping)
+    {
+        perror("[SyncDir] Warning: UringSetup(): Error at mmap() (submission entries).\n");
+        UringTeardown(Uring);
+        return STATUS_FAIL;
+    }
+    Uring->Sqes = mapping;
+
+    Uring->SqTail = (unsigned*) ((BYTE*) Uring->SqRing + params.sq_off.tail);
+    Uring->SqMask = (unsigned*) ((BYTE*) Uring->SqRing + params.sq_off.ring_mask);
+    Uring->SqArray = (unsigned*) ((BYTE*) Uring->SqRing + params.sq_off.array);
+    mapping = (NULL != Uring->CqRing) ? Uring->CqRing : Uring->SqRing;
+    Uring->CqHead = (unsigned*) ((BYTE*) mapping + params.cq_off.head);
+    Uring->CqTail = (unsigned*) ((BYTE*) mapping + params.cq_off.tail);
+    Uring->CqMask = (unsigned*) ((BYTE*) mapping + params.cq_off.ring_mask);
+    Uring->Cqes = (BYTE*) mapping + params.cq_off.cqes;
+
+    Uring->QueueDepth = QueueDepth;
+    Uring->BufferSize = BufferSize;
+
+    // Register the buffers. Not fatal: plain reads and writes (IORING_OP_READ/WRITE, same kernels as IORING_FEAT_RW_CUR_POS).
+
+    for (i = 0; i < QueueDepth; i ++)
+    {
+        Uring->Buffers[i] = Buffers[i];
+        iovecs[i].iov_base = Buffers[i];
+        iovecs[i].iov_len = BufferSize;
+    }
+
+    if (0 == syscall(__NR_io_uring_register, Uring->RingFd, IORING_REGISTER_BUFFERS, iovecs, QueueDepth))
+    {
+        Uring->IsRegistered = TRUE;
+    }
+    else if (!(params.features & IORING_FEAT_RW_CUR_POS))
+    {
+        UringTeardown(Uring);                                           // Kernel without IORING_OP_READ/WRITE.
+        return STATUS_FAIL;
+    }
+
+    return STATUS_SUCCESS;
+} // UringSetup()
+
+
+
+//
+// UringTeardown
+//
+void
+UringTeardown(
+    __inout URING       *Uring
+    )
+/*++
+Description: The routine waits for the operations still in flight, then destroys the ring. The buffers are left to the caller.
+
+- Uring: Pointer to the URING (set up or not).
+
+Return value: None.
+--*/
+{
+    __int32     result;
+    DWORD       i;
+
+    if (Uring->RingFd < 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < Uring->QueueDepth; i ++)
+    {
+        UringWaitBuffer(Uring, i, &result);
+    }
+
+    if (NULL != Uring->Sqes)
+    {
+        munmap(Uring->Sqes, Uring->SqesSize);
+    }
+    if (NULL != Uring->CqRing)
+    {
+        munmap(Uring->CqRing, Uring->CqRingSize);
+    }
+    if (NULL != Uring->SqRing)
+    {
+        munmap(Uring->SqRing, Uring->SqRingSize);
+    }
+    close(Uring->RingFd);                                               // Also unregisters the buffers.
+
+    Uring->RingFd = -1;
+    Uring->Sqes = NULL;
+    Uring->CqRing = NULL;
+    Uring->SqRing = NULL;
+} // UringTeardown()
+
+
+
+//
+// UringSubmitRead
+//
+SDSTATUS
+UringSubmitRead(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __in __int32        FileDescriptor,
+    __in DWORD          Length,
+    __in QWORD          Offset
+    )
+/*++
+Description: The routine starts reading Length bytes of the file, at Offset, into the buffer BufferIndex.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the read was not started).
+--*/
+{
+    return UringSubmit(Uring, FALSE, BufferIndex, FileDescriptor, Length, Offset);
+} // UringSubmitRead()
+
+
+
+//
+// UringSubmitWrite
+//
+SDSTATUS
+UringSubmitWrite(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __in __int32        FileDescriptor,
+    __in DWORD          Length,
+    __in QWORD          Offset
+    )
+/*++
+Description: The routine starts writing the first Length bytes of the buffer BufferIndex to the file, at Offset.
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the write was not started).
+--*/
+{
+    return UringSubmit(Uring, TRUE, BufferIndex, FileDescriptor, Length, Offset);
+} // UringSubmitWrite()
+
+
+
+//
+// UringWaitBuffer
+//
+SDSTATUS
+UringWaitBuffer(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __out __int32       *Result
+    )
+/*++
+Description: The routine waits for the operation in flight on the buffer BufferIndex to complete (if any).
+
+- Result: Pointer to where the routine outputs the result of the last operation on the buffer (bytes, or -errno).
+
+Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise (the ring failed).
+--*/
+{
+    (*Result) = -EINVAL;
+
+    if (Uring->RingFd < 0 || BufferIndex >= Uring->QueueDepth)
+    {
+        printf("[SyncDir] Error: UringWaitBuffer(): Invalid parameters.\n");
+        return STATUS_FAIL;
+    }
+
+    UringReapCompletions(Uring);
+    while (TRUE == Uring->IsPending[BufferIndex])
+    {
+        if (UringEnter(Uring->RingFd, 0, 1, IORING_ENTER_GETEVENTS) < 0)
+        {
+            perror("[SyncDir] Error: UringWaitBuffer(): Error at io_uring_enter().\n");
+            return STATUS_FAIL;
+        }
+        UringReapCompletions(Uring);
+    }
+
+    (*Result) = Uring->Results[BufferIndex];
+
+    return STATUS_SUCCESS;
+} // UringWaitBuffer()
+
+
+
+#else //--> #ifdef __NR_io_uring_setup
+
+
+
+/*++
+No io_uring in the system headers: the ring is never set up, the callers do synchronous I/O.
+--*/
+
+SDSTATUS
+UringSetup(
+    __out URING         *Uring,
+    __in DWORD          QueueDepth,
+    __in BYTE           **Buffers,
+    __in DWORD          BufferSize
+    )
+{
+    (void) QueueDepth;
+    (void) Buffers;
+    (void) BufferSize;
+
+    memset(Uring, 0, sizeof(*Uring));
+    Uring->RingFd = -1;
+
+    return STATUS_FAIL;
+}
+
+void
+UringTeardown(
+    __inout URING       *Uring
+    )
+{
+    (void) Uring;
+}
+
+SDSTATUS
+UringSubmitRead(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __in __int32        FileDescriptor,
+    __in DWORD          Length,
+    __in QWORD          Offset
+    )
+{
+    (void) Uring; (void) BufferIndex; (void) FileDescriptor; (void) Length; (void) Offset;
+
+    return STATUS_FAIL;
+}
+
+SDSTATUS
+UringSubmitWrite(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __in __int32        FileDescriptor,
+    __in DWORD          Length,
+    __in QWORD          Offset
+    )
+{
+    (void) Uring; (void) BufferIndex; (void) FileDescriptor; (void) Length; (void) Offset;
+
+    return STATUS_FAIL;
+}
+
+SDSTATUS
+UringWaitBuffer(
+    __inout URING       *Uring,
+    __in DWORD          BufferIndex,
+    __out __int32       *Result
+    )
+{
+    (void) Uring;
+    (void) BufferIndex;
+    (*Result) = -ENOSYS;
+
+    return STATUS_FAIL;
+}
+
+
+
+#endif //--> #ifdef __NR_io_uring_setup
@@ -9,6 +9,11 @@
 #include "syncdir_utile.h"
 
 
+
+READ_QUOTA_ROUTINE gReadQuotaRoutine = NULL;                            // Definition. NULL: file reads are not limited.
+
+
+
 //
 // IsSymbolicLinkValid
 //
@@ -333,133 +338,62 @@ Return value: TRUE if the file exists, FALSE otherwise.
 
 
 //
-// MD5HashOfFile
+// BytesToHexString
 //
-SDSTATUS
-MD5HashOfFile(
-    __in char   *FileFullPath,
-    __out char  *MD5Hash
+void
+BytesToHexString(
+    __in const BYTE *Bytes,
+    __in DWORD      NumberOfBytes,
+    __out char      *HexString
     )
 /*++
-    Description: The routine outputs the MD5 hash for a given file content. The hash is output at the address pointed by MD5Hash.
-    The file is identified by FileFullPath.
+Description: The routine converts NumberOfBytes bytes to their lowercase hexadecimal representation (2 characters per byte, 
+'\0' terminated), as printed by md5sum.
 
-    - FileFullPath: Pointer to the full path of the file.
-    - MD5Hash: Pointer containing the address where the MD5 hash of the file is output. Storage must be caller provided.
-    
-    Return value: STATUS_SUCCESS on success, STATUS_FAIL otherwise.
+- Bytes: Pointer to the bytes to be converted.
+- NumberOfBytes: Number of bytes at Bytes.
+- HexString: Pointer to where the string is output. Storage of at least 2 * NumberOfBytes + 1 characters is provided by the caller.
+
+Return value: None.
 --*/
 {
-    SDSTATUS    status;
-    FILE        *commandPipe;
-    char        commandBuffer[SD_MAX_PATH_LENGTH + 30];
-    char        md5HashBuffer[SD_HASH_CODE_LENGTH + 1]; 
-
-    // PREINIT.
-
-    status = STATUS_FAIL;
-    commandPipe = NULL;
-    commandBuffer[0] = 0;
-    md5HashBuffer[0] = 0;
-
-    // Parameter validation.
-
-    if (NULL == FileFullPath)
-    {
-        perror("[SyncDir] Error: MD5HashOfFile(): Invalid parameter 1.\n");
-        return STATUS_FAIL;
-    }
-    if (!IsFileValid(FileFullPath))
-    {
-        perror("[SyncDir] Error: MD5HashOfFile(): Invalid parameter 1. (File does not exist.)\n");
-        return STATUS_FAIL;
-    }
-    if (NULL == MD5Hash)
-    {
-        perror("[SyncDir] Error: MD5HashOfFile(): Invalid parameter 2.\n");
-        return STATUS_FAIL;
-    }
-
-
-    //
-    // INIT.
-    //
-
-
-    // Initialize the command.
-    // Use awk to print the first "word" (md5sum returns 32 chars + space + md5sum flag + file name).
+    static const char hexDigits[] = "0123456789abcdef";
+    DWORD i;
 
-    sprintf(commandBuffer, "md5sum \"%s\" | awk '{print $1}'", FileFullPath);
-
-
-    // Initialize the command output pipe, to get the results.
-
-    commandPipe = popen(commandBuffer, "r");
-    if (NULL == commandPipe)
+    for (i = 0; i < NumberOfBytes; i ++)
     {
-        perror("[SyncDir] Error: MD5HashOfFile(): Error at popen().\n");
-        status = STATUS_FAIL;
-        goto cleanup_MD5HashOfFile;
+        HexString[2 * i] = hexDigits[Bytes[i] >> 4];
+        HexString[2 * i + 1] = hexDigits[Bytes[i] & 0x0F];
     }
+    HexString[2 * NumberOfBytes] = 0;
 
+} // BytesToHexString()
 
 
-    //
-    // Main processing.
-    //
-
-
-    // Get the MD5 hash of the file.
 
-    if (NULL == fgets(md5HashBuffer, sizeof(md5HashBuffer), commandPipe))
-    {
-        perror("[SyncDir] Warning: MD5HashOfFile(): EOF or error at fgets().\n");
-    }
-
-
-    // Output the MD5 hash.
-
-    strcpy(MD5Hash, md5HashBuffer);
-
-
-
-    // If here, everything worked well.
-    status = STATUS_SUCCESS;
+//
+// FileReadQuota
+//
+size_t
+FileReadQuota(
+    __in size_t     Wanted
+    )
+/*++
+Description: The routine returns how many of the Wanted bytes a file read may request now, as allowed by gReadQuotaRoutine (if set).
+The routine may wait, for the limits of the reads to allow them.
 
-    // UNINIT. Cleanup.
-    cleanup_MD5HashOfFile:
+- Wanted: Number of bytes the caller is about to read.
 
-    if (SUCCESS(status))
-    {
-        // Close pipe.
-        if (NULL != commandPipe)
-        {
-            if (-1 == pclose(commandPipe))
-            {
-                printf("[SyncDir] Warning: MD5HashOfFile(): Pipe close may not have succeeded.\n");
-            }
-            commandPipe = NULL;
-        }
-    }
-    else
+Return value: The number of bytes allowed (at most Wanted; not 0, unless Wanted is 0).
+--*/
+{
+    if (NULL == gReadQuotaRoutine || 0 == Wanted)
     {
-        // Close pipe.
-        if (NULL != commandPipe)
-        {
-            if (-1 == pclose(commandPipe))
-            {
-                printf("[SyncDir] Warning: MD5HashOfFile(): Pipe close may not have succeeded.\n");
-            }
-            commandPipe = NULL;
-        }
-
-        // Output NULL, on fail.
-        MD5Hash[0] = 0;
+        return Wanted;
     }
 
-    return status;
-} // MD5HashOfFile
-
+    return gReadQuotaRoutine(Wanted);
+} // FileReadQuota()
 
 
 